@@ -0,0 +1,3 @@
+CC = 'cc'
+prefix = '/usr/local'
+conf = {'top_dir': '/root/repo'}
@@ -99,7 +99,7 @@ allocate_menu(MenuItemList* list)
     MenuItemList* menu_items;
     char* string;
 }
-%token T_END T_EXEC T_EXIT T_MENU T_NEWLINE
+%token T_CASCADE T_END T_EXEC T_EXIT T_GRID T_MENU T_NEWLINE T_RELOAD T_RESTART T_TILE
 %type<menu> menu
 %type<menu_item> menu_item
 %type<menu_items> menu_items
@@ -138,6 +138,18 @@ menu_item
         | T_RELOAD {
             $$ = allocate_menu_item(MENU_ITEM_TYPE_RELOAD);
         }
+        | T_CASCADE {
+            $$ = allocate_menu_item(MENU_ITEM_TYPE_CASCADE);
+        }
+        | T_GRID {
+            $$ = allocate_menu_item(MENU_ITEM_TYPE_GRID);
+        }
+        | T_TILE {
+            $$ = allocate_menu_item(MENU_ITEM_TYPE_TILE);
+        }
+        | T_RESTART {
+            $$ = allocate_menu_item(MENU_ITEM_TYPE_RESTART);
+        }
         | /* empty */ {
             $$ = NULL;
         }
@@ -34,11 +34,9 @@ compute_size_of_menu_item(MenuItem* item)
 {
     size_t size = sizeof(MenuItem);
 
-    MenuItemType type = item->type;
-    if ((type == MENU_ITEM_TYPE_EXIT) || (type == MENU_ITEM_TYPE_RELOAD)) {
+    if (item->type != MENU_ITEM_TYPE_EXEC) {
         return size;
     }
-    assert(type == MENU_ITEM_TYPE_EXEC);
 
     size += align(strlen(item->u.exec.caption.ptr) + 1);
     size += align(strlen(item->u.exec.command.ptr) + 1);
@@ -85,6 +83,10 @@ serialize_menu_item(MenuItem* new_item, MenuItem* item, uintptr_t base, uintptr_
         break;
     case MENU_ITEM_TYPE_EXIT:
     case MENU_ITEM_TYPE_RELOAD:
+    case MENU_ITEM_TYPE_CASCADE:
+    case MENU_ITEM_TYPE_GRID:
+    case MENU_ITEM_TYPE_TILE:
+    case MENU_ITEM_TYPE_RESTART:
         break;
     default:
         assert(false);
@@ -0,0 +1,940 @@
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XTest.h>
+
+#include <fawm/config.h>
+
+/*
+ * End-to-end benchmarks of fawm. This starts Xvfb and fawm, drives fawm with
+ * XTest like a user, and prints results in JSON to stdout.
+ */
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+#define SAMPLES_MAX 64
+#define WINDOWS_MAX (1000 + SAMPLES_MAX)
+#define DRAG_MOTIONS_NUM 200
+#define TIMEOUT_USEC (5 * 1000 * 1000)
+#define IDLE_USEC (200 * 1000)
+#define SWITCH_WINDOWS_NUM 200
+#define COLD_START_WINDOWS_NUM 200
+
+/* Same as DESKTOPS_NUM of fawm. The window list starts after the pager. */
+#define DESKTOPS_NUM 4
+
+struct Samples {
+    int size;
+    int timeouts;
+    long values[SAMPLES_MAX];
+};
+
+typedef struct Samples Samples;
+
+struct Bench {
+    Display* display;
+    Window root;
+    Window windows[WINDOWS_MAX];
+    int windows_num;
+    int repeats;
+
+    Window taskbar;
+    int taskbar_x;
+    int taskbar_y;
+    int taskbar_width;
+    int taskbar_height;
+    Window menu;
+
+    const char* config_file;
+    int config_items_num;
+};
+
+typedef struct Bench Bench;
+
+static long
+get_monotonic_usec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000 * ts.tv_sec + ts.tv_nsec / 1000;
+}
+
+static void
+die(const char* msg)
+{
+    fprintf(stderr, "fawm-bench: %s\n", msg);
+    exit(1);
+}
+
+static void
+add_sample(Samples* samples, long value)
+{
+    if (SAMPLES_MAX <= samples->size) {
+        return;
+    }
+    samples->values[samples->size] = value;
+    samples->size++;
+}
+
+static int
+compare_longs(const void* a, const void* b)
+{
+    long n = *(const long*)a;
+    long m = *(const long*)b;
+    return n < m ? -1 : (m < n ? 1 : 0);
+}
+
+static void
+print_samples(const char* name, Samples* samples, const char* tail)
+{
+    int size = samples->size;
+    long* values = samples->values;
+    qsort(values, size, sizeof(values[0]), compare_longs);
+    long total = 0;
+    int i;
+    for (i = 0; i < size; i++) {
+        total += values[i];
+    }
+    long mean = 0 < size ? total / size : 0;
+    long p50 = 0 < size ? values[size / 2] : 0;
+    long max = 0 < size ? values[size - 1] : 0;
+    const char* fmt = "      \"%s\": { \"samples\": %d, \"timeouts\": %d, \"mean\": %ld, \"p50\": %ld, \"max\": %ld }%s\n";
+    printf(fmt, name, size, samples->timeouts, mean, p50, max, tail);
+}
+
+typedef Bool (*EventMatcher)(Bench*, XEvent*, void*);
+
+/* Discards other events until a matching one comes or timeout expires. */
+static Bool
+wait_for_event(Bench* bench, EventMatcher match, void* arg, long timeout, XEvent* e)
+{
+    Display* display = bench->display;
+    long deadline = get_monotonic_usec() + timeout;
+    while (True) {
+        while (0 < XPending(display)) {
+            XNextEvent(display, e);
+            if (match(bench, e, arg)) {
+                return True;
+            }
+        }
+        long rest = deadline - get_monotonic_usec();
+        if (rest <= 0) {
+            return False;
+        }
+        int fd = XConnectionNumber(display);
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+        struct timeval tv;
+        tv.tv_sec = rest / 1000000;
+        tv.tv_usec = rest % 1000000;
+        if ((select(fd + 1, &fds, NULL, NULL, &tv) < 0) && (errno != EINTR)) {
+            die("select failed.");
+        }
+    }
+}
+
+static Bool
+match_map_notify(Bench* bench, XEvent* e, void* arg)
+{
+    return (e->type == MapNotify) && (e->xmap.window == *(Window*)arg);
+}
+
+static Bool
+match_reparent_notify(Bench* bench, XEvent* e, void* arg)
+{
+    return (e->type == ReparentNotify) && (e->xreparent.window == *(Window*)arg);
+}
+
+static Bool
+match_unmap_notify(Bench* bench, XEvent* e, void* arg)
+{
+    return (e->type == UnmapNotify) && (e->xunmap.window == *(Window*)arg);
+}
+
+static Bool
+match_destroy_notify(Bench* bench, XEvent* e, void* arg)
+{
+    return (e->type == DestroyNotify) && (e->xdestroywindow.window == *(Window*)arg);
+}
+
+static Bool
+match_configure_notify(Bench* bench, XEvent* e, void* arg)
+{
+    return (e->type == ConfigureNotify) && (e->xconfigure.window == *(Window*)arg);
+}
+
+static Bool
+match_button_press(Bench* bench, XEvent* e, void* arg)
+{
+    return (e->type == ButtonPress) && (e->xbutton.window == *(Window*)arg);
+}
+
+/*
+ * Matches the ReparentNotify which a window of the bench gets by itself. arg
+ * is True for a reparent to the root window, and False for one into a frame.
+ */
+static Bool
+match_own_reparent_notify(Bench* bench, XEvent* e, void* arg)
+{
+    if ((e->type != ReparentNotify) || (e->xreparent.event != e->xreparent.window)) {
+        return False;
+    }
+    return (e->xreparent.parent == bench->root) == *(Bool*)arg;
+}
+
+/* arg is a window, or NULL for any window of the bench. */
+static Bool
+match_focus_in(Bench* bench, XEvent* e, void* arg)
+{
+    if ((e->type != FocusIn) || (e->xfocus.detail == NotifyPointer)) {
+        return False;
+    }
+    return (arg == NULL) || (e->xfocus.window == *(Window*)arg);
+}
+
+/* A container of a desktop is mapped on the root window by a switch. */
+static Bool
+match_container_map(Bench* bench, XEvent* e, void* arg)
+{
+    if ((e->type != MapNotify) || (e->xmap.event != bench->root)) {
+        return False;
+    }
+    return e->xmap.window != bench->menu;
+}
+
+/* The first window which fawm maps on the root window is the popup menu. */
+static Bool
+match_menu_map(Bench* bench, XEvent* e, void* arg)
+{
+    if ((e->type != MapNotify) || (e->xmap.event != bench->root)) {
+        return False;
+    }
+    if ((bench->menu != None) && (e->xmap.window != bench->menu)) {
+        return False;
+    }
+    bench->menu = e->xmap.window;
+    return True;
+}
+
+static void
+drain_events(Bench* bench)
+{
+    Display* display = bench->display;
+    XSync(display, False);
+    while (0 < XPending(display)) {
+        XEvent e;
+        XNextEvent(display, &e);
+    }
+}
+
+static pid_t
+spawn(char* const argv[], const char* display_name)
+{
+    pid_t pid = fork();
+    if (pid == -1) {
+        die("fork failed.");
+    }
+    if (pid == 0) {
+        setenv("DISPLAY", display_name, 1);
+        execvp(argv[0], argv);
+        fprintf(stderr, "fawm-bench: cannot execute %s: %s\n", argv[0], strerror(errno));
+        _exit(1);
+    }
+    return pid;
+}
+
+static void
+stop(pid_t pid)
+{
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+static Display*
+connect_server(const char* display_name)
+{
+    int i;
+    for (i = 0; i < 100; i++) {
+        Display* display = XOpenDisplay(display_name);
+        if (display != NULL) {
+            return display;
+        }
+        usleep(100 * 1000);
+    }
+    die("cannot connect to Xvfb.");
+    return NULL;
+}
+
+static void
+write_config(Bench* bench, int items_num)
+{
+    FILE* fp = fopen(bench->config_file, "w");
+    if (fp == NULL) {
+        die("cannot write the config file.");
+    }
+    /* The first item is selected to reload. Others change the menu size. */
+    fprintf(fp, "menu\n    reload\n");
+    int i;
+    for (i = 1; i < items_num; i++) {
+        fprintf(fp, "    exec \"item %d\" \"true\"\n", i);
+    }
+    fprintf(fp, "end\n");
+    fclose(fp);
+    bench->config_items_num = items_num;
+}
+
+static void
+move_pointer(Bench* bench, int x, int y)
+{
+    XTestFakeMotionEvent(bench->display, -1, x, y, CurrentTime);
+}
+
+static void
+press_button(Bench* bench)
+{
+    XTestFakeButtonEvent(bench->display, Button1, True, CurrentTime);
+}
+
+static void
+release_button(Bench* bench)
+{
+    XTestFakeButtonEvent(bench->display, Button1, False, CurrentTime);
+}
+
+static void
+click(Bench* bench, int x, int y)
+{
+    move_pointer(bench, x, y);
+    press_button(bench);
+    release_button(bench);
+    XFlush(bench->display);
+}
+
+static Window
+create_window(Bench* bench)
+{
+    Display* display = bench->display;
+    int screen = DefaultScreen(display);
+    unsigned long black = BlackPixel(display, screen);
+    unsigned long white = WhitePixel(display, screen);
+    if (WINDOWS_MAX <= bench->windows_num) {
+        die("too many windows.");
+    }
+    Window w = XCreateSimpleWindow(display, bench->root, 0, 0, 320, 240, 0, black, white);
+    XSelectInput(display, w, StructureNotifyMask | FocusChangeMask | ButtonPressMask);
+    char name[32];
+    snprintf(name, sizeof(name), "bench %d", bench->windows_num);
+    XStoreName(display, w, name);
+    bench->windows[bench->windows_num] = w;
+    bench->windows_num++;
+    return w;
+}
+
+/* Returns the time from XMapWindow until fawm focuses the window. */
+static Bool
+map_window(Bench* bench, Window w, long* usec)
+{
+    XEvent e;
+    long start = get_monotonic_usec();
+    XMapWindow(bench->display, w);
+    XFlush(bench->display);
+    if (!wait_for_event(bench, match_focus_in, &w, TIMEOUT_USEC, &e)) {
+        return False;
+    }
+    *usec = get_monotonic_usec() - start;
+    return True;
+}
+
+static void
+destroy_last_window(Bench* bench)
+{
+    bench->windows_num--;
+    Window w = bench->windows[bench->windows_num];
+    XDestroyWindow(bench->display, w);
+    XEvent e;
+    wait_for_event(bench, match_destroy_notify, &w, TIMEOUT_USEC, &e);
+}
+
+static void
+grow_windows(Bench* bench, int n)
+{
+    while (bench->windows_num < n) {
+        Window w = create_window(bench);
+        XMapWindow(bench->display, w);
+        XEvent e;
+        if (!wait_for_event(bench, match_map_notify, &w, TIMEOUT_USEC, &e)) {
+            die("a window was not mapped.");
+        }
+    }
+    drain_events(bench);
+}
+
+static Window
+get_parent(Bench* bench, Window w)
+{
+    Window root;
+    Window parent;
+    Window* children;
+    unsigned int n;
+    if (XQueryTree(bench->display, w, &root, &parent, &children, &n) == 0) {
+        return None;
+    }
+    if (children != NULL) {
+        XFree(children);
+    }
+    return parent;
+}
+
+/* The taskbar is the widest child of the root window at the bottom. */
+static Bool
+search_taskbar(Bench* bench)
+{
+    Display* display = bench->display;
+    Window root;
+    Window parent;
+    Window* children;
+    unsigned int n;
+    if (XQueryTree(display, bench->root, &root, &parent, &children, &n) == 0) {
+        die("XQueryTree failed.");
+    }
+    unsigned int i;
+    for (i = 0; i < n; i++) {
+        XWindowAttributes wa;
+        if (XGetWindowAttributes(display, children[i], &wa) == 0) {
+            continue;
+        }
+        if ((wa.map_state != IsViewable) || (wa.width < SCREEN_WIDTH - 2)) {
+            continue;
+        }
+        if (wa.y + wa.height + 2 * wa.border_width < SCREEN_HEIGHT) {
+            continue;
+        }
+        bench->taskbar = children[i];
+        bench->taskbar_x = wa.x + wa.border_width;
+        bench->taskbar_y = wa.y + wa.border_width;
+        bench->taskbar_width = wa.width;
+        bench->taskbar_height = wa.height;
+    }
+    if (children != NULL) {
+        XFree(children);
+    }
+    return bench->taskbar != None;
+}
+
+/*
+ * fawm is ready when it reparented the first window and mapped the taskbar.
+ * The window may be mapped before fawm starts, and then fawm reparents it at
+ * startup.
+ */
+static void
+wait_for_fawm(Bench* bench)
+{
+    Window w = create_window(bench);
+    XMapWindow(bench->display, w);
+    XEvent e;
+    if (!wait_for_event(bench, match_reparent_notify, &w, TIMEOUT_USEC, &e)) {
+        die("fawm did not manage a window.");
+    }
+    int i;
+    for (i = 0; (i < 50) && !search_taskbar(bench); i++) {
+        usleep(100 * 1000);
+    }
+    if (bench->taskbar == None) {
+        die("cannot find the taskbar.");
+    }
+    drain_events(bench);
+}
+
+static void
+bench_map(Bench* bench, Samples* samples)
+{
+    int i;
+    for (i = 0; i < bench->repeats; i++) {
+        Window w = create_window(bench);
+        long usec;
+        if (map_window(bench, w, &usec)) {
+            add_sample(samples, usec);
+        }
+        else {
+            samples->timeouts++;
+        }
+    }
+}
+
+/*
+ * Drags the title bar of the last window. The result is the time of a motion
+ * until fawm moves the frame, as an average over DRAG_MOTIONS_NUM motions.
+ */
+static void
+bench_drag(Bench* bench, Samples* samples)
+{
+    Display* display = bench->display;
+    Window w = bench->windows[bench->windows_num - 1];
+    Window frame = get_parent(bench, w);
+    Window container = get_parent(bench, frame);
+    if ((frame == None) || (container == None)) {
+        samples->timeouts++;
+        return;
+    }
+    XSelectInput(display, container, SubstructureNotifyMask);
+
+    Window _;
+    int child_x;
+    int child_y;
+    unsigned int width;
+    unsigned int height;
+    unsigned int border_width;
+    unsigned int depth;
+    XGetGeometry(display, w, &_, &child_x, &child_y, &width, &height, &border_width, &depth);
+    int x;
+    int y;
+    XTranslateCoordinates(display, w, bench->root, 0, 0, &x, &y, &_);
+    x = x - child_x + 16;
+    y = y - child_y / 2;
+    move_pointer(bench, x, y);
+    press_button(bench);
+    drain_events(bench);
+
+    int i;
+    for (i = 0; i < bench->repeats; i++) {
+        long start = get_monotonic_usec();
+        int j;
+        for (j = 0; j < DRAG_MOTIONS_NUM; j++) {
+            int sign = i % 2 == 0 ? 1 : -1;
+            move_pointer(bench, x + sign * j, y + sign * j / 2);
+        }
+        XFlush(display);
+        long last = 0;
+        XEvent e;
+        while (wait_for_event(bench, match_configure_notify, &frame, IDLE_USEC, &e)) {
+            last = get_monotonic_usec();
+        }
+        if (last == 0) {
+            samples->timeouts++;
+            continue;
+        }
+        add_sample(samples, (last - start) / DRAG_MOTIONS_NUM);
+    }
+    release_button(bench);
+    XSelectInput(display, container, NoEventMask);
+    drain_events(bench);
+}
+
+/* Clicks two items of the window list by turns. */
+static void
+bench_focus(Bench* bench, Samples* samples)
+{
+    int list_x = bench->taskbar_x + bench->taskbar_height * (1 + DESKTOPS_NUM);
+    int xs[] = { list_x + 1, bench->taskbar_x + bench->taskbar_width / 2 };
+    int y = bench->taskbar_y + bench->taskbar_height / 2;
+    XEvent e;
+    click(bench, xs[0], y);
+    wait_for_event(bench, match_focus_in, NULL, IDLE_USEC, &e);
+    int i;
+    for (i = 0; i < bench->repeats; i++) {
+        long start = get_monotonic_usec();
+        click(bench, xs[(i + 1) % 2], y);
+        if (!wait_for_event(bench, match_focus_in, NULL, TIMEOUT_USEC, &e)) {
+            samples->timeouts++;
+            continue;
+        }
+        add_sample(samples, get_monotonic_usec() - start);
+    }
+}
+
+static Bool
+open_menu(Bench* bench, long* usec)
+{
+    int x = bench->taskbar_x + bench->taskbar_height / 2;
+    int y = bench->taskbar_y + bench->taskbar_height / 2;
+    long start = get_monotonic_usec();
+    move_pointer(bench, x, y);
+    press_button(bench);
+    XFlush(bench->display);
+    XEvent e;
+    if (!wait_for_event(bench, match_menu_map, NULL, TIMEOUT_USEC, &e)) {
+        release_button(bench);
+        return False;
+    }
+    *usec = get_monotonic_usec() - start;
+    return True;
+}
+
+/* The button is released on the taskbar, so that no item is selected. */
+static void
+close_menu(Bench* bench)
+{
+    release_button(bench);
+    XFlush(bench->display);
+    XEvent e;
+    wait_for_event(bench, match_unmap_notify, &bench->menu, TIMEOUT_USEC, &e);
+}
+
+static void
+bench_menu(Bench* bench, Samples* samples)
+{
+    int i;
+    for (i = 0; i < bench->repeats; i++) {
+        long usec;
+        if (!open_menu(bench, &usec)) {
+            samples->timeouts++;
+            continue;
+        }
+        add_sample(samples, usec);
+        close_menu(bench);
+    }
+}
+
+/* A window at the position, which fawm keeps because of USPosition */
+static Window
+create_window_at(Bench* bench, int x, int y)
+{
+    Window w = create_window(bench);
+    XSizeHints hints;
+    bzero(&hints, sizeof(hints));
+    hints.flags = USPosition;
+    hints.x = x;
+    hints.y = y;
+    XSetWMNormalHints(bench->display, w, &hints);
+    XMoveWindow(bench->display, w, x, y);
+    return w;
+}
+
+static Bool
+click_window(Bench* bench, Window w, long* usec)
+{
+    int x;
+    int y;
+    Window _;
+    XTranslateCoordinates(bench->display, w, bench->root, 160, 120, &x, &y, &_);
+    move_pointer(bench, x, y);
+    drain_events(bench);
+    long start = get_monotonic_usec();
+    press_button(bench);
+    XFlush(bench->display);
+    XEvent e;
+    Bool delivered = wait_for_event(bench, match_button_press, &w, TIMEOUT_USEC, &e);
+    release_button(bench);
+    XFlush(bench->display);
+    *usec = get_monotonic_usec() - start;
+    return delivered;
+}
+
+/*
+ * Clicks two windows side by side by turns, twice each. The first click
+ * reaches an unfocused client through the synchronous grab of fawm, which
+ * focuses it and replays the click. The second one goes to the focused client
+ * without fawm. Both are timed until the client gets ButtonPress.
+ */
+static void
+bench_click(Bench* bench, Samples* unfocused, Samples* focused)
+{
+    Window windows[2];
+    int i;
+    for (i = 0; i < 2; i++) {
+        windows[i] = create_window_at(bench, SCREEN_WIDTH - 800 + 400 * i, 100);
+        long _;
+        if (!map_window(bench, windows[i], &_)) {
+            die("a window was not focused.");
+        }
+    }
+    for (i = 0; i < bench->repeats; i++) {
+        Window w = windows[i % 2];
+        long usec;
+        if (click_window(bench, w, &usec)) {
+            add_sample(unfocused, usec);
+        }
+        else {
+            unfocused->timeouts++;
+        }
+        if (click_window(bench, w, &usec)) {
+            add_sample(focused, usec);
+        }
+        else {
+            focused->timeouts++;
+        }
+    }
+    destroy_last_window(bench);
+    destroy_last_window(bench);
+    drain_events(bench);
+}
+
+/*
+ * Selects "reload" after changing the number of items. fawm resizes the menu
+ * after reading the config, and it ends a measurement.
+ */
+static void
+bench_reload(Bench* bench, Samples* samples)
+{
+    Display* display = bench->display;
+    int i;
+    for (i = 0; i < bench->repeats; i++) {
+        long _;
+        if (!open_menu(bench, &_)) {
+            samples->timeouts++;
+            continue;
+        }
+        Window w = bench->menu;
+        Window root;
+        int x;
+        int y;
+        unsigned int width;
+        unsigned int height;
+        unsigned int border_width;
+        unsigned int depth;
+        XGetGeometry(display, w, &root, &x, &y, &width, &height, &border_width, &depth);
+        move_pointer(bench, x + border_width + 2, y + border_width + 2);
+        write_config(bench, bench->config_items_num == 2 ? 3 : 2);
+        drain_events(bench);
+
+        long start = get_monotonic_usec();
+        release_button(bench);
+        XFlush(display);
+        XEvent e;
+        if (!wait_for_event(bench, match_configure_notify, &w, TIMEOUT_USEC, &e)) {
+            samples->timeouts++;
+            continue;
+        }
+        add_sample(samples, get_monotonic_usec() - start);
+    }
+}
+
+static void
+click_pager(Bench* bench, int desktop)
+{
+    int size = bench->taskbar_height;
+    click(bench, bench->taskbar_x + size * (1 + desktop) + size / 2, bench->taskbar_y + size / 2);
+}
+
+/*
+ * Maps SWITCH_WINDOWS_NUM windows on each desktop, and switches desktops by
+ * the pager. A switch is timed until fawm focuses the top window of the next
+ * desktop.
+ */
+static void
+bench_switch(Bench* bench, Samples* samples)
+{
+    while (0 < bench->windows_num) {
+        destroy_last_window(bench);
+    }
+    XEvent e;
+    int i;
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        click_pager(bench, i);
+        wait_for_event(bench, match_container_map, NULL, IDLE_USEC, &e);
+        grow_windows(bench, SWITCH_WINDOWS_NUM * (i + 1));
+    }
+    /* The last desktop is the current one. */
+    for (i = 0; i < bench->repeats; i++) {
+        drain_events(bench);
+        long start = get_monotonic_usec();
+        click_pager(bench, i % DESKTOPS_NUM);
+        if (!wait_for_event(bench, match_focus_in, NULL, TIMEOUT_USEC, &e)) {
+            samples->timeouts++;
+            continue;
+        }
+        add_sample(samples, get_monotonic_usec() - start);
+    }
+}
+
+static Bool
+wait_for_reparents(Bench* bench, Bool to_root)
+{
+    int i;
+    for (i = 0; i < bench->windows_num; i++) {
+        XEvent e;
+        if (!wait_for_event(bench, match_own_reparent_notify, &to_root, TIMEOUT_USEC, &e)) {
+            return False;
+        }
+    }
+    return True;
+}
+
+/*
+ * Restarts fawm with COLD_START_WINDOWS_NUM windows. When fawm stops, the
+ * server gives the windows back to the root window by the save-set. A start
+ * is timed from spawning fawm until it reparented all of the windows.
+ */
+static void
+bench_cold_start(Bench* bench, char* const fawm_argv[], const char* display_name, pid_t* fawm_pid, Samples* samples)
+{
+    while (COLD_START_WINDOWS_NUM < bench->windows_num) {
+        destroy_last_window(bench);
+    }
+    grow_windows(bench, COLD_START_WINDOWS_NUM);
+    int i;
+    for (i = 0; i < bench->repeats; i++) {
+        stop(*fawm_pid);
+        if (!wait_for_reparents(bench, True)) {
+            die("fawm did not give the windows back.");
+        }
+        drain_events(bench);
+        long start = get_monotonic_usec();
+        *fawm_pid = spawn(fawm_argv, display_name);
+        if (!wait_for_reparents(bench, False)) {
+            samples->timeouts++;
+            continue;
+        }
+        add_sample(samples, get_monotonic_usec() - start);
+    }
+}
+
+static void
+run(Bench* bench, int windows_num, const char* tail)
+{
+    grow_windows(bench, windows_num);
+    Samples map = { 0, 0 };
+    bench_map(bench, &map);
+    Samples drag = { 0, 0 };
+    bench_drag(bench, &drag);
+    while (windows_num < bench->windows_num) {
+        destroy_last_window(bench);
+    }
+    Samples focus = { 0, 0 };
+    bench_focus(bench, &focus);
+    Samples menu = { 0, 0 };
+    bench_menu(bench, &menu);
+    Samples reload = { 0, 0 };
+    bench_reload(bench, &reload);
+    Samples click_unfocused = { 0, 0 };
+    Samples click_focused = { 0, 0 };
+    bench_click(bench, &click_unfocused, &click_focused);
+
+    printf("    {\n");
+    printf("      \"windows\": %d,\n", windows_num);
+    print_samples("map_usec", &map, ",");
+    print_samples("drag_usec_per_motion", &drag, ",");
+    print_samples("focus_usec", &focus, ",");
+    print_samples("menu_usec", &menu, ",");
+    print_samples("reload_usec", &reload, ",");
+    print_samples("click_unfocused_usec", &click_unfocused, ",");
+    print_samples("click_focused_usec", &click_focused, "");
+    printf("    }%s\n", tail);
+    fflush(stdout);
+}
+
+static void
+usage()
+{
+    printf("Usage: fawm-bench [--fawm=PATH] [--xvfb=PATH] [--display=NAME] [--repeats=N]\n");
+}
+
+int
+main(int argc, char* argv[])
+{
+    const char* fawm = "fawm";
+    const char* xvfb = "Xvfb";
+    const char* display_name = ":99";
+    int repeats = 10;
+    struct option longopts[] = {
+        { "display", required_argument, NULL, 'd' },
+        { "fawm", required_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { "repeats", required_argument, NULL, 'r' },
+        { "xvfb", required_argument, NULL, 'x' },
+        { NULL, 0, NULL, 0 }
+    };
+    int val;
+    while ((val = getopt_long_only(argc, argv, "", longopts, NULL)) != -1) {
+        switch (val) {
+        case 'd':
+            display_name = optarg;
+            break;
+        case 'f':
+            fawm = optarg;
+            break;
+        case 'h':
+            usage();
+            return 0;
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+        case 'x':
+            xvfb = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if ((repeats < 1) || (SAMPLES_MAX < repeats)) {
+        die("repeats must be in 1..64.");
+    }
+
+    Bench bench;
+    bzero(&bench, sizeof(bench));
+    bench.repeats = repeats;
+    char config_file[] = "/tmp/fawm-bench.XXXXXX";
+    int fd = mkstemp(config_file);
+    if (fd == -1) {
+        die("mkstemp failed.");
+    }
+    close(fd);
+    bench.config_file = config_file;
+    write_config(&bench, 2);
+
+    char geometry[32];
+    snprintf(geometry, sizeof(geometry), "%dx%dx24", SCREEN_WIDTH, SCREEN_HEIGHT);
+    char* xvfb_argv[] = { (char*)xvfb, (char*)display_name, "-screen", "0", geometry, "-nolisten", "tcp", NULL };
+    pid_t xvfb_pid = spawn(xvfb_argv, display_name);
+    Display* display = connect_server(display_name);
+    int _;
+    if (!XTestQueryExtension(display, &_, &_, &_, &_)) {
+        stop(xvfb_pid);
+        die("the server has no XTest.");
+    }
+    bench.display = display;
+    bench.root = DefaultRootWindow(display);
+    XSelectInput(display, bench.root, SubstructureNotifyMask);
+
+    char* fawm_argv[] = { (char*)fawm, "--config", config_file, NULL };
+    pid_t fawm_pid = spawn(fawm_argv, display_name);
+    wait_for_fawm(&bench);
+
+    printf("{\n");
+    printf("  \"version\": \"%s\",\n", FAWM_PACKAGE_VERSION);
+    printf("  \"results\": [\n");
+    int sizes[] = { 10, 100, 1000 };
+    int sizes_num = sizeof(sizes) / sizeof(sizes[0]);
+    int i;
+    for (i = 0; i < sizes_num; i++) {
+        run(&bench, sizes[i], i < sizes_num - 1 ? "," : "");
+    }
+    printf("  ],\n");
+    Samples switches = { 0, 0 };
+    bench_switch(&bench, &switches);
+    printf("  \"switch\": {\n");
+    printf("      \"windows_per_desktop\": %d,\n", SWITCH_WINDOWS_NUM);
+    print_samples("switch_usec", &switches, "");
+    printf("  },\n");
+    Samples cold_starts = { 0, 0 };
+    bench_cold_start(&bench, fawm_argv, display_name, &fawm_pid, &cold_starts);
+    printf("  \"cold_start\": {\n");
+    printf("      \"windows\": %d,\n", COLD_START_WINDOWS_NUM);
+    print_samples("cold_start_usec", &cold_starts, "");
+    printf("  }\n");
+    printf("}\n");
+
+    stop(fawm_pid);
+    XCloseDisplay(display);
+    stop(xvfb_pid);
+    unlink(config_file);
+
+    return 0;
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
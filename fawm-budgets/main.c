@@ -0,0 +1,794 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XTest.h>
+
+#include <fawm/config.h>
+#include <fawm/private/scenarios.h>
+
+/*
+ * A regression test of requests and round trips of fawm. This starts Xvfb and
+ * fawm, and plays the scenarios of scenarios.h with scripted clients and
+ * XTest. Before and after each step of a scenario, this reads totals which
+ * fawm prints by SIGUSR1. A step which made fawm send more requests or round
+ * trips than the budget of its scenario makes the exit status 2, and so does
+ * a "configure" step which did not give the client exactly one synthetic
+ * ConfigureNotify. Results are printed in JSON to stdout.
+ */
+
+#define WINDOWS_MAX (SCENARIO_BACKGROUND_WINDOWS_NUM + SCENARIO_REPEATS_MAX)
+#define TIMEOUT_USEC (10 * 1000 * 1000)
+#define IDLE_USEC (50 * 1000)
+#define POLL_USEC (10 * 1000)
+
+/*
+ * Requests which the handlers are meant to send, as a real server counts
+ * them. Xft sends a request for each clip change too. n is the number of
+ * windows in the taskbar.
+ */
+/* A clip, the clock, rectangles, lines, four pager labels, and each title */
+#define TASKBAR_DRAW(n) (8 + (n))
+/* Corner marks, a clip, the title, and an unclip */
+#define FRAME_DRAW 4
+/* DefineCursor over a box or an edge, and UndefineCursor out of it */
+#define CURSOR 2
+/* SetWindowBackgroundPixmap and ClearArea of a highlighted box */
+#define HIGHLIGHT_BOX 2
+/*
+ * GrabButton on the old frame, UngrabButton on the new one, SetInputFocus,
+ * ClearArea of the taskbar, SetWindowBackground and ClearArea of both frames,
+ * RaiseWindow, and the redraws of the taskbar and both frames.
+ */
+#define FOCUS_CHANGE(n) (9 + 2 * FRAME_DRAW + TASKBAR_DRAW(n))
+/*
+ * Focus to the next frame after the focused one was hidden. The hidden frame
+ * is neither grabbed nor raised nor redrawn.
+ */
+#define FOCUS_NEXT (6 + FRAME_DRAW)
+/*
+ * GetWindowAttributes, GetWMNormalHints, two GetTextProperty, two
+ * CreateWindow, MapSubwindows, ChangeWindowAttributes, SetWindowBorderWidth,
+ * ReparentWindow, GetWMProtocols, two MapWindow, and AddToSaveSet. All of the
+ * Get requests are round trips.
+ */
+#define MANAGE 14
+#define MANAGE_ROUND_TRIPS 5
+/*
+ * ConfigureWindow of the frame and the client, the corner marks erased and
+ * drawn again, and one Expose series for the new area of the frame.
+ */
+#define RESIZE_FRAME (2 + 2 + FRAME_DRAW)
+/* UnmapWindow, ClearArea of the taskbar, and the frame which was under it */
+#define HIDE_FRAME(n) (2 + TASKBAR_DRAW(n) + FRAME_DRAW)
+
+/*
+ * Budgets of one step, in the order of Scenario. They are the costs above
+ * with the most windows of the scenarios in the taskbar. A new window needs
+ * no UngrabButton, and a closed one resets the pixmap of its close box for
+ * the frame pool.
+ */
+static struct {
+    unsigned long requests;
+    unsigned long round_trips;
+} budgets[] = {
+    { MANAGE + FRAME_DRAW + FOCUS_CHANGE(WINDOWS_MAX) - 1, MANAGE_ROUND_TRIPS }, /* map */
+    { CURSOR + FOCUS_CHANGE(WINDOWS_MAX), 0 }, /* focus */
+    { CURSOR + FOCUS_CHANGE(WINDOWS_MAX) + 1, 0 }, /* move */
+    { CURSOR + FOCUS_CHANGE(WINDOWS_MAX) + RESIZE_FRAME, 0 }, /* resize */
+    { 3 + FRAME_DRAW + TASKBAR_DRAW(WINDOWS_MAX), 1 }, /* retitle: GetTextProperty and two ClearArea */
+    { RESIZE_FRAME + 1, 0 }, /* configure: and a synthetic ConfigureNotify */
+    { CURSOR + FOCUS_CHANGE(WINDOWS_MAX), 0 }, /* taskbar */
+    { CURSOR + HIGHLIGHT_BOX + HIDE_FRAME(WINDOWS_MAX) + FOCUS_NEXT, 0 }, /* minimize */
+    { CURSOR + HIGHLIGHT_BOX + 1 + HIDE_FRAME(WINDOWS_MAX) + 1 + FOCUS_NEXT, 0 } /* close: and WM_DELETE_WINDOW */
+};
+
+/* The format must be same as the one of dump_event_stats() of fawm. */
+#define FAWM_TOTALS_FMT "totals: requests=%lu, round trips=%lu"
+
+struct Totals {
+    unsigned long requests;
+    unsigned long round_trips;
+};
+
+typedef struct Totals Totals;
+
+struct Stats {
+    unsigned long requests;
+    unsigned long max_requests;
+    unsigned long round_trips;
+    unsigned long max_round_trips;
+};
+
+typedef struct Stats Stats;
+
+struct Harness {
+    Display* display;
+    Window root;
+    Atom wm_protocols;
+    Atom wm_delete_window;
+    pid_t fawm_pid;
+    FILE* fawm_stderr;
+    int repeats;
+    /* Synthetic ConfigureNotify which the clients got */
+    unsigned long configure_notifies;
+    int configure_failures;
+    Window windows[WINDOWS_MAX];
+    int windows_num;
+    Window taskbar;
+    int taskbar_x;
+    int taskbar_y;
+    int taskbar_width;
+    int taskbar_height;
+};
+
+typedef struct Harness Harness;
+
+static void
+die(const char* msg)
+{
+    fprintf(stderr, "fawm-budgets: %s\n", msg);
+    exit(1);
+}
+
+static long
+get_monotonic_usec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static pid_t
+spawn(char* const argv[], const char* display_name, int fd)
+{
+    pid_t pid = fork();
+    if (pid == -1) {
+        die("fork failed.");
+    }
+    if (pid == 0) {
+        if (fd != -1) {
+            dup2(fd, 2);
+            close(fd);
+        }
+        setenv("DISPLAY", display_name, 1);
+        execvp(argv[0], argv);
+        fprintf(stderr, "fawm-budgets: cannot execute %s: %s\n", argv[0], strerror(errno));
+        _exit(1);
+    }
+    return pid;
+}
+
+static void
+stop(pid_t pid)
+{
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+static Display*
+connect_server(const char* display_name)
+{
+    int i;
+    for (i = 0; i < 100; i++) {
+        Display* display = XOpenDisplay(display_name);
+        if (display != NULL) {
+            return display;
+        }
+        usleep(100 * 1000);
+    }
+    die("cannot connect to Xvfb.");
+    return NULL;
+}
+
+static char*
+make_temp_file(const char* template)
+{
+    char* path = strdup(template);
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        die("mkstemp failed.");
+    }
+    close(fd);
+    return path;
+}
+
+static void
+write_config(const char* path)
+{
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        die("cannot write the config file.");
+    }
+    fprintf(fp, "menu\n    reload\nend\n");
+    fclose(fp);
+}
+
+/* fawm prints the totals to the file of its standard error. */
+static void
+read_totals(Harness* harness, Totals* totals)
+{
+    kill(harness->fawm_pid, SIGUSR1);
+    FILE* fp = harness->fawm_stderr;
+    long deadline = get_monotonic_usec() + TIMEOUT_USEC;
+    char line[512];
+    while (get_monotonic_usec() < deadline) {
+        if (fgets(line, sizeof(line), fp) == NULL) {
+            clearerr(fp);
+            usleep(POLL_USEC);
+            continue;
+        }
+        const char* s = strstr(line, "totals: ");
+        if (s == NULL) {
+            continue;
+        }
+        if (sscanf(s, FAWM_TOTALS_FMT, &totals->requests, &totals->round_trips) != 2) {
+            die("cannot read totals of fawm.");
+        }
+        return;
+    }
+    die("fawm did not print totals.");
+}
+
+/*
+ * Processes events of the clients. A client closes its window as soon as fawm
+ * asks. Returns True if a window was closed.
+ */
+static Bool
+handle_events(Harness* harness)
+{
+    Display* display = harness->display;
+    XSync(display, False);
+    Bool closed = False;
+    while (0 < XPending(display)) {
+        XEvent e;
+        XNextEvent(display, &e);
+        if ((e.type == ConfigureNotify) && e.xconfigure.send_event) {
+            harness->configure_notifies++;
+            continue;
+        }
+        if ((e.type != ClientMessage) || (e.xclient.message_type != harness->wm_protocols)) {
+            continue;
+        }
+        if ((Atom)e.xclient.data.l[0] != harness->wm_delete_window) {
+            continue;
+        }
+        XDestroyWindow(display, e.xclient.window);
+        closed = True;
+    }
+    XSync(display, False);
+    return closed;
+}
+
+/* fawm is idle when the totals do not change for a while. */
+static void
+wait_for_idle(Harness* harness, Totals* totals)
+{
+    long deadline = get_monotonic_usec() + TIMEOUT_USEC;
+    Totals last;
+    read_totals(harness, &last);
+    while (get_monotonic_usec() < deadline) {
+        usleep(IDLE_USEC);
+        Bool closed = handle_events(harness);
+        read_totals(harness, totals);
+        Bool same = (totals->requests == last.requests) && (totals->round_trips == last.round_trips);
+        if (!closed && same) {
+            return;
+        }
+        last = *totals;
+    }
+    die("fawm did not become idle.");
+}
+
+static void
+move_pointer(Harness* harness, int x, int y)
+{
+    XTestFakeMotionEvent(harness->display, -1, x, y, CurrentTime);
+}
+
+static void
+press_button(Harness* harness)
+{
+    XTestFakeButtonEvent(harness->display, Button1, True, CurrentTime);
+}
+
+static void
+release_button(Harness* harness)
+{
+    XTestFakeButtonEvent(harness->display, Button1, False, CurrentTime);
+}
+
+static void
+click(Harness* harness, int x, int y)
+{
+    move_pointer(harness, x, y);
+    press_button(harness);
+    release_button(harness);
+}
+
+static void
+drag(Harness* harness, int x, int y, int dx, int dy)
+{
+    move_pointer(harness, x, y);
+    press_button(harness);
+    int i;
+    for (i = 1; i <= SCENARIO_MOTIONS_NUM; i++) {
+        move_pointer(harness, x + i * dx, y + i * dy);
+    }
+    release_button(harness);
+}
+
+static Window
+create_window(Harness* harness)
+{
+    Display* display = harness->display;
+    int n = harness->windows_num;
+    if (WINDOWS_MAX <= n) {
+        die("too many windows.");
+    }
+    int x = SCENARIO_WINDOW_X(n);
+    int y = SCENARIO_WINDOW_Y(n);
+    int width = SCENARIO_WINDOW_WIDTH;
+    int height = SCENARIO_WINDOW_HEIGHT;
+    int screen = DefaultScreen(display);
+    unsigned long black = BlackPixel(display, screen);
+    unsigned long white = WhitePixel(display, screen);
+    Window w = XCreateSimpleWindow(display, harness->root, x, y, width, height, 0, black, white);
+    XSelectInput(display, w, StructureNotifyMask);
+    char title[32];
+    snprintf(title, sizeof(title), "scenario %d", n);
+    XStoreName(display, w, title);
+    XSetWMProtocols(display, w, &harness->wm_delete_window, 1);
+    XSizeHints hints;
+    bzero(&hints, sizeof(hints));
+    hints.flags = USPosition | USSize;
+    hints.x = x;
+    hints.y = y;
+    hints.width = width;
+    hints.height = height;
+    XSetWMNormalHints(display, w, &hints);
+    XMapWindow(display, w);
+    harness->windows[n] = w;
+    harness->windows_num++;
+    return w;
+}
+
+static Window
+get_parent(Harness* harness, Window w)
+{
+    Window root;
+    Window parent;
+    Window* children;
+    unsigned int n;
+    if (XQueryTree(harness->display, w, &root, &parent, &children, &n) == 0) {
+        die("XQueryTree failed.");
+    }
+    if (children != NULL) {
+        XFree(children);
+    }
+    return parent;
+}
+
+static void
+get_size(Harness* harness, Window w, int* x, int* y, unsigned int* width, unsigned int* height)
+{
+    Window root;
+    unsigned int border_width;
+    unsigned int depth;
+    XGetGeometry(harness->display, w, &root, x, y, width, height, &border_width, &depth);
+}
+
+static void
+get_origin(Harness* harness, Window w, int* x, int* y)
+{
+    Window child;
+    XTranslateCoordinates(harness->display, w, harness->root, 0, 0, x, y, &child);
+}
+
+/* A point on the title bar, at the middle of the space above the client */
+static void
+get_title_point(Harness* harness, Window w, int* x, int* y)
+{
+    int child_x;
+    int child_y;
+    unsigned int width;
+    unsigned int height;
+    get_size(harness, w, &child_x, &child_y, &width, &height);
+    get_origin(harness, get_parent(harness, w), x, y);
+    *x += 16;
+    *y += child_y / 2;
+}
+
+static void
+get_corner_point(Harness* harness, Window w, int* x, int* y)
+{
+    Window frame = get_parent(harness, w);
+    int _;
+    unsigned int width;
+    unsigned int height;
+    get_size(harness, frame, &_, &_, &width, &height);
+    get_origin(harness, frame, x, y);
+    *x += width - 2;
+    *y += height - 2;
+}
+
+/*
+ * The buttons window of a frame is as wide as three boxes of the height of
+ * the title, plus one. n is 1 for the close box, and 3 for the minimize box.
+ */
+static void
+click_box(Harness* harness, Window w, int n)
+{
+    Window root;
+    Window parent;
+    Window* children;
+    unsigned int children_num;
+    Window frame = get_parent(harness, w);
+    if (XQueryTree(harness->display, frame, &root, &parent, &children, &children_num) == 0) {
+        die("XQueryTree failed.");
+    }
+    unsigned int i;
+    for (i = 0; i < children_num; i++) {
+        int _;
+        unsigned int width;
+        unsigned int height;
+        get_size(harness, children[i], &_, &_, &width, &height);
+        if (width != 3 * height - 2) {
+            continue;
+        }
+        int size = height - 1;
+        int x;
+        int y;
+        get_origin(harness, children[i], &x, &y);
+        click(harness, x + width - 1 - n * size + size / 2, y + size / 2);
+        break;
+    }
+    if (children != NULL) {
+        XFree(children);
+    }
+    if (i == children_num) {
+        die("cannot find buttons of a frame.");
+    }
+}
+
+/* The taskbar is the widest child of the root window at the bottom. */
+static Bool
+search_taskbar(Harness* harness)
+{
+    Display* display = harness->display;
+    Window root;
+    Window parent;
+    Window* children;
+    unsigned int n;
+    if (XQueryTree(display, harness->root, &root, &parent, &children, &n) == 0) {
+        die("XQueryTree failed.");
+    }
+    unsigned int i;
+    for (i = 0; i < n; i++) {
+        XWindowAttributes wa;
+        if (XGetWindowAttributes(display, children[i], &wa) == 0) {
+            continue;
+        }
+        if ((wa.map_state != IsViewable) || (wa.width < SCENARIO_SCREEN_WIDTH - 2)) {
+            continue;
+        }
+        if (wa.y + wa.height + 2 * wa.border_width < SCENARIO_SCREEN_HEIGHT) {
+            continue;
+        }
+        harness->taskbar = children[i];
+        harness->taskbar_x = wa.x + wa.border_width;
+        harness->taskbar_y = wa.y + wa.border_width;
+        harness->taskbar_width = wa.width;
+        harness->taskbar_height = wa.height;
+    }
+    if (children != NULL) {
+        XFree(children);
+    }
+    return harness->taskbar != None;
+}
+
+static void
+click_taskbar(Harness* harness, int repeat)
+{
+    int x = harness->taskbar_x + harness->taskbar_width * (repeat % 2 == 0 ? 2 : 3) / 4;
+    click(harness, x, harness->taskbar_y + harness->taskbar_height / 2);
+}
+
+/* Same as configure_scenario_window() of fawm-fake */
+static void
+configure_window(Harness* harness, int n, int repeat)
+{
+    int x = SCENARIO_WINDOW_X(n) + SCENARIO_MOTION_SIZE;
+    int y = SCENARIO_WINDOW_Y(n) + SCENARIO_MOTION_SIZE;
+    int width = SCENARIO_WINDOW_WIDTH + (repeat % 2 == 0 ? SCENARIO_MOTION_SIZE : 0);
+    int height = SCENARIO_WINDOW_HEIGHT + (repeat % 2 == 0 ? SCENARIO_MOTION_SIZE : 0);
+    XMoveResizeWindow(harness->display, harness->windows[n], x, y, width, height);
+}
+
+/* Same as fake_play_scenario() of fawm */
+static void
+play_scenario(Harness* harness, Scenario scenario, int repeat)
+{
+    Window* windows = harness->windows;
+    int sign = repeat % 2 == 0 ? 1 : -1;
+    int size = SCENARIO_MOTION_SIZE;
+    char title[32];
+    int x;
+    int y;
+    switch (scenario) {
+    case SCENARIO_MAP:
+        create_window(harness);
+        break;
+    case SCENARIO_FOCUS:
+        get_title_point(harness, windows[repeat % 2], &x, &y);
+        click(harness, x, y);
+        break;
+    case SCENARIO_MOVE:
+        get_title_point(harness, windows[0], &x, &y);
+        drag(harness, x, y, sign * size, sign * size / 2);
+        break;
+    case SCENARIO_RESIZE:
+        get_corner_point(harness, windows[1], &x, &y);
+        drag(harness, x, y, sign * size, sign * size);
+        break;
+    case SCENARIO_RETITLE:
+        snprintf(title, sizeof(title), "retitled %d", repeat);
+        XStoreName(harness->display, windows[2], title);
+        break;
+    case SCENARIO_CONFIGURE:
+        configure_window(harness, 3, repeat);
+        break;
+    case SCENARIO_TASKBAR:
+        click_taskbar(harness, repeat);
+        break;
+    case SCENARIO_MINIMIZE:
+        click_box(harness, windows[SCENARIO_BACKGROUND_WINDOWS_NUM + repeat], 3);
+        break;
+    case SCENARIO_CLOSE:
+        click_box(harness, windows[repeat], 1);
+        break;
+    default:
+        die("unknown scenario.");
+        break;
+    }
+    XSync(harness->display, False);
+}
+
+/*
+ * fawm is ready when it reparented the first window and mapped the taskbar.
+ * Other background windows are mapped after it.
+ */
+static void
+prepare_scenarios(Harness* harness)
+{
+    Window w = create_window(harness);
+    long deadline = get_monotonic_usec() + TIMEOUT_USEC;
+    Bool reparented = False;
+    while (!reparented) {
+        if (deadline < get_monotonic_usec()) {
+            die("fawm did not manage a window.");
+        }
+        if (XPending(harness->display) == 0) {
+            usleep(POLL_USEC);
+            continue;
+        }
+        XEvent e;
+        XNextEvent(harness->display, &e);
+        reparented = (e.type == ReparentNotify) && (e.xreparent.window == w);
+    }
+    while (harness->windows_num < SCENARIO_BACKGROUND_WINDOWS_NUM) {
+        create_window(harness);
+    }
+    Totals _;
+    wait_for_idle(harness, &_);
+    if (!search_taskbar(harness)) {
+        die("cannot find the taskbar.");
+    }
+}
+
+static void
+add_step(Stats* stats, unsigned long requests, unsigned long round_trips)
+{
+    stats->requests += requests;
+    if (stats->max_requests < requests) {
+        stats->max_requests = requests;
+    }
+    stats->round_trips += round_trips;
+    if (stats->max_round_trips < round_trips) {
+        stats->max_round_trips = round_trips;
+    }
+}
+
+static void
+run(Harness* harness, Stats* stats)
+{
+    Totals start;
+    wait_for_idle(harness, &start);
+    int scenario;
+    for (scenario = 0; scenario < SCENARIOS_NUM; scenario++) {
+        int i;
+        for (i = 0; i < harness->repeats; i++) {
+            unsigned long notifies = harness->configure_notifies;
+            play_scenario(harness, scenario, i);
+            Totals end;
+            wait_for_idle(harness, &end);
+            notifies = harness->configure_notifies - notifies;
+            if ((scenario == SCENARIO_CONFIGURE) && (notifies != 1)) {
+                const char* fmt = "fawm-budgets: configure gave %lu synthetic ConfigureNotify (1 expected).\n";
+                fprintf(stderr, fmt, notifies);
+                harness->configure_failures++;
+            }
+            unsigned long requests = end.requests - start.requests;
+            unsigned long round_trips = end.round_trips - start.round_trips;
+            add_step(&stats[scenario], requests, round_trips);
+            start = end;
+        }
+    }
+}
+
+static int
+check_budgets(Stats* stats)
+{
+    const char* names[] = SCENARIO_NAMES;
+    int failures = 0;
+    int i;
+    for (i = 0; i < SCENARIOS_NUM; i++) {
+        if (budgets[i].requests < stats[i].max_requests) {
+            const char* fmt = "fawm-budgets: %s sent %lu requests in a step (budget %lu).\n";
+            fprintf(stderr, fmt, names[i], stats[i].max_requests, budgets[i].requests);
+            failures++;
+        }
+        if (budgets[i].round_trips < stats[i].max_round_trips) {
+            const char* fmt = "fawm-budgets: %s made %lu round trips in a step (budget %lu).\n";
+            fprintf(stderr, fmt, names[i], stats[i].max_round_trips, budgets[i].round_trips);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+static void
+print_stats(Stats* stats, int repeats)
+{
+    const char* names[] = SCENARIO_NAMES;
+    printf("{\n");
+    printf("  \"version\": \"%s\",\n", FAWM_PACKAGE_VERSION);
+    printf("  \"repeats\": %d,\n", repeats);
+    printf("  \"scenarios\": [\n");
+    int i;
+    for (i = 0; i < SCENARIOS_NUM; i++) {
+        Stats* s = &stats[i];
+        double requests = (double)s->requests / repeats;
+        double round_trips = (double)s->round_trips / repeats;
+        const char* tail = i < SCENARIOS_NUM - 1 ? "," : "";
+        printf("    {\n");
+        printf("      \"name\": \"%s\",\n", names[i]);
+        const char* fmt = "      \"%s\": { \"mean\": %.2f, \"max\": %lu, \"budget\": %lu }%s\n";
+        printf(fmt, "requests", requests, s->max_requests, budgets[i].requests, ",");
+        printf(fmt, "round_trips", round_trips, s->max_round_trips, budgets[i].round_trips, "");
+        printf("    }%s\n", tail);
+    }
+    printf("  ]\n");
+    printf("}\n");
+    fflush(stdout);
+}
+
+static void
+usage()
+{
+    printf("Usage: fawm-budgets [--fawm=PATH] [--xvfb=PATH] [--display=NAME] [--repeats=N] [--measure]\n");
+}
+
+int
+main(int argc, char* argv[])
+{
+    const char* fawm = "fawm";
+    const char* xvfb = "Xvfb";
+    const char* display_name = ":99";
+    int repeats = SCENARIO_REPEATS_MAX;
+    Bool measure = False;
+    struct option longopts[] = {
+        { "display", required_argument, NULL, 'd' },
+        { "fawm", required_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { "measure", no_argument, NULL, 'm' },
+        { "repeats", required_argument, NULL, 'r' },
+        { "xvfb", required_argument, NULL, 'x' },
+        { NULL, 0, NULL, 0 }
+    };
+    int val;
+    while ((val = getopt_long_only(argc, argv, "", longopts, NULL)) != -1) {
+        switch (val) {
+        case 'd':
+            display_name = optarg;
+            break;
+        case 'f':
+            fawm = optarg;
+            break;
+        case 'h':
+            usage();
+            return 0;
+        case 'm':
+            measure = True;
+            break;
+        case 'r':
+            repeats = atoi(optarg);
+            break;
+        case 'x':
+            xvfb = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if ((repeats < 1) || (SCENARIO_REPEATS_MAX < repeats)) {
+        die("repeats must be in 1..8.");
+    }
+
+    Harness harness;
+    bzero(&harness, sizeof(harness));
+    harness.repeats = repeats;
+    char* config_file = make_temp_file("/tmp/fawm-budgets.XXXXXX");
+    write_config(config_file);
+    char* stderr_file = make_temp_file("/tmp/fawm-budgets.XXXXXX");
+
+    char geometry[32];
+    snprintf(geometry, sizeof(geometry), "%dx%dx24", SCENARIO_SCREEN_WIDTH, SCENARIO_SCREEN_HEIGHT);
+    char* xvfb_argv[] = { (char*)xvfb, (char*)display_name, "-screen", "0", geometry, "-nolisten", "tcp", NULL };
+    pid_t xvfb_pid = spawn(xvfb_argv, display_name, -1);
+    Display* display = connect_server(display_name);
+    int _;
+    if (!XTestQueryExtension(display, &_, &_, &_, &_)) {
+        stop(xvfb_pid);
+        die("the server has no XTest.");
+    }
+    harness.display = display;
+    harness.root = DefaultRootWindow(display);
+    harness.wm_protocols = XInternAtom(display, "WM_PROTOCOLS", False);
+    harness.wm_delete_window = XInternAtom(display, "WM_DELETE_WINDOW", False);
+
+    int fd = open(stderr_file, O_WRONLY | O_APPEND);
+    if (fd == -1) {
+        die("cannot open the stderr file.");
+    }
+    char* fawm_argv[] = { (char*)fawm, "--config", config_file, NULL };
+    harness.fawm_pid = spawn(fawm_argv, display_name, fd);
+    close(fd);
+    harness.fawm_stderr = fopen(stderr_file, "r");
+    if (harness.fawm_stderr == NULL) {
+        die("cannot read the stderr file.");
+    }
+
+    prepare_scenarios(&harness);
+    Stats stats[SCENARIOS_NUM];
+    bzero(stats, sizeof(stats));
+    run(&harness, stats);
+    print_stats(stats, repeats);
+    int failures = harness.configure_failures + (measure ? 0 : check_budgets(stats));
+
+    stop(harness.fawm_pid);
+    XCloseDisplay(display);
+    stop(xvfb_pid);
+    fclose(harness.fawm_stderr);
+    unlink(stderr_file);
+    unlink(config_file);
+    free(stderr_file);
+    free(config_file);
+
+    return failures == 0 ? 0 : 2;
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,9 @@
+/*
+ * fawm with the fake server, for tests and benchmarks without X. main.c of
+ * fawm is built again with FAWM_FAKE, and the other objects are shared.
+ */
+#define FAWM_FAKE
+#include "../fawm/main.c"
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,781 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include <fawm/config.h>
+
+#if defined(FAWM_HAVE_XRES)
+#include <X11/extensions/XRes.h>
+#endif
+
+/*
+ * A soak test of fawm. This starts Xvfb and fawm, opens and destroys many
+ * windows with random sizes, titles, WM_PROTOCOLS and size hints in rounds,
+ * and samples resources of fawm after each round. Every round ends with no
+ * windows, so the numbers must not grow after the first round (warming up).
+ * RSS and the heap move a little by fragmentation, so only their slope across
+ * the rounds after the first is checked, which finds a leak of a few bytes per
+ * window. Samples are printed in JSON to stdout, and a growth makes the exit
+ * status 2.
+ */
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+#define WINDOWS_MAX 10000
+#define TITLE_SIZE_MAX 256
+#define TIMEOUT_USEC (30 * 1000 * 1000)
+#define POLL_USEC (10 * 1000)
+#define RESOURCE_TYPES_MAX 32
+
+/*
+ * Numbers which fawm prints by SIGUSR1. The format must be same as the one of
+ * dump_resources() of fawm.
+ */
+struct FawmResources {
+    int frames;
+    int pooled_frames;
+    int array_capacity;
+    int window_states;
+    int gcs;
+    int pixmaps;
+    int xft_draws;
+    int regions;
+    long heap;
+};
+
+typedef struct FawmResources FawmResources;
+
+#define FAWM_RESOURCES_FMT "resources: frames=%d, pooled frames=%d, array capacity=%d, window states=%d, gcs=%d, pixmaps=%d, xft_draws=%d, regions=%d, heap=%ld"
+
+/* Numbers of resources of fawm in the server, by XRes */
+struct ServerResources {
+    int size;
+    Atom types[RESOURCE_TYPES_MAX];
+    int counts[RESOURCE_TYPES_MAX];
+};
+
+typedef struct ServerResources ServerResources;
+
+struct Sample {
+    long rss_kb;
+    FawmResources fawm;
+    ServerResources server;
+};
+
+typedef struct Sample Sample;
+
+struct Stress {
+    Display* display;
+    Window root;
+    Window windows[WINDOWS_MAX];
+    int windows_num;
+    unsigned int seed;
+
+    pid_t fawm_pid;
+    FILE* fawm_stderr;
+    /* The first XID of fawm in the server. None without XRes. */
+    XID fawm_client;
+
+    Atom wm_delete_window;
+    Atom wm_take_focus;
+};
+
+typedef struct Stress Stress;
+
+static long
+get_monotonic_usec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000 * ts.tv_sec + ts.tv_nsec / 1000;
+}
+
+static void
+die(const char* msg)
+{
+    fprintf(stderr, "fawm-stress: %s\n", msg);
+    exit(1);
+}
+
+static int
+get_random(Stress* stress, int n)
+{
+    return rand_r(&stress->seed) % n;
+}
+
+/* Standard error of the child goes to fd, or is inherited if fd is -1. */
+static pid_t
+spawn(char* const argv[], const char* display_name, int fd)
+{
+    pid_t pid = fork();
+    if (pid == -1) {
+        die("fork failed.");
+    }
+    if (pid == 0) {
+        if (fd != -1) {
+            dup2(fd, 2);
+            close(fd);
+        }
+        setenv("DISPLAY", display_name, 1);
+        execvp(argv[0], argv);
+        fprintf(stderr, "fawm-stress: cannot execute %s: %s\n", argv[0], strerror(errno));
+        _exit(1);
+    }
+    return pid;
+}
+
+static void
+stop(pid_t pid)
+{
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+static Display*
+connect_server(const char* display_name)
+{
+    int i;
+    for (i = 0; i < 100; i++) {
+        Display* display = XOpenDisplay(display_name);
+        if (display != NULL) {
+            return display;
+        }
+        usleep(100 * 1000);
+    }
+    die("cannot connect to Xvfb.");
+    return NULL;
+}
+
+static char*
+make_temp_file(const char* template)
+{
+    char* path = strdup(template);
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        die("mkstemp failed.");
+    }
+    close(fd);
+    return path;
+}
+
+static void
+write_config(const char* path)
+{
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        die("cannot write the config file.");
+    }
+    fprintf(fp, "menu\n    reload\nend\n");
+    fclose(fp);
+}
+
+/* Waits until the server sends n events of the type to the windows. */
+static Bool
+wait_for_events(Stress* stress, int type, int n)
+{
+    Display* display = stress->display;
+    long deadline = get_monotonic_usec() + TIMEOUT_USEC;
+    int count = 0;
+    while (count < n) {
+        while ((count < n) && (0 < XPending(display))) {
+            XEvent e;
+            XNextEvent(display, &e);
+            if (e.type != type) {
+                continue;
+            }
+            /* A withdrawn window may be reparented to the root window. */
+            if ((type == ReparentNotify) && (e.xreparent.parent == stress->root)) {
+                continue;
+            }
+            count++;
+        }
+        long rest = deadline - get_monotonic_usec();
+        if (rest <= 0) {
+            return False;
+        }
+        int fd = XConnectionNumber(display);
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+        struct timeval tv;
+        tv.tv_sec = rest / 1000000;
+        tv.tv_usec = rest % 1000000;
+        if ((count < n) && (select(fd + 1, &fds, NULL, NULL, &tv) < 0) && (errno != EINTR)) {
+            die("select failed.");
+        }
+    }
+    return True;
+}
+
+/* Titles have random lengths and both of ASCII and multibyte characters. */
+static void
+make_title(Stress* stress, char* buf, int size)
+{
+    const char* pieces[] = { "a", "Z", "0", " ", "-", "\xe3\x81\x82", "\xe6\xbc\xa2", "\xc3\xa9" };
+    int pieces_num = sizeof(pieces) / sizeof(pieces[0]);
+    int len = get_random(stress, size / 4);
+    int pos = 0;
+    int i;
+    for (i = 0; i < len; i++) {
+        const char* s = pieces[get_random(stress, pieces_num)];
+        int n = strlen(s);
+        if (size <= pos + n) {
+            break;
+        }
+        memcpy(&buf[pos], s, n);
+        pos += n;
+    }
+    buf[pos] = '\0';
+}
+
+static void
+make_size_hints(Stress* stress, XSizeHints* hints)
+{
+    bzero(hints, sizeof(*hints));
+    hints->flags = get_random(stress, 2) == 0 ? USPosition : PPosition;
+    if (get_random(stress, 2) == 0) {
+        hints->flags |= PMinSize;
+        hints->min_width = get_random(stress, 200);
+        hints->min_height = get_random(stress, 200);
+    }
+    if (get_random(stress, 2) == 0) {
+        hints->flags |= PMaxSize;
+        hints->max_width = 1 + get_random(stress, SCREEN_WIDTH);
+        hints->max_height = 1 + get_random(stress, SCREEN_HEIGHT);
+    }
+    if (get_random(stress, 4) == 0) {
+        hints->flags |= PResizeInc | PBaseSize;
+        hints->width_inc = 1 + get_random(stress, 16);
+        hints->height_inc = 1 + get_random(stress, 16);
+        hints->base_width = get_random(stress, 32);
+        hints->base_height = get_random(stress, 32);
+    }
+}
+
+static void
+set_protocols(Stress* stress, Window w)
+{
+    Atom protocols[2];
+    int n = 0;
+    if (get_random(stress, 2) == 0) {
+        protocols[n] = stress->wm_delete_window;
+        n++;
+    }
+    if (get_random(stress, 2) == 0) {
+        protocols[n] = stress->wm_take_focus;
+        n++;
+    }
+    if (0 < n) {
+        XSetWMProtocols(stress->display, w, protocols, n);
+    }
+}
+
+static Window
+create_window(Stress* stress)
+{
+    Display* display = stress->display;
+    int screen = DefaultScreen(display);
+    unsigned long black = BlackPixel(display, screen);
+    unsigned long white = WhitePixel(display, screen);
+    if (WINDOWS_MAX <= stress->windows_num) {
+        die("too many windows.");
+    }
+    int x = get_random(stress, SCREEN_WIDTH);
+    int y = get_random(stress, SCREEN_HEIGHT);
+    int width = 1 + get_random(stress, SCREEN_WIDTH);
+    int height = 1 + get_random(stress, SCREEN_HEIGHT);
+    Window w = XCreateSimpleWindow(display, stress->root, x, y, width, height, 0, black, white);
+    XSelectInput(display, w, StructureNotifyMask);
+
+    char title[TITLE_SIZE_MAX];
+    make_title(stress, title, sizeof(title));
+    XSizeHints hints;
+    make_size_hints(stress, &hints);
+    Xutf8SetWMProperties(display, w, title, NULL, NULL, 0, &hints, NULL, NULL);
+    set_protocols(stress, w);
+
+    stress->windows[stress->windows_num] = w;
+    stress->windows_num++;
+    return w;
+}
+
+/*
+ * Windows are destroyed in a random order. Some of them are withdrawn before,
+ * and some are renamed, to run other paths of fawm.
+ */
+static Bool
+destroy_windows(Stress* stress)
+{
+    Display* display = stress->display;
+    int n = stress->windows_num;
+    int i;
+    for (i = n - 1; 0 < i; i--) {
+        int j = get_random(stress, i + 1);
+        Window w = stress->windows[i];
+        stress->windows[i] = stress->windows[j];
+        stress->windows[j] = w;
+    }
+    for (i = 0; i < n; i++) {
+        Window w = stress->windows[i];
+        switch (get_random(stress, 4)) {
+        case 0:
+            XUnmapWindow(display, w);
+            break;
+        case 1:
+            {
+                char title[TITLE_SIZE_MAX];
+                make_title(stress, title, sizeof(title));
+                Xutf8SetWMProperties(display, w, title, NULL, NULL, 0, NULL, NULL, NULL);
+            }
+            break;
+        default:
+            break;
+        }
+        XDestroyWindow(display, w);
+    }
+    stress->windows_num = 0;
+    XFlush(display);
+    return wait_for_events(stress, DestroyNotify, n);
+}
+
+static long
+read_rss_kb(pid_t pid)
+{
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "ps -o rss= -p %d", (int)pid);
+    FILE* fp = popen(cmd, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    long rss;
+    if (fscanf(fp, "%ld", &rss) != 1) {
+        rss = -1;
+    }
+    pclose(fp);
+    return rss;
+}
+
+/* Reads the next line of resources in the standard error of fawm. */
+static Bool
+read_fawm_resources(Stress* stress, FawmResources* resources)
+{
+    FILE* fp = stress->fawm_stderr;
+    long deadline = get_monotonic_usec() + TIMEOUT_USEC;
+    char line[512];
+    while (get_monotonic_usec() < deadline) {
+        if (fgets(line, sizeof(line), fp) == NULL) {
+            clearerr(fp);
+            usleep(POLL_USEC);
+            continue;
+        }
+        const char* s = strstr(line, "resources: ");
+        if (s == NULL) {
+            continue;
+        }
+        FawmResources* r = resources;
+        int n = sscanf(s, FAWM_RESOURCES_FMT, &r->frames, &r->pooled_frames, &r->array_capacity, &r->window_states, &r->gcs, &r->pixmaps, &r->xft_draws, &r->regions, &r->heap);
+        return n == 9;
+    }
+    return False;
+}
+
+#if defined(FAWM_HAVE_XRES)
+/*
+ * fawm is the owner of windows on the root window when it started, because
+ * the server has no other clients.
+ */
+static XID
+search_fawm_client(Stress* stress)
+{
+    Display* display = stress->display;
+    int _;
+    if (!XResQueryExtension(display, &_, &_)) {
+        return None;
+    }
+    Window root;
+    Window parent;
+    Window* children;
+    unsigned int n;
+    if ((XQueryTree(display, stress->root, &root, &parent, &children, &n) == 0) || (n == 0)) {
+        return None;
+    }
+    Window w = children[0];
+    XFree(children);
+
+    XResClient* clients;
+    int clients_num;
+    if (XResQueryClients(display, &clients_num, &clients) == 0) {
+        return None;
+    }
+    XID base = None;
+    int i;
+    for (i = 0; i < clients_num; i++) {
+        if ((w & ~clients[i].resource_mask) == clients[i].resource_base) {
+            base = clients[i].resource_base;
+        }
+    }
+    XFree(clients);
+    return base;
+}
+
+static void
+read_server_resources(Stress* stress, ServerResources* resources)
+{
+    resources->size = 0;
+    XResType* types;
+    int n;
+    if (XResQueryClientResources(stress->display, stress->fawm_client, &n, &types) == 0) {
+        return;
+    }
+    int i;
+    for (i = 0; (i < n) && (i < RESOURCE_TYPES_MAX); i++) {
+        resources->types[i] = types[i].resource_type;
+        resources->counts[i] = types[i].count;
+    }
+    resources->size = i;
+    XFree(types);
+}
+#else
+static XID
+search_fawm_client(Stress* stress)
+{
+    return None;
+}
+
+static void
+read_server_resources(Stress* stress, ServerResources* resources)
+{
+    resources->size = 0;
+}
+#endif
+
+/*
+ * fawm may be still processing DestroyNotify events. SIGUSR1 is repeated
+ * until it has no frames.
+ */
+static Bool
+take_sample(Stress* stress, Sample* sample)
+{
+    long deadline = get_monotonic_usec() + TIMEOUT_USEC;
+    do {
+        XSync(stress->display, False);
+        kill(stress->fawm_pid, SIGUSR1);
+        if (!read_fawm_resources(stress, &sample->fawm)) {
+            return False;
+        }
+        if (sample->fawm.frames == 0) {
+            break;
+        }
+        usleep(POLL_USEC);
+    } while (get_monotonic_usec() < deadline);
+    sample->rss_kb = read_rss_kb(stress->fawm_pid);
+    if (stress->fawm_client != None) {
+        read_server_resources(stress, &sample->server);
+    }
+    return True;
+}
+
+static Bool
+run_round(Stress* stress, int windows_num, Sample* sample)
+{
+    Display* display = stress->display;
+    int i;
+    for (i = 0; i < windows_num; i++) {
+        Window w = create_window(stress);
+        XMapWindow(display, w);
+    }
+    XFlush(display);
+    if (!wait_for_events(stress, ReparentNotify, windows_num)) {
+        return False;
+    }
+    if (!destroy_windows(stress)) {
+        return False;
+    }
+    return take_sample(stress, sample);
+}
+
+static int
+search_server_count(ServerResources* resources, Atom type)
+{
+    int i;
+    for (i = 0; i < resources->size; i++) {
+        if (resources->types[i] == type) {
+            return resources->counts[i];
+        }
+    }
+    return 0;
+}
+
+static int
+report_growth(const char* name, long base, long value)
+{
+    if (value <= base) {
+        return 0;
+    }
+    fprintf(stderr, "fawm-stress: %s grew from %ld to %ld.\n", name, base, value);
+    return 1;
+}
+
+/* Compares counts of a sample with the ones of the first round. */
+static int
+check_sample(Stress* stress, Sample* base, Sample* sample)
+{
+    FawmResources* b = &base->fawm;
+    FawmResources* r = &sample->fawm;
+    int n = 0;
+    n += report_growth("frames", 0, r->frames);
+    n += report_growth("pooled frames", b->pooled_frames, r->pooled_frames);
+    n += report_growth("array capacity", b->array_capacity, r->array_capacity);
+    n += report_growth("window states", b->window_states, r->window_states);
+    n += report_growth("gcs", b->gcs, r->gcs);
+    n += report_growth("pixmaps", b->pixmaps, r->pixmaps);
+    n += report_growth("xft_draws", b->xft_draws, r->xft_draws);
+    n += report_growth("regions", b->regions, r->regions);
+    ServerResources* server = &sample->server;
+    int i;
+    for (i = 0; i < server->size; i++) {
+        Atom type = server->types[i];
+        char* name = XGetAtomName(stress->display, type);
+        int count = search_server_count(&base->server, type);
+        n += report_growth(name != NULL ? name : "?", count, server->counts[i]);
+        if (name != NULL) {
+            XFree(name);
+        }
+    }
+    return n;
+}
+
+/* The least squares slope of values per round. A negative value is unknown. */
+static int
+check_slope(const char* name, const long* values, int n, double limit)
+{
+    double sum_x = 0;
+    double sum_y = 0;
+    double sum_xx = 0;
+    double sum_xy = 0;
+    int i;
+    for (i = 0; i < n; i++) {
+        if (values[i] < 0) {
+            return 0;
+        }
+        sum_x += i;
+        sum_y += values[i];
+        sum_xx += (double)i * i;
+        sum_xy += (double)i * values[i];
+    }
+    double slope = (n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x);
+    if (slope <= limit) {
+        return 0;
+    }
+    fprintf(stderr, "fawm-stress: %s grew by %.0f per round.\n", name, slope);
+    return 1;
+}
+
+static void
+print_sample(Stress* stress, int round, Sample* sample, const char* tail)
+{
+    FawmResources* r = &sample->fawm;
+    printf("    {\n");
+    printf("      \"round\": %d,\n", round);
+    printf("      \"rss_kb\": %ld,\n", sample->rss_kb);
+    printf("      \"heap\": %ld,\n", r->heap);
+    printf("      \"frames\": %d,\n", r->frames);
+    printf("      \"pooled_frames\": %d,\n", r->pooled_frames);
+    printf("      \"array_capacity\": %d,\n", r->array_capacity);
+    printf("      \"window_states\": %d,\n", r->window_states);
+    printf("      \"gcs\": %d,\n", r->gcs);
+    printf("      \"pixmaps\": %d,\n", r->pixmaps);
+    printf("      \"xft_draws\": %d,\n", r->xft_draws);
+    printf("      \"regions\": %d,\n", r->regions);
+    printf("      \"server\": {");
+    ServerResources* server = &sample->server;
+    int i;
+    for (i = 0; i < server->size; i++) {
+        char* name = XGetAtomName(stress->display, server->types[i]);
+        printf(" \"%s\": %d%s", name != NULL ? name : "?", server->counts[i], i < server->size - 1 ? "," : " ");
+        if (name != NULL) {
+            XFree(name);
+        }
+    }
+    printf("}\n");
+    printf("    }%s\n", tail);
+    fflush(stdout);
+}
+
+/* fawm is ready when it reparented the first window. */
+static void
+wait_for_fawm(Stress* stress)
+{
+    Window w = create_window(stress);
+    XMapWindow(stress->display, w);
+    XFlush(stress->display);
+    if (!wait_for_events(stress, ReparentNotify, 1)) {
+        die("fawm did not manage a window.");
+    }
+    if (!destroy_windows(stress)) {
+        die("a window was not destroyed.");
+    }
+}
+
+static void
+usage()
+{
+    printf("Usage: fawm-stress [--fawm=PATH] [--xvfb=PATH] [--display=NAME] [--rounds=N] [--windows=N] [--seed=N] [--slope=KB]\n");
+}
+
+int
+main(int argc, char* argv[])
+{
+    const char* fawm = "fawm";
+    const char* xvfb = "Xvfb";
+    const char* display_name = ":99";
+    int rounds = 10;
+    int windows_num = 1000;
+    unsigned int seed = 1;
+    double slope_kb = 4;
+    struct option longopts[] = {
+        { "display", required_argument, NULL, 'd' },
+        { "fawm", required_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { "rounds", required_argument, NULL, 'r' },
+        { "seed", required_argument, NULL, 's' },
+        { "slope", required_argument, NULL, 'l' },
+        { "windows", required_argument, NULL, 'w' },
+        { "xvfb", required_argument, NULL, 'x' },
+        { NULL, 0, NULL, 0 }
+    };
+    int val;
+    while ((val = getopt_long_only(argc, argv, "", longopts, NULL)) != -1) {
+        switch (val) {
+        case 'd':
+            display_name = optarg;
+            break;
+        case 'f':
+            fawm = optarg;
+            break;
+        case 'h':
+            usage();
+            return 0;
+        case 'l':
+            slope_kb = atof(optarg);
+            break;
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            windows_num = atoi(optarg);
+            break;
+        case 'x':
+            xvfb = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    /* A slope needs two rounds after the first one. */
+    if (rounds < 3) {
+        die("rounds must be 3 or more.");
+    }
+    if ((windows_num < 1) || (WINDOWS_MAX < windows_num)) {
+        die("windows must be in 1..10000.");
+    }
+
+    Stress stress;
+    bzero(&stress, sizeof(stress));
+    stress.seed = seed;
+    char* config_file = make_temp_file("/tmp/fawm-stress.XXXXXX");
+    write_config(config_file);
+    char* stderr_file = make_temp_file("/tmp/fawm-stress.XXXXXX");
+
+    char geometry[32];
+    snprintf(geometry, sizeof(geometry), "%dx%dx24", SCREEN_WIDTH, SCREEN_HEIGHT);
+    char* xvfb_argv[] = { (char*)xvfb, (char*)display_name, "-screen", "0", geometry, "-nolisten", "tcp", NULL };
+    pid_t xvfb_pid = spawn(xvfb_argv, display_name, -1);
+    Display* display = connect_server(display_name);
+    stress.display = display;
+    stress.root = DefaultRootWindow(display);
+    stress.wm_delete_window = XInternAtom(display, "WM_DELETE_WINDOW", False);
+    stress.wm_take_focus = XInternAtom(display, "WM_TAKE_FOCUS", False);
+
+    int fd = open(stderr_file, O_WRONLY | O_APPEND);
+    if (fd == -1) {
+        die("cannot open the file for the standard error.");
+    }
+    char* fawm_argv[] = { (char*)fawm, "--config", config_file, NULL };
+    stress.fawm_pid = spawn(fawm_argv, display_name, fd);
+    close(fd);
+    stress.fawm_stderr = fopen(stderr_file, "r");
+    if (stress.fawm_stderr == NULL) {
+        die("cannot read the standard error of fawm.");
+    }
+    wait_for_fawm(&stress);
+    stress.fawm_client = search_fawm_client(&stress);
+
+    printf("{\n");
+    printf("  \"version\": \"%s\",\n", FAWM_PACKAGE_VERSION);
+    printf("  \"windows\": %d,\n", windows_num);
+    printf("  \"rounds\": [\n");
+    Sample base;
+    bzero(&base, sizeof(base));
+    long* heaps = (long*)malloc(sizeof(heaps[0]) * rounds);
+    long* rss_kbs = (long*)malloc(sizeof(rss_kbs[0]) * rounds);
+    if ((heaps == NULL) || (rss_kbs == NULL)) {
+        die("malloc failed.");
+    }
+    int growths = 0;
+    int i;
+    for (i = 0; i < rounds; i++) {
+        Sample sample;
+        bzero(&sample, sizeof(sample));
+        if (!run_round(&stress, windows_num, &sample)) {
+            stop(stress.fawm_pid);
+            stop(xvfb_pid);
+            die("fawm did not respond.");
+        }
+        print_sample(&stress, i, &sample, i < rounds - 1 ? "," : "");
+        heaps[i] = sample.fawm.heap;
+        rss_kbs[i] = sample.rss_kb;
+        if (i == 0) {
+            base = sample;
+            continue;
+        }
+        growths += check_sample(&stress, &base, &sample);
+    }
+    printf("  ]\n");
+    printf("}\n");
+    growths += check_slope("heap", heaps + 1, rounds - 1, 1024 * slope_kb);
+    growths += check_slope("rss_kb", rss_kbs + 1, rounds - 1, slope_kb);
+    free(rss_kbs);
+    free(heaps);
+
+    stop(stress.fawm_pid);
+    fclose(stress.fawm_stderr);
+    XCloseDisplay(display);
+    stop(xvfb_pid);
+    unlink(stderr_file);
+    unlink(config_file);
+    free(stderr_file);
+    free(config_file);
+
+    return growths == 0 ? 0 : 2;
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,265 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fawm/private/trace.h>
+
+/*
+ * Decodes a trace of fawm --log-file into text. Each line is a timestamp in
+ * seconds from the first record, a call site, the pid and the message.
+ */
+
+struct Definitions {
+    int size;
+    char** items;
+};
+
+typedef struct Definitions Definitions;
+
+static void*
+alloc_memory(size_t size)
+{
+    void* p = malloc(size);
+    if (p == NULL) {
+        fprintf(stderr, "malloc failed.\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void
+define(Definitions* definitions, int id, const char* s)
+{
+    if (definitions->size <= id) {
+        int size = id + 64;
+        size_t bytes = sizeof(definitions->items[0]) * size;
+        char** items = (char**)realloc(definitions->items, bytes);
+        if (items == NULL) {
+            fprintf(stderr, "realloc failed.\n");
+            exit(1);
+        }
+        memset(&items[definitions->size], 0, bytes - sizeof(items[0]) * definitions->size);
+        definitions->size = size;
+        definitions->items = items;
+    }
+    free(definitions->items[id]);
+    char* t = (char*)alloc_memory(strlen(s) + 1);
+    strcpy(t, s);
+    definitions->items[id] = t;
+}
+
+static const char*
+lookup(Definitions* definitions, int id)
+{
+    if ((id < 0) || (definitions->size <= id)) {
+        return NULL;
+    }
+    return definitions->items[id];
+}
+
+static const char*
+read_number(const char* p, const char* end, int64_t* n)
+{
+    if (end < p + sizeof(*n)) {
+        return NULL;
+    }
+    memcpy(n, p, sizeof(*n));
+    return p + sizeof(*n);
+}
+
+static const char*
+read_string(const char* p, const char* end, char* s)
+{
+    if (end < p + 1) {
+        return NULL;
+    }
+    size_t len = (unsigned char)*p;
+    if (end < p + 1 + len) {
+        return NULL;
+    }
+    memcpy(s, p + 1, len);
+    s[len] = '\0';
+    return p + 1 + len;
+}
+
+/* Prints one argument with its conversion specification in spec. */
+static const char*
+print_arg(FILE* fp, const char* spec, char type, const char* p, const char* end)
+{
+    int64_t n;
+    double d;
+    char s[TRACE_STRING_MAX + 1];
+    switch (type) {
+    case TRACE_ARG_INT:
+        p = read_number(p, end, &n);
+        if (p != NULL) {
+            fprintf(fp, spec, (int)n);
+        }
+        return p;
+    case TRACE_ARG_LONG:
+        p = read_number(p, end, &n);
+        if (p != NULL) {
+            fprintf(fp, spec, (long)n);
+        }
+        return p;
+    case TRACE_ARG_DOUBLE:
+        p = read_number(p, end, &n);
+        if (p != NULL) {
+            memcpy(&d, &n, sizeof(d));
+            fprintf(fp, spec, d);
+        }
+        return p;
+    case TRACE_ARG_POINTER:
+        p = read_number(p, end, &n);
+        if (p != NULL) {
+            fprintf(fp, spec, (void*)(intptr_t)n);
+        }
+        return p;
+    case TRACE_ARG_STRING:
+        p = read_string(p, end, s);
+        if (p != NULL) {
+            fprintf(fp, spec, s);
+        }
+        return p;
+    default:
+        return NULL;
+    }
+}
+
+static void
+print_message(FILE* fp, const char* fmt, const char* p, const char* end)
+{
+    int args_num = 0;
+    const char* q = fmt;
+    while (*q != '\0') {
+        if (*q != '%') {
+            fputc(*q, fp);
+            q++;
+            continue;
+        }
+        char type;
+        const char* next = trace_scan_conversion(q, &type);
+        char spec[32];
+        size_t len = next - q;
+        if (sizeof(spec) <= len) {
+            len = sizeof(spec) - 1;
+        }
+        memcpy(spec, q, len);
+        spec[len] = '\0';
+        q = next;
+        if (strcmp(spec, "%%") == 0) {
+            fputc('%', fp);
+            continue;
+        }
+        /* A broken argument is shown as its specification. */
+        bool ok = (type != '\0') && (args_num < TRACE_ARGS_MAX) && (p != NULL);
+        const char* rest = ok ? print_arg(fp, spec, type, p, end) : NULL;
+        if (rest == NULL) {
+            fputs(spec, fp);
+        }
+        p = rest;
+        args_num++;
+    }
+    fputc('\n', fp);
+}
+
+static bool
+decode(FILE* fpin, FILE* fpout)
+{
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, fpin) != 1) {
+        fprintf(stderr, "Cannot read the header.\n");
+        return false;
+    }
+    if (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "Not a trace of fawm.\n");
+        return false;
+    }
+
+    Definitions files = { 0, NULL };
+    Definitions formats = { 0, NULL };
+    bool started = false;
+    uint64_t start = 0;
+    char payload[TRACE_RECORD_MAX + 1];
+    TraceRecord record;
+    /*
+     * A header as long as the first half of a record begins a segment which a
+     * restarted fawm appended. Its pid replaces the former one, but the start
+     * is kept, because the monotonic clock goes on across exec(2).
+     */
+    while (fread(&record, sizeof(header), 1, fpin) == 1) {
+        if (memcmp(&record, TRACE_MAGIC, sizeof(header.magic)) == 0) {
+            memcpy(&header, &record, sizeof(header));
+            continue;
+        }
+        size_t rest = sizeof(record) - sizeof(header);
+        if (fread((char*)&record + sizeof(header), 1, rest, fpin) != rest) {
+            fprintf(stderr, "Truncated record.\n");
+            return false;
+        }
+        size_t size = record.size;
+        if ((size < sizeof(record)) || (TRACE_RECORD_MAX < size)) {
+            fprintf(stderr, "Broken record of size %zu.\n", size);
+            return false;
+        }
+        size_t payload_size = size - sizeof(record);
+        if (fread(payload, 1, payload_size, fpin) != payload_size) {
+            fprintf(stderr, "Truncated record.\n");
+            return false;
+        }
+        payload[payload_size] = '\0';
+
+        const char* file;
+        const char* fmt;
+        switch (record.type) {
+        case TRACE_RECORD_TYPE_FILE:
+            define(&files, record.file, payload);
+            break;
+        case TRACE_RECORD_TYPE_FORMAT:
+            define(&formats, record.format, payload);
+            break;
+        case TRACE_RECORD_TYPE_EVENT:
+            if (!started) {
+                started = true;
+                start = record.nsec;
+            }
+            uint64_t nsec = record.nsec - start;
+            file = lookup(&files, record.file);
+            fmt = lookup(&formats, record.format);
+            fprintf(fpout, "%llu.%09llu ", (unsigned long long)(nsec / 1000000000), (unsigned long long)(nsec % 1000000000));
+            fprintf(fpout, "%s:%u [%u] ", file != NULL ? file : "?", record.line, header.pid);
+            print_message(fpout, fmt != NULL ? fmt : "?", payload, payload + payload_size);
+            break;
+        default:
+            fprintf(stderr, "Unknown record type: %u\n", record.type);
+            break;
+        }
+    }
+
+    return true;
+}
+
+int
+main(int argc, const char* argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <trace>\n", argv[0]);
+        return 1;
+    }
+    const char* path = argv[1];
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return 1;
+    }
+    bool ok = decode(fp, stdout);
+    fclose(fp);
+
+    return ok ? 0 : 1;
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,94 @@
+#include <fawm/private/backend.h>
+
+Backend xlib_backend = {
+    .name = "xlib",
+
+    .open_display = XOpenDisplay,
+    .close_display = XCloseDisplay,
+    .pending = XPending,
+    .next_event = XNextEvent,
+    .check_if_event = XCheckIfEvent,
+    .flush = XFlush,
+    .sync = XSync,
+
+    .add_to_save_set = XAddToSaveSet,
+    .alloc_named_color = XAllocNamedColor,
+    .allow_events = XAllowEvents,
+    .change_window_attributes = XChangeWindowAttributes,
+    .clear_area = XClearArea,
+    .configure_window = XConfigureWindow,
+    .copy_area = XCopyArea,
+    .create_font_cursor = XCreateFontCursor,
+    .create_gc = XCreateGC,
+    .create_pixmap_from_bitmap_data = XCreatePixmapFromBitmapData,
+    .create_pixmap = XCreatePixmap,
+    .create_simple_window = XCreateSimpleWindow,
+    .create_window = XCreateWindow,
+    .define_cursor = XDefineCursor,
+    .destroy_window = XDestroyWindow,
+    .draw_rectangles = XDrawRectangles,
+    .draw_segments = XDrawSegments,
+    .fill_rectangle = XFillRectangle,
+    .fill_rectangles = XFillRectangles,
+    .free_cursor = XFreeCursor,
+    .free_gc = XFreeGC,
+    .free_pixmap = XFreePixmap,
+    .get_geometry = XGetGeometry,
+    .get_text_property = XGetTextProperty,
+    .get_window_attributes = XGetWindowAttributes,
+    .get_wm_normal_hints = XGetWMNormalHints,
+    .get_wm_protocols = XGetWMProtocols,
+    .grab_button = XGrabButton,
+    .intern_atom = XInternAtom,
+    .kill_client = XKillClient,
+    .map_raised = XMapRaised,
+    .map_subwindows = XMapSubwindows,
+    .map_window = XMapWindow,
+    .move_resize_window = XMoveResizeWindow,
+    .move_window = XMoveWindow,
+    .query_tree = XQueryTree,
+    .raise_window = XRaiseWindow,
+    .reparent_window = XReparentWindow,
+    .resize_window = XResizeWindow,
+    .restack_windows = XRestackWindows,
+    .select_input = XSelectInput,
+    .send_event = XSendEvent,
+    .set_close_down_mode = XSetCloseDownMode,
+    .set_input_focus = XSetInputFocus,
+    .set_window_background = XSetWindowBackground,
+    .set_window_background_pixmap = XSetWindowBackgroundPixmap,
+    .set_window_border_width = XSetWindowBorderWidth,
+    .undefine_cursor = XUndefineCursor,
+    .ungrab_button = XUngrabButton,
+    .unmap_window = XUnmapWindow,
+
+    .xft_char_exists = XftCharExists,
+    .xft_char_index = XftCharIndex,
+    .xft_color_alloc_name = XftColorAllocName,
+    .xft_draw_change = XftDrawChange,
+    .xft_draw_create = XftDrawCreate,
+    .xft_draw_destroy = XftDrawDestroy,
+    .xft_draw_drawable = XftDrawDrawable,
+    .xft_draw_glyph_font_spec = XftDrawGlyphFontSpec,
+    .xft_draw_set_clip = XftDrawSetClip,
+    .xft_draw_set_clip_rectangles = XftDrawSetClipRectangles,
+    .xft_draw_string_utf8 = XftDrawStringUtf8,
+    .xft_font_close = XftFontClose,
+    .xft_font_open_name = XftFontOpenName,
+    .xft_glyph_extents = XftGlyphExtents,
+    .xft_text_extents_utf8 = XftTextExtentsUtf8,
+
+#if defined(FAWM_HAVE_XRANDR)
+    .rr_free_crtc_info = XRRFreeCrtcInfo,
+    .rr_free_screen_resources = XRRFreeScreenResources,
+    .rr_get_crtc_info = XRRGetCrtcInfo,
+    .rr_get_screen_resources_current = XRRGetScreenResourcesCurrent,
+    .rr_query_extension = XRRQueryExtension,
+    .rr_select_input = XRRSelectInput,
+    .rr_update_configuration = XRRUpdateConfiguration,
+#endif
+};
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
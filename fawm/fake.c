@@ -0,0 +1,2723 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/Xft/Xft.h>
+
+#include <fawm/private/backend.h>
+#include <fawm/private/fake.h>
+
+/*
+ * Resources are kept in an array indexed by their ids. An id is never reused,
+ * so a request for a destroyed window fails with BadWindow like the real one.
+ */
+#define FAKE_ID_BASE 0x00200000
+#define FAKE_DEPTH 24
+#define FAKE_ATOM_BASE (XA_LAST_PREDEFINED + 1)
+
+#define FAKE_CLIENTS_MIN 8
+#define FAKE_CLIENTS_MAX 64
+#define FAKE_EDGE_SIZE 8
+#define FAKE_TITLE_SIZE 32
+#define FAKE_APPLICATIONS_NUM 8
+
+enum FakeResourceType {
+    FAKE_RESOURCE_FREE,
+    FAKE_RESOURCE_WINDOW,
+    FAKE_RESOURCE_PIXMAP,
+    FAKE_RESOURCE_CURSOR
+};
+
+struct FakeResource {
+    enum FakeResourceType type;
+    Window parent;
+    /* From the bottom to the top */
+    Window* children;
+    int children_num;
+    int children_capacity;
+    Bool mapped;
+    Bool override_redirect;
+    int bit_gravity;
+    int x;
+    int y;
+    unsigned int width;
+    unsigned int height;
+    unsigned int border_width;
+    long event_mask;
+    unsigned int grabbed_buttons;
+    /* Properties of a client window */
+    Bool client;
+    char* name;
+    /* WM_CLASS, which is two strings terminated by NULs */
+    char* class_hint;
+    int class_hint_size;
+    Bool delete_window;
+    XSizeHints hints;
+    long hints_supplied;
+    /* ConfigureWindow requests, and synthetic ConfigureNotify sent to it */
+    unsigned long configures;
+    unsigned long configure_notifies;
+};
+
+typedef struct FakeResource FakeResource;
+
+struct FakeDraw {
+    Drawable drawable;
+};
+
+typedef struct FakeDraw FakeDraw;
+
+static struct {
+    _XPrivDisplay display;
+    Screen screen;
+    Visual visual;
+
+    FakeResource* resources;
+    int resources_num;
+    int resources_capacity;
+
+    char** atoms;
+    int atoms_num;
+    int atoms_capacity;
+
+    /* A ring buffer */
+    XEvent* events;
+    int events_head;
+    int events_num;
+    int events_capacity;
+
+    Window* clients;
+    int clients_num;
+    int clients_capacity;
+
+    Window focus;
+    int pointer_x;
+    int pointer_y;
+    unsigned int buttons;
+    Window pointer_window;
+    /* A window which has the pointer grabbed by a button */
+    Window grab;
+    Bool grab_passive;
+    Time time;
+    Bool replaying;
+
+    /* Windows of scenarios in the order of their numbers */
+    Window scenario_windows[SCENARIO_BACKGROUND_WINDOWS_NUM + SCENARIO_REPEATS_MAX];
+    int scenario_windows_num;
+    /* Counts of the client and its frame before the last "configure" step */
+    struct {
+        Window client;
+        Window frame;
+        unsigned long client_configures;
+        unsigned long frame_configures;
+        unsigned long configure_notifies;
+    } configure_step;
+
+    FakeStats stats;
+} server;
+
+static void*
+fake_alloc(size_t size)
+{
+    void* p = calloc(1, size);
+    if (p == NULL) {
+        fprintf(stderr, "fake: calloc failed.\n");
+        abort();
+    }
+    return p;
+}
+
+static void*
+fake_realloc(void* p, size_t size)
+{
+    void* q = realloc(p, size);
+    if (q == NULL) {
+        fprintf(stderr, "fake: realloc failed.\n");
+        abort();
+    }
+    return q;
+}
+
+static char*
+fake_strdup(const char* s)
+{
+    char* t = (char*)fake_alloc(strlen(s) + 1);
+    strcpy(t, s);
+    return t;
+}
+
+static void
+append_window(Window** windows, int* size, int* capacity, Window w)
+{
+    if (*size == *capacity) {
+        *capacity = *capacity == 0 ? 8 : 2 * *capacity;
+        *windows = (Window*)fake_realloc(*windows, sizeof(Window) * *capacity);
+    }
+    (*windows)[*size] = w;
+    (*size)++;
+}
+
+static void
+remove_window(Window* windows, int* size, Window w)
+{
+    int i;
+    for (i = 0; (i < *size) && (windows[i] != w); i++) {
+    }
+    if (i == *size) {
+        return;
+    }
+    memmove(&windows[i], &windows[i + 1], sizeof(Window) * (*size - i - 1));
+    (*size)--;
+}
+
+static void
+count_request()
+{
+    server.display->request++;
+    server.stats.requests++;
+}
+
+static void
+report_error(unsigned long* counter, const char* error, const char* request, XID id)
+{
+    (*counter)++;
+    if (server.stats.message[0] != '\0') {
+        return;
+    }
+    FakeStats* stats = &server.stats;
+    const char* fmt = "%s in %s (id=0x%08lx)";
+    snprintf(stats->message, sizeof(stats->message), fmt, error, request, id);
+}
+
+static FakeResource*
+find_resource(XID id, enum FakeResourceType type)
+{
+    if ((id < FAKE_ID_BASE) || (FAKE_ID_BASE + server.resources_num <= id)) {
+        return NULL;
+    }
+    FakeResource* r = &server.resources[id - FAKE_ID_BASE];
+    return r->type == type ? r : NULL;
+}
+
+static FakeResource*
+find_window(Window w)
+{
+    return find_resource(w, FAKE_RESOURCE_WINDOW);
+}
+
+static FakeResource*
+check_window(Window w, const char* request)
+{
+    FakeResource* r = find_window(w);
+    if (r == NULL) {
+        report_error(&server.stats.bad_window, "BadWindow", request, w);
+    }
+    return r;
+}
+
+static Bool
+check_size(unsigned int width, unsigned int height, const char* request)
+{
+    /* A negative size which is passed as unsigned int is too large. */
+    if ((0 < width) && (width <= 32767) && (0 < height) && (height <= 32767)) {
+        return True;
+    }
+    report_error(&server.stats.bad_value, "BadValue", request, width);
+    return False;
+}
+
+static XID
+create_resource(enum FakeResourceType type)
+{
+    if (server.resources_num == server.resources_capacity) {
+        int capacity = server.resources_capacity;
+        int new_capacity = capacity == 0 ? 1024 : 2 * capacity;
+        size_t size = sizeof(FakeResource) * new_capacity;
+        server.resources = (FakeResource*)fake_realloc(server.resources, size);
+        bzero(&server.resources[capacity], sizeof(FakeResource) * (new_capacity - capacity));
+        server.resources_capacity = new_capacity;
+    }
+    FakeResource* r = &server.resources[server.resources_num];
+    r->type = type;
+    server.resources_num++;
+    return FAKE_ID_BASE + server.resources_num - 1;
+}
+
+static XEvent*
+push_event()
+{
+    if (server.events_num == server.events_capacity) {
+        int capacity = server.events_capacity;
+        int new_capacity = capacity == 0 ? 256 : 2 * capacity;
+        XEvent* events = (XEvent*)fake_alloc(sizeof(XEvent) * new_capacity);
+        int i;
+        for (i = 0; i < server.events_num; i++) {
+            events[i] = server.events[(server.events_head + i) % capacity];
+        }
+        free(server.events);
+        server.events = events;
+        server.events_head = 0;
+        server.events_capacity = new_capacity;
+    }
+    int index = (server.events_head + server.events_num) % server.events_capacity;
+    server.events_num++;
+    server.stats.events++;
+    return &server.events[index];
+}
+
+/* The copy is delivered to w. xany.window is the event window of any type. */
+static void
+queue_event(XEvent* e, Window w)
+{
+    if (server.replaying) {
+        return;
+    }
+    XEvent* dest = push_event();
+    *dest = *e;
+    dest->xany.serial = server.display->request;
+    dest->xany.send_event = False;
+    dest->xany.display = (Display*)server.display;
+    dest->xany.window = w;
+}
+
+static Bool
+selects(Window w, long mask)
+{
+    FakeResource* r = find_window(w);
+    return (r != NULL) && ((r->event_mask & mask) != 0);
+}
+
+static void
+queue_selected_event(XEvent* e, Window w, long mask)
+{
+    if (selects(w, mask)) {
+        queue_event(e, w);
+    }
+}
+
+static void
+send_structure_event(FakeResource* r, Window w, XEvent* e)
+{
+    queue_selected_event(e, w, StructureNotifyMask);
+    queue_selected_event(e, r->parent, SubstructureNotifyMask);
+}
+
+static Window
+get_root()
+{
+    return server.screen.root;
+}
+
+static Bool
+is_viewable(FakeResource* r)
+{
+    while (r->parent != None) {
+        if (!r->mapped) {
+            return False;
+        }
+        r = find_window(r->parent);
+    }
+    return True;
+}
+
+static Bool
+is_ancestor(Window ancestor, Window w)
+{
+    FakeResource* r = find_window(w);
+    while ((r != NULL) && (r->parent != None)) {
+        if (r->parent == ancestor) {
+            return True;
+        }
+        r = find_window(r->parent);
+    }
+    return False;
+}
+
+/* Computes the position of the inside of w in the root window. */
+static void
+get_origin(Window w, int* x, int* y)
+{
+    *x = *y = 0;
+    FakeResource* r = find_window(w);
+    while ((r != NULL) && (r->parent != None)) {
+        *x += r->x + r->border_width;
+        *y += r->y + r->border_width;
+        r = find_window(r->parent);
+    }
+}
+
+/* count is the number of Expose events which follow in the series. */
+static void
+queue_expose(Window w, int x, int y, int width, int height, int count)
+{
+    if ((width <= 0) || (height <= 0) || !selects(w, ExposureMask)) {
+        return;
+    }
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = Expose;
+    e.xexpose.x = x;
+    e.xexpose.y = y;
+    e.xexpose.width = width;
+    e.xexpose.height = height;
+    e.xexpose.count = count;
+    queue_event(&e, w);
+}
+
+static void
+expose_tree(Window w)
+{
+    FakeResource* r = find_window(w);
+    if (!r->mapped) {
+        return;
+    }
+    queue_expose(w, 0, 0, r->width, r->height, 0);
+    int i;
+    for (i = 0; i < r->children_num; i++) {
+        expose_tree(r->children[i]);
+    }
+}
+
+/*
+ * Exposes the parent and siblings under w which were covered by the rectangle
+ * (in the parent). Other windows are assumed not to cover them.
+ */
+static void
+expose_under(FakeResource* r, Window w, int x, int y, int width, int height)
+{
+    FakeResource* parent = find_window(r->parent);
+    if ((parent == NULL) || !is_viewable(parent)) {
+        return;
+    }
+    queue_expose(r->parent, x, y, width, height, 0);
+    int i;
+    for (i = 0; (i < parent->children_num) && (parent->children[i] != w); i++) {
+        FakeResource* sibling = find_window(parent->children[i]);
+        if (!sibling->mapped) {
+            continue;
+        }
+        int left = sibling->x + sibling->border_width;
+        int top = sibling->y + sibling->border_width;
+        int x1 = x < left ? left : x;
+        int y1 = y < top ? top : y;
+        int right = left + sibling->width;
+        int bottom = top + sibling->height;
+        int x2 = x + width < right ? x + width : right;
+        int y2 = y + height < bottom ? y + height : bottom;
+        queue_expose(parent->children[i], x1 - left, y1 - top, x2 - x1, y2 - y1, 0);
+    }
+}
+
+static void
+expose_outer_under(FakeResource* r, Window w)
+{
+    int border_size = 2 * r->border_width;
+    expose_under(r, w, r->x, r->y, r->width + border_size, r->height + border_size);
+}
+
+static void
+map_window(Window w, FakeResource* r)
+{
+    if (r->mapped) {
+        return;
+    }
+    r->mapped = True;
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = MapNotify;
+    e.xmap.window = w;
+    e.xmap.override_redirect = r->override_redirect;
+    send_structure_event(r, w, &e);
+    if (is_viewable(r)) {
+        expose_tree(w);
+    }
+}
+
+static void
+unmap_window(Window w, FakeResource* r)
+{
+    if (!r->mapped) {
+        return;
+    }
+    Bool viewable = is_viewable(r);
+    r->mapped = False;
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = UnmapNotify;
+    e.xunmap.window = w;
+    e.xunmap.from_configure = False;
+    send_structure_event(r, w, &e);
+    if (viewable) {
+        expose_outer_under(r, w);
+    }
+}
+
+static void
+release_grab()
+{
+    server.grab = None;
+    server.grab_passive = False;
+}
+
+static void
+destroy_window(Window w, FakeResource* r)
+{
+    while (0 < r->children_num) {
+        Window child = r->children[r->children_num - 1];
+        destroy_window(child, find_window(child));
+    }
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = DestroyNotify;
+    e.xdestroywindow.window = w;
+    send_structure_event(r, w, &e);
+
+    FakeResource* parent = find_window(r->parent);
+    remove_window(parent->children, &parent->children_num, w);
+    if (r->client) {
+        remove_window(server.clients, &server.clients_num, w);
+    }
+    if (server.focus == w) {
+        server.focus = None;
+    }
+    if (server.grab == w) {
+        release_grab();
+    }
+    if (server.pointer_window == w) {
+        server.pointer_window = r->parent;
+    }
+    free(r->children);
+    free(r->name);
+    free(r->class_hint);
+    bzero(r, sizeof(*r));
+    r->type = FAKE_RESOURCE_FREE;
+}
+
+static void
+destroy_window_tree(Window w, FakeResource* r)
+{
+    /* The top window is unmapped before it is destroyed. */
+    unmap_window(w, r);
+    destroy_window(w, r);
+}
+
+static Window
+get_sibling_below(FakeResource* r, Window w)
+{
+    FakeResource* parent = find_window(r->parent);
+    int i;
+    for (i = 0; (i < parent->children_num) && (parent->children[i] != w); i++) {
+    }
+    return 0 < i ? parent->children[i - 1] : None;
+}
+
+static void
+restack(FakeResource* r, Window w, Window sibling, int stack_mode)
+{
+    FakeResource* parent = find_window(r->parent);
+    remove_window(parent->children, &parent->children_num, w);
+    Window* children = parent->children;
+    int n = parent->children_num;
+    int i;
+    switch (stack_mode) {
+    case Above:
+        if (sibling == None) {
+            i = n;
+            break;
+        }
+        for (i = 0; (i < n) && (children[i] != sibling); i++) {
+        }
+        i = i < n ? i + 1 : n;
+        break;
+    case Below:
+        if (sibling == None) {
+            i = 0;
+            break;
+        }
+        for (i = 0; (i < n) && (children[i] != sibling); i++) {
+        }
+        i = i < n ? i : 0;
+        break;
+    default:
+        i = n;
+        break;
+    }
+    append_window(&parent->children, &parent->children_num, &parent->children_capacity, w);
+    children = parent->children;
+    memmove(&children[i + 1], &children[i], sizeof(Window) * (n - i));
+    children[i] = w;
+}
+
+static void
+expose_grown(FakeResource* r, Window w, int old_width, int old_height)
+{
+    if (!r->mapped || !is_viewable(r)) {
+        return;
+    }
+    if (r->bit_gravity == ForgetGravity) {
+        queue_expose(w, 0, 0, r->width, r->height, 0);
+        return;
+    }
+    int width = r->width;
+    int height = r->height;
+    int min_width = width < old_width ? width : old_width;
+    /* A real server exposes the new L-shaped area in one series. */
+    Bool bottom_grown = (0 < min_width) && (old_height < height);
+    queue_expose(w, old_width, 0, width - old_width, height, bottom_grown ? 1 : 0);
+    queue_expose(w, 0, old_height, min_width, height - old_height, 0);
+}
+
+static void
+configure_window(Window w, FakeResource* r, unsigned int mask, XWindowChanges* changes, const char* request)
+{
+    r->configures++;
+    if ((mask & (CWWidth | CWHeight)) != 0) {
+        unsigned int width = mask & CWWidth ? changes->width : r->width;
+        unsigned int height = mask & CWHeight ? changes->height : r->height;
+        if (!check_size(width, height, request)) {
+            return;
+        }
+    }
+    if ((mask & CWSibling) != 0) {
+        FakeResource* sibling = check_window(changes->sibling, request);
+        if (sibling == NULL) {
+            return;
+        }
+        if ((sibling->parent != r->parent) || ((mask & CWStackMode) == 0)) {
+            report_error(&server.stats.bad_match, "BadMatch", request, w);
+            return;
+        }
+    }
+    int old_x = r->x;
+    int old_y = r->y;
+    int old_width = r->width;
+    int old_height = r->height;
+    int old_border_width = r->border_width;
+    int border_size = 2 * old_border_width;
+    r->x = mask & CWX ? changes->x : r->x;
+    r->y = mask & CWY ? changes->y : r->y;
+    r->width = mask & CWWidth ? changes->width : r->width;
+    r->height = mask & CWHeight ? changes->height : r->height;
+    r->border_width = mask & CWBorderWidth ? changes->border_width : r->border_width;
+    if ((mask & CWStackMode) != 0) {
+        Window sibling = mask & CWSibling ? changes->sibling : None;
+        restack(r, w, sibling, changes->stack_mode);
+    }
+
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = ConfigureNotify;
+    e.xconfigure.window = w;
+    e.xconfigure.x = r->x;
+    e.xconfigure.y = r->y;
+    e.xconfigure.width = r->width;
+    e.xconfigure.height = r->height;
+    e.xconfigure.border_width = r->border_width;
+    e.xconfigure.above = get_sibling_below(r, w);
+    e.xconfigure.override_redirect = r->override_redirect;
+    send_structure_event(r, w, &e);
+
+    Bool moved = (r->x != old_x) || (r->y != old_y);
+    Bool resized = (r->width != old_width) || (r->height != old_height);
+    if (!r->mapped || !is_viewable(r)) {
+        return;
+    }
+    int width = old_width + border_size;
+    int height = old_height + border_size;
+    int new_border_size = 2 * r->border_width;
+    int right = r->x + r->width + new_border_size;
+    int bottom = r->y + r->height + new_border_size;
+    /* Nothing under w is exposed when w still covers its old area. */
+    Bool covered = (r->x <= old_x) && (r->y <= old_y) && (old_x + width <= right) && (old_y + height <= bottom);
+    if ((moved || resized || (r->border_width != old_border_width)) && !covered) {
+        expose_under(r, w, old_x, old_y, width, height);
+    }
+    if (resized) {
+        expose_grown(r, w, old_width, old_height);
+    }
+}
+
+static int
+fake_add_to_save_set(Display* display, Window w)
+{
+    count_request();
+    check_window(w, "AddToSaveSet");
+    return 1;
+}
+
+static unsigned long
+hash_color_name(const char* name)
+{
+    unsigned long h = 5381;
+    const char* p;
+    for (p = name; *p != '\0'; p++) {
+        h = 33 * h + *p;
+    }
+    return h & 0xffffff;
+}
+
+static void
+set_color(XColor* color, unsigned long pixel)
+{
+    color->pixel = pixel;
+    color->red = ((pixel >> 16) & 0xff) * 0x101;
+    color->green = ((pixel >> 8) & 0xff) * 0x101;
+    color->blue = (pixel & 0xff) * 0x101;
+    color->flags = DoRed | DoGreen | DoBlue;
+}
+
+static Status
+fake_alloc_named_color(Display* display, Colormap colormap, const char* color_name, XColor* color_def_return, XColor* exact_def_return)
+{
+    count_request();
+    unsigned long pixel = hash_color_name(color_name);
+    set_color(color_def_return, pixel);
+    set_color(exact_def_return, pixel);
+    return 1;
+}
+
+static int
+fake_allow_events(Display* display, int event_mode, Time time)
+{
+    count_request();
+    /* A replayed press goes to the client, which ignores it. */
+    if ((event_mode == ReplayPointer) && server.grab_passive) {
+        release_grab();
+    }
+    return 1;
+}
+
+static void
+change_attributes(FakeResource* r, unsigned long valuemask, XSetWindowAttributes* attributes)
+{
+    if (valuemask & CWEventMask) {
+        r->event_mask = attributes->event_mask;
+    }
+    if (valuemask & CWOverrideRedirect) {
+        r->override_redirect = attributes->override_redirect;
+    }
+    if (valuemask & CWBitGravity) {
+        r->bit_gravity = attributes->bit_gravity;
+    }
+}
+
+static int
+fake_change_window_attributes(Display* display, Window w, unsigned long valuemask, XSetWindowAttributes* attributes)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ChangeWindowAttributes");
+    if (r == NULL) {
+        return 1;
+    }
+    change_attributes(r, valuemask, attributes);
+    return 1;
+}
+
+static int
+fake_clear_area(Display* display, Window w, int x, int y, unsigned int width, unsigned int height, Bool exposures)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ClearArea");
+    if ((r == NULL) || !exposures || !is_viewable(r)) {
+        return 1;
+    }
+    /* Zero means the rest of the window. */
+    int w_width = width == 0 ? r->width - x : width;
+    int w_height = height == 0 ? r->height - y : height;
+    queue_expose(w, x, y, w_width, w_height, 0);
+    return 1;
+}
+
+static int
+fake_configure_window(Display* display, Window w, unsigned int value_mask, XWindowChanges* changes)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ConfigureWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    configure_window(w, r, value_mask, changes, "ConfigureWindow");
+    return 1;
+}
+
+static Bool
+check_drawable(Drawable d, const char* request)
+{
+    if ((find_window(d) != NULL) || (find_resource(d, FAKE_RESOURCE_PIXMAP) != NULL)) {
+        return True;
+    }
+    report_error(&server.stats.bad_window, "BadDrawable", request, d);
+    return False;
+}
+
+static int
+fake_copy_area(Display* display, Drawable src, Drawable dest, GC gc, int src_x, int src_y, unsigned int width, unsigned int height, int dest_x, int dest_y)
+{
+    count_request();
+    check_drawable(src, "CopyArea");
+    check_drawable(dest, "CopyArea");
+    return 1;
+}
+
+static Cursor
+fake_create_font_cursor(Display* display, unsigned int shape)
+{
+    count_request();
+    return create_resource(FAKE_RESOURCE_CURSOR);
+}
+
+static GC
+fake_create_gc(Display* display, Drawable d, unsigned long valuemask, XGCValues* values)
+{
+    count_request();
+    check_drawable(d, "CreateGC");
+    /* fawm never looks into a GC. */
+    return (GC)fake_alloc(sizeof(XGCValues));
+}
+
+static Pixmap
+create_pixmap(unsigned int width, unsigned int height, const char* request)
+{
+    if (!check_size(width, height, request)) {
+        return None;
+    }
+    Pixmap pixmap = create_resource(FAKE_RESOURCE_PIXMAP);
+    FakeResource* r = find_resource(pixmap, FAKE_RESOURCE_PIXMAP);
+    r->width = width;
+    r->height = height;
+    return pixmap;
+}
+
+static Pixmap
+fake_create_pixmap_from_bitmap_data(Display* display, Drawable d, char* data, unsigned int width, unsigned int height, unsigned long fg, unsigned long bg, unsigned int depth)
+{
+    count_request();
+    check_drawable(d, "CreatePixmap");
+    return create_pixmap(width, height, "CreatePixmap");
+}
+
+static Pixmap
+fake_create_pixmap(Display* display, Drawable d, unsigned int width, unsigned int height, unsigned int depth)
+{
+    count_request();
+    check_drawable(d, "CreatePixmap");
+    return create_pixmap(width, height, "CreatePixmap");
+}
+
+static Window
+create_window(Window parent, int x, int y, unsigned int width, unsigned int height, unsigned int border_width, unsigned long valuemask, XSetWindowAttributes* attributes, const char* request)
+{
+    FakeResource* p = check_window(parent, request);
+    if ((p == NULL) || !check_size(width, height, request)) {
+        return None;
+    }
+    Window w = create_resource(FAKE_RESOURCE_WINDOW);
+    /* The array may have been moved. */
+    p = find_window(parent);
+    FakeResource* r = find_window(w);
+    r->parent = parent;
+    r->x = x;
+    r->y = y;
+    r->width = width;
+    r->height = height;
+    r->border_width = border_width;
+    r->bit_gravity = ForgetGravity;
+    if (attributes != NULL) {
+        change_attributes(r, valuemask, attributes);
+    }
+    append_window(&p->children, &p->children_num, &p->children_capacity, w);
+
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = CreateNotify;
+    e.xcreatewindow.window = w;
+    e.xcreatewindow.x = x;
+    e.xcreatewindow.y = y;
+    e.xcreatewindow.width = width;
+    e.xcreatewindow.height = height;
+    e.xcreatewindow.border_width = border_width;
+    e.xcreatewindow.override_redirect = r->override_redirect;
+    queue_selected_event(&e, parent, SubstructureNotifyMask);
+
+    return w;
+}
+
+static Window
+fake_create_simple_window(Display* display, Window parent, int x, int y, unsigned int width, unsigned int height, unsigned int border_width, unsigned long border, unsigned long background)
+{
+    count_request();
+    return create_window(parent, x, y, width, height, border_width, 0, NULL, "CreateWindow");
+}
+
+static Window
+fake_create_window(Display* display, Window parent, int x, int y, unsigned int width, unsigned int height, unsigned int border_width, int depth, unsigned int class, Visual* visual, unsigned long valuemask, XSetWindowAttributes* attributes)
+{
+    count_request();
+    return create_window(parent, x, y, width, height, border_width, valuemask, attributes, "CreateWindow");
+}
+
+static int
+fake_define_cursor(Display* display, Window w, Cursor cursor)
+{
+    count_request();
+    check_window(w, "ChangeWindowAttributes");
+    return 1;
+}
+
+static int
+fake_destroy_window(Display* display, Window w)
+{
+    count_request();
+    FakeResource* r = check_window(w, "DestroyWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    destroy_window_tree(w, r);
+    return 1;
+}
+
+static int
+fake_draw_rectangles(Display* display, Drawable d, GC gc, XRectangle* rectangles, int nrectangles)
+{
+    count_request();
+    check_drawable(d, "PolyRectangle");
+    return 1;
+}
+
+static int
+fake_draw_segments(Display* display, Drawable d, GC gc, XSegment* segments, int nsegments)
+{
+    count_request();
+    check_drawable(d, "PolySegment");
+    return 1;
+}
+
+static int
+fake_fill_rectangle(Display* display, Drawable d, GC gc, int x, int y, unsigned int width, unsigned int height)
+{
+    count_request();
+    check_drawable(d, "PolyFillRectangle");
+    return 1;
+}
+
+static int
+fake_fill_rectangles(Display* display, Drawable d, GC gc, XRectangle* rectangles, int nrectangles)
+{
+    count_request();
+    check_drawable(d, "PolyFillRectangle");
+    return 1;
+}
+
+static int
+fake_free_cursor(Display* display, Cursor cursor)
+{
+    count_request();
+    FakeResource* r = find_resource(cursor, FAKE_RESOURCE_CURSOR);
+    if (r == NULL) {
+        report_error(&server.stats.bad_window, "BadCursor", "FreeCursor", cursor);
+        return 1;
+    }
+    r->type = FAKE_RESOURCE_FREE;
+    return 1;
+}
+
+static int
+fake_free_gc(Display* display, GC gc)
+{
+    count_request();
+    free(gc);
+    return 1;
+}
+
+static int
+fake_free_pixmap(Display* display, Pixmap pixmap)
+{
+    count_request();
+    FakeResource* r = find_resource(pixmap, FAKE_RESOURCE_PIXMAP);
+    if (r == NULL) {
+        report_error(&server.stats.bad_window, "BadPixmap", "FreePixmap", pixmap);
+        return 1;
+    }
+    r->type = FAKE_RESOURCE_FREE;
+    return 1;
+}
+
+static Status
+fake_get_geometry(Display* display, Drawable d, Window* root_return, int* x_return, int* y_return, unsigned int* width_return, unsigned int* height_return, unsigned int* border_width_return, unsigned int* depth_return)
+{
+    count_request();
+    FakeResource* r = find_window(d);
+    r = r != NULL ? r : find_resource(d, FAKE_RESOURCE_PIXMAP);
+    if (r == NULL) {
+        report_error(&server.stats.bad_window, "BadDrawable", "GetGeometry", d);
+        return 0;
+    }
+    *root_return = get_root();
+    *x_return = r->x;
+    *y_return = r->y;
+    *width_return = r->width;
+    *height_return = r->height;
+    *border_width_return = r->border_width;
+    *depth_return = FAKE_DEPTH;
+    return 1;
+}
+
+static Status
+fake_get_text_property(Display* display, Window w, XTextProperty* text_prop_return, Atom property)
+{
+    count_request();
+    FakeResource* r = check_window(w, "GetProperty");
+    if (r == NULL) {
+        return 0;
+    }
+    /* The caller frees value with XFree(), which is free(3). */
+    if ((property == XA_WM_CLASS) && (r->class_hint != NULL)) {
+        int size = r->class_hint_size;
+        text_prop_return->value = (unsigned char*)fake_alloc(size);
+        memcpy(text_prop_return->value, r->class_hint, size);
+        text_prop_return->nitems = size;
+    }
+    else if ((property == XA_WM_NAME) && (r->name != NULL)) {
+        text_prop_return->value = (unsigned char*)fake_strdup(r->name);
+        text_prop_return->nitems = strlen(r->name);
+    }
+    else {
+        return 0;
+    }
+    text_prop_return->encoding = XA_STRING;
+    text_prop_return->format = 8;
+    return 1;
+}
+
+static int
+get_map_state(FakeResource* r)
+{
+    if (!r->mapped) {
+        return IsUnmapped;
+    }
+    return is_viewable(r) ? IsViewable : IsUnviewable;
+}
+
+static Status
+fake_get_window_attributes(Display* display, Window w, XWindowAttributes* window_attributes_return)
+{
+    count_request();
+    FakeResource* r = check_window(w, "GetWindowAttributes");
+    if (r == NULL) {
+        return 0;
+    }
+    XWindowAttributes* wa = window_attributes_return;
+    bzero(wa, sizeof(*wa));
+    wa->x = r->x;
+    wa->y = r->y;
+    wa->width = r->width;
+    wa->height = r->height;
+    wa->border_width = r->border_width;
+    wa->depth = FAKE_DEPTH;
+    wa->visual = &server.visual;
+    wa->root = get_root();
+    wa->class = InputOutput;
+    wa->bit_gravity = r->bit_gravity;
+    wa->win_gravity = NorthWestGravity;
+    wa->colormap = server.screen.cmap;
+    wa->map_installed = True;
+    wa->map_state = get_map_state(r);
+    wa->all_event_masks = r->event_mask;
+    wa->your_event_mask = r->event_mask;
+    wa->override_redirect = r->override_redirect;
+    wa->screen = &server.screen;
+    return 1;
+}
+
+static Status
+fake_get_wm_normal_hints(Display* display, Window w, XSizeHints* hints, long* supplied_return)
+{
+    count_request();
+    FakeResource* r = check_window(w, "GetProperty");
+    if ((r == NULL) || (r->hints_supplied == 0)) {
+        return 0;
+    }
+    *hints = r->hints;
+    *supplied_return = r->hints_supplied;
+    return 1;
+}
+
+static Atom
+intern_atom(const char* name, Bool only_if_exists)
+{
+    int i;
+    for (i = 0; i < server.atoms_num; i++) {
+        if (strcmp(server.atoms[i], name) == 0) {
+            return FAKE_ATOM_BASE + i;
+        }
+    }
+    if (only_if_exists) {
+        return None;
+    }
+    if (server.atoms_num == server.atoms_capacity) {
+        int capacity = server.atoms_capacity == 0 ? 16 : 2 * server.atoms_capacity;
+        server.atoms = (char**)fake_realloc(server.atoms, sizeof(char*) * capacity);
+        server.atoms_capacity = capacity;
+    }
+    server.atoms[server.atoms_num] = fake_strdup(name);
+    server.atoms_num++;
+    return FAKE_ATOM_BASE + server.atoms_num - 1;
+}
+
+static Status
+fake_get_wm_protocols(Display* display, Window w, Atom** protocols_return, int* count_return)
+{
+    count_request();
+    FakeResource* r = check_window(w, "GetProperty");
+    if ((r == NULL) || !r->delete_window) {
+        return 0;
+    }
+    Atom* protocols = (Atom*)fake_alloc(sizeof(Atom));
+    protocols[0] = intern_atom("WM_DELETE_WINDOW", False);
+    *protocols_return = protocols;
+    *count_return = 1;
+    return 1;
+}
+
+static unsigned int
+get_button_bits(unsigned int button)
+{
+    return button == AnyButton ? ~0U : 1U << button;
+}
+
+static int
+fake_grab_button(Display* display, unsigned int button, unsigned int modifiers, Window grab_window, Bool owner_events, unsigned int event_mask, int pointer_mode, int keyboard_mode, Window confine_to, Cursor cursor)
+{
+    count_request();
+    FakeResource* r = check_window(grab_window, "GrabButton");
+    if (r == NULL) {
+        return 1;
+    }
+    r->grabbed_buttons |= get_button_bits(button);
+    return 1;
+}
+
+static Atom
+fake_intern_atom(Display* display, const char* name, Bool only_if_exists)
+{
+    count_request();
+    return intern_atom(name, only_if_exists);
+}
+
+static int
+fake_kill_client(Display* display, XID resource)
+{
+    count_request();
+    FakeResource* r = find_window(resource);
+    if ((r == NULL) || !r->client) {
+        report_error(&server.stats.bad_value, "BadValue", "KillClient", resource);
+        return 1;
+    }
+    if (server.replaying) {
+        return 1;
+    }
+    destroy_window_tree(resource, r);
+    return 1;
+}
+
+static int
+fake_map_raised(Display* display, Window w)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ConfigureWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    restack(r, w, None, Above);
+    map_window(w, r);
+    return 1;
+}
+
+static int
+fake_map_subwindows(Display* display, Window w)
+{
+    count_request();
+    FakeResource* r = check_window(w, "MapSubwindows");
+    if (r == NULL) {
+        return 1;
+    }
+    int i;
+    for (i = 0; i < r->children_num; i++) {
+        Window child = r->children[i];
+        map_window(child, find_window(child));
+    }
+    return 1;
+}
+
+static int
+fake_map_window(Display* display, Window w)
+{
+    count_request();
+    FakeResource* r = check_window(w, "MapWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    map_window(w, r);
+    return 1;
+}
+
+static int
+fake_move_resize_window(Display* display, Window w, int x, int y, unsigned int width, unsigned int height)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ConfigureWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    XWindowChanges changes;
+    changes.x = x;
+    changes.y = y;
+    changes.width = width;
+    changes.height = height;
+    configure_window(w, r, CWX | CWY | CWWidth | CWHeight, &changes, "ConfigureWindow");
+    return 1;
+}
+
+static int
+fake_move_window(Display* display, Window w, int x, int y)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ConfigureWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    XWindowChanges changes;
+    changes.x = x;
+    changes.y = y;
+    configure_window(w, r, CWX | CWY, &changes, "ConfigureWindow");
+    return 1;
+}
+
+static Status
+fake_query_tree(Display* display, Window w, Window* root_return, Window* parent_return, Window** children_return, unsigned int* nchildren_return)
+{
+    count_request();
+    FakeResource* r = check_window(w, "QueryTree");
+    if (r == NULL) {
+        return 0;
+    }
+    int n = r->children_num;
+    Window* children = (Window*)fake_alloc(sizeof(Window) * (n + 1));
+    memcpy(children, r->children, sizeof(Window) * n);
+    *root_return = get_root();
+    *parent_return = r->parent;
+    *children_return = children;
+    *nchildren_return = n;
+    return 1;
+}
+
+static int
+fake_raise_window(Display* display, Window w)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ConfigureWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    XWindowChanges changes;
+    changes.stack_mode = Above;
+    configure_window(w, r, CWStackMode, &changes, "ConfigureWindow");
+    return 1;
+}
+
+static int
+fake_reparent_window(Display* display, Window w, Window parent, int x, int y)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ReparentWindow");
+    FakeResource* p = check_window(parent, "ReparentWindow");
+    if ((r == NULL) || (p == NULL)) {
+        return 1;
+    }
+    if ((w == parent) || is_ancestor(w, parent)) {
+        report_error(&server.stats.bad_match, "BadMatch", "ReparentWindow", w);
+        return 1;
+    }
+    Bool mapped = r->mapped;
+    unmap_window(w, r);
+    Window old_parent = r->parent;
+    FakeResource* old = find_window(old_parent);
+    remove_window(old->children, &old->children_num, w);
+    append_window(&p->children, &p->children_num, &p->children_capacity, w);
+    r->parent = parent;
+    r->x = x;
+    r->y = y;
+
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = ReparentNotify;
+    e.xreparent.window = w;
+    e.xreparent.parent = parent;
+    e.xreparent.x = x;
+    e.xreparent.y = y;
+    e.xreparent.override_redirect = r->override_redirect;
+    queue_selected_event(&e, w, StructureNotifyMask);
+    queue_selected_event(&e, old_parent, SubstructureNotifyMask);
+    queue_selected_event(&e, parent, SubstructureNotifyMask);
+
+    if (mapped) {
+        map_window(w, r);
+    }
+    return 1;
+}
+
+static int
+fake_resize_window(Display* display, Window w, unsigned int width, unsigned int height)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ConfigureWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    XWindowChanges changes;
+    changes.width = width;
+    changes.height = height;
+    configure_window(w, r, CWWidth | CWHeight, &changes, "ConfigureWindow");
+    return 1;
+}
+
+static int
+fake_restack_windows(Display* display, Window* windows, int nwindows)
+{
+    /* Each window is put just below the previous one. */
+    int i;
+    for (i = 1; i < nwindows; i++) {
+        count_request();
+        Window w = windows[i];
+        FakeResource* r = check_window(w, "ConfigureWindow");
+        if (r == NULL) {
+            continue;
+        }
+        XWindowChanges changes;
+        changes.sibling = windows[i - 1];
+        changes.stack_mode = Below;
+        configure_window(w, r, CWSibling | CWStackMode, &changes, "ConfigureWindow");
+    }
+    return 1;
+}
+
+static int
+fake_select_input(Display* display, Window w, long event_mask)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ChangeWindowAttributes");
+    if (r == NULL) {
+        return 1;
+    }
+    r->event_mask = event_mask;
+    return 1;
+}
+
+static void
+destroy_client(Window w)
+{
+    FakeResource* r = find_window(w);
+    if ((r == NULL) || !r->client) {
+        return;
+    }
+    destroy_window_tree(w, r);
+}
+
+static Status
+fake_send_event(Display* display, Window w, Bool propagate, long event_mask, XEvent* event_send)
+{
+    count_request();
+    FakeResource* r = check_window(w, "SendEvent");
+    if ((r != NULL) && (event_send->type == ConfigureNotify)) {
+        r->configure_notifies++;
+    }
+    if ((r == NULL) || (event_send->type != ClientMessage)) {
+        return 1;
+    }
+    /* A client closes its window as soon as it is asked. */
+    Atom atom = event_send->xclient.data.l[0];
+    if (server.replaying) {
+        return 1;
+    }
+    if (r->delete_window && (atom == intern_atom("WM_DELETE_WINDOW", False))) {
+        destroy_client(w);
+    }
+    return 1;
+}
+
+static void
+queue_focus_event(int type, Window w, int detail)
+{
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = type;
+    e.xfocus.mode = NotifyNormal;
+    e.xfocus.detail = detail;
+    queue_selected_event(&e, w, FocusChangeMask);
+}
+
+static void
+queue_focus_out(Window w, Window focus)
+{
+    queue_focus_event(FocusOut, w, NotifyNonlinear);
+    FakeResource* r = find_window(w);
+    while ((r != NULL) && (r->parent != None) && (r->parent != get_root())) {
+        Window parent = r->parent;
+        if (is_ancestor(parent, focus)) {
+            break;
+        }
+        queue_focus_event(FocusOut, parent, NotifyNonlinearVirtual);
+        r = find_window(parent);
+    }
+}
+
+static void
+queue_focus_in(Window w, Window old)
+{
+    FakeResource* r = find_window(w);
+    if ((r != NULL) && (r->parent != None) && (r->parent != get_root())) {
+        if (!is_ancestor(r->parent, old)) {
+            queue_focus_in(r->parent, old);
+        }
+    }
+    Bool virtual = w != server.focus;
+    queue_focus_event(FocusIn, w, virtual ? NotifyNonlinearVirtual : NotifyNonlinear);
+}
+
+/* Nothing remains after fawm closes, because the fake server ends with it. */
+static int
+fake_set_close_down_mode(Display* display, int close_mode)
+{
+    count_request();
+    return 1;
+}
+
+static int
+fake_set_input_focus(Display* display, Window focus, int revert_to, Time time)
+{
+    count_request();
+    if ((focus != None) && (focus != PointerRoot)) {
+        FakeResource* r = check_window(focus, "SetInputFocus");
+        if (r == NULL) {
+            return 1;
+        }
+        if (!is_viewable(r)) {
+            report_error(&server.stats.bad_match, "BadMatch", "SetInputFocus", focus);
+            return 1;
+        }
+    }
+    Window old = server.focus;
+    if (old == focus) {
+        return 1;
+    }
+    server.focus = focus;
+    if (find_window(old) != NULL) {
+        queue_focus_out(old, focus);
+    }
+    if (find_window(focus) != NULL) {
+        queue_focus_in(focus, old);
+    }
+    return 1;
+}
+
+static int
+fake_set_window_background(Display* display, Window w, unsigned long background_pixel)
+{
+    count_request();
+    check_window(w, "ChangeWindowAttributes");
+    return 1;
+}
+
+static int
+fake_set_window_background_pixmap(Display* display, Window w, Pixmap background_pixmap)
+{
+    count_request();
+    check_window(w, "ChangeWindowAttributes");
+    return 1;
+}
+
+static int
+fake_set_window_border_width(Display* display, Window w, unsigned int width)
+{
+    count_request();
+    FakeResource* r = check_window(w, "ConfigureWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    XWindowChanges changes;
+    changes.border_width = width;
+    configure_window(w, r, CWBorderWidth, &changes, "ConfigureWindow");
+    return 1;
+}
+
+static int
+fake_undefine_cursor(Display* display, Window w)
+{
+    count_request();
+    check_window(w, "ChangeWindowAttributes");
+    return 1;
+}
+
+static int
+fake_ungrab_button(Display* display, unsigned int button, unsigned int modifiers, Window grab_window)
+{
+    count_request();
+    FakeResource* r = check_window(grab_window, "UngrabButton");
+    if (r == NULL) {
+        return 1;
+    }
+    r->grabbed_buttons &= ~get_button_bits(button);
+    return 1;
+}
+
+static int
+fake_unmap_window(Display* display, Window w)
+{
+    count_request();
+    FakeResource* r = check_window(w, "UnmapWindow");
+    if (r == NULL) {
+        return 1;
+    }
+    unmap_window(w, r);
+    return 1;
+}
+
+/*
+ * Glyphs of the fake font are indexed by their code points. A character out
+ * of ASCII is twice as wide as an ASCII one.
+ */
+#define FAKE_FONT_ASCENT 16
+#define FAKE_FONT_DESCENT 4
+#define FAKE_GLYPH_WIDTH 10
+
+static int
+get_glyph_advance(FT_UInt glyph)
+{
+    return glyph < 0x80 ? FAKE_GLYPH_WIDTH : 2 * FAKE_GLYPH_WIDTH;
+}
+
+static void
+set_extents(XGlyphInfo* extents, int width)
+{
+    extents->width = width;
+    extents->height = FAKE_FONT_ASCENT + FAKE_FONT_DESCENT;
+    extents->x = 0;
+    extents->y = FAKE_FONT_ASCENT;
+    extents->xOff = width;
+    extents->yOff = 0;
+}
+
+static FcBool
+fake_xft_char_exists(Display* display, XftFont* font, FcChar32 ucs4)
+{
+    return FcTrue;
+}
+
+static FT_UInt
+fake_xft_char_index(Display* display, XftFont* font, FcChar32 ucs4)
+{
+    return ucs4;
+}
+
+static Bool
+fake_xft_color_alloc_name(Display* display, const Visual* visual, Colormap cmap, const char* name, XftColor* result)
+{
+    count_request();
+    unsigned long pixel = hash_color_name(name);
+    result->pixel = pixel;
+    result->color.red = ((pixel >> 16) & 0xff) * 0x101;
+    result->color.green = ((pixel >> 8) & 0xff) * 0x101;
+    result->color.blue = (pixel & 0xff) * 0x101;
+    result->color.alpha = 0xffff;
+    return True;
+}
+
+static void
+fake_xft_draw_change(XftDraw* draw, Drawable d)
+{
+    ((FakeDraw*)draw)->drawable = d;
+}
+
+static XftDraw*
+fake_xft_draw_create(Display* display, Drawable d, Visual* visual, Colormap colormap)
+{
+    FakeDraw* draw = (FakeDraw*)fake_alloc(sizeof(FakeDraw));
+    draw->drawable = d;
+    return (XftDraw*)draw;
+}
+
+static void
+fake_xft_draw_destroy(XftDraw* draw)
+{
+    free(draw);
+}
+
+static Drawable
+fake_xft_draw_drawable(XftDraw* draw)
+{
+    return ((FakeDraw*)draw)->drawable;
+}
+
+static void
+fake_xft_draw_glyph_font_spec(XftDraw* draw, const XftColor* color, const XftGlyphFontSpec* glyphs, int len)
+{
+    count_request();
+    check_drawable(((FakeDraw*)draw)->drawable, "RenderCompositeGlyphs");
+}
+
+static Bool
+fake_xft_draw_set_clip(XftDraw* draw, Region r)
+{
+    return True;
+}
+
+static Bool
+fake_xft_draw_set_clip_rectangles(XftDraw* draw, int xorigin, int yorigin, const XRectangle* rects, int n)
+{
+    return True;
+}
+
+static void
+fake_xft_draw_string_utf8(XftDraw* draw, const XftColor* color, XftFont* pub, int x, int y, const FcChar8* string, int len)
+{
+    count_request();
+    check_drawable(((FakeDraw*)draw)->drawable, "RenderCompositeGlyphs");
+}
+
+static void
+fake_xft_font_close(Display* display, XftFont* font)
+{
+    free(font);
+}
+
+static XftFont*
+fake_xft_font_open_name(Display* display, int screen, const char* name)
+{
+    XftFont* font = (XftFont*)fake_alloc(sizeof(XftFont));
+    font->ascent = FAKE_FONT_ASCENT;
+    font->descent = FAKE_FONT_DESCENT;
+    font->height = FAKE_FONT_ASCENT + FAKE_FONT_DESCENT;
+    font->max_advance_width = 2 * FAKE_GLYPH_WIDTH;
+    return font;
+}
+
+static void
+fake_xft_glyph_extents(Display* display, XftFont* font, const FT_UInt* glyphs, int nglyphs, XGlyphInfo* extents)
+{
+    int width = 0;
+    int i;
+    for (i = 0; i < nglyphs; i++) {
+        width += get_glyph_advance(glyphs[i]);
+    }
+    set_extents(extents, width);
+}
+
+static void
+fake_xft_text_extents_utf8(Display* display, XftFont* font, const FcChar8* string, int len, XGlyphInfo* extents)
+{
+    /* Only leading bytes are counted. */
+    int width = 0;
+    int i;
+    for (i = 0; i < len; i++) {
+        FcChar8 c = string[i];
+        if ((c & 0xc0) != 0x80) {
+            width += get_glyph_advance(c);
+        }
+    }
+    set_extents(extents, width);
+}
+
+#if defined(FAWM_HAVE_XRANDR)
+static void
+fake_rr_free_crtc_info(XRRCrtcInfo* info)
+{
+}
+
+static void
+fake_rr_free_screen_resources(XRRScreenResources* resources)
+{
+}
+
+static XRRCrtcInfo*
+fake_rr_get_crtc_info(Display* display, XRRScreenResources* resources, RRCrtc crtc)
+{
+    return NULL;
+}
+
+static XRRScreenResources*
+fake_rr_get_screen_resources_current(Display* display, Window w)
+{
+    return NULL;
+}
+
+/* The fake server has one output without RandR. */
+static Bool
+fake_rr_query_extension(Display* display, int* event_base, int* error_base)
+{
+    return False;
+}
+
+static void
+fake_rr_select_input(Display* display, Window w, int mask)
+{
+}
+
+static int
+fake_rr_update_configuration(XEvent* e)
+{
+    return 0;
+}
+#endif
+
+static Display*
+fake_open_display(const char* display_name)
+{
+    if (server.display != NULL) {
+        return NULL;
+    }
+    bzero(&server, sizeof(server));
+    _XPrivDisplay display = (_XPrivDisplay)fake_alloc(sizeof(*display));
+    server.display = display;
+    display->fd = -1;
+    display->default_screen = 0;
+    display->nscreens = 1;
+    display->screens = &server.screen;
+
+    Visual* visual = &server.visual;
+    visual->visualid = 0x21;
+    visual->class = TrueColor;
+    visual->red_mask = 0xff0000;
+    visual->green_mask = 0x00ff00;
+    visual->blue_mask = 0x0000ff;
+    visual->bits_per_rgb = 8;
+    visual->map_entries = 256;
+
+    Screen* screen = &server.screen;
+    screen->display = (Display*)display;
+    screen->width = FAKE_SCREEN_WIDTH;
+    screen->height = FAKE_SCREEN_HEIGHT;
+    screen->root_depth = FAKE_DEPTH;
+    screen->root_visual = visual;
+    screen->cmap = 0x20;
+    screen->white_pixel = 0xffffff;
+    screen->black_pixel = 0;
+
+    Window root = create_resource(FAKE_RESOURCE_WINDOW);
+    FakeResource* r = find_window(root);
+    r->mapped = True;
+    r->width = FAKE_SCREEN_WIDTH;
+    r->height = FAKE_SCREEN_HEIGHT;
+    r->bit_gravity = ForgetGravity;
+    screen->root = root;
+    server.pointer_window = root;
+
+    return (Display*)display;
+}
+
+static int
+fake_close_display(Display* display)
+{
+    int i;
+    for (i = 0; i < server.resources_num; i++) {
+        FakeResource* r = &server.resources[i];
+        free(r->children);
+        free(r->name);
+        free(r->class_hint);
+    }
+    free(server.resources);
+    for (i = 0; i < server.atoms_num; i++) {
+        free(server.atoms[i]);
+    }
+    free(server.atoms);
+    free(server.events);
+    free(server.clients);
+    free(server.display);
+    bzero(&server, sizeof(server));
+    return 0;
+}
+
+static int
+fake_pending(Display* display)
+{
+    return server.events_num;
+}
+
+static void
+shift_event(XEvent* event_return)
+{
+    *event_return = server.events[server.events_head];
+    server.events_head = (server.events_head + 1) % server.events_capacity;
+    server.events_num--;
+}
+
+static int
+fake_next_event(Display* display, XEvent* event_return)
+{
+    /* The real one blocks, but nobody would wake it up here. */
+    assert(0 < server.events_num);
+    shift_event(event_return);
+    return 0;
+}
+
+static Bool
+fake_check_if_event(Display* display, XEvent* event_return, Bool (*predicate)(Display*, XEvent*, XPointer), XPointer arg)
+{
+    int capacity = server.events_capacity;
+    int i;
+    for (i = 0; i < server.events_num; i++) {
+        XEvent* e = &server.events[(server.events_head + i) % capacity];
+        if (predicate(display, e, arg)) {
+            break;
+        }
+    }
+    if (i == server.events_num) {
+        return False;
+    }
+    *event_return = server.events[(server.events_head + i) % capacity];
+    for (; 0 < i; i--) {
+        int to = (server.events_head + i) % capacity;
+        int from = (server.events_head + i - 1) % capacity;
+        server.events[to] = server.events[from];
+    }
+    server.events_head = (server.events_head + 1) % capacity;
+    server.events_num--;
+    return True;
+}
+
+static int
+fake_flush(Display* display)
+{
+    return 1;
+}
+
+static int
+fake_sync(Display* display, Bool discard)
+{
+    return 1;
+}
+
+Backend fake_backend = {
+    .name = "fake",
+
+    .open_display = fake_open_display,
+    .close_display = fake_close_display,
+    .pending = fake_pending,
+    .next_event = fake_next_event,
+    .check_if_event = fake_check_if_event,
+    .flush = fake_flush,
+    .sync = fake_sync,
+
+    .add_to_save_set = fake_add_to_save_set,
+    .alloc_named_color = fake_alloc_named_color,
+    .allow_events = fake_allow_events,
+    .change_window_attributes = fake_change_window_attributes,
+    .clear_area = fake_clear_area,
+    .configure_window = fake_configure_window,
+    .copy_area = fake_copy_area,
+    .create_font_cursor = fake_create_font_cursor,
+    .create_gc = fake_create_gc,
+    .create_pixmap_from_bitmap_data = fake_create_pixmap_from_bitmap_data,
+    .create_pixmap = fake_create_pixmap,
+    .create_simple_window = fake_create_simple_window,
+    .create_window = fake_create_window,
+    .define_cursor = fake_define_cursor,
+    .destroy_window = fake_destroy_window,
+    .draw_rectangles = fake_draw_rectangles,
+    .draw_segments = fake_draw_segments,
+    .fill_rectangle = fake_fill_rectangle,
+    .fill_rectangles = fake_fill_rectangles,
+    .free_cursor = fake_free_cursor,
+    .free_gc = fake_free_gc,
+    .free_pixmap = fake_free_pixmap,
+    .get_geometry = fake_get_geometry,
+    .get_text_property = fake_get_text_property,
+    .get_window_attributes = fake_get_window_attributes,
+    .get_wm_normal_hints = fake_get_wm_normal_hints,
+    .get_wm_protocols = fake_get_wm_protocols,
+    .grab_button = fake_grab_button,
+    .intern_atom = fake_intern_atom,
+    .kill_client = fake_kill_client,
+    .map_raised = fake_map_raised,
+    .map_subwindows = fake_map_subwindows,
+    .map_window = fake_map_window,
+    .move_resize_window = fake_move_resize_window,
+    .move_window = fake_move_window,
+    .query_tree = fake_query_tree,
+    .raise_window = fake_raise_window,
+    .reparent_window = fake_reparent_window,
+    .resize_window = fake_resize_window,
+    .restack_windows = fake_restack_windows,
+    .select_input = fake_select_input,
+    .send_event = fake_send_event,
+    .set_close_down_mode = fake_set_close_down_mode,
+    .set_input_focus = fake_set_input_focus,
+    .set_window_background = fake_set_window_background,
+    .set_window_background_pixmap = fake_set_window_background_pixmap,
+    .set_window_border_width = fake_set_window_border_width,
+    .undefine_cursor = fake_undefine_cursor,
+    .ungrab_button = fake_ungrab_button,
+    .unmap_window = fake_unmap_window,
+
+    .xft_char_exists = fake_xft_char_exists,
+    .xft_char_index = fake_xft_char_index,
+    .xft_color_alloc_name = fake_xft_color_alloc_name,
+    .xft_draw_change = fake_xft_draw_change,
+    .xft_draw_create = fake_xft_draw_create,
+    .xft_draw_destroy = fake_xft_draw_destroy,
+    .xft_draw_drawable = fake_xft_draw_drawable,
+    .xft_draw_glyph_font_spec = fake_xft_draw_glyph_font_spec,
+    .xft_draw_set_clip = fake_xft_draw_set_clip,
+    .xft_draw_set_clip_rectangles = fake_xft_draw_set_clip_rectangles,
+    .xft_draw_string_utf8 = fake_xft_draw_string_utf8,
+    .xft_font_close = fake_xft_font_close,
+    .xft_font_open_name = fake_xft_font_open_name,
+    .xft_glyph_extents = fake_xft_glyph_extents,
+    .xft_text_extents_utf8 = fake_xft_text_extents_utf8,
+
+#if defined(FAWM_HAVE_XRANDR)
+    .rr_free_crtc_info = fake_rr_free_crtc_info,
+    .rr_free_screen_resources = fake_rr_free_screen_resources,
+    .rr_get_crtc_info = fake_rr_get_crtc_info,
+    .rr_get_screen_resources_current = fake_rr_get_screen_resources_current,
+    .rr_query_extension = fake_rr_query_extension,
+    .rr_select_input = fake_rr_select_input,
+    .rr_update_configuration = fake_rr_update_configuration,
+#endif
+};
+
+/*
+ * Requests of clients. A request to a window under the window manager is
+ * redirected to it.
+ */
+static Bool
+is_redirected(FakeResource* r)
+{
+    return !r->override_redirect && selects(r->parent, SubstructureRedirectMask);
+}
+
+Window
+fake_create_client(Display* display, int x, int y, int width, int height, const char* title)
+{
+    Window w = create_window(get_root(), x, y, width, height, 0, 0, NULL, "CreateWindow");
+    if (w == None) {
+        return None;
+    }
+    FakeResource* r = find_window(w);
+    r->client = True;
+    r->name = fake_strdup(title);
+    append_window(&server.clients, &server.clients_num, &server.clients_capacity, w);
+    return w;
+}
+
+void
+fake_set_protocols(Display* display, Window w, Bool delete_window)
+{
+    FakeResource* r = find_window(w);
+    if (r == NULL) {
+        return;
+    }
+    r->delete_window = delete_window;
+}
+
+void
+fake_set_normal_hints(Display* display, Window w, XSizeHints* hints)
+{
+    FakeResource* r = find_window(w);
+    if (r == NULL) {
+        return;
+    }
+    r->hints = *hints;
+    r->hints_supplied = hints->flags;
+}
+
+void
+fake_set_class_hint(Display* display, Window w, const char* res_name, const char* res_class)
+{
+    FakeResource* r = find_window(w);
+    if (r == NULL) {
+        return;
+    }
+    int name_size = strlen(res_name) + 1;
+    int class_size = strlen(res_class) + 1;
+    free(r->class_hint);
+    r->class_hint = (char*)fake_alloc(name_size + class_size);
+    memcpy(r->class_hint, res_name, name_size);
+    memcpy(r->class_hint + name_size, res_class, class_size);
+    r->class_hint_size = name_size + class_size;
+}
+
+void
+fake_set_title(Display* display, Window w, const char* title)
+{
+    FakeResource* r = find_window(w);
+    if (r == NULL) {
+        return;
+    }
+    free(r->name);
+    r->name = fake_strdup(title);
+
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = PropertyNotify;
+    e.xproperty.atom = XA_WM_NAME;
+    e.xproperty.time = server.time;
+    e.xproperty.state = PropertyNewValue;
+    queue_selected_event(&e, w, PropertyChangeMask);
+}
+
+void
+fake_map_client(Display* display, Window w)
+{
+    FakeResource* r = find_window(w);
+    if ((r == NULL) || r->mapped) {
+        return;
+    }
+    if (!is_redirected(r)) {
+        map_window(w, r);
+        return;
+    }
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = MapRequest;
+    e.xmaprequest.window = w;
+    queue_event(&e, r->parent);
+}
+
+void
+fake_unmap_client(Display* display, Window w)
+{
+    FakeResource* r = find_window(w);
+    if (r == NULL) {
+        return;
+    }
+    unmap_window(w, r);
+}
+
+void
+fake_configure_client(Display* display, Window w, unsigned int value_mask, XWindowChanges* changes)
+{
+    FakeResource* r = find_window(w);
+    if (r == NULL) {
+        return;
+    }
+    if (!is_redirected(r)) {
+        configure_window(w, r, value_mask, changes, "ConfigureWindow");
+        return;
+    }
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = ConfigureRequest;
+    e.xconfigurerequest.window = w;
+    e.xconfigurerequest.x = changes->x;
+    e.xconfigurerequest.y = changes->y;
+    e.xconfigurerequest.width = changes->width;
+    e.xconfigurerequest.height = changes->height;
+    e.xconfigurerequest.border_width = changes->border_width;
+    e.xconfigurerequest.above = value_mask & CWSibling ? changes->sibling : None;
+    e.xconfigurerequest.detail = value_mask & CWStackMode ? changes->stack_mode : Above;
+    e.xconfigurerequest.value_mask = value_mask;
+    queue_event(&e, r->parent);
+}
+
+void
+fake_destroy_client(Display* display, Window w)
+{
+    destroy_client(w);
+}
+
+/* Finds the deepest viewable window which has the point. */
+static Window
+find_window_at(int x, int y)
+{
+    Window w = get_root();
+    FakeResource* r = find_window(w);
+    int origin_x = 0;
+    int origin_y = 0;
+    Bool found = True;
+    while (found) {
+        found = False;
+        int i;
+        for (i = r->children_num - 1; 0 <= i; i--) {
+            Window child = r->children[i];
+            FakeResource* c = find_window(child);
+            if (!c->mapped) {
+                continue;
+            }
+            int left = origin_x + c->x;
+            int top = origin_y + c->y;
+            int border_size = 2 * c->border_width;
+            int right = left + c->width + border_size;
+            int bottom = top + c->height + border_size;
+            if ((x < left) || (right <= x) || (y < top) || (bottom <= y)) {
+                continue;
+            }
+            origin_x = left + c->border_width;
+            origin_y = top + c->border_width;
+            w = child;
+            r = c;
+            found = True;
+            break;
+        }
+    }
+    return w;
+}
+
+/* Returns the child of w which has the descendant, or None. */
+static Window
+find_subwindow(Window w, Window descendant)
+{
+    Window subwindow = descendant;
+    FakeResource* r = find_window(subwindow);
+    while ((r != NULL) && (r->parent != w)) {
+        if (r->parent == None) {
+            return None;
+        }
+        subwindow = r->parent;
+        r = find_window(subwindow);
+    }
+    return r != NULL ? subwindow : None;
+}
+
+static void
+fill_pointer_event(XEvent* e, Window w, Window target)
+{
+    int origin_x;
+    int origin_y;
+    get_origin(w, &origin_x, &origin_y);
+    /* XButtonEvent, XMotionEvent and XCrossingEvent share these members. */
+    e->xbutton.root = get_root();
+    e->xbutton.subwindow = find_subwindow(w, target);
+    e->xbutton.time = server.time;
+    e->xbutton.x = server.pointer_x - origin_x;
+    e->xbutton.y = server.pointer_y - origin_y;
+    e->xbutton.x_root = server.pointer_x;
+    e->xbutton.y_root = server.pointer_y;
+    e->xbutton.state = server.buttons;
+    e->xbutton.same_screen = True;
+}
+
+static void
+queue_leave(Window w, int detail)
+{
+    if (!selects(w, LeaveWindowMask)) {
+        return;
+    }
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = LeaveNotify;
+    fill_pointer_event(&e, w, server.pointer_window);
+    e.xcrossing.mode = NotifyNormal;
+    e.xcrossing.detail = detail;
+    queue_event(&e, w);
+}
+
+/* Only LeaveNotify is made. fawm does not select EnterNotify. */
+static void
+cross(Window old, Window new)
+{
+    if (is_ancestor(old, new)) {
+        queue_leave(old, NotifyInferior);
+        return;
+    }
+    queue_leave(old, is_ancestor(new, old) ? NotifyAncestor : NotifyNonlinear);
+    FakeResource* r = find_window(old);
+    while ((r != NULL) && (r->parent != None)) {
+        Window parent = r->parent;
+        if ((parent == new) || is_ancestor(parent, new)) {
+            break;
+        }
+        queue_leave(parent, NotifyNonlinearVirtual);
+        r = find_window(parent);
+    }
+}
+
+static long
+get_motion_mask()
+{
+    long mask = PointerMotionMask;
+    if (server.buttons != 0) {
+        mask |= ButtonMotionMask;
+    }
+    if (server.buttons & Button1Mask) {
+        mask |= Button1MotionMask;
+    }
+    return mask;
+}
+
+/* Finds the window which takes an event from target up to the root. */
+static Window
+propagate(Window target, long mask)
+{
+    Window w = target;
+    while ((w != None) && !selects(w, mask)) {
+        w = find_window(w)->parent;
+    }
+    return w;
+}
+
+/*
+ * A real server finds the window under the pointer again when windows move.
+ * The fake does it when a button is pressed, because a frame which was moved
+ * after the last motion may not be under the pointer any more.
+ */
+static void
+update_pointer_window()
+{
+    Window old = server.pointer_window;
+    Window target = find_window_at(server.pointer_x, server.pointer_y);
+    server.pointer_window = target;
+    if ((server.grab == None) && (old != target)) {
+        cross(old, target);
+    }
+}
+
+void
+fake_move_pointer(Display* display, int x, int y)
+{
+    x = x < 0 ? 0 : (FAKE_SCREEN_WIDTH <= x ? FAKE_SCREEN_WIDTH - 1 : x);
+    y = y < 0 ? 0 : (FAKE_SCREEN_HEIGHT <= y ? FAKE_SCREEN_HEIGHT - 1 : y);
+    if ((x == server.pointer_x) && (y == server.pointer_y)) {
+        return;
+    }
+    server.time++;
+    server.pointer_x = x;
+    server.pointer_y = y;
+    update_pointer_window();
+    Window target = server.pointer_window;
+
+    long mask = get_motion_mask();
+    Window w = server.grab != None ? server.grab : propagate(target, mask);
+    if ((w == None) || !selects(w, mask)) {
+        return;
+    }
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = MotionNotify;
+    fill_pointer_event(&e, w, target);
+    e.xmotion.is_hint = NotifyNormal;
+    queue_event(&e, w);
+}
+
+static Window
+find_passive_grab(Window target, unsigned int button)
+{
+    /* The outermost grab is activated. */
+    Window grab = None;
+    Window w = target;
+    while (w != None) {
+        FakeResource* r = find_window(w);
+        if (r->grabbed_buttons & get_button_bits(button)) {
+            grab = w;
+        }
+        w = r->parent;
+    }
+    return grab;
+}
+
+static unsigned int
+get_button_mask(unsigned int button)
+{
+    return Button1Mask << (button - Button1);
+}
+
+static void
+queue_button_event(int type, Window w, Window target, unsigned int button)
+{
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.type = type;
+    fill_pointer_event(&e, w, target);
+    e.xbutton.button = button;
+    queue_event(&e, w);
+}
+
+void
+fake_press_button(Display* display, unsigned int button)
+{
+    server.time++;
+    update_pointer_window();
+    Window target = server.pointer_window;
+    Window w = server.grab;
+    if (w == None) {
+        w = find_passive_grab(target, button);
+        server.grab_passive = w != None;
+    }
+    if (w == None) {
+        w = propagate(target, ButtonPressMask);
+    }
+    if (w != None) {
+        server.grab = w;
+        queue_button_event(ButtonPress, w, target, button);
+    }
+    server.buttons |= get_button_mask(button);
+}
+
+void
+fake_release_button(Display* display, unsigned int button)
+{
+    server.time++;
+    Window target = server.pointer_window;
+    Window w = server.grab != None ? server.grab : propagate(target, ButtonReleaseMask);
+    if ((w != None) && selects(w, ButtonReleaseMask)) {
+        queue_button_event(ButtonRelease, w, target, button);
+    }
+    server.buttons &= ~get_button_mask(button);
+    if (server.buttons == 0) {
+        release_grab();
+    }
+}
+
+/*
+ * While replaying, clients are the recording. A client does what the event
+ * tells, instead of closing its window for WM_DELETE_WINDOW.
+ */
+static void
+follow_replayed_event(XEvent* e)
+{
+    FakeResource* r;
+    switch (e->type) {
+    case DestroyNotify:
+        destroy_client(e->xdestroywindow.window);
+        break;
+    case UnmapNotify:
+        r = find_window(e->xunmap.window);
+        if ((r != NULL) && r->client) {
+            unmap_window(e->xunmap.window, r);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void
+fake_put_event(Display* display, XEvent* e)
+{
+    if (server.replaying) {
+        follow_replayed_event(e);
+    }
+    XEvent* dest = push_event();
+    *dest = *e;
+    dest->xany.display = display;
+}
+
+void
+fake_set_replaying(Display* display, Bool replaying)
+{
+    server.replaying = replaying;
+}
+
+static int
+random_int(unsigned int* seed, int min, int max)
+{
+    return min + rand_r(seed) % (max - min + 1);
+}
+
+static void
+create_random_client(Display* display, unsigned int* seed)
+{
+    int width = random_int(seed, 100, 900);
+    int height = random_int(seed, 80, 700);
+    int x = random_int(seed, 0, FAKE_SCREEN_WIDTH - width);
+    int y = random_int(seed, 0, FAKE_SCREEN_HEIGHT - height);
+    int n = rand_r(seed) % 10000;
+    char title[FAKE_TITLE_SIZE];
+    snprintf(title, sizeof(title), "client %d", n);
+    Window w = fake_create_client(display, x, y, width, height, title);
+    /* Clients are instances of some applications. */
+    char res_class[16];
+    snprintf(res_class, sizeof(res_class), "App%d", n % FAKE_APPLICATIONS_NUM);
+    fake_set_class_hint(display, w, "fake", res_class);
+    fake_set_protocols(display, w, random_int(seed, 0, 1));
+    if (random_int(seed, 0, 9) < 3) {
+        XSizeHints hints;
+        bzero(&hints, sizeof(hints));
+        hints.flags = PResizeInc | (random_int(seed, 0, 1) ? USPosition : 0);
+        hints.width_inc = random_int(seed, 1, 16);
+        hints.height_inc = random_int(seed, 1, 16);
+        fake_set_normal_hints(display, w, &hints);
+    }
+    fake_map_client(display, w);
+}
+
+static void
+configure_random_client(Display* display, unsigned int* seed, Window w)
+{
+    XWindowChanges changes;
+    changes.x = random_int(seed, 0, FAKE_SCREEN_WIDTH / 2);
+    changes.y = random_int(seed, 0, FAKE_SCREEN_HEIGHT / 2);
+    changes.width = random_int(seed, 1, 1200);
+    changes.height = random_int(seed, 1, 900);
+    changes.border_width = 0;
+    changes.stack_mode = random_int(seed, 0, 1) ? Above : Below;
+    unsigned int value_mask = rand_r(seed) & (CWX | CWY | CWWidth | CWHeight | CWStackMode);
+    fake_configure_client(display, w, value_mask, &changes);
+}
+
+static void
+click(Display* display, int x, int y)
+{
+    fake_move_pointer(display, x, y);
+    fake_press_button(display, Button1);
+    fake_release_button(display, Button1);
+}
+
+/*
+ * Picks a point in a frame; on the title bar, on the edges or corners, or
+ * anywhere including the client.
+ */
+static void
+pick_point_in_frame(unsigned int* seed, FakeResource* frame, int* x, int* y)
+{
+    int width = frame->width;
+    int height = frame->height;
+    int edge_x = random_int(seed, 0, 1) ? 0 : width - FAKE_EDGE_SIZE;
+    int edge_y = random_int(seed, 0, 1) ? 0 : height - FAKE_EDGE_SIZE;
+    switch (random_int(seed, 0, 4)) {
+    case 0:
+    case 1:
+        *x = random_int(seed, 0, width - 1);
+        *y = random_int(seed, 0, height < FAKE_TITLE_SIZE ? height - 1 : FAKE_TITLE_SIZE);
+        break;
+    case 2:
+        *x = edge_x + random_int(seed, 0, FAKE_EDGE_SIZE - 1);
+        *y = random_int(seed, 0, height - 1);
+        break;
+    case 3:
+        *x = random_int(seed, 0, width - 1);
+        *y = edge_y + random_int(seed, 0, FAKE_EDGE_SIZE - 1);
+        break;
+    default:
+        *x = random_int(seed, 0, width - 1);
+        *y = random_int(seed, 0, height - 1);
+        break;
+    }
+}
+
+static void
+drag_in_frame(Display* display, unsigned int* seed, Window w, Bool press)
+{
+    FakeResource* r = find_window(w);
+    Window frame_window = r->parent;
+    FakeResource* frame = find_window(frame_window);
+    if ((frame_window == get_root()) || !is_viewable(frame)) {
+        /* A minimized one is shown from the taskbar. */
+        int x = random_int(seed, 0, FAKE_SCREEN_WIDTH - 1);
+        click(display, x, FAKE_SCREEN_HEIGHT - random_int(seed, 1, FAKE_EDGE_SIZE));
+        return;
+    }
+    int origin_x;
+    int origin_y;
+    get_origin(frame_window, &origin_x, &origin_y);
+    int x;
+    int y;
+    pick_point_in_frame(seed, frame, &x, &y);
+    x += origin_x;
+    y += origin_y;
+    fake_move_pointer(display, x, y);
+    if (press) {
+        fake_press_button(display, Button1);
+    }
+    int steps = random_int(seed, 1, 10);
+    int i;
+    for (i = 0; i < steps; i++) {
+        x += random_int(seed, -48, 48);
+        y += random_int(seed, -48, 48);
+        fake_move_pointer(display, x, y);
+    }
+    if (press) {
+        fake_release_button(display, Button1);
+    }
+}
+
+void
+fake_act(Display* display, unsigned int* seed)
+{
+    int n = server.clients_num;
+    int action = random_int(seed, 0, 99);
+    if ((n < FAKE_CLIENTS_MIN) || ((action < 6) && (n < FAKE_CLIENTS_MAX))) {
+        create_random_client(display, seed);
+        return;
+    }
+    Window w = server.clients[rand_r(seed) % n];
+    char title[FAKE_TITLE_SIZE];
+    int x;
+    if (action < 12) {
+        fake_destroy_client(display, w);
+    }
+    else if (action < 18) {
+        snprintf(title, sizeof(title), "title %d", rand_r(seed) % 10000);
+        fake_set_title(display, w, title);
+    }
+    else if (action < 26) {
+        configure_random_client(display, seed, w);
+    }
+    else if (action < 30) {
+        if (find_window(w)->mapped) {
+            fake_unmap_client(display, w);
+        }
+        else {
+            fake_map_client(display, w);
+        }
+    }
+    else if (action < 40) {
+        x = random_int(seed, 0, FAKE_SCREEN_WIDTH - 1);
+        click(display, x, FAKE_SCREEN_HEIGHT - random_int(seed, 1, FAKE_EDGE_SIZE));
+    }
+    else if (action < 55) {
+        drag_in_frame(display, seed, w, False);
+    }
+    else {
+        drag_in_frame(display, seed, w, True);
+    }
+}
+
+static void
+create_scenario_window(Display* display)
+{
+    int n = server.scenario_windows_num;
+    char title[FAKE_TITLE_SIZE];
+    snprintf(title, sizeof(title), "scenario %d", n);
+    int x = SCENARIO_WINDOW_X(n);
+    int y = SCENARIO_WINDOW_Y(n);
+    int width = SCENARIO_WINDOW_WIDTH;
+    int height = SCENARIO_WINDOW_HEIGHT;
+    Window w = fake_create_client(display, x, y, width, height, title);
+    fake_set_protocols(display, w, True);
+    XSizeHints hints;
+    bzero(&hints, sizeof(hints));
+    hints.flags = USPosition | USSize;
+    hints.x = x;
+    hints.y = y;
+    hints.width = width;
+    hints.height = height;
+    fake_set_normal_hints(display, w, &hints);
+    fake_map_client(display, w);
+    server.scenario_windows[n] = w;
+    server.scenario_windows_num++;
+}
+
+void
+fake_prepare_scenarios(Display* display)
+{
+    int i;
+    for (i = 0; i < SCENARIO_BACKGROUND_WINDOWS_NUM; i++) {
+        create_scenario_window(display);
+    }
+}
+
+/* A point on the title bar, at the middle of the space above the client */
+static void
+get_title_point(Window w, int* x, int* y)
+{
+    FakeResource* r = find_window(w);
+    get_origin(r->parent, x, y);
+    *x += 16;
+    *y += r->y / 2;
+}
+
+static void
+get_corner_point(Window w, int* x, int* y)
+{
+    Window frame_window = find_window(w)->parent;
+    FakeResource* frame = find_window(frame_window);
+    get_origin(frame_window, x, y);
+    *x += frame->width - 2;
+    *y += frame->height - 2;
+}
+
+static void
+drag(Display* display, int x, int y, int dx, int dy)
+{
+    fake_move_pointer(display, x, y);
+    fake_press_button(display, Button1);
+    int i;
+    for (i = 1; i <= SCENARIO_MOTIONS_NUM; i++) {
+        fake_move_pointer(display, x + i * dx, y + i * dy);
+    }
+    fake_release_button(display, Button1);
+}
+
+/*
+ * The buttons window of a frame is as wide as three boxes of the height of
+ * the title, plus one. n is 1 for the close box, and 3 for the minimize box.
+ */
+static void
+click_box(Display* display, Window w, int n)
+{
+    FakeResource* frame = find_window(find_window(w)->parent);
+    int i;
+    for (i = 0; i < frame->children_num; i++) {
+        Window child = frame->children[i];
+        FakeResource* r = find_window(child);
+        if (r->width != 3 * r->height - 2) {
+            continue;
+        }
+        int size = r->height - 1;
+        int x;
+        int y;
+        get_origin(child, &x, &y);
+        click(display, x + r->width - 1 - n * size + size / 2, y + size / 2);
+        return;
+    }
+}
+
+/*
+ * The taskbar is the widest child of the root window at the bottom. Containers
+ * of desktops are as wide, but the taskbar is above them.
+ */
+static FakeResource*
+find_taskbar()
+{
+    FakeResource* root = find_window(get_root());
+    int i;
+    for (i = root->children_num - 1; 0 <= i; i--) {
+        FakeResource* r = find_window(root->children[i]);
+        if (!r->mapped || (r->width < FAKE_SCREEN_WIDTH - 2)) {
+            continue;
+        }
+        if (r->y + r->height + 2 * r->border_width < FAKE_SCREEN_HEIGHT) {
+            continue;
+        }
+        return r;
+    }
+    return NULL;
+}
+
+static void
+click_taskbar(Display* display, int repeat)
+{
+    FakeResource* r = find_taskbar();
+    if (r == NULL) {
+        return;
+    }
+    int x = r->x + r->border_width + r->width * (repeat % 2 == 0 ? 2 : 3) / 4;
+    click(display, x, r->y + r->border_width + r->height / 2);
+}
+
+/* The pager is next to the menu button, and its cells are as wide as high. */
+void
+fake_click_pager(Display* display, int desktop)
+{
+    FakeResource* r = find_taskbar();
+    if (r == NULL) {
+        return;
+    }
+    int size = r->height;
+    int x = r->x + r->border_width + size * (1 + desktop) + size / 2;
+    click(display, x, r->y + r->border_width + size / 2);
+}
+
+/*
+ * A client asks for a new size and position. Its size alternates, so that no
+ * request is redundant.
+ */
+static void
+configure_scenario_window(Display* display, int n, int repeat)
+{
+    Window w = server.scenario_windows[n];
+    FakeResource* client = find_window(w);
+    FakeResource* frame = find_window(client->parent);
+    server.configure_step.client = w;
+    server.configure_step.frame = client->parent;
+    server.configure_step.client_configures = client->configures;
+    server.configure_step.frame_configures = frame->configures;
+    server.configure_step.configure_notifies = client->configure_notifies;
+
+    XWindowChanges changes;
+    changes.x = SCENARIO_WINDOW_X(n) + SCENARIO_MOTION_SIZE;
+    changes.y = SCENARIO_WINDOW_Y(n) + SCENARIO_MOTION_SIZE;
+    changes.width = SCENARIO_WINDOW_WIDTH + (repeat % 2 == 0 ? SCENARIO_MOTION_SIZE : 0);
+    changes.height = SCENARIO_WINDOW_HEIGHT + (repeat % 2 == 0 ? SCENARIO_MOTION_SIZE : 0);
+    fake_configure_client(display, w, CWX | CWY | CWWidth | CWHeight, &changes);
+}
+
+void
+fake_play_scenario(Display* display, Scenario scenario, int repeat)
+{
+    Window* windows = server.scenario_windows;
+    int sign = repeat % 2 == 0 ? 1 : -1;
+    int size = SCENARIO_MOTION_SIZE;
+    char title[FAKE_TITLE_SIZE];
+    int x;
+    int y;
+    switch (scenario) {
+    case SCENARIO_MAP:
+        create_scenario_window(display);
+        break;
+    case SCENARIO_FOCUS:
+        get_title_point(windows[repeat % 2], &x, &y);
+        click(display, x, y);
+        break;
+    case SCENARIO_MOVE:
+        get_title_point(windows[0], &x, &y);
+        drag(display, x, y, sign * size, sign * size / 2);
+        break;
+    case SCENARIO_RESIZE:
+        get_corner_point(windows[1], &x, &y);
+        drag(display, x, y, sign * size, sign * size);
+        break;
+    case SCENARIO_RETITLE:
+        snprintf(title, sizeof(title), "retitled %d", repeat);
+        fake_set_title(display, windows[2], title);
+        break;
+    case SCENARIO_CONFIGURE:
+        configure_scenario_window(display, 3, repeat);
+        break;
+    case SCENARIO_TASKBAR:
+        click_taskbar(display, repeat);
+        break;
+    case SCENARIO_MINIMIZE:
+        click_box(display, windows[SCENARIO_BACKGROUND_WINDOWS_NUM + repeat], 3);
+        break;
+    case SCENARIO_CLOSE:
+        click_box(display, windows[repeat], 1);
+        break;
+    default:
+        assert(False);
+        break;
+    }
+}
+
+Bool
+fake_check_scenario(Display* display, Scenario scenario, char* message, int size)
+{
+    if (scenario != SCENARIO_CONFIGURE) {
+        return True;
+    }
+    FakeResource* client = find_window(server.configure_step.client);
+    FakeResource* frame = find_window(server.configure_step.frame);
+    if ((client == NULL) || (frame == NULL)) {
+        snprintf(message, size, "the configured client or its frame is gone");
+        return False;
+    }
+    unsigned long client_configures = client->configures - server.configure_step.client_configures;
+    unsigned long frame_configures = frame->configures - server.configure_step.frame_configures;
+    unsigned long notifies = client->configure_notifies - server.configure_step.configure_notifies;
+    if ((client_configures == 1) && (frame_configures == 1) && (notifies == 1)) {
+        return True;
+    }
+    const char* fmt = "ConfigureWindow: client=%lu, frame=%lu, synthetic ConfigureNotify=%lu (1 each expected)";
+    snprintf(message, size, fmt, client_configures, frame_configures, notifies);
+    return False;
+}
+
+void
+fake_get_stats(Display* display, FakeStats* stats)
+{
+    *stats = server.stats;
+    stats->windows = 0;
+    int i;
+    for (i = 0; i < server.resources_num; i++) {
+        stats->windows += server.resources[i].type == FAKE_RESOURCE_WINDOW ? 1 : 0;
+    }
+    stats->clients = server.clients_num;
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,178 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fawm/private/geometries.h>
+
+struct Geometries {
+    void* data;
+    size_t size;
+    GeometriesFileHeader* header;
+    GeometryEntry* entries;
+};
+
+/* FNV-1a */
+static uint64_t
+hash_bytes(uint64_t hash, const char* p, size_t size)
+{
+    size_t i;
+    for (i = 0; i < size; i++) {
+        hash ^= (unsigned char)p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t
+geometries_make_key(const char* class_hint, size_t class_size, const char* role, size_t role_size)
+{
+    uint64_t hash = hash_bytes(0xcbf29ce484222325ULL, class_hint, class_size);
+    /* A separator, so that ("ab", "c") differs from ("a", "bc") */
+    hash = hash_bytes(hash, "", 1);
+    hash = hash_bytes(hash, role, role_size);
+    return hash != 0 ? hash : 1;
+}
+
+static size_t
+compute_file_size()
+{
+    return sizeof(GeometriesFileHeader) + sizeof(GeometryEntry) * GEOMETRIES_CAPACITY;
+}
+
+static bool
+is_valid_header(GeometriesFileHeader* header)
+{
+    if (memcmp(header->magic, GEOMETRIES_MAGIC, sizeof(header->magic)) != 0) {
+        return false;
+    }
+    return header->capacity == GEOMETRIES_CAPACITY;
+}
+
+static void*
+map_file(const char* path, size_t size)
+{
+    if (path == NULL) {
+        void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return p != MAP_FAILED ? p : NULL;
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    /* A file of another size is cleared, and its header is written again. */
+    if ((st.st_size != size) && ((ftruncate(fd, 0) != 0) || (ftruncate(fd, size) != 0))) {
+        close(fd);
+        return NULL;
+    }
+    /* All pages are read now, so that no lookup waits for the disk. */
+    int flags = MAP_SHARED;
+#if defined(MAP_POPULATE)
+    flags |= MAP_POPULATE;
+#endif
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    int e = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        errno = e;
+        return NULL;
+    }
+    return p;
+}
+
+Geometries*
+geometries_open(const char* path)
+{
+    size_t size = compute_file_size();
+    void* data = map_file(path, size);
+    if (data == NULL) {
+        return NULL;
+    }
+    Geometries* geometries = (Geometries*)malloc(sizeof(Geometries));
+    if (geometries == NULL) {
+        munmap(data, size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    geometries->data = data;
+    geometries->size = size;
+    geometries->header = (GeometriesFileHeader*)data;
+    geometries->entries = (GeometryEntry*)(geometries->header + 1);
+
+    GeometriesFileHeader* header = geometries->header;
+    if (!is_valid_header(header)) {
+        memset(data, 0, size);
+        memcpy(header->magic, GEOMETRIES_MAGIC, sizeof(header->magic));
+        header->capacity = GEOMETRIES_CAPACITY;
+        header->clock = 0;
+    }
+
+    return geometries;
+}
+
+bool
+geometries_lookup(Geometries* geometries, uint64_t key, GeometryEntry* entry)
+{
+    unsigned int mask = GEOMETRIES_CAPACITY - 1;
+    unsigned int start = key & mask;
+    int i;
+    for (i = 0; i < GEOMETRIES_PROBES; i++) {
+        GeometryEntry* e = &geometries->entries[(start + i) & mask];
+        if (e->key == 0) {
+            return false;
+        }
+        if (e->key == key) {
+            *entry = *e;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+geometries_store(Geometries* geometries, uint64_t key, int x, int y, unsigned int width, unsigned int height)
+{
+    unsigned int mask = GEOMETRIES_CAPACITY - 1;
+    unsigned int start = key & mask;
+    GeometryEntry* victim = NULL;
+    int i;
+    for (i = 0; i < GEOMETRIES_PROBES; i++) {
+        GeometryEntry* e = &geometries->entries[(start + i) & mask];
+        if ((e->key == 0) || (e->key == key)) {
+            victim = e;
+            break;
+        }
+        /* Differences are compared, because the clock may wrap around. */
+        uint32_t clock = geometries->header->clock;
+        if ((victim == NULL) || (clock - victim->stamp < clock - e->stamp)) {
+            victim = e;
+        }
+    }
+    victim->key = key;
+    victim->x = x;
+    victim->y = y;
+    victim->width = width;
+    victim->height = height;
+    victim->stamp = ++geometries->header->clock;
+}
+
+void
+geometries_close(Geometries* geometries)
+{
+    munmap(geometries->data, geometries->size);
+    free(geometries);
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
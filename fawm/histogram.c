@@ -0,0 +1,76 @@
+#include <string.h>
+
+#include <fawm/private/histogram.h>
+
+static int
+find_most_significant_bit(uint64_t n)
+{
+    return 63 - __builtin_clzll(n);
+}
+
+static int
+compute_bucket(uint64_t value)
+{
+    if (value < 2 * HISTOGRAM_SUB_BUCKETS_NUM) {
+        return value;
+    }
+    int shift = find_most_significant_bit(value) - HISTOGRAM_SUB_BITS;
+    int sub_bucket = (value >> shift) - HISTOGRAM_SUB_BUCKETS_NUM;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS_NUM + sub_bucket;
+}
+
+/* Returns the largest value in the bucket. */
+static uint64_t
+compute_highest_value(int bucket)
+{
+    if (bucket < 2 * HISTOGRAM_SUB_BUCKETS_NUM) {
+        return bucket;
+    }
+    int shift = bucket / HISTOGRAM_SUB_BUCKETS_NUM - 1;
+    int sub_bucket = bucket % HISTOGRAM_SUB_BUCKETS_NUM;
+    uint64_t lowest = (uint64_t)(HISTOGRAM_SUB_BUCKETS_NUM + sub_bucket) << shift;
+    return lowest + ((uint64_t)1 << shift) - 1;
+}
+
+void
+histogram_initialize(Histogram* histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void
+histogram_record(Histogram* histogram, uint64_t value)
+{
+    histogram->count++;
+    histogram->max = histogram->max < value ? value : histogram->max;
+    histogram->buckets[compute_bucket(value)]++;
+}
+
+/*
+ * Returns the value which percent of recorded values are equal to or less
+ * than. It is never larger than the maximum.
+ */
+uint64_t
+histogram_percentile(Histogram* histogram, double percent)
+{
+    uint64_t count = histogram->count;
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percent * count / 100 + 0.5);
+    rank = rank < 1 ? 1 : (count < rank ? count : rank);
+    uint64_t total = 0;
+    int i;
+    for (i = 0; i < HISTOGRAM_BUCKETS_NUM; i++) {
+        total += histogram->buckets[i];
+        if (rank <= total) {
+            break;
+        }
+    }
+    uint64_t value = compute_highest_value(i);
+    return histogram->max < value ? histogram->max : value;
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,121 @@
+#include <assert.h>
+#include <stdbool.h>
+
+#include <fawm/private/layout.h>
+
+static void
+set_rect(SpatialRect* rect, int x, int y, int width, int height)
+{
+    rect->x = x;
+    rect->y = y;
+    rect->width = width;
+    rect->height = height;
+}
+
+/*
+ * The last rectangle is the front one. It is moved down by step from the one
+ * behind, and goes back to the top-left when it reaches an edge of bounds.
+ */
+static void
+layout_cascade(SpatialRect* bounds, int n, int step, SpatialRect* rects)
+{
+    int width = 2 * bounds->width / 3;
+    int height = 2 * bounds->height / 3;
+    int room_x = bounds->width - width;
+    int room_y = bounds->height - height;
+    int steps_num = step < 1 ? 1 : (room_x < room_y ? room_x : room_y) / step + 1;
+    int i;
+    for (i = 0; i < n; i++) {
+        int offset = (i % steps_num) * step;
+        int x = bounds->x + offset;
+        int y = bounds->y + offset;
+        set_rect(&rects[i], x, y, width, height);
+    }
+}
+
+static int
+compute_columns_num(int n)
+{
+    int columns_num = 1;
+    while (columns_num * columns_num < n) {
+        columns_num++;
+    }
+    return columns_num;
+}
+
+/*
+ * Rectangles are put from the top-left in rows. The last row may have less
+ * ones, and they share the whole width.
+ */
+static void
+layout_grid(SpatialRect* bounds, int n, SpatialRect* rects)
+{
+    int columns_num = compute_columns_num(n);
+    int rows_num = (n + columns_num - 1) / columns_num;
+    int i;
+    for (i = 0; i < n; i++) {
+        int row = i / columns_num;
+        int column = i % columns_num;
+        int rest = n - row * columns_num;
+        int num = rest < columns_num ? rest : columns_num;
+        int x = bounds->x + column * bounds->width / num;
+        int y = bounds->y + row * bounds->height / rows_num;
+        int right = bounds->x + (column + 1) * bounds->width / num;
+        int bottom = bounds->y + (row + 1) * bounds->height / rows_num;
+        set_rect(&rects[i], x, y, right - x, bottom - y);
+    }
+}
+
+/*
+ * The first rectangle has the left half. The others are stacked in the right
+ * half.
+ */
+static void
+layout_tile(SpatialRect* bounds, int n, SpatialRect* rects)
+{
+    if (n == 1) {
+        *rects = *bounds;
+        return;
+    }
+    int half = bounds->width / 2;
+    set_rect(&rects[0], bounds->x, bounds->y, half, bounds->height);
+    int x = bounds->x + half;
+    int width = bounds->width - half;
+    int stacked_num = n - 1;
+    int i;
+    for (i = 0; i < stacked_num; i++) {
+        int y = bounds->y + i * bounds->height / stacked_num;
+        int bottom = bounds->y + (i + 1) * bounds->height / stacked_num;
+        set_rect(&rects[i + 1], x, y, width, bottom - y);
+    }
+}
+
+/*
+ * Computes n rectangles in bounds at once. step is the offset of cascading
+ * rectangles.
+ */
+void
+layout_compute(LayoutType type, SpatialRect* bounds, int n, int step, SpatialRect* rects)
+{
+    if (n < 1) {
+        return;
+    }
+    switch (type) {
+    case LAYOUT_TYPE_CASCADE:
+        layout_cascade(bounds, n, step, rects);
+        break;
+    case LAYOUT_TYPE_GRID:
+        layout_grid(bounds, n, rects);
+        break;
+    case LAYOUT_TYPE_TILE:
+        layout_tile(bounds, n, rects);
+        break;
+    default:
+        assert(false);
+        break;
+    }
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -3,6 +3,11 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <libgen.h>
+#include <limits.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -11,6 +16,7 @@
 #include <sys/param.h>
 #include <sys/resource.h>
 #include <sys/select.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -25,24 +31,82 @@
 
 #include <fawm/config.h>
 #include <fawm/private.h>
+#include <fawm/private/backend.h>
+#if defined(FAWM_FAKE)
+#include <fawm/private/fake.h>
+#endif
+#include <fawm/private/geometries.h>
+#include <fawm/private/histogram.h>
+#include <fawm/private/layout.h>
+#include <fawm/private/recording.h>
+#include <fawm/private/restart.h>
+#include <fawm/private/spatial.h>
+#include <fawm/private/trace.h>
+
+#if defined(FAWM_HAVE_XRANDR)
+#include <X11/extensions/Xrandr.h>
+#endif
+
+#define MAX_TITLE_SIZE 128
+#define MAX_ELLIPSIS_GLYPHS 3
+
+/**
+ * A title which is already converted into glyphs. It is shaped for max_width,
+ * and is truncated with an ellipsis when the title is wider than max_width.
+ * Positions of glyphs are relative to (x, y).
+ */
+struct GlyphRun {
+    XftGlyphFontSpec glyphs[MAX_TITLE_SIZE + MAX_ELLIPSIS_GLYPHS];
+    int glyphs_num;
+    int max_width;
+    int width;
+    Bool truncated;
+    int x;
+    int y;
+};
+
+typedef struct GlyphRun GlyphRun;
+
+enum FrameStatus {
+    FOCUS_NONE,
+    FOCUS_MINIMIZE,
+    FOCUS_MAXIMIZE,
+    FOCUS_CLOSE
+};
+
+#define FRAME_STATUS_NUM 4
+#define CORNER_MARKS_NUM 8
+/* A frame and its buttons */
+#define FRAME_WINDOWS_NUM 2
+#define FRAME_POOL_SIZE 16
+#define FRAMES_PER_SLAB 32
 
 struct Frame {
     Window window;
     Window child;
-    XftDraw* draw;
     Bool wm_delete_window;
-    char title[128];
+    char title[MAX_TITLE_SIZE];
+    GlyphRun title_run;
+    GlyphRun list_run;
     int width_inc;
     int height_inc;
-    GC line_gc;
-    GC focused_gc;
-    GC unfocused_gc;
-    enum {
-        FOCUS_NONE,
-        FOCUS_MINIMIZE,
-        FOCUS_MAXIMIZE,
-        FOCUS_CLOSE
-    } status;
+    Window buttons;
+    /* The size which the corner marks were drawn at, or 0 */
+    int marks_width;
+    int marks_height;
+    /* True while an Expose series has uncovered a corner mark */
+    Bool marks_exposed;
+    enum FrameStatus status;
+    /* True while Button1 on the child is grabbed to focus it by a click */
+    Bool grabbed;
+    int desktop;
+    /* The outer rectangle of a mapped frame. The layer is the desktop. */
+    SpatialEntry spatial;
+    /* The key of the application in geometries, or 0 */
+    uint64_t geometry_key;
+    /* The index in applied of the desktop, valid while applied_stamp is current */
+    int applied_index;
+    unsigned int applied_stamp;
 };
 
 typedef struct Frame Frame;
@@ -55,6 +119,143 @@ struct Array {
 
 typedef struct Array Array;
 
+#define DESKTOPS_NUM 4
+
+/*
+ * Frames of a desktop are children of its container window, so a desktop is
+ * shown or hidden by mapping or unmapping only the container.
+ */
+struct Desktop {
+    Window container;
+    Array frames;   /* In the order of the taskbar */
+    /*
+     * z_order (the top first) is the desired stacking order. Its head is the
+     * focused frame. applied is the order which was sent to the server last.
+     * They are compared, and only the difference is sent once per event batch.
+     */
+    Array z_order;
+    Array applied;
+    Bool dirty;
+};
+
+typedef struct Desktop Desktop;
+
+#define OUTPUTS_MAX 8
+#define STARTUP_PHASES_MAX 16
+#if defined(FAWM_FAKE)
+#define FAKE_SWITCHES_NUM (8 * DESKTOPS_NUM)
+#endif
+
+struct Output {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+typedef struct Output Output;
+
+/* One taskbar is placed at the bottom of each output. */
+struct Taskbar {
+    Window window;
+    XftDraw* draw;
+    int clock_x;
+};
+
+typedef struct Taskbar Taskbar;
+
+#define DRAW_BATCH_GCS_NUM 4
+#define DRAW_BATCH_SIZE 128
+
+/**
+ * Lines and rectangles for one drawable are accumulated here per GC, and are
+ * sent at once (one XFillRectangles, one XDrawRectangles and one XDrawSegments
+ * per GC). Filled rectangles are sent before outlines, so callers must not
+ * depend on other orders.
+ */
+struct DrawBatch {
+    Drawable drawable;
+    int gcs_num;
+    struct {
+        GC gc;
+        XRectangle fill_rects[DRAW_BATCH_SIZE];
+        int fill_rects_num;
+        XRectangle rects[DRAW_BATCH_SIZE];
+        int rects_num;
+        XSegment segments[DRAW_BATCH_SIZE];
+        int segments_num;
+    } gcs[DRAW_BATCH_GCS_NUM];
+};
+
+typedef struct DrawBatch DrawBatch;
+
+/*
+ * A client side copy of states of a window. A member is valid only while its
+ * bit is set in known.
+ */
+struct WindowState {
+    Window window;
+    unsigned int known;
+    Cursor cursor;
+    Bool mapped;
+    unsigned long background;
+    int x;
+    int y;
+    unsigned int width;
+    unsigned int height;
+    /* A frame whose geometry the spatial index follows, or NULL */
+    struct Frame* frame;
+};
+
+typedef struct WindowState WindowState;
+
+#define STATE_CURSOR        (1 << 0)
+#define STATE_MAPPED        (1 << 1)
+#define STATE_BACKGROUND    (1 << 2)
+#define STATE_POSITION      (1 << 3)
+#define STATE_SIZE          (1 << 4)
+
+/* An open addressing hash table of WindowStates. None marks an empty slot. */
+struct WindowStates {
+    int size;
+    int capacity;
+    WindowState* items;
+};
+
+typedef struct WindowStates WindowStates;
+
+enum ShadowedRequest {
+    SR_CONFIGURE_WINDOW,
+    SR_DEFINE_CURSOR,
+    SR_GET_GEOMETRY,
+    SR_MAP_RAISED,
+    SR_MAP_WINDOW,
+    SR_MOVE_RESIZE_WINDOW,
+    SR_MOVE_WINDOW,
+    SR_RAISE_WINDOW,
+    SR_RESIZE_WINDOW,
+    SR_SET_INPUT_FOCUS,
+    SR_SET_WINDOW_BACKGROUND,
+    SR_UNDEFINE_CURSOR,
+    SR_UNMAP_WINDOW,
+    SHADOWED_REQUESTS_NUM
+};
+
+static const char* shadowed_request_names[] = {
+    "XConfigureWindow",
+    "XDefineCursor",
+    "XGetGeometry",
+    "XMapRaised",
+    "XMapWindow",
+    "XMoveResizeWindow",
+    "XMoveWindow",
+    "XRaiseWindow",
+    "XResizeWindow",
+    "XSetInputFocus",
+    "XSetWindowBackground",
+    "XUndefineCursor",
+    "XUnmapWindow" };
+
 enum GraspedPosition {
     GP_NONE,
     GP_TITLE_BAR,
@@ -70,10 +271,65 @@ enum GraspedPosition {
 
 typedef enum GraspedPosition GraspedPosition;
 
+/* latency is in nanoseconds. */
+struct EventStats {
+    Histogram latency;
+    unsigned long requests;
+    unsigned long round_trips;
+    unsigned long max_round_trips;
+};
+
+typedef struct EventStats EventStats;
+
+#if defined(FAWM_FAKE)
+/* Requests and round trips of steps of a scenario, per step and at most */
+struct ScenarioStats {
+    unsigned long requests;
+    unsigned long max_requests;
+    unsigned long round_trips;
+    unsigned long max_round_trips;
+};
+
+typedef struct ScenarioStats ScenarioStats;
+#endif
+
 struct WindowManager {
+    Backend* backend;
     Display* display;
     Bool running;
 
+#if defined(FAWM_FAKE)
+    /*
+     * With fake_backend, fawm makes its own events by fake_act() until
+     * events_left events are processed. With --fake-scenarios, it plays each
+     * scenario of fawm-budgets repeats times instead. serial and round_trips
+     * are the counts when the last step started. failures counts steps which
+     * fake_check_scenario() rejected. With --fake-switch, it maps
+     * switch_windows clients on each desktop, and switches desktops
+     * FAKE_SWITCHES_NUM times by the pager.
+     */
+    struct {
+        unsigned long events_left;
+        unsigned int seed;
+        int repeats;
+        int step;
+        unsigned long serial;
+        unsigned long round_trips;
+        ScenarioStats scenarios[SCENARIOS_NUM];
+        int failures;
+        /* Requests of redraws of taskbars, and windows listed at most */
+        unsigned long taskbar_draws;
+        unsigned long taskbar_requests;
+        unsigned long max_taskbar_requests;
+        int max_taskbar_frames;
+        int switch_windows;
+        long step_start;
+        Histogram switch_latency;
+        unsigned long switch_requests;
+        unsigned long max_switch_requests;
+    } fake;
+#endif
+
     unsigned long focused_foreground_color;
     unsigned long unfocused_foreground_color;
     int border_size;
@@ -84,7 +340,61 @@ struct WindowManager {
     int padding_size;
 
     Array all_frames;
-    Array frames_z_order;
+    Desktop desktops[DESKTOPS_NUM];
+    int current_desktop;
+
+    /*
+     * Rectangles of outputs (monitors) are cached, and are updated only when
+     * the server notifies a change of them, so that placing a window or a menu
+     * never asks RandR.
+     */
+    Output outputs[OUTPUTS_MAX];
+    int outputs_num;
+#if defined(FAWM_HAVE_XRANDR)
+    int rr_event_base;
+#endif
+    /*
+     * The focused frame has no passive grab, so clicks in it are delivered to
+     * the client without freezing the pointer.
+     */
+    Frame* focused_frame;
+    int restack_requests;
+    /*
+     * Arrays for restack_frames(), which are reused by all batches. stamp
+     * tells applied_index of a frame is of this batch.
+     */
+    struct {
+        int capacity;
+        int* positions;
+        int* tails;
+        int* prev;
+        Bool* stable;
+        Window* windows;
+        unsigned int stamp;
+    } restack;
+
+    /*
+     * Rectangles of frames, which follow geometries in the shadow. z of an
+     * entry is top_z when the frame was moved to the top of the z-order, or
+     * bottom_z when it was moved to the bottom.
+     */
+    struct {
+        SpatialIndex index;
+        int top_z;
+        int bottom_z;
+    } spatial;
+
+    /*
+     * Frames of destroyed clients are kept unmapped in frame_pool, and are
+     * reused for next clients. Frame structs are allocated by slabs, and
+     * free_frames holds unused ones.
+     */
+    Array frame_pool;
+    Array free_frames;
+    struct {
+        int hits;
+        int misses;
+    } frame_pool_stats;
 
     GraspedPosition grasped_position;
     Window grasped_frame;
@@ -92,9 +402,75 @@ struct WindowManager {
     int grasped_y;
     int grasped_width;
     int grasped_height;
+    int grasped_output;
+    /* Expose events on frames while a frame is resized by the pointer */
+    struct {
+        int steps;
+        int exposes;
+    } resize_stats;
+
+    /*
+     * Statistics of handlers per event type. round_trips is the number of all
+     * requests which waited for replies.
+     */
+    struct {
+        EventStats types[LASTEvent];
+        unsigned long round_trips;
+    } event_stats;
 
     XftFont* title_font;
     XftColor title_color;
+    struct {
+        FT_UInt glyph;
+        int glyphs_num;
+        int advance;
+    } ellipsis;
+
+    /*
+     * All windows have the default depth, so one set of GCs is shared by all
+     * drawings.
+     */
+    struct {
+        GC line_gc;
+        GC focused_gc;
+        GC unfocused_gc;
+    } gcs;
+
+    /*
+     * Decorations are drawn once into pixmaps (or are plain windows), so that
+     * the X server repaints them without fawm.
+     */
+    struct {
+        Pixmap buttons[FRAME_STATUS_NUM];
+    } decoration;
+
+    /* One XftDraw is retargeted to a frame which is being drawn. */
+    XftDraw* frame_draw;
+
+    /* Numbers of server side resources which fawm holds now */
+    struct {
+        int gcs;
+        int pixmaps;
+        int xft_draws;
+        int regions;
+    } resources;
+
+    /*
+     * The XX* wrappers drop requests which change nothing in this shadow.
+     * States are kept for windows which are registered by track_window() only.
+     * top is the window which was raised last among children of the root
+     * window, or None if it is unknown.
+     */
+    struct {
+        WindowStates windows;
+        Bool focus_known;
+        Window focus;
+        Window top;
+        struct {
+            int sent;
+            int elided;
+        } requests[SHADOWED_REQUESTS_NUM];
+    } shadow;
 
     Cursor normal_cursor;
     Cursor bottom_left_cursor;
@@ -108,36 +484,85 @@ struct WindowManager {
 
     struct {
         Window window;
-        GC title_gc;
-        GC selected_gc;
         XftDraw* draw;
         int margin;
         int selected_item;
     } popup_menu;
 
     struct {
-        Window window;
-        XftDraw* draw;
+        Taskbar bars[OUTPUTS_MAX];  /* bars[i] is on outputs[i] */
+        int bars_num;
+        int height;
+        Array listed;   /* Frames which are listed in a taskbar */
+        Bool exposed;   /* Cleared in this batch of events */
 
         XftFont* clock_font;
+        Bool clock_font_wanted;
         int clock_margin;
         time_t clock;
-        int clock_x;
-
-        GC line_gc;
-        GC focused_gc;
     } taskbar;
 
     struct {
+        Atom compound_text;
         Atom wm_delete_window;
         Atom wm_protocols;
+        Atom wm_window_role;
     } atoms;
 
-    FILE* log_file; /* For debug */
+    /* The last geometries of applications. The file is NULL for fake runs. */
+    Geometries* geometries;
+    const char* geometries_file;
+
+    TraceWriter* trace; /* For debug */
+    RecordingWriter* recording;
+
+#if defined(FAWM_FAKE)
+    /*
+     * A recording is replayed with fake_backend batch by batch. With realtime,
+     * a batch is put at the recorded time since the first event.
+     */
+    struct {
+        Replay* replay;
+        Bool realtime;
+        uint64_t first_nsec;
+        long start;
+        int events_num;
+    } replay;
+#endif
+
+    /*
+     * A restart leaves frames in the server, and passes them to the next fawm
+     * through a file of fd. snapshot is the one which this fawm adopts. path
+     * is the executable which is found before frames are left.
+     */
+    struct {
+        Bool restarted;
+        Bool requested;
+        const char* program;
+        char path[MAXPATHLEN];
+        int fd;
+        RestartSnapshot* snapshot;
+        /* A snapshot which this fawm cannot adopt */
+        RestartSnapshot* rejected;
+        Bool adopted;
+    } restart;
 
     struct Config* config;
     const char* fawm_exe;
     const char* config_file;
+    /* __fawm_config__ runs while fawm sets up X. */
+    FILE* config_pipe;
+
+    struct {
+        long start;
+        long last;
+        int phases_num;
+        struct {
+            const char* name;
+            long nsec;
+        } phases[STARTUP_PHASES_MAX];
+        Bool verbose;
+    } startup;
 };
 
 typedef struct WindowManager WindowManager;
@@ -156,24 +581,26 @@ print_message(FILE* fp, const char* fmt, va_list ap)
     fflush(fp);
 }
 
-static void
-output_log(WindowManager* wm, const char* fmt, ...)
-{
-    va_list ap;
-    va_start(ap, fmt);
-    print_message(wm->log_file, fmt, ap);
-    va_end(ap);
-}
-
-#define LOG_HEAD_FMT "%s:%u [%u] "
-#define LOG_HEAD __FILE__, __LINE__, getpid()
-#define LOG(wm, fmt, ...) \
-    output_log(wm, LOG_HEAD_FMT fmt, LOG_HEAD, __VA_ARGS__)
-#define LOG0(wm, msg) output_log(wm, LOG_HEAD_FMT msg, LOG_HEAD)
+/*
+ * A log is a binary trace, which fawm-trace decodes. Arguments are not even
+ * evaluated without --log-file.
+ */
 #define LOG_X(filename, lineno, wm, fmt, ...) \
-    output_log(wm, LOG_HEAD_FMT fmt, filename, lineno, getpid(), __VA_ARGS__)
+do { \
+    if ((wm)->trace != NULL) { \
+        static TraceFormat trace_format = { fmt }; \
+        trace_write((wm)->trace, &trace_format, (filename), (lineno), __VA_ARGS__); \
+    } \
+} while (0)
 #define LOG_X0(filename, lineno, wm, msg) \
-    output_log(wm, LOG_HEAD_FMT msg, filename, lineno, getpid())
+do { \
+    if ((wm)->trace != NULL) { \
+        static TraceFormat trace_format = { msg }; \
+        trace_write((wm)->trace, &trace_format, (filename), (lineno)); \
+    } \
+} while (0)
+#define LOG(wm, fmt, ...) LOG_X(__FILE__, __LINE__, wm, fmt, __VA_ARGS__)
+#define LOG0(wm, msg) LOG_X0(__FILE__, __LINE__, wm, msg)
 
 static void
 print_error(const char* fmt, ...)
@@ -184,6 +611,28 @@ print_error(const char* fmt, ...)
     va_end(ap);
 }
 
+static long
+get_monotonic_usec()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        print_error("clock_gettime failed: %s", strerror(errno));
+        return 0;
+    }
+    return 1000000 * ts.tv_sec + ts.tv_nsec / 1000;
+}
+
+static long
+get_monotonic_nsec()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        print_error("clock_gettime failed: %s", strerror(errno));
+        return 0;
+    }
+    return 1000000000L * ts.tv_sec + ts.tv_nsec;
+}
+
 static void
 initialize_array(Array* a)
 {
@@ -197,7 +646,24 @@ ensure_array_size(Array* a, int size)
     if (size <= a->capacity) {
         return;
     }
-    int capacity = 8 + a->capacity;
+    int capacity = MAX(8, 2 * a->capacity);
+    Frame** p = (Frame**)realloc(a->items, sizeof(a->items[0]) * capacity);
+    assert(p != NULL);
+    a->capacity = capacity;
+    a->items = p;
+}
+
+/*
+ * An array gives memory back when it becomes a quarter full, so that opening
+ * and closing many windows does not leave large arrays.
+ */
+static void
+shrink_array(Array* a)
+{
+    int capacity = a->capacity / 2;
+    if ((capacity < 8) || (capacity / 2 < a->size)) {
+        return;
+    }
     Frame** p = (Frame**)realloc(a->items, sizeof(a->items[0]) * capacity);
     assert(p != NULL);
     a->capacity = capacity;
@@ -215,8 +681,9 @@ remove_from_array(Array* a, Frame* f)
         return;
     }
     int rest = size - i - 1;
-    memcpy(&a->items[i], &a->items[i + 1], sizeof(a->items[0]) * rest);
+    memmove(&a->items[i], &a->items[i + 1], sizeof(a->items[0]) * rest);
     a->size--;
+    shrink_array(a);
 }
 
 static void
@@ -272,2505 +739,5656 @@ search_frame(WindowManager* wm, Window w)
     return search_in_array(&wm->all_frames, is_frame, w);
 }
 
-static int
-__XAddToSaveSet__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
+static Desktop*
+get_current_desktop(WindowManager* wm)
 {
-    LOG_X(filename, lineno, wm, "XAddToSaveSet(display, w=0x%08x)", w);
-    return XAddToSaveSet(display, w);
+    return &wm->desktops[wm->current_desktop];
 }
 
-#define XXAddToSaveSet(wm, a, b) \
-    __XAddToSaveSet__(__FILE__, __LINE__, (wm), (a), (b))
-
-static Status
-__XAllocNamedColor__(const char* filename, int lineno, WindowManager* wm, Display* display, Colormap colormap, const char* color_name, XColor* color_def_return, XColor* exact_def_return)
+static Desktop*
+get_desktop_of_frame(WindowManager* wm, Frame* frame)
 {
-    LOG_X(filename, lineno, wm, "XAllocNamedColor(display, colormap, color_name=\"%s\", color_def_return, exact_def_return)", color_name);
-    return XAllocNamedColor(display, colormap, color_name, color_def_return, exact_def_return);
+    return &wm->desktops[frame->desktop];
 }
 
-#define XXAllocNamedColor(wm, a, b, c, d, e) \
-    __XAllocNamedColor__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
-
-static int
-__XAllowEvents__(const char* filename, int lineno, WindowManager* wm, Display* display, int event_mode, Time time)
+static Bool
+is_container(WindowManager* wm, Window w)
 {
-    LOG_X0(filename, lineno, wm, "XAllowEvents(display, event_mode, time)");
-    return XAllowEvents(display, event_mode, time);
+    int i;
+    for (i = 0; (i < DESKTOPS_NUM) && (wm->desktops[i].container != w); i++) {
+    }
+    return i < DESKTOPS_NUM;
 }
 
-#define XXAllowEvents(wm, a, b, c) \
-    __XAllowEvents__(__FILE__, __LINE__, (wm), (a), (b), (c))
-
-static int
-__XChangeWindowAttributes__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned long valuemask, XSetWindowAttributes* attributes)
+static unsigned int
+hash_window(Window w)
 {
-    LOG_X(filename, lineno, wm, "XChangeWindowAttributes(display, w=0x%08x, valuemask, attributes)", w);
-    return XChangeWindowAttributes(display, w, valuemask, attributes);
+    return (unsigned int)((w ^ (w >> 16)) * 2654435761u);
 }
 
-#define XXChangeWindowAttributes(wm, a, b, c, d) \
-    __XChangeWindowAttributes__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
-
-static Bool
-__XCheckTypedWindowEvent__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, int event_type, XEvent* event_return)
+static WindowState*
+find_window_state(WindowManager* wm, Window w)
 {
-    LOG_X(filename, lineno, wm, "XCheckTypedWindowEvent(display, w=0x%08x, event_type, event_return)", w);
-    return XCheckTypedWindowEvent(display, w, event_type, event_return);
+    WindowStates* states = &wm->shadow.windows;
+    if ((states->capacity == 0) || (w == None)) {
+        return NULL;
+    }
+    WindowState* items = states->items;
+    unsigned int mask = states->capacity - 1;
+    unsigned int i;
+    for (i = hash_window(w) & mask; items[i].window != None; i = (i + 1) & mask) {
+        if (items[i].window == w) {
+            return &items[i];
+        }
+    }
+    return NULL;
 }
 
-#define XXCheckTypedWindowEvent(wm, a, b, c, d) \
-    __XCheckTypedWindowEvent__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
-
-static int
-__XConfigureWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned value_mask, XWindowChanges* changes)
+static WindowState*
+insert_window_state(WindowStates* states, Window w)
 {
-    LOG_X(filename, lineno, wm, "XConfigureWindow(display, w=0x%08x, value_mask, changes)", w);
-    return XConfigureWindow(display, w, value_mask, changes);
+    WindowState* items = states->items;
+    unsigned int mask = states->capacity - 1;
+    unsigned int i;
+    for (i = hash_window(w) & mask; items[i].window != None; i = (i + 1) & mask) {
+    }
+    WindowState* state = &items[i];
+    bzero(state, sizeof(*state));
+    state->window = w;
+    states->size++;
+    return state;
 }
 
-#define XXConfigureWindow(wm, a, b, c, d) \
-    __XConfigureWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
-
-#if 0
-static int
-__XCopyArea__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable src, Drawable dest, GC gc, int src_x, int src_y, unsigned int width, unsigned int height, int dest_x, int dest_y)
+static void
+grow_window_states(WindowStates* states)
 {
-    LOG_X(filename, lineno, wm, "XCopyArea(display, src=0x%08x, dest=0x%08x, gc, src_x=%d, src_y=%d, width=%d, height=%d, dest_x=%d, dest_y=%d)", src, dest, src_x, src_y, width, height, dest_x, dest_y);
-    return XCopyArea(display, src, dest, gc, src_x, src_y, width, height, dest_x, dest_y);
-}
+    WindowState* old_items = states->items;
+    int old_capacity = states->capacity;
+    int capacity = old_capacity == 0 ? 64 : 2 * old_capacity;
+    WindowState* items = (WindowState*)calloc(capacity, sizeof(items[0]));
+    assert(items != NULL);
+    states->size = 0;
+    states->capacity = capacity;
+    states->items = items;
 
-#define XXCopyArea(wm, a, b, c, d, e, f, g, h, i, j) \
-    __XCopyArea__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h), (i), (j))
-#endif
+    int i;
+    for (i = 0; i < old_capacity; i++) {
+        Window w = old_items[i].window;
+        if (w != None) {
+            *insert_window_state(states, w) = old_items[i];
+        }
+    }
+    free(old_items);
+}
 
-static Cursor
-__XCreateFontCursor__(const char* filename, int lineno, WindowManager* wm, Display* display, unsigned int shape)
+static void
+track_window(WindowManager* wm, Window w)
 {
-    LOG_X(filename, lineno, wm, "XCreateFontCursor(display, shape=%d)", shape);
-    return XCreateFontCursor(display, shape);
+    if (find_window_state(wm, w) != NULL) {
+        return;
+    }
+    WindowStates* states = &wm->shadow.windows;
+    if (states->capacity < 2 * (states->size + 1)) {
+        grow_window_states(states);
+    }
+    insert_window_state(states, w);
 }
 
-#define XXCreateFontCursor(wm, a, b) \
-    __XCreateFontCursor__(__FILE__, __LINE__, (wm), (a), (b))
-
-static GC
-__XCreateGC__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, unsigned long valuemask, XGCValues* values)
+static void
+forget_window(WindowManager* wm, Window w)
 {
-    LOG_X(filename, lineno, wm, "XCreateGC(display, d=0x%08x, valuemask, values)", d);
-    return XCreateGC(display, d, valuemask, values);
+    if (wm->shadow.focus == w) {
+        wm->shadow.focus_known = False;
+    }
+    if (wm->shadow.top == w) {
+        wm->shadow.top = None;
+    }
+    WindowState* state = find_window_state(wm, w);
+    if (state == NULL) {
+        return;
+    }
+    /*
+     * Following entries are shifted back into the hole, so that no probe
+     * sequence is broken by the removal.
+     */
+    WindowStates* states = &wm->shadow.windows;
+    WindowState* items = states->items;
+    unsigned int mask = states->capacity - 1;
+    unsigned int i = state - items;
+    unsigned int j = i;
+    while (True) {
+        j = (j + 1) & mask;
+        Window v = items[j].window;
+        if (v == None) {
+            break;
+        }
+        unsigned int k = hash_window(v) & mask;
+        Bool stays = i <= j ? (i < k) && (k <= j) : (i < k) || (k <= j);
+        if (stays) {
+            continue;
+        }
+        items[i] = items[j];
+        i = j;
+    }
+    items[i].window = None;
+    states->size--;
 }
 
-#define XXCreateGC(wm, a, b, c, d) \
-    __XCreateGC__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
-
-#if 0
-static Pixmap
-__XCreatePixmapFromBitmapData__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, char* data, unsigned int width, unsigned int height, unsigned long fg, unsigned long bg, unsigned int depth)
+static void
+forget_focus(WindowManager* wm)
 {
-    LOG_X(filename, lineno, wm, "XCreatePixmapFromBitmapData(display, d=0x%08x, data, width=%u, height=%u, fg, bg, depth=%u)", d, width, height, depth);
-    return XCreatePixmapFromBitmapData(display, d, data, width, height, fg, bg, depth);
+    wm->shadow.focus_known = False;
 }
 
-#define XXCreatePixmapFromBitmapData(wm, a, b, c, d, e, f, g, h) \
-    __XCreatePixmapFromBitmapData__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h))
-#endif
-
-static Window
-__XCreateSimpleWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window parent, int x, int y, unsigned int width, unsigned int height, unsigned int border_width, unsigned long border, unsigned long background)
+static void
+forget_top(WindowManager* wm)
 {
-    LOG_X(filename, lineno, wm, "XCreateSimpleWindow(display, parent=0x%08x, x=%d, y=%d, width=%u, height=%u, border_width=%u, border, background)", parent, x, y, width, height, border_width);
-    return XCreateSimpleWindow(display, parent, x, y, width, height, border_width, border, background);
+    wm->shadow.top = None;
 }
 
-#define XXCreateSimpleWindow(wm, a, b, c, d, e, f, g, h, i) \
-    __XCreateSimpleWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h), (i))
-
 static int
-__XDefineCursor__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Cursor cursor)
+elide_request(const char* filename, int lineno, WindowManager* wm, enum ShadowedRequest request, Window w)
 {
-    LOG_X(filename, lineno, wm, "XDefineCursor(display, w=0x%08x, cursor)", w);
-    return XDefineCursor(display, w, cursor);
+    wm->shadow.requests[request].elided++;
+    const char* name = shadowed_request_names[request];
+    LOG_X(filename, lineno, wm, "%s(display, w=0x%08x) elided", name, w);
+    /* Xlib functions which only send requests always return 1. */
+    return 1;
 }
 
-#define XXDefineCursor(wm, a, b, c) \
-    __XDefineCursor__(__FILE__, __LINE__, (wm), (a), (b), (c))
-
-static int
-__XDrawRectangle__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, GC gc, int x, int y, int width, int height)
+static void
+count_sent_request(WindowManager* wm, enum ShadowedRequest request)
 {
-#define FMT "XDrawRectangle(display, d=0x%08x, gc, x=%d, y=%d, width=%d, height=%d)"
-    LOG_X(filename, lineno, wm, FMT, d, x, y, width, height);
-#undef FMT
-    return XDrawRectangle(display, d, gc, x, y, width, height);
+    wm->shadow.requests[request].sent++;
 }
 
-#define XXDrawRectangle(wm, a, b, c, d, e, f, g) \
-    __XDrawRectangle__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g))
+/*
+ * Wrappers of requests which wait for replies call this. Handlers which do
+ * round trips often are slow.
+ */
+static void
+count_round_trip(WindowManager* wm)
+{
+    wm->event_stats.round_trips++;
+}
 
-static int
-__XDrawLine__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, GC gc, int x1, int y1, int x2, int y2)
+static void
+log_shadow_stats(WindowManager* wm)
 {
-    LOG_X(filename, lineno, wm, "XDrawLine(display, d=0x%08x, gc, x1=%d, y1=%d, x2=%d, y2=%d)", d, x1, y1, x2, y2);
-    return XDrawLine(display, d, gc, x1, y1, x2, y2);
+    int i;
+    for (i = 0; i < SHADOWED_REQUESTS_NUM; i++) {
+        const char* name = shadowed_request_names[i];
+        int sent = wm->shadow.requests[i].sent;
+        int elided = wm->shadow.requests[i].elided;
+        LOG(wm, "shadow: %s: sent=%d, elided=%d", name, sent, elided);
+    }
 }
 
-#define XXDrawLine(wm, a, b, c, d, e, f, g) \
-    __XDrawLine__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g))
+static Bool
+has_shadow_position(WindowState* state, int x, int y)
+{
+    if ((state == NULL) || ((state->known & STATE_POSITION) == 0)) {
+        return False;
+    }
+    return (state->x == x) && (state->y == y);
+}
 
-static int
-__XFillRectangle__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, GC gc, int x, int y, unsigned int width, unsigned int height)
+static Bool
+has_shadow_size(WindowState* state, unsigned int width, unsigned int height)
 {
-    LOG_X(filename, lineno, wm, "XFillRectangle(display, d=0x%08x, gc, x=%d, y=%d, width=%u, height=%u)", d, x, y, width, height);
-    return XFillRectangle(display, d, gc, x, y, width, height);
+    if ((state == NULL) || ((state->known & STATE_SIZE) == 0)) {
+        return False;
+    }
+    return (state->width == width) && (state->height == height);
 }
 
-#define XXFillRectangle(wm, a, b, c, d, e, f, g) \
-    __XFillRectangle__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g))
+static void
+update_shadow_position(WindowState* state, int x, int y)
+{
+    if (state == NULL) {
+        return;
+    }
+    state->known |= STATE_POSITION;
+    state->x = x;
+    state->y = y;
+}
 
-#if 0
-static int
-__XFreePixmap__(const char* filename, int lineno, WindowManager* wm, Display* display, Pixmap pixmap)
+static void
+update_shadow_size(WindowState* state, unsigned int width, unsigned int height)
 {
-    LOG_X0(filename, lineno, wm, "XFreePixmap(display, pixmap)");
-    return XFreePixmap(display, pixmap);
+    if (state == NULL) {
+        return;
+    }
+    /* The server refuses such a size, so the window keeps an unknown one. */
+    if ((width == 0) || (height == 0) || (32767 < width) || (32767 < height)) {
+        state->known &= ~STATE_SIZE;
+        return;
+    }
+    state->known |= STATE_SIZE;
+    state->width = width;
+    state->height = height;
 }
 
-#define XXFreePixmap(wm, a, b) \
-    __XFreePixmap__(__FILE__, __LINE__, (wm), (a), (b))
-#endif
+static Bool
+has_shadow_mapped(WindowState* state, Bool mapped)
+{
+    if ((state == NULL) || ((state->known & STATE_MAPPED) == 0)) {
+        return False;
+    }
+    return state->mapped == mapped;
+}
 
-static int
-__XFree__(const char* filename, int lineno, WindowManager* wm, void* data)
+static void
+update_shadow_mapped(WindowState* state, Bool mapped)
 {
-    LOG_X(filename, lineno, wm, "XFree(data=%p)", data);
-    return XFree(data);
+    if (state == NULL) {
+        return;
+    }
+    state->known |= STATE_MAPPED;
+    state->mapped = mapped;
 }
 
-#define XXFree(wm, data) __XFree__(__FILE__, __LINE__, (wm), (data))
+static Bool
+has_shadow_cursor(WindowState* state, Cursor cursor)
+{
+    if ((state == NULL) || ((state->known & STATE_CURSOR) == 0)) {
+        return False;
+    }
+    return state->cursor == cursor;
+}
 
-static Status
-__XGetGeometry__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, Window* root_return, int* x_return, int* y_return, unsigned int* width_return, unsigned int* height_return, unsigned int* border_width_return, unsigned int* depth_return)
+static void
+update_shadow_cursor(WindowState* state, Cursor cursor)
 {
-    LOG_X(filename, lineno, wm, "XGetGeometry(display, d=0x%08x, root_return, x_return, y_return, width_return, height_return, border_width_return, depth_return)", d);
-    return XGetGeometry(display, d, root_return, x_return, y_return, width_return, height_return, border_width_return, depth_return);
+    if (state == NULL) {
+        return;
+    }
+    state->known |= STATE_CURSOR;
+    state->cursor = cursor;
 }
 
-#define XXGetGeometry(wm, a, b, c, d, e, f, g, h, i) \
-    __XGetGeometry__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h), (i))
+static Bool
+is_configure_redundant(WindowState* state, unsigned int value_mask, XWindowChanges* changes)
+{
+    if (state == NULL) {
+        return False;
+    }
+    if ((value_mask & ~(CWX | CWY | CWWidth | CWHeight)) != 0) {
+        return False;
+    }
+    if (((value_mask & (CWX | CWY)) != 0) && ((state->known & STATE_POSITION) == 0)) {
+        return False;
+    }
+    if (((value_mask & (CWWidth | CWHeight)) != 0) && ((state->known & STATE_SIZE) == 0)) {
+        return False;
+    }
+    if ((value_mask & CWX) && (changes->x != state->x)) {
+        return False;
+    }
+    if ((value_mask & CWY) && (changes->y != state->y)) {
+        return False;
+    }
+    if ((value_mask & CWWidth) && (changes->width != state->width)) {
+        return False;
+    }
+    if ((value_mask & CWHeight) && (changes->height != state->height)) {
+        return False;
+    }
+    return True;
+}
 
-static Status
-__XGetTextProperty__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, XTextProperty* text_prop_return, Atom property)
+static void
+update_shadow_configuration(WindowState* state, unsigned int value_mask, XWindowChanges* changes)
 {
-    LOG_X(filename, lineno, wm, "XGetTextProperty(display, w=0x%08x, text_prop_return, property)", w);
-    return XGetTextProperty(display, w, text_prop_return, property);
+    if (state == NULL) {
+        return;
+    }
+    unsigned int position_mask = value_mask & (CWX | CWY);
+    if ((state->known & STATE_POSITION) || (position_mask == (CWX | CWY))) {
+        int x = value_mask & CWX ? changes->x : state->x;
+        int y = value_mask & CWY ? changes->y : state->y;
+        update_shadow_position(state, x, y);
+    }
+    unsigned int size_mask = value_mask & (CWWidth | CWHeight);
+    if ((state->known & STATE_SIZE) || (size_mask == (CWWidth | CWHeight))) {
+        unsigned int width = value_mask & CWWidth ? changes->width : state->width;
+        unsigned int height = value_mask & CWHeight ? changes->height : state->height;
+        update_shadow_size(state, width, height);
+    }
 }
 
-#define XXGetTextProperty(wm, a, b, c, d) \
-    __XGetTextProperty__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+static void
+reindex_window(WindowManager* wm, WindowState* state)
+{
+    if ((state == NULL) || (state->frame == NULL)) {
+        return;
+    }
+    SpatialIndex* index = &wm->spatial.index;
+    SpatialEntry* entry = &state->frame->spatial;
+    unsigned int known = STATE_MAPPED | STATE_POSITION | STATE_SIZE;
+    if (((state->known & known) != known) || !state->mapped) {
+        spatial_remove(index, entry);
+        return;
+    }
+    int border_size = 2 * wm->border_size;
+    int width = state->width + border_size;
+    int height = state->height + border_size;
+    spatial_update(index, entry, state->x, state->y, width, height);
+}
 
-static Status
-__XGetWindowAttributes__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, XWindowAttributes* window_attributes_return)
+static int
+__XAddToSaveSet__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
 {
-    LOG_X(filename, lineno, wm, "XGetWindowAttributes(display, w=0x%08x, window_attributes_return=%p)", w, window_attributes_return);
-    return XGetWindowAttributes(display, w, window_attributes_return);
+    LOG_X(filename, lineno, wm, "XAddToSaveSet(display, w=0x%08x)", w);
+    return wm->backend->add_to_save_set(display, w);
 }
 
-#define XXGetWindowAttributes(wm, a, b, c) \
-    __XGetWindowAttributes__(__FILE__, __LINE__, (wm), (a), (b), (c))
+#define XXAddToSaveSet(wm, a, b) \
+    __XAddToSaveSet__(__FILE__, __LINE__, (wm), (a), (b))
 
 static Status
-__XGetWMProtocols__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Atom** protocols_return, int* count_return)
+__XAllocNamedColor__(const char* filename, int lineno, WindowManager* wm, Display* display, Colormap colormap, const char* color_name, XColor* color_def_return, XColor* exact_def_return)
 {
-    LOG_X(filename, lineno, wm, "XGetWMProtocols(display, w=0x%08x, protocols_return, count_return)", w);
-    return XGetWMProtocols(display, w, protocols_return, count_return);
+    LOG_X(filename, lineno, wm, "XAllocNamedColor(display, colormap, color_name=\"%s\", color_def_return, exact_def_return)", color_name);
+    count_round_trip(wm);
+    return wm->backend->alloc_named_color(display, colormap, color_name, color_def_return, exact_def_return);
 }
 
-#define XXGetWMProtocols(wm, a, b, c, d) \
-    __XGetWMProtocols__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+#define XXAllocNamedColor(wm, a, b, c, d, e) \
+    __XAllocNamedColor__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
 
 static int
-__XGrabButton__(const char* filename, int lineno, WindowManager* wm, Display* display, unsigned int button, unsigned int modifiers, Window grab_window, Bool owner_events, unsigned int event_mask, int pointer_mode, int keyboard_mode, Window confine_to, Cursor cursor)
+__XAllowEvents__(const char* filename, int lineno, WindowManager* wm, Display* display, int event_mode, Time time)
 {
-    LOG_X(filename, lineno, wm, "XGrabButton(display, button, modifiers, grab_window=0x%08x, owner_events, event_mask, pointer_mode, keyboard_mode, confine_to=0x%08x, cursor)", grab_window, confine_to);
-    return XGrabButton(display, button, modifiers, grab_window, owner_events, event_mask, pointer_mode, keyboard_mode, confine_to, cursor);
+    LOG_X0(filename, lineno, wm, "XAllowEvents(display, event_mode, time)");
+    return wm->backend->allow_events(display, event_mode, time);
 }
 
-#define XXGrabButton(wm, a, b, c, d, e, f, g, h, i, j) \
-    __XGrabButton__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h), (i), (j))
+#define XXAllowEvents(wm, a, b, c) \
+    __XAllowEvents__(__FILE__, __LINE__, (wm), (a), (b), (c))
 
-static Atom
-__XInternAtom__(const char* filename, int lineno, WindowManager* wm, Display* display, const char* name, Bool only_if_exists)
+static int
+__XChangeWindowAttributes__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned long valuemask, XSetWindowAttributes* attributes)
 {
-    LOG_X(filename, lineno, wm, "XInternAtom(display, name=\"%s\", only_if_exists)", name);
-    return XInternAtom(display, name, only_if_exists);
+    LOG_X(filename, lineno, wm, "XChangeWindowAttributes(display, w=0x%08x, valuemask, attributes)", w);
+    return wm->backend->change_window_attributes(display, w, valuemask, attributes);
 }
 
-#define XXInternAtom(wm, a, b, c) \
-    __XInternAtom__(__FILE__, __LINE__, (wm), (a), (b), (c))
+#define XXChangeWindowAttributes(wm, a, b, c, d) \
+    __XChangeWindowAttributes__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
 
-static int
-__XKillClient__(const char* filename, int lineno, WindowManager* wm, Display* display, XID resource)
+static Bool
+__XCheckIfEvent__(const char* filename, int lineno, WindowManager* wm, Display* display, XEvent* event_return, Bool (*predicate)(Display*, XEvent*, XPointer), XPointer arg)
 {
-    LOG_X0(filename, lineno, wm, "XKillClient(display, resource)");
-    return XKillClient(display, resource);
+    LOG_X0(filename, lineno, wm, "XCheckIfEvent(display, event_return, predicate, arg)");
+    return wm->backend->check_if_event(display, event_return, predicate, arg);
 }
 
-#define XXKillClient(wm, a, b) \
-    __XKillClient__(__FILE__, __LINE__, (wm), (a), (b))
+#define XXCheckIfEvent(wm, a, b, c, d) \
+    __XCheckIfEvent__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
 
 static int
-__XMapRaised__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
+__XClearArea__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, int x, int y, unsigned width, unsigned height, Bool exposures)
 {
-    LOG_X(filename, lineno, wm, "XMapRaised(display, w=0x%08x)", w);
-    return XMapRaised(display, w);
+    LOG_X(filename, lineno, wm, "XClearArea(display, w=0x%08x, x=%d, y=%d, width=%u, height=%u, exposures)", w, x, y, width, height);
+    return wm->backend->clear_area(display, w, x, y, width, height, exposures);
 }
 
-#define XXMapRaised(wm, a, b) __XMapRaised__(__FILE__, __LINE__, (wm), (a), (b))
+#define XXClearArea(wm, a, b, c, d, e, f, g) \
+    __XClearArea__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g))
 
 static int
-__XMapWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
+__XConfigureWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned value_mask, XWindowChanges* changes)
 {
-    LOG_X(filename, lineno, wm, "XMapWindow(display, w=0x%08x)", w);
-    return XMapWindow(display, w);
+    WindowState* state = find_window_state(wm, w);
+    if (is_configure_redundant(state, value_mask, changes)) {
+        return elide_request(filename, lineno, wm, SR_CONFIGURE_WINDOW, w);
+    }
+    LOG_X(filename, lineno, wm, "XConfigureWindow(display, w=0x%08x, value_mask, changes)", w);
+    count_sent_request(wm, SR_CONFIGURE_WINDOW);
+    update_shadow_configuration(state, value_mask, changes);
+    reindex_window(wm, state);
+    if (value_mask & CWStackMode) {
+        forget_top(wm);
+    }
+    return wm->backend->configure_window(display, w, value_mask, changes);
 }
 
-#define XXMapWindow(wm, a, b) __XMapWindow__(__FILE__, __LINE__, (wm), (a), (b))
+#define XXConfigureWindow(wm, a, b, c, d) \
+    __XConfigureWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
 
+#if 0
 static int
-__XMoveResizeWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, int x, int y, unsigned width, unsigned height)
+__XCopyArea__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable src, Drawable dest, GC gc, int src_x, int src_y, unsigned int width, unsigned int height, int dest_x, int dest_y)
 {
-    LOG_X(filename, lineno, wm, "XMoveResizeWindow(display, w=0x%08x, x=%d, y=%d, width=%u, height=%u)", w, x, y, width, height);
-    return XMoveResizeWindow(display, w, x, y, width, height);
+    LOG_X(filename, lineno, wm, "XCopyArea(display, src=0x%08x, dest=0x%08x, gc, src_x=%d, src_y=%d, width=%d, height=%d, dest_x=%d, dest_y=%d)", src, dest, src_x, src_y, width, height, dest_x, dest_y);
+    return wm->backend->copy_area(display, src, dest, gc, src_x, src_y, width, height, dest_x, dest_y);
 }
 
-#define XXMoveResizeWindow(wm, a, b, c, d, e, f) \
-    __XMoveResizeWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f))
+#define XXCopyArea(wm, a, b, c, d, e, f, g, h, i, j) \
+    __XCopyArea__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h), (i), (j))
+#endif
 
-static int
-__XMoveWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, int x, int y)
+static Cursor
+__XCreateFontCursor__(const char* filename, int lineno, WindowManager* wm, Display* display, unsigned int shape)
 {
-    LOG_X(filename, lineno, wm, "XMoveWindow(display, w=0x%08x, x=%d, y=%d)", w, x, y);
-    return XMoveWindow(display, w, x, y);
+    LOG_X(filename, lineno, wm, "XCreateFontCursor(display, shape=%d)", shape);
+    return wm->backend->create_font_cursor(display, shape);
 }
 
-#define XXMoveWindow(wm, a, b, c, d) \
-    __XMoveWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+#define XXCreateFontCursor(wm, a, b) \
+    __XCreateFontCursor__(__FILE__, __LINE__, (wm), (a), (b))
 
-static Status
-__XQueryTree__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Window* root_return, Window* parent_return, Window** children_return, unsigned int* nchildren_return)
+static Cursor
+get_cursor(WindowManager* wm, Cursor* cursor, unsigned int shape)
 {
-    LOG_X(filename, lineno, wm, "XQueryTree(display, w=0x%08x, root_return, parent_return, children_return, nchildren_return)", w);
-    return XQueryTree(display, w, root_return, parent_return, children_return, nchildren_return);
+    if (*cursor == None) {
+        *cursor = XXCreateFontCursor(wm, wm->display, shape);
+    }
+    return *cursor;
 }
 
-#define XXQueryTree(wm, a, b, c, d, e, f) \
-    __XQueryTree__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f))
+static GC
+__XCreateGC__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, unsigned long valuemask, XGCValues* values)
+{
+    LOG_X(filename, lineno, wm, "XCreateGC(display, d=0x%08x, valuemask, values)", d);
+    wm->resources.gcs++;
+    return wm->backend->create_gc(display, d, valuemask, values);
+}
 
-static int
-__XRaiseWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
+#define XXCreateGC(wm, a, b, c, d) \
+    __XCreateGC__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+
+#if 0
+static Pixmap
+__XCreatePixmapFromBitmapData__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, char* data, unsigned int width, unsigned int height, unsigned long fg, unsigned long bg, unsigned int depth)
 {
-    LOG_X(filename, lineno, wm, "XRaiseWindow(display, w=0x%08x)", w);
-    return XRaiseWindow(display, w);
+    LOG_X(filename, lineno, wm, "XCreatePixmapFromBitmapData(display, d=0x%08x, data, width=%u, height=%u, fg, bg, depth=%u)", d, width, height, depth);
+    return wm->backend->create_pixmap_from_bitmap_data(display, d, data, width, height, fg, bg, depth);
 }
 
-#define XXRaiseWindow(wm, a, b) \
-    __XRaiseWindow__(__FILE__, __LINE__, (wm), (a), (b))
+#define XXCreatePixmapFromBitmapData(wm, a, b, c, d, e, f, g, h) \
+    __XCreatePixmapFromBitmapData__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h))
+#endif
 
-static int
-__XReparentWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Window parent,  int x, int y)
+static Pixmap
+__XCreatePixmap__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, unsigned int width, unsigned int height, unsigned int depth)
 {
-    LOG_X(filename, lineno, wm, "XReparentWindow(display, w=0x%08x, parent=0x%08x, x=%d, y=%d)", w, parent, x, y);
-    return XReparentWindow(display, w, parent, x, y);
+    LOG_X(filename, lineno, wm, "XCreatePixmap(display, d=0x%08x, width=%u, height=%u, depth=%u)", d, width, height, depth);
+    wm->resources.pixmaps++;
+    return wm->backend->create_pixmap(display, d, width, height, depth);
 }
 
-#define XXReparentWindow(wm, a, b, c, d, e) \
-    __XReparentWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
+#define XXCreatePixmap(wm, a, b, c, d, e) \
+    __XCreatePixmap__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
 
-static int
-__XResizeWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned width, unsigned height)
+/* A replay pairs windows which fawm creates with recorded ones. */
+static void
+register_created_window(WindowManager* wm, Window w)
 {
-    LOG_X(filename, lineno, wm, "XResizeWindow(display, w=0x%08x, width=%u, height=%u)", w, width, height);
-    return XResizeWindow(display, w, width, height);
+    if (wm->recording != NULL) {
+        recording_write_window(wm->recording, w);
+    }
+#if defined(FAWM_FAKE)
+    if (wm->replay.replay != NULL) {
+        replay_bind_window(wm->replay.replay, w);
+    }
+#endif
 }
 
-#define XXResizeWindow(wm, a, b, c, d) \
-    __XResizeWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+static Window
+__XCreateSimpleWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window parent, int x, int y, unsigned int width, unsigned int height, unsigned int border_width, unsigned long border, unsigned long background)
+{
+    LOG_X(filename, lineno, wm, "XCreateSimpleWindow(display, parent=0x%08x, x=%d, y=%d, width=%u, height=%u, border_width=%u, border, background)", parent, x, y, width, height, border_width);
+    /* A new window is placed on the top of its siblings. */
+    forget_top(wm);
+    Window w = wm->backend->create_simple_window(display, parent, x, y, width, height, border_width, border, background);
+    register_created_window(wm, w);
+    return w;
+}
 
-static Status
-__XSendEvent__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Bool propagate, long event_mask, XEvent* event_send)
+#define XXCreateSimpleWindow(wm, a, b, c, d, e, f, g, h, i) \
+    __XCreateSimpleWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h), (i))
+
+static Window
+__XCreateWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window parent, int x, int y, unsigned int width, unsigned int height, unsigned int border_width, int depth, unsigned int class, Visual* visual, unsigned long valuemask, XSetWindowAttributes* attributes)
 {
-    LOG_X(filename, lineno, wm, "XSendEvent(display, w=0x%08x, propagate, event_mask, event_send)", w);
-    return XSendEvent(display, w, propagate, event_mask, event_send);
+    LOG_X(filename, lineno, wm, "XCreateWindow(display, parent=0x%08x, x=%d, y=%d, width=%u, height=%u, border_width=%u, depth=%d, class=%u, visual, valuemask, attributes)", parent, x, y, width, height, border_width, depth, class);
+    forget_top(wm);
+    Window w = wm->backend->create_window(display, parent, x, y, width, height, border_width, depth, class, visual, valuemask, attributes);
+    register_created_window(wm, w);
+    return w;
 }
 
-#define XXSendEvent(wm, a, b, c, d, e) \
-    __XSendEvent__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
+#define XXCreateWindow(wm, a, b, c, d, e, f, g, h, i, j, k, l) \
+    __XCreateWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h), (i), (j), (k), (l))
 
 static int
-__XSetInputFocus__(const char* filename, int lineno, WindowManager* wm, Display* display, Window focus, int revert_to, Time time)
+__XDefineCursor__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Cursor cursor)
 {
-    LOG_X(filename, lineno, wm, "XSetInputFocus(display, focus=0x%08x, revert_to, time)", focus);
-    return XSetInputFocus(display, focus, revert_to, time);
+    WindowState* state = find_window_state(wm, w);
+    if (has_shadow_cursor(state, cursor)) {
+        return elide_request(filename, lineno, wm, SR_DEFINE_CURSOR, w);
+    }
+    LOG_X(filename, lineno, wm, "XDefineCursor(display, w=0x%08x, cursor)", w);
+    count_sent_request(wm, SR_DEFINE_CURSOR);
+    update_shadow_cursor(state, cursor);
+    return wm->backend->define_cursor(display, w, cursor);
 }
 
-#define XXSetInputFocus(wm, a, b, c, d) \
-    __XSetInputFocus__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+#define XXDefineCursor(wm, a, b, c) \
+    __XDefineCursor__(__FILE__, __LINE__, (wm), (a), (b), (c))
 
 static int
-__XSetWindowBackground__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned long background_pixel)
+__XDrawRectangles__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, GC gc, XRectangle* rectangles, int nrectangles)
 {
-    LOG_X(filename, lineno, wm, "XSetWindowBackground(display, w=0x%08x, background_pixel)", w);
-    return XSetWindowBackground(display, w, background_pixel);
+    LOG_X(filename, lineno, wm, "XDrawRectangles(display, d=0x%08x, gc, rectangles, nrectangles=%d)", d, nrectangles);
+    return wm->backend->draw_rectangles(display, d, gc, rectangles, nrectangles);
 }
 
-#define XXSetWindowBackground(wm, a, b, c) \
-    __XSetWindowBackground__(__FILE__, __LINE__, (wm), (a), (b), (c))
+#define XXDrawRectangles(wm, a, b, c, d, e) \
+    __XDrawRectangles__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
 
 static int
-__XSetWindowBorderWidth__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned width)
+__XDrawSegments__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, GC gc, XSegment* segments, int nsegments)
 {
-    LOG_X(filename, lineno, wm, "XSetWindowBorderWidth(display, w=0x%08x, width=%u)", w, width);
-    return XSetWindowBorderWidth(display, w, width);
+    LOG_X(filename, lineno, wm, "XDrawSegments(display, d=0x%08x, gc, segments, nsegments=%d)", d, nsegments);
+    return wm->backend->draw_segments(display, d, gc, segments, nsegments);
 }
 
-#define XXSetWindowBorderWidth(wm, a, b, c) \
-    __XSetWindowBorderWidth__(__FILE__, __LINE__, (wm), (a), (b), (c))
+#define XXDrawSegments(wm, a, b, c, d, e) \
+    __XDrawSegments__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
 
-static Status
-__XTextPropertyToStringList__(const char* filename, int lineno, WindowManager* wm, XTextProperty* text_prop, char*** list_return, int* count_return)
+static int
+__XFillRectangle__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, GC gc, int x, int y, unsigned int width, unsigned int height)
 {
-    LOG_X0(filename, lineno, wm, "XTextPropertyToStringList(text_prop, list_return, count_return)");
-    return XTextPropertyToStringList(text_prop, list_return, count_return);
+    LOG_X(filename, lineno, wm, "XFillRectangle(display, d=0x%08x, gc, x=%d, y=%d, width=%u, height=%u)", d, x, y, width, height);
+    return wm->backend->fill_rectangle(display, d, gc, x, y, width, height);
 }
 
-#define XXTextPropertyToStringList(wm, a, b, c) \
-    __XTextPropertyToStringList__(__FILE__, __LINE__, (wm), (a), (b), (c))
+#define XXFillRectangle(wm, a, b, c, d, e, f, g) \
+    __XFillRectangle__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g))
 
 static int
-__XUnmapWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
+__XFillRectangles__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, GC gc, XRectangle* rectangles, int nrectangles)
 {
-    LOG_X(filename, lineno, wm, "XUnmapWindow(display, w=0x%08x)", w);
-    return XUnmapWindow(display, w);
+    LOG_X(filename, lineno, wm, "XFillRectangles(display, d=0x%08x, gc, rectangles, nrectangles=%d)", d, nrectangles);
+    return wm->backend->fill_rectangles(display, d, gc, rectangles, nrectangles);
 }
 
-#define XXUnmapWindow(wm, a, b) \
-    __XUnmapWindow__(__FILE__, __LINE__, (wm), (a), (b))
+#define XXFillRectangles(wm, a, b, c, d, e) \
+    __XFillRectangles__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
 
-static Bool
-__XftColorAllocName__(const char* filename, int lineno, WindowManager* wm, Display* display, Visual* visual, Colormap colormap, char* name, XftColor* result)
+static int
+__XFreeCursor__(const char* filename, int lineno, WindowManager* wm, Display* display, Cursor cursor)
 {
-    LOG_X(filename, lineno, wm, "XftColorAllocName(display, visual, colormap, name=\"%s\", result)", name);
-    return XftColorAllocName(display, visual, colormap, name, result);
+    LOG_X0(filename, lineno, wm, "XFreeCursor(display, cursor)");
+    return wm->backend->free_cursor(display, cursor);
 }
 
-#define XXftColorAllocName(wm, a, b, c, d, e) \
-    __XftColorAllocName__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
+#define XXFreeCursor(wm, a, b) \
+    __XFreeCursor__(__FILE__, __LINE__, (wm), (a), (b))
 
-static XftDraw*
-__XftDrawCreate__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, Visual* visual, Colormap colormap)
+static int
+__XFreePixmap__(const char* filename, int lineno, WindowManager* wm, Display* display, Pixmap pixmap)
 {
-    LOG_X(filename, lineno, wm, "XftDrawCreate(display, d=0x%08x, visual, colormap)", d);
-    return XftDrawCreate(display, d, visual, colormap);
+    LOG_X0(filename, lineno, wm, "XFreePixmap(display, pixmap)");
+    wm->resources.pixmaps--;
+    return wm->backend->free_pixmap(display, pixmap);
 }
 
-#define XXftDrawCreate(wm, a, b, c, d) \
-    __XftDrawCreate__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+#define XXFreePixmap(wm, a, b) \
+    __XFreePixmap__(__FILE__, __LINE__, (wm), (a), (b))
 
-static void
-__XftDrawDestroy__(const char* filename, int lineno, WindowManager* wm, XftDraw* draw)
+static int
+__XFree__(const char* filename, int lineno, WindowManager* wm, void* data)
 {
-    LOG_X0(filename, lineno, wm, "XftDrawDestroy(draw)");
-    return XftDrawDestroy(draw);
+    LOG_X(filename, lineno, wm, "XFree(data=%p)", data);
+    return XFree(data);
 }
 
-#define XXftDrawDestroy(wm, a) __XftDrawDestroy__(__FILE__, __LINE__, (wm), (a))
+#define XXFree(wm, data) __XFree__(__FILE__, __LINE__, (wm), (data))
 
-static void
-__XftDrawStringUtf8__(const char* filename, int lineno, WindowManager* wm, XftDraw* draw, XftColor* color, XftFont* pub, int x, int y, FcChar8* string, int len)
+static Status
+__XGetGeometry__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, Window* root_return, int* x_return, int* y_return, unsigned int* width_return, unsigned int* height_return, unsigned int* border_width_return, unsigned int* depth_return)
 {
-    LOG_X(filename, lineno, wm, "XftDrawStringUtf8(draw, color, pub, x=%d, y=%d, string, len=%d)", x, y, len);
-    return XftDrawStringUtf8(draw, color, pub, x, y, string, len);
+    LOG_X(filename, lineno, wm, "XGetGeometry(display, d=0x%08x, root_return, x_return, y_return, width_return, height_return, border_width_return, depth_return)", d);
+    count_round_trip(wm);
+    count_sent_request(wm, SR_GET_GEOMETRY);
+    Status status = wm->backend->get_geometry(display, d, root_return, x_return, y_return, width_return, height_return, border_width_return, depth_return);
+    if (status != 0) {
+        WindowState* state = find_window_state(wm, d);
+        update_shadow_position(state, *x_return, *y_return);
+        update_shadow_size(state, *width_return, *height_return);
+    }
+    return status;
 }
 
-#define XXftDrawStringUtf8(wm, a, b, c, d, e, f, g) \
-    __XftDrawStringUtf8__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g))
+#define XXGetGeometry(wm, a, b, c, d, e, f, g, h, i) \
+    __XGetGeometry__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h), (i))
 
-static void
-__XftTextExtentsUtf8__(const char* filename, int lineno, WindowManager* wm, Display* display, XftFont* font, XftChar8* string, int len, XGlyphInfo* extents)
+static Status
+__XGetTextProperty__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, XTextProperty* text_prop_return, Atom property)
 {
-    LOG_X(filename, lineno, wm, "XftTextExtentsUtf8(display=0x%08x, font=0x%08x, string=\"%s\", len=%d, extents=%p)", display, font, string, len, extents);
-    XftTextExtentsUtf8(display, font, string, len, extents);
+    LOG_X(filename, lineno, wm, "XGetTextProperty(display, w=0x%08x, text_prop_return, property)", w);
+    count_round_trip(wm);
+    return wm->backend->get_text_property(display, w, text_prop_return, property);
 }
 
-#define XXftTextExtentsUtf8(wm, a, b, c, d, e) \
-    __XftTextExtentsUtf8__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
+#define XXGetTextProperty(wm, a, b, c, d) \
+    __XGetTextProperty__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
 
-static XftFont*
-__XftFontOpenName__(const char* filename, int lineno, WindowManager* wm, Display* display, int screen, const char* name)
+static Status
+__XGetWindowAttributes__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, XWindowAttributes* window_attributes_return)
 {
-    LOG_X(filename, lineno, wm, "XftFontOpenName(display, screen, name=\"%s\")", name);
-    return XftFontOpenName(display, screen, name);
+    LOG_X(filename, lineno, wm, "XGetWindowAttributes(display, w=0x%08x, window_attributes_return=%p)", w, window_attributes_return);
+    count_round_trip(wm);
+    Status status = wm->backend->get_window_attributes(display, w, window_attributes_return);
+    if (status != 0) {
+        WindowState* state = find_window_state(wm, w);
+        XWindowAttributes* wa = window_attributes_return;
+        update_shadow_position(state, wa->x, wa->y);
+        update_shadow_size(state, wa->width, wa->height);
+        update_shadow_mapped(state, wa->map_state != IsUnmapped);
+    }
+    return status;
 }
 
-#define XXftFontOpenName(wm, a, b, c) \
-    __XftFontOpenName__(__FILE__, __LINE__, (wm), (a), (b), (c))
+#define XXGetWindowAttributes(wm, a, b, c) \
+    __XGetWindowAttributes__(__FILE__, __LINE__, (wm), (a), (b), (c))
 
-static void
-draw_box(WindowManager* wm, Frame* frame, int width, int height, int n, int status)
+static Status
+__XGetWMProtocols__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Atom** protocols_return, int* count_return)
 {
-    Display* display = wm->display;
-    Window w = frame->window;
-
-    int size = wm->title_height;
-    int frame_size = wm->frame_size;
-    int x = width - frame_size - n * size;
-    int y = frame_size;
-    GC unfocused_gc = frame->unfocused_gc;
-    GC fill_gc = frame->status == status ? frame->focused_gc : unfocused_gc;
-    XXFillRectangle(wm, display, w, fill_gc, x, y, size, size);
-    XXDrawRectangle(wm, display, w, frame->line_gc, x, y, size, size);
+    LOG_X(filename, lineno, wm, "XGetWMProtocols(display, w=0x%08x, protocols_return, count_return)", w);
+    count_round_trip(wm);
+    return wm->backend->get_wm_protocols(display, w, protocols_return, count_return);
 }
 
-static void
-draw_boxes(WindowManager* wm, Frame* frame, int width, int height)
+#define XXGetWMProtocols(wm, a, b, c, d) \
+    __XGetWMProtocols__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+
+static int
+__XGrabButton__(const char* filename, int lineno, WindowManager* wm, Display* display, unsigned int button, unsigned int modifiers, Window grab_window, Bool owner_events, unsigned int event_mask, int pointer_mode, int keyboard_mode, Window confine_to, Cursor cursor)
 {
-    draw_box(wm, frame, width, height, 1, FOCUS_CLOSE);
-    draw_box(wm, frame, width, height, 2, FOCUS_MAXIMIZE);
-    draw_box(wm, frame, width, height, 3, FOCUS_MINIMIZE);
+    LOG_X(filename, lineno, wm, "XGrabButton(display, button, modifiers, grab_window=0x%08x, owner_events, event_mask, pointer_mode, keyboard_mode, confine_to=0x%08x, cursor)", grab_window, confine_to);
+    return wm->backend->grab_button(display, button, modifiers, grab_window, owner_events, event_mask, pointer_mode, keyboard_mode, confine_to, cursor);
 }
 
+#define XXGrabButton(wm, a, b, c, d, e, f, g, h, i, j) \
+    __XGrabButton__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g), (h), (i), (j))
+
 static Atom
-intern(WindowManager* wm, const char* name)
+__XInternAtom__(const char* filename, int lineno, WindowManager* wm, Display* display, const char* name, Bool only_if_exists)
 {
-    return XXInternAtom(wm, wm->display, name, False);
+    LOG_X(filename, lineno, wm, "XInternAtom(display, name=\"%s\", only_if_exists)", name);
+    count_round_trip(wm);
+    return wm->backend->intern_atom(display, name, only_if_exists);
 }
 
-static void
-__XFreeStringList__(const char* filename, int lineno, WindowManager* wm, char** list)
+#define XXInternAtom(wm, a, b, c) \
+    __XInternAtom__(__FILE__, __LINE__, (wm), (a), (b), (c))
+
+static int
+__XKillClient__(const char* filename, int lineno, WindowManager* wm, Display* display, XID resource)
 {
-    LOG_X(filename, lineno, wm, "XFreeStringList(list=%p)", list);
-    XFreeStringList(list);
+    LOG_X0(filename, lineno, wm, "XKillClient(display, resource)");
+    return wm->backend->kill_client(display, resource);
 }
 
-#define XXFreeStringList(wm, a) \
-    __XFreeStringList__(__FILE__, __LINE__, (wm), (a))
+#define XXKillClient(wm, a, b) \
+    __XKillClient__(__FILE__, __LINE__, (wm), (a), (b))
 
-static void
-get_window_name(WindowManager* wm, char* dest, int size, Window w)
+static int
+__XMapRaised__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
 {
-    XTextProperty prop;
-    dest[0] = '\0';
-    if (XXGetTextProperty(wm, wm->display, w, &prop, XA_WM_NAME) == 0) {
-        return;
-    }
-    Atom encoding = prop.encoding;
-    Atom compound_text_atom = intern(wm, "XA_COMPOUND_TEXT");
-    /* FIXME: What is XA_COMPOUND_TEXT? */
-    if ((encoding != XA_STRING) && (encoding != compound_text_atom)) {
-        return;
+    WindowState* state = find_window_state(wm, w);
+    if (has_shadow_mapped(state, True) && (wm->shadow.top == w)) {
+        return elide_request(filename, lineno, wm, SR_MAP_RAISED, w);
     }
-
-    char** strings;
-    int _;
-    if (XXTextPropertyToStringList(wm, &prop, &strings, &_) == 0) {
-        return;
-    }
-    if (strings == NULL) {
-        return;
-    }
-    snprintf(dest, size, "%s", strings[0]);
-    XXFreeStringList(wm, strings);
+    LOG_X(filename, lineno, wm, "XMapRaised(display, w=0x%08x)", w);
+    count_sent_request(wm, SR_MAP_RAISED);
+    update_shadow_mapped(state, True);
+    reindex_window(wm, state);
+    wm->shadow.top = w;
+    return wm->backend->map_raised(display, w);
 }
 
-static void
-draw_title_font_string(WindowManager* wm, XftDraw* draw, int x, int y, const char* text)
-{
-    XftColor* color = &wm->title_color;
-    XftFont* font = wm->title_font;
-    int len = strlen(text);
-    XXftDrawStringUtf8(wm, draw, color, font, x, y, (XftChar8*)text, len);
-}
+#define XXMapRaised(wm, a, b) __XMapRaised__(__FILE__, __LINE__, (wm), (a), (b))
 
-static void
-draw_title_text(WindowManager* wm, Frame* frame)
+static int
+__XMapWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
 {
-    int frame_size = wm->frame_size;
-    int x = frame_size;
-    int y = frame_size + wm->title_font->ascent;
-    draw_title_font_string(wm, frame->draw, x, y, frame->title);
+    WindowState* state = find_window_state(wm, w);
+    if (has_shadow_mapped(state, True)) {
+        return elide_request(filename, lineno, wm, SR_MAP_WINDOW, w);
+    }
+    LOG_X(filename, lineno, wm, "XMapWindow(display, w=0x%08x)", w);
+    count_sent_request(wm, SR_MAP_WINDOW);
+    update_shadow_mapped(state, True);
+    reindex_window(wm, state);
+    return wm->backend->map_window(display, w);
 }
 
-static void
-get_geometry(WindowManager* wm, Window w, unsigned int* width, unsigned int* height)
+#define XXMapWindow(wm, a, b) __XMapWindow__(__FILE__, __LINE__, (wm), (a), (b))
+
+static int
+__XMapSubwindows__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
 {
-    Window _;
-    int __;
-    unsigned int ___;
-    XXGetGeometry(wm, wm->display, w, &_, &__, &__, width, height, &___, &___);
+    LOG_X(filename, lineno, wm, "XMapSubwindows(display, w=0x%08x)", w);
+    return wm->backend->map_subwindows(display, w);
 }
 
-static void
-draw_corner(WindowManager* wm, Window w, int width, int height)
+#define XXMapSubwindows(wm, a, b) \
+    __XMapSubwindows__(__FILE__, __LINE__, (wm), (a), (b))
+
+static int
+__XMoveResizeWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, int x, int y, unsigned width, unsigned height)
 {
-    Display* display = wm->display;
-    GC gc = DefaultGC(display, DefaultScreen(display));
-    int frame_size = wm->frame_size;
-    int corner_size = wm->resizable_corner_size;
-#define DRAW_LINE(x1, y1, x2, y2) \
-    XXDrawLine(wm, display, w, gc, (x1), (y1), (x2), (y2))
-#define DRAW_HORIZONTAL_LINE(x1, y1, x2) DRAW_LINE((x1), (y1), (x2), (y1))
-#define DRAW_VIRTICAL_LINE(x1, y1, y2) DRAW_LINE((x1), (y1), (x1), (y2))
-    DRAW_HORIZONTAL_LINE(0, corner_size, frame_size);
-    DRAW_VIRTICAL_LINE(corner_size, 0, frame_size);
-    int east_x1 = width - corner_size;
-    DRAW_VIRTICAL_LINE(east_x1, 0, frame_size);
-    int east_x2 = width - frame_size;
-    DRAW_HORIZONTAL_LINE(east_x2, corner_size, width);
-    int south_y1 = height - corner_size;
-    DRAW_HORIZONTAL_LINE(east_x2, south_y1, width);
-    int south_y2 = height - frame_size;
-    DRAW_VIRTICAL_LINE(east_x1, south_y2, height);
-    DRAW_VIRTICAL_LINE(corner_size, south_y2, height);
-    DRAW_HORIZONTAL_LINE(0, south_y1, frame_size);
-#undef DRAW_VIRTICAL_LINE
-#undef DRAW_HORIZONTAL_LINE
-#undef DRAW_LINE
+    WindowState* state = find_window_state(wm, w);
+    if (has_shadow_position(state, x, y) && has_shadow_size(state, width, height)) {
+        return elide_request(filename, lineno, wm, SR_MOVE_RESIZE_WINDOW, w);
+    }
+    LOG_X(filename, lineno, wm, "XMoveResizeWindow(display, w=0x%08x, x=%d, y=%d, width=%u, height=%u)", w, x, y, width, height);
+    count_sent_request(wm, SR_MOVE_RESIZE_WINDOW);
+    update_shadow_position(state, x, y);
+    update_shadow_size(state, width, height);
+    reindex_window(wm, state);
+    return wm->backend->move_resize_window(display, w, x, y, width, height);
 }
 
-static void
-draw_frame(WindowManager* wm, Window w)
+#define XXMoveResizeWindow(wm, a, b, c, d, e, f) \
+    __XMoveResizeWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f))
+
+static int
+__XMoveWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, int x, int y)
 {
-    Frame* frame = search_frame(wm, w);
-    if (frame == NULL) {
-        return;
+    WindowState* state = find_window_state(wm, w);
+    if (has_shadow_position(state, x, y)) {
+        return elide_request(filename, lineno, wm, SR_MOVE_WINDOW, w);
     }
-    unsigned int width;
-    unsigned int height;
-    get_geometry(wm, frame->window, &width, &height);
-
-    draw_title_text(wm, frame);
-    draw_boxes(wm, frame, width, height);
-    draw_corner(wm, w, width, height);
+    LOG_X(filename, lineno, wm, "XMoveWindow(display, w=0x%08x, x=%d, y=%d)", w, x, y);
+    count_sent_request(wm, SR_MOVE_WINDOW);
+    update_shadow_position(state, x, y);
+    reindex_window(wm, state);
+    return wm->backend->move_window(display, w, x, y);
 }
 
-static void
-change_frame_event_mask(WindowManager* wm, Window w)
+#define XXMoveWindow(wm, a, b, c, d) \
+    __XMoveWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+
+static Status
+__XQueryTree__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Window* root_return, Window* parent_return, Window** children_return, unsigned int* nchildren_return)
 {
-    XSetWindowAttributes swa;
-    swa.event_mask = 0
-        | ButtonPressMask
-        | ButtonReleaseMask
-        | ExposureMask
-        | FocusChangeMask
-        | LeaveWindowMask
-        | PointerMotionMask
-        | PropertyChangeMask
-        | SubstructureNotifyMask
-        | SubstructureRedirectMask;
-    XXChangeWindowAttributes(wm, wm->display, w, CWEventMask, &swa);
+    LOG_X(filename, lineno, wm, "XQueryTree(display, w=0x%08x, root_return, parent_return, children_return, nchildren_return)", w);
+    count_round_trip(wm);
+    return wm->backend->query_tree(display, w, root_return, parent_return, children_return, nchildren_return);
 }
 
-static void*
-alloc_memory(size_t size)
+#define XXQueryTree(wm, a, b, c, d, e, f) \
+    __XQueryTree__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f))
+
+#if defined(FAWM_HAVE_XRANDR)
+static XRRScreenResources*
+__XRRGetScreenResourcesCurrent__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
 {
-    void* p = malloc(size);
-    if (p == NULL) {
-        print_error("malloc failed.");
-        abort();
-    }
-    memset(p, 0xfb, size);
-    return p;
+    LOG_X(filename, lineno, wm, "XRRGetScreenResourcesCurrent(display, w=0x%08x)", w);
+    count_round_trip(wm);
+    return wm->backend->rr_get_screen_resources_current(display, w);
 }
 
-static Frame*
-alloc_frame()
+#define XXRRGetScreenResourcesCurrent(wm, a, b) \
+    __XRRGetScreenResourcesCurrent__(__FILE__, __LINE__, (wm), (a), (b))
+
+static XRRCrtcInfo*
+__XRRGetCrtcInfo__(const char* filename, int lineno, WindowManager* wm, Display* display, XRRScreenResources* resources, RRCrtc crtc)
 {
-    return (Frame*)alloc_memory(sizeof(Frame));
+    LOG_X(filename, lineno, wm, "XRRGetCrtcInfo(display, resources, crtc=0x%08x)", crtc);
+    count_round_trip(wm);
+    return wm->backend->rr_get_crtc_info(display, resources, crtc);
 }
 
+#define XXRRGetCrtcInfo(wm, a, b, c) \
+    __XRRGetCrtcInfo__(__FILE__, __LINE__, (wm), (a), (b), (c))
+
 static void
-insert_frame(WindowManager* wm, Frame* frame)
+__XRRSelectInput__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, int mask)
 {
-    append_to_array(&wm->all_frames, frame);
-    prepend_to_array(&wm->frames_z_order, frame);
+    LOG_X(filename, lineno, wm, "XRRSelectInput(display, w=0x%08x, mask)", w);
+    wm->backend->rr_select_input(display, w, mask);
 }
 
+#define XXRRSelectInput(wm, a, b, c) \
+    __XRRSelectInput__(__FILE__, __LINE__, (wm), (a), (b), (c))
+#endif
+
 static int
-compute_frame_width(WindowManager* wm)
+__XRaiseWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
 {
-    /**
-     * Name of this function is "compute_frame_width", but this returns value
-     * including client borders size.
-     */
-    return 2 * (wm->frame_size + wm->client_border_size);
+    if (wm->shadow.top == w) {
+        return elide_request(filename, lineno, wm, SR_RAISE_WINDOW, w);
+    }
+    LOG_X(filename, lineno, wm, "XRaiseWindow(display, w=0x%08x)", w);
+    count_sent_request(wm, SR_RAISE_WINDOW);
+    wm->shadow.top = w;
+    return wm->backend->raise_window(display, w);
 }
 
+#define XXRaiseWindow(wm, a, b) \
+    __XRaiseWindow__(__FILE__, __LINE__, (wm), (a), (b))
+
 static int
-compute_frame_height(WindowManager* wm)
+__XReparentWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Window parent,  int x, int y)
 {
-    /**
-     * Name of this function is "compute_frame_height", but this returns value
-     * including client borders size.
-     */
-    return wm->title_height + 3 * wm->frame_size + 2 * wm->client_border_size;
+    LOG_X(filename, lineno, wm, "XReparentWindow(display, w=0x%08x, parent=0x%08x, x=%d, y=%d)", w, parent, x, y);
+    WindowState* state = find_window_state(wm, w);
+    update_shadow_position(state, x, y);
+    reindex_window(wm, state);
+    forget_top(wm);
+    return wm->backend->reparent_window(display, w, parent, x, y);
 }
 
-static XftDraw*
-create_draw(WindowManager* wm, Window w)
+#define XXReparentWindow(wm, a, b, c, d, e) \
+    __XReparentWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
+
+static int
+__XResizeWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned width, unsigned height)
 {
-    Display* display = wm->display;
-    int screen = DefaultScreen(display);
-    Visual* visual = DefaultVisual(display, screen);
-    Colormap colormap = DefaultColormap(display, screen);
-    return XXftDrawCreate(wm, display, w, visual, colormap);
+    WindowState* state = find_window_state(wm, w);
+    if (has_shadow_size(state, width, height)) {
+        return elide_request(filename, lineno, wm, SR_RESIZE_WINDOW, w);
+    }
+    LOG_X(filename, lineno, wm, "XResizeWindow(display, w=0x%08x, width=%u, height=%u)", w, width, height);
+    count_sent_request(wm, SR_RESIZE_WINDOW);
+    update_shadow_size(state, width, height);
+    reindex_window(wm, state);
+    return wm->backend->resize_window(display, w, width, height);
 }
 
-static GC
-create_foreground_gc(WindowManager* wm, Window w, int pixel)
-{
-    XGCValues v;
-    v.foreground = pixel;
-    return XXCreateGC(wm, wm->display, w, GCForeground, &v);
-}
+#define XXResizeWindow(wm, a, b, c, d) \
+    __XResizeWindow__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
 
-static Frame*
-create_frame(WindowManager* wm, int x, int y, int child_width, int child_height)
+static int
+__XRestackWindows__(const char* filename, int lineno, WindowManager* wm, Display* display, Window* windows, int nwindows)
 {
-    Display* display = wm->display;
-    int width = child_width + compute_frame_width(wm);
-    int height = child_height + compute_frame_height(wm);
-    int focused_color = wm->focused_foreground_color;
-    int black = BlackPixel(display, DefaultScreen(display));
-    Window w = XXCreateSimpleWindow(
-        wm,
-        display, DefaultRootWindow(display),
-        x, y,
-        width, height,
-        wm->border_size,
-        black, focused_color);
-    change_frame_event_mask(wm, w);
-
-    Frame* frame = alloc_frame();
-    frame->window = w;
-    frame->draw = create_draw(wm, w);
-    assert(frame->draw != NULL);
-    frame->wm_delete_window = False;
-    frame->width_inc = frame->height_inc = 1;
-
-    frame->line_gc = create_foreground_gc(wm, w, black);
-    frame->focused_gc = create_foreground_gc(wm, w, focused_color);
-    int color = wm->unfocused_foreground_color;
-    frame->unfocused_gc = create_foreground_gc(wm, w, color);
-    frame->status = FOCUS_NONE;
-
-    insert_frame(wm, frame);
-
-    return frame;
+    LOG_X(filename, lineno, wm, "XRestackWindows(display, windows, nwindows=%d)", nwindows);
+    int i;
+    for (i = 1; i < nwindows; i++) {
+        if (windows[i] == wm->shadow.top) {
+            forget_top(wm);
+        }
+    }
+    return wm->backend->restack_windows(display, windows, nwindows);
 }
 
-static void
-move_frame_to_z_order_head(WindowManager* wm, Frame* frame)
+#define XXRestackWindows(wm, a, b, c) \
+    __XRestackWindows__(__FILE__, __LINE__, (wm), (a), (b), (c))
+
+static Status
+__XSendEvent__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Bool propagate, long event_mask, XEvent* event_send)
 {
-    Array* a = &wm->frames_z_order;
-    /* FIXME: Do it in one function. */
-    remove_from_array(a, frame);
-    prepend_to_array(a, frame);
+    LOG_X(filename, lineno, wm, "XSendEvent(display, w=0x%08x, propagate, event_mask, event_send)", w);
+    return wm->backend->send_event(display, w, propagate, event_mask, event_send);
 }
 
+#define XXSendEvent(wm, a, b, c, d, e) \
+    __XSendEvent__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
+
 static int
-__XClearArea__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, int x, int y, unsigned width, unsigned height, Bool exposures)
+__XSetInputFocus__(const char* filename, int lineno, WindowManager* wm, Display* display, Window focus, int revert_to, Time time)
 {
-    LOG_X(filename, lineno, wm, "XClearArea(display, w=0x%08x, x=%d, y=%d, width=%u, height=%u, exposures)", w, x, y, width, height);
-    return XClearArea(display, w, x, y, width, height, exposures);
+    if (wm->shadow.focus_known && (wm->shadow.focus == focus)) {
+        return elide_request(filename, lineno, wm, SR_SET_INPUT_FOCUS, focus);
+    }
+    LOG_X(filename, lineno, wm, "XSetInputFocus(display, focus=0x%08x, revert_to, time)", focus);
+    count_sent_request(wm, SR_SET_INPUT_FOCUS);
+    wm->shadow.focus_known = True;
+    wm->shadow.focus = focus;
+    return wm->backend->set_input_focus(display, focus, revert_to, time);
 }
 
-#define XXClearArea(wm, a, b, c, d, e, f, g) \
-    __XClearArea__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g))
+#define XXSetInputFocus(wm, a, b, c, d) \
+    __XSetInputFocus__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
 
-static void
-expose(WindowManager* wm, Window w)
+static int
+__XSetCloseDownMode__(const char* filename, int lineno, WindowManager* wm, Display* display, int close_mode)
 {
-    XXClearArea(wm, wm->display, w, 0, 0, 0, 0, True);
+    LOG_X(filename, lineno, wm, "XSetCloseDownMode(display, close_mode=%d)", close_mode);
+    return wm->backend->set_close_down_mode(display, close_mode);
 }
 
-static void
-focus(WindowManager* wm, Frame* frame)
+#define XXSetCloseDownMode(wm, a, b) \
+    __XSetCloseDownMode__(__FILE__, __LINE__, (wm), (a), (b))
+
+static int
+__XSetWindowBackground__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned long background_pixel)
 {
-    move_frame_to_z_order_head(wm, frame);
-    XXSetInputFocus(wm, wm->display, frame->child, RevertToNone, CurrentTime);
-    expose(wm, wm->taskbar.window);
+    WindowState* state = find_window_state(wm, w);
+    if ((state != NULL) && (state->known & STATE_BACKGROUND) && (state->background == background_pixel)) {
+        return elide_request(filename, lineno, wm, SR_SET_WINDOW_BACKGROUND, w);
+    }
+    LOG_X(filename, lineno, wm, "XSetWindowBackground(display, w=0x%08x, background_pixel)", w);
+    count_sent_request(wm, SR_SET_WINDOW_BACKGROUND);
+    if (state != NULL) {
+        state->known |= STATE_BACKGROUND;
+        state->background = background_pixel;
+    }
+    return wm->backend->set_window_background(display, w, background_pixel);
 }
 
-static void
-read_protocol(WindowManager* wm, Frame* frame, Atom atom)
+#define XXSetWindowBackground(wm, a, b, c) \
+    __XSetWindowBackground__(__FILE__, __LINE__, (wm), (a), (b), (c))
+
+static int
+__XSetWindowBackgroundPixmap__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, Pixmap background_pixmap)
 {
-    if (atom == wm->atoms.wm_delete_window) {
-        frame->wm_delete_window = True;
+    LOG_X(filename, lineno, wm, "XSetWindowBackgroundPixmap(display, w=0x%08x, background_pixmap=0x%08x)", w, background_pixmap);
+    WindowState* state = find_window_state(wm, w);
+    if (state != NULL) {
+        state->known &= ~STATE_BACKGROUND;
     }
+    return wm->backend->set_window_background_pixmap(display, w, background_pixmap);
 }
 
-static void
-read_protocols(WindowManager* wm, Frame* frame)
+#define XXSetWindowBackgroundPixmap(wm, a, b, c) \
+    __XSetWindowBackgroundPixmap__(__FILE__, __LINE__, (wm), (a), (b), (c))
+
+static int
+__XSetWindowBorderWidth__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, unsigned width)
 {
-    Atom* protos;
-    int n;
-    if (XXGetWMProtocols(wm, wm->display, frame->child, &protos, &n) == 0) {
-        return;
-    }
-    int i;
-    for (i = 0; i < n; i++) {
-        read_protocol(wm, frame, protos[i]);
-    }
-    XFree(protos);
+    LOG_X(filename, lineno, wm, "XSetWindowBorderWidth(display, w=0x%08x, width=%u)", w, width);
+    return wm->backend->set_window_border_width(display, w, width);
 }
 
+#define XXSetWindowBorderWidth(wm, a, b, c) \
+    __XSetWindowBorderWidth__(__FILE__, __LINE__, (wm), (a), (b), (c))
+
 static Status
-__XGetWMNormalHints__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, XSizeHints* hints, long* supplied_return)
+__XTextPropertyToStringList__(const char* filename, int lineno, WindowManager* wm, XTextProperty* text_prop, char*** list_return, int* count_return)
 {
-    LOG_X(filename, lineno, wm, "XGetWMNormalHints(display, w=0x%08x, hints=%p, supplied_return=%p)", w, hints, supplied_return);
-    return XGetWMNormalHints(display, w, hints, supplied_return);
+    LOG_X0(filename, lineno, wm, "XTextPropertyToStringList(text_prop, list_return, count_return)");
+    return XTextPropertyToStringList(text_prop, list_return, count_return);
 }
 
-#define XXGetWMNormalHints(wm, a, b, c, d) \
-    __XGetWMNormalHints__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+#define XXTextPropertyToStringList(wm, a, b, c) \
+    __XTextPropertyToStringList__(__FILE__, __LINE__, (wm), (a), (b), (c))
 
-static void
-get_normal_hints(WindowManager* wm, Frame* frame)
+static int
+__XUngrabButton__(const char* filename, int lineno, WindowManager* wm, Display* display, unsigned int button, unsigned int modifiers, Window grab_window)
 {
-    XSizeHints hints;
-    long _;
-    XXGetWMNormalHints(wm, wm->display, frame->child, &hints, &_);
-    if ((hints.flags & PResizeInc) == 0) {
-        return;
-    }
-    frame->width_inc = hints.width_inc;
-    frame->height_inc = hints.height_inc;
-    LOG(wm, "PResizeInc: window=0x%08x, width_inc=%d, height_inc=%d", frame->child, hints.width_inc, hints.height_inc);
+    LOG_X(filename, lineno, wm, "XUngrabButton(display, button, modifiers, grab_window=0x%08x)", grab_window);
+    return wm->backend->ungrab_button(display, button, modifiers, grab_window);
 }
 
-static void
-reparent_window(WindowManager* wm, Window w)
+#define XXUngrabButton(wm, a, b, c, d) \
+    __XUngrabButton__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+
+static int
+__XUnmapWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
 {
-    LOG(wm, "reparent_window: w=0x%08x", w);
-    Display* display = wm->display;
-    XWindowAttributes wa;
-    if (XXGetWindowAttributes(wm, display, w, &wa) == 0) {
-        return;
+    WindowState* state = find_window_state(wm, w);
+    if (has_shadow_mapped(state, False)) {
+        return elide_request(filename, lineno, wm, SR_UNMAP_WINDOW, w);
     }
-    Frame* frame = create_frame(wm, wa.x, wa.y, wa.width, wa.height);
-    frame->child = w;
-    get_window_name(wm, frame->title, array_sizeof(frame->title), w);
-    LOG(wm, "Window Name: window=0x%08x, name=%s", w, frame->title);
-    int frame_size = wm->frame_size;
-    int x = frame_size;
-    int y = 2 * frame_size + wm->title_height;
-    XXSetWindowBorderWidth(wm, display, w, wm->client_border_size);
-    Window parent = frame->window;
-    LOG(wm, "Reparenting: frame=0x%08x, child=0x%08x", parent, w);
-    XXReparentWindow(wm, display, w, parent, x, y);
-
-    get_normal_hints(wm, frame);
-    read_protocols(wm, frame);
-
-    XXGrabButton(wm, display, Button1, AnyModifier, w, True, ButtonPressMask, GrabModeSync, GrabModeAsync, None, None);
-
-    XXMapWindow(wm, display, frame->window);
-    XXMapWindow(wm, display, w);
-    focus(wm, frame);
-    XXAddToSaveSet(wm, display, w);
+    LOG_X(filename, lineno, wm, "XUnmapWindow(display, w=0x%08x)", w);
+    count_sent_request(wm, SR_UNMAP_WINDOW);
+    update_shadow_mapped(state, False);
+    reindex_window(wm, state);
+    return wm->backend->unmap_window(display, w);
 }
 
+#define XXUnmapWindow(wm, a, b) \
+    __XUnmapWindow__(__FILE__, __LINE__, (wm), (a), (b))
+
+#if 0
 static Bool
-is_mapped(WindowManager* wm, Window w)
+__XftColorAllocName__(const char* filename, int lineno, WindowManager* wm, Display* display, Visual* visual, Colormap colormap, char* name, XftColor* result)
 {
-    XWindowAttributes wa;
-    XXGetWindowAttributes(wm, wm->display, w, &wa);
-    return wa.map_state != IsUnmapped;
+    LOG_X(filename, lineno, wm, "XftColorAllocName(display, visual, colormap, name=\"%s\", result)", name);
+    count_round_trip(wm);
+    return wm->backend->xft_color_alloc_name(display, visual, colormap, name, result);
 }
 
-static void
-reparent_mapped_child(WindowManager* wm, Window w)
+#define XXftColorAllocName(wm, a, b, c, d, e) \
+    __XftColorAllocName__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
+#endif
+
+static XftDraw*
+__XftDrawCreate__(const char* filename, int lineno, WindowManager* wm, Display* display, Drawable d, Visual* visual, Colormap colormap)
 {
-    if (!is_mapped(wm, w)) {
-        return;
-    }
-    reparent_window(wm, w);
+    LOG_X(filename, lineno, wm, "XftDrawCreate(display, d=0x%08x, visual, colormap)", d);
+    wm->resources.xft_draws++;
+    return wm->backend->xft_draw_create(display, d, visual, colormap);
 }
 
+#define XXftDrawCreate(wm, a, b, c, d) \
+    __XftDrawCreate__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+
 static void
-reparent_toplevels(WindowManager* wm)
+__XftDrawDestroy__(const char* filename, int lineno, WindowManager* wm, XftDraw* draw)
 {
-    Display* display = wm->display;
-    Window root = DefaultRootWindow(display);
-    Window _;
-    Window* children;
-    unsigned int nchildren;
-    if (XXQueryTree(wm, display, root, &_, &_, &children, &nchildren) == 0) {
-        print_error("XQueryTree failed.");
-        return;
-    }
-    int i;
-    for (i = 0; i < nchildren; i++) {
-        reparent_mapped_child(wm, children[i]);
-    }
-    XXFree(wm, children);
+    LOG_X0(filename, lineno, wm, "XftDrawDestroy(draw)");
+    wm->resources.xft_draws--;
+    wm->backend->xft_draw_destroy(draw);
 }
 
-static unsigned long
-alloc_color(WindowManager* wm, const char* name)
+#define XXftDrawDestroy(wm, a) \
+    __XftDrawDestroy__(__FILE__, __LINE__, (wm), (a))
+
+static void
+__XftDrawChange__(const char* filename, int lineno, WindowManager* wm, XftDraw* draw, Drawable d)
 {
-    Display* display = wm->display;
-    int screen = DefaultScreen(display);
-    Colormap colormap = DefaultColormap(display, screen);
-    XColor c;
-    XColor _;
-    if (XXAllocNamedColor(wm, display, colormap, name, &c, &_) == 0) {
-        return BlackPixel(display, screen);
-    }
-    return c.pixel;
+    LOG_X(filename, lineno, wm, "XftDrawChange(draw, d=0x%08x)", d);
+    wm->backend->xft_draw_change(draw, d);
 }
 
-static int
-__XFreeGC__(const char* filename, int lineno, WindowManager* wm, Display* display, GC gc)
+#define XXftDrawChange(wm, a, b) __XftDrawChange__(__FILE__, __LINE__, (wm), (a), (b))
+
+static void
+__XftDrawStringUtf8__(const char* filename, int lineno, WindowManager* wm, XftDraw* draw, XftColor* color, XftFont* pub, int x, int y, FcChar8* string, int len)
 {
-    LOG_X0(filename, lineno, wm, "XFreeGC(display, gc)");
-    return XFreeGC(display, gc);
+    LOG_X(filename, lineno, wm, "XftDrawStringUtf8(draw, color, pub, x=%d, y=%d, string, len=%d)", x, y, len);
+    return wm->backend->xft_draw_string_utf8(draw, color, pub, x, y, string, len);
 }
 
-#define XXFreeGC(wm, display, gc) \
-    __XFreeGC__(__FILE__, __LINE__, (wm), (display), (gc))
+#define XXftDrawStringUtf8(wm, a, b, c, d, e, f, g) \
+    __XftDrawStringUtf8__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e), (f), (g))
 
 static void
-free_frame(WindowManager* wm, Frame* frame)
+__XftTextExtentsUtf8__(const char* filename, int lineno, WindowManager* wm, Display* display, XftFont* font, XftChar8* string, int len, XGlyphInfo* extents)
 {
-    remove_from_array(&wm->all_frames, frame);
-    remove_from_array(&wm->frames_z_order, frame);
-
-    XXftDrawDestroy(wm, frame->draw);
+    LOG_X(filename, lineno, wm, "XftTextExtentsUtf8(display=0x%08x, font=0x%08x, string=\"%s\", len=%d, extents=%p)", display, font, string, len, extents);
+    wm->backend->xft_text_extents_utf8(display, font, string, len, extents);
+}
 
-    Display* display = wm->display;
-    XXFreeGC(wm, display, frame->line_gc);
-    XXFreeGC(wm, display, frame->focused_gc);
-    XXFreeGC(wm, display, frame->unfocused_gc);
+#define XXftTextExtentsUtf8(wm, a, b, c, d, e) \
+    __XftTextExtentsUtf8__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
 
-    memset(frame, 0xfd, sizeof(*frame));
-    free(frame);
+static FcBool
+__XftCharExists__(const char* filename, int lineno, WindowManager* wm, Display* display, XftFont* font, FcChar32 ucs4)
+{
+    LOG_X(filename, lineno, wm, "XftCharExists(display, font, ucs4=0x%04x)", ucs4);
+    return wm->backend->xft_char_exists(display, font, ucs4);
 }
 
-static int
-__XDestroyWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
+#define XXftCharExists(wm, a, b, c) \
+    __XftCharExists__(__FILE__, __LINE__, (wm), (a), (b), (c))
+
+static FT_UInt
+__XftCharIndex__(const char* filename, int lineno, WindowManager* wm, Display* display, XftFont* font, FcChar32 ucs4)
 {
-    LOG_X(filename, lineno, wm, "XDestroyWindow(display, w=0x%08x)", w);
-    return XDestroyWindow(display, w);
+    LOG_X(filename, lineno, wm, "XftCharIndex(display, font, ucs4=0x%04x)", ucs4);
+    return wm->backend->xft_char_index(display, font, ucs4);
 }
 
-#define XXDestroyWindow(wm, a, b) \
-    __XDestroyWindow__(__FILE__, __LINE__, (wm), (a), (b))
+#define XXftCharIndex(wm, a, b, c) \
+    __XftCharIndex__(__FILE__, __LINE__, (wm), (a), (b), (c))
 
 static void
-destroy_frame(WindowManager* wm, Frame* frame)
+__XftGlyphExtents__(const char* filename, int lineno, WindowManager* wm, Display* display, XftFont* font, FT_UInt* glyphs, int nglyphs, XGlyphInfo* extents)
 {
-    Window w = frame->window;
-    free_frame(wm, frame);
-    XXDestroyWindow(wm, wm->display, w);
+    LOG_X(filename, lineno, wm, "XftGlyphExtents(display, font, glyphs, nglyphs=%d, extents=%p)", nglyphs, extents);
+    wm->backend->xft_glyph_extents(display, font, glyphs, nglyphs, extents);
 }
 
+#define XXftGlyphExtents(wm, a, b, c, d, e) \
+    __XftGlyphExtents__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
+
 static void
-focus_top_frame(WindowManager* wm)
+__XftDrawGlyphFontSpec__(const char* filename, int lineno, WindowManager* wm, XftDraw* draw, XftColor* color, XftGlyphFontSpec* glyphs, int len)
 {
-    if (wm->frames_z_order.size == 0) {
-        expose(wm, wm->taskbar.window);
-        return;
-    }
-    focus(wm, wm->frames_z_order.items[0]);
+    LOG_X(filename, lineno, wm, "XftDrawGlyphFontSpec(draw, color, glyphs, len=%d)", len);
+    wm->backend->xft_draw_glyph_font_spec(draw, color, glyphs, len);
 }
 
-static void
-process_destroy_notify(WindowManager* wm, XDestroyWindowEvent* e)
+#define XXftDrawGlyphFontSpec(wm, a, b, c, d) \
+    __XftDrawGlyphFontSpec__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+
+static int
+__XftDrawSetClip__(const char* filename, int lineno, WindowManager* wm, XftDraw* d, Region r)
 {
-    Window w = e->window;
-    LOG(wm, "process_destroy_notify: event=0x%08x, window=0x%08x", e->event, w);
-    Frame* frame = search_frame_of_child(wm, w);
-    if (frame == NULL) {
-        return;
-    }
-    destroy_frame(wm, frame);
-    focus_top_frame(wm);
+    LOG_X0(filename, lineno, wm, "XftDrawSetClip(d, r)");
+    return wm->backend->xft_draw_set_clip(d, r);
 }
 
+#define XXftDrawSetClip(wm, d, r) \
+                        __XftDrawSetClip__(__FILE__, __LINE__, (wm), (d), (r))
+
 static Bool
-is_range_inside(int range_begin, int range_size, int n)
+__XftDrawSetClipRectangles__(const char* filename, int lineno, WindowManager* wm, XftDraw* draw, int xorigin, int yorigin, XRectangle* rects, int n)
 {
-    return (range_begin <= n) && (n < range_begin + range_size);
+    LOG_X(filename, lineno, wm, "XftDrawSetClipRectangles(draw, xorigin=%d, yorigin=%d, rects, n=%d)", xorigin, yorigin, n);
+    return wm->backend->xft_draw_set_clip_rectangles(draw, xorigin, yorigin, rects, n);
 }
 
-static Bool
-is_region_inside(int region_x, int region_y, int region_width, int region_height, int x, int y)
+#define XXftDrawSetClipRectangles(wm, a, b, c, d, e) \
+    __XftDrawSetClipRectangles__(__FILE__, __LINE__, (wm), (a), (b), (c), (d), (e))
+
+static XftFont*
+__XftFontOpenName__(const char* filename, int lineno, WindowManager* wm, Display* display, int screen, const char* name)
 {
-    if (!is_range_inside(region_x, region_width, x)) {
-        return False;
-    }
-    if (!is_range_inside(region_y, region_height, y)) {
-        return False;
-    }
-    return True;
+    LOG_X(filename, lineno, wm, "XftFontOpenName(display, screen, name=\"%s\")", name);
+    count_round_trip(wm);
+    return wm->backend->xft_font_open_name(display, screen, name);
 }
 
+#define XXftFontOpenName(wm, a, b, c) \
+    __XftFontOpenName__(__FILE__, __LINE__, (wm), (a), (b), (c))
+
 static void
-release_frame(WindowManager* wm)
+__XftFontClose__(const char* filename, int lineno, WindowManager* wm, Display* display, XftFont* font)
 {
-    wm->grasped_position = GP_NONE;
+    LOG_X0(filename, lineno, wm, "XftFontClose(display, font)");
+    wm->backend->xft_font_close(display, font);
 }
 
+#define XXftFontClose(wm, a, b) \
+    __XftFontClose__(__FILE__, __LINE__, (wm), (a), (b))
+
 static void
-grasp_frame(WindowManager* wm, GraspedPosition pos, Window w, int x, int y)
+begin_draw_batch(DrawBatch* batch, Drawable d)
 {
-    wm->grasped_position = pos;
-    wm->grasped_frame = w;
-    wm->grasped_x = x;
-    wm->grasped_y = y;
-
-    XWindowAttributes wa;
-    XXGetWindowAttributes(wm, wm->display, w, &wa);
-    wm->grasped_width = wa.width;
-    wm->grasped_height = wa.height;
+    batch->drawable = d;
+    batch->gcs_num = 0;
 }
 
 static void
-map_popup_menu(WindowManager* wm, int x, int y)
+flush_draw_batch(WindowManager* wm, DrawBatch* batch)
 {
     Display* display = wm->display;
-    Window w = wm->popup_menu.window;
-    unsigned int menu_width;
-    unsigned int menu_height;
-    get_geometry(wm, w, &menu_width, &menu_height);
-    unsigned int root_width;
-    unsigned int root_height;
-    get_geometry(wm, DefaultRootWindow(display), &root_width, &root_height);
-    int menu_x = x;
-    int menu_y = y + 1;
-    if (root_width < menu_x + menu_width) {
-        menu_x = x - menu_width;
+    Drawable d = batch->drawable;
+    int i;
+    for (i = 0; i < batch->gcs_num; i++) {
+        GC gc = batch->gcs[i].gc;
+        XRectangle* rects = batch->gcs[i].fill_rects;
+        int n = batch->gcs[i].fill_rects_num;
+        if (0 < n) {
+            XXFillRectangles(wm, display, d, gc, rects, n);
+        }
     }
-    if (root_height < menu_y + menu_height) {
-        menu_y = y - menu_height - 1;
+    for (i = 0; i < batch->gcs_num; i++) {
+        GC gc = batch->gcs[i].gc;
+        XRectangle* rects = batch->gcs[i].rects;
+        int rects_num = batch->gcs[i].rects_num;
+        if (0 < rects_num) {
+            XXDrawRectangles(wm, display, d, gc, rects, rects_num);
+        }
+        XSegment* segments = batch->gcs[i].segments;
+        int segments_num = batch->gcs[i].segments_num;
+        if (0 < segments_num) {
+            XXDrawSegments(wm, display, d, gc, segments, segments_num);
+        }
     }
-
-    wm->popup_menu.selected_item = -1;
-    XXMoveWindow(wm, display, w, menu_x, menu_y);
-    XXMapRaised(wm, display, w);
+    batch->gcs_num = 0;
 }
 
-static GraspedPosition
-detect_frame_position(WindowManager* wm, Window w, int x, int y)
+static int
+find_batch_gc(WindowManager* wm, DrawBatch* batch, GC gc)
 {
-    unsigned int width;
-    unsigned int height;
-    get_geometry(wm, w, &width, &height);
-    int frame_size = wm->frame_size;
-    int corner_size = wm->resizable_corner_size;
-    int virt_corner_size = corner_size - frame_size;
-
-    if (is_region_inside(0, frame_size, frame_size, virt_corner_size, x, y)) {
-        return GP_NORTH_WEST;
-    }
-    if (is_region_inside(0, 0, corner_size, frame_size, x, y)) {
-        return GP_NORTH_WEST;
+    int i;
+    for (i = 0; (i < batch->gcs_num) && (batch->gcs[i].gc != gc); i++) {
     }
-
-    int middle_width = width - 2 * corner_size;
-    if (is_region_inside(corner_size, 0, middle_width, frame_size, x, y)) {
-        return GP_NORTH;
+    if (i < batch->gcs_num) {
+        return i;
     }
-
-    int east_corner_x = width - corner_size;
-    if (is_region_inside(east_corner_x, 0, corner_size, frame_size, x, y)) {
-        return GP_NORTH_EAST;
+    if (i == DRAW_BATCH_GCS_NUM) {
+        flush_draw_batch(wm, batch);
+        i = 0;
     }
-    int virt_east_x = width - frame_size;
-    if (is_region_inside(virt_east_x, frame_size, frame_size, virt_corner_size, x, y)) {
-        return GP_NORTH_EAST;
+    batch->gcs[i].gc = gc;
+    batch->gcs[i].fill_rects_num = 0;
+    batch->gcs[i].rects_num = 0;
+    batch->gcs[i].segments_num = 0;
+    batch->gcs_num = i + 1;
+    return i;
+}
+
+static XRectangle*
+add_batch_rectangle(WindowManager* wm, DrawBatch* batch, GC gc, Bool fill)
+{
+    int i = find_batch_gc(wm, batch, gc);
+    int* pn = fill ? &batch->gcs[i].fill_rects_num : &batch->gcs[i].rects_num;
+    if (*pn == DRAW_BATCH_SIZE) {
+        flush_draw_batch(wm, batch);
+        i = find_batch_gc(wm, batch, gc);
+        pn = fill ? &batch->gcs[i].fill_rects_num : &batch->gcs[i].rects_num;
     }
+    XRectangle* rects = fill ? batch->gcs[i].fill_rects : batch->gcs[i].rects;
+    XRectangle* r = &rects[*pn];
+    (*pn)++;
+    return r;
+}
 
-    int middle_height = height - 2 * corner_size;
-    if (is_region_inside(virt_east_x, corner_size, frame_size, middle_height, x, y)) {
-        return GP_EAST;
-    }
+static void
+set_rectangle(XRectangle* r, int x, int y, int width, int height)
+{
+    r->x = x;
+    r->y = y;
+    r->width = width;
+    r->height = height;
+}
 
-    if (is_region_inside(virt_east_x, height - corner_size, frame_size, virt_corner_size, x, y)) {
-        return GP_SOUTH_EAST;
-    }
-    int bottom_y = height - frame_size;
-    if (is_region_inside(east_corner_x, bottom_y, corner_size, frame_size, x, y)) {
-        return GP_SOUTH_EAST;
-    }
+static void
+batch_fill_rectangle(WindowManager* wm, DrawBatch* batch, GC gc, int x, int y, int width, int height)
+{
+    XRectangle* r = add_batch_rectangle(wm, batch, gc, True);
+    set_rectangle(r, x, y, width, height);
+}
 
-    if (is_region_inside(corner_size, height - frame_size, middle_width, frame_size, x, y)) {
-        return GP_SOUTH;
-    }
+static void
+batch_rectangle(WindowManager* wm, DrawBatch* batch, GC gc, int x, int y, int width, int height)
+{
+    XRectangle* r = add_batch_rectangle(wm, batch, gc, False);
+    set_rectangle(r, x, y, width, height);
+}
 
-    if (is_region_inside(0, bottom_y, corner_size, frame_size, x, y)) {
-        return GP_SOUTH_WEST;
-    }
-    if (is_region_inside(0, height - corner_size, frame_size, corner_size - frame_size, x, y)) {
-        return GP_SOUTH_WEST;
+static void
+batch_line(WindowManager* wm, DrawBatch* batch, GC gc, int x1, int y1, int x2, int y2)
+{
+    int i = find_batch_gc(wm, batch, gc);
+    if (batch->gcs[i].segments_num == DRAW_BATCH_SIZE) {
+        flush_draw_batch(wm, batch);
+        i = find_batch_gc(wm, batch, gc);
     }
+    XSegment* segment = &batch->gcs[i].segments[batch->gcs[i].segments_num];
+    segment->x1 = x1;
+    segment->y1 = y1;
+    segment->x2 = x2;
+    segment->y2 = y2;
+    batch->gcs[i].segments_num++;
+}
 
-    if (is_region_inside(0, corner_size, frame_size, middle_height, x, y)) {
-        return GP_WEST;
-    }
+static int
+compute_buttons_width(WindowManager* wm)
+{
+    return 3 * wm->title_height + 1;
+}
 
-    if (is_region_inside(0, 0, width, height, x, y)) {
-        return GP_TITLE_BAR;
-    }
+static int
+compute_buttons_height(WindowManager* wm)
+{
+    return wm->title_height + 1;
+}
 
-    return GP_NONE;
+static void
+draw_box(WindowManager* wm, DrawBatch* batch, int n, int status, int box_status)
+{
+    int size = wm->title_height;
+    int x = compute_buttons_width(wm) - 1 - n * size;
+    int y = 0;
+    GC unfocused_gc = wm->gcs.unfocused_gc;
+    GC fill_gc = status == box_status ? wm->gcs.focused_gc : unfocused_gc;
+    batch_fill_rectangle(wm, batch, fill_gc, x, y, size, size);
+    batch_rectangle(wm, batch, wm->gcs.line_gc, x, y, size, size);
 }
 
 static void
-close_frame(WindowManager* wm, Frame* frame)
+draw_boxes(WindowManager* wm, Drawable d, int status)
 {
-    Display* display = wm->display;
-    Window child = frame->child;
-    if (!frame->wm_delete_window) {
-        XXKillClient(wm, display, child);
-        return;
-    }
-    XEvent e;
-    bzero(&e, sizeof(e));
-    e.xclient.type = ClientMessage;
-    e.xclient.window = child;
-    e.xclient.message_type = wm->atoms.wm_protocols;
-    e.xclient.format = 32;
-    e.xclient.data.l[0] = wm->atoms.wm_delete_window;
-    e.xclient.data.l[1] = CurrentTime;
-    XXSendEvent(wm, display, child, False, 0, &e);
+    DrawBatch batch;
+    begin_draw_batch(&batch, d);
+    draw_box(wm, &batch, 1, status, FOCUS_CLOSE);
+    draw_box(wm, &batch, 2, status, FOCUS_MAXIMIZE);
+    draw_box(wm, &batch, 3, status, FOCUS_MINIMIZE);
+    flush_draw_batch(wm, &batch);
 }
 
+static Atom
+intern(WindowManager* wm, const char* name)
+{
+    return XXInternAtom(wm, wm->display, name, False);
+}
+
+static void
+__XFreeStringList__(const char* filename, int lineno, WindowManager* wm, char** list)
+{
+    LOG_X(filename, lineno, wm, "XFreeStringList(list=%p)", list);
+    XFreeStringList(list);
+}
+
+#define XXFreeStringList(wm, a) \
+    __XFreeStringList__(__FILE__, __LINE__, (wm), (a))
+
 static void
-focus_window_of_taskbar(WindowManager* wm, int x, int y)
+get_window_name(WindowManager* wm, char* dest, int size, Window w)
 {
-    if (wm->taskbar.clock_x < x) {
+    XTextProperty prop;
+    dest[0] = '\0';
+    if (XXGetTextProperty(wm, wm->display, w, &prop, XA_WM_NAME) == 0) {
         return;
     }
-    Display* display = wm->display;
-    unsigned int _;
-    unsigned int taskbar_height;
-    get_geometry(wm, wm->taskbar.window, &_, &taskbar_height);
-    unsigned int root_height;
-    get_geometry(wm, DefaultRootWindow(display), &_, &root_height);
-    if (x < taskbar_height) {
-        map_popup_menu(wm, 0, root_height - taskbar_height);
+    Atom encoding = prop.encoding;
+    /* FIXME: What is XA_COMPOUND_TEXT? */
+    if ((encoding != XA_STRING) && (encoding != wm->atoms.compound_text)) {
+        XXFree(wm, prop.value);
         return;
     }
 
-    int nframes = wm->all_frames.size;
-    if (nframes == 0) {
+    char** strings;
+    int _;
+    Status status = XXTextPropertyToStringList(wm, &prop, &strings, &_);
+    XXFree(wm, prop.value);
+    if ((status == 0) || (strings == NULL)) {
         return;
     }
-    Frame* frame = wm->all_frames.items[x / (wm->taskbar.clock_x / nframes)];
-    Window w = frame->window;
-    XXMapWindow(wm, display, w);
-    XXRaiseWindow(wm, display, w);
-    focus(wm, frame);
+    snprintf(dest, size, "%s", strings[0]);
+    XXFreeStringList(wm, strings);
 }
 
 static void
-unmap_frame(WindowManager* wm, Frame* frame)
+draw_title_font_string(WindowManager* wm, XftDraw* draw, int x, int y, const char* text)
 {
-    remove_from_array(&wm->frames_z_order, frame);
-    XXUnmapWindow(wm, wm->display, frame->window);
+    XftColor* color = &wm->title_color;
+    XftFont* font = wm->title_font;
+    int len = strlen(text);
+    XXftDrawStringUtf8(wm, draw, color, font, x, y, (XftChar8*)text, len);
+}
 
-    focus_top_frame(wm);
+static void
+invalidate_glyph_run(GlyphRun* run)
+{
+    run->max_width = -1;
 }
 
 static void
-process_button_press(WindowManager* wm, XButtonEvent* e)
+append_glyph(GlyphRun* run, XftFont* font, FT_UInt glyph, int x)
 {
-    LOG(wm, "process_button_press: window=0x%08x, root=0x%08x, subwindow=0x%08x", e->window, e->root, e->subwindow);
-    if (e->button != Button1) {
-        return;
+    XftGlyphFontSpec* spec = &run->glyphs[run->glyphs_num];
+    spec->font = font;
+    spec->glyph = glyph;
+    spec->x = x;
+    spec->y = 0;
+    run->glyphs_num++;
+}
+
+static void
+append_ellipsis(WindowManager* wm, GlyphRun* run, int x)
+{
+    XftFont* font = wm->title_font;
+    int advance = wm->ellipsis.advance;
+    int i;
+    for (i = 0; i < wm->ellipsis.glyphs_num; i++) {
+        append_glyph(run, font, wm->ellipsis.glyph, x + advance * i);
     }
-    Window w = e->window;
+}
+
+static void
+shape_glyph_run(WindowManager* wm, GlyphRun* run, const char* text, int max_width)
+{
     Display* display = wm->display;
-    if (w == DefaultRootWindow(display)) {
-        map_popup_menu(wm, e->x, e->y);
-        return;
+    XftFont* font = wm->title_font;
+    int ellipsis_width = wm->ellipsis.advance * wm->ellipsis.glyphs_num;
+    const FcChar8* p = (const FcChar8*)text;
+    int len = strlen(text);
+    int x = 0;
+    /*
+     * fit_num and fit_width are size of the longest head which can be followed
+     * by an ellipsis.
+     */
+    int fit_num = 0;
+    int fit_width = 0;
+    run->glyphs_num = 0;
+    run->truncated = False;
+    while (0 < len) {
+        FcChar32 c;
+        int size = FcUtf8ToUcs4(p, &c, len);
+        if (size <= 0) {
+            break;
+        }
+        p += size;
+        len -= size;
+
+        FT_UInt glyph = XXftCharIndex(wm, display, font, c);
+        XGlyphInfo info;
+        XXftGlyphExtents(wm, display, font, &glyph, 1, &info);
+        int next_x = x + info.xOff;
+        if (max_width < next_x) {
+            run->truncated = True;
+            break;
+        }
+        if (next_x + ellipsis_width <= max_width) {
+            fit_num = run->glyphs_num + 1;
+            fit_width = next_x;
+        }
+        append_glyph(run, font, glyph, x);
+        x = next_x;
     }
-    else if (w == wm->taskbar.window) {
-        focus_window_of_taskbar(wm, e->x, e->y);
-        return;
+    if (run->truncated) {
+        run->glyphs_num = fit_num;
+        x = fit_width;
+        if (ellipsis_width <= max_width) {
+            append_ellipsis(wm, run, x);
+            x += ellipsis_width;
+        }
     }
-    Frame* frame = search_frame_of_child(wm, w);
-    if (frame != NULL) {
-        XXRaiseWindow(wm, display, frame->window);
-        focus(wm, frame);
-        XXAllowEvents(wm, display, ReplayPointer, CurrentTime);
+
+    run->max_width = max_width;
+    run->width = x;
+    run->x = run->y = 0;
+}
+
+static void
+update_glyph_run(WindowManager* wm, GlyphRun* run, const char* text, int max_width)
+{
+    if (run->max_width == max_width) {
         return;
     }
-    frame = search_frame(wm, w);
-    if (frame == NULL) {
+    if ((0 <= run->max_width) && !run->truncated && (run->width <= max_width)) {
+        /* The whole title still fits. Glyphs are same as before. */
+        run->max_width = max_width;
         return;
     }
-    if (frame->status == FOCUS_CLOSE) {
-        close_frame(wm, frame);
+    shape_glyph_run(wm, run, text, max_width);
+}
+
+static void
+move_glyph_run(GlyphRun* run, int x, int y)
+{
+    int dx = x - run->x;
+    int dy = y - run->y;
+    if ((dx == 0) && (dy == 0)) {
         return;
     }
-    if (frame->status == FOCUS_MINIMIZE) {
-        unmap_frame(wm, frame);
-        return;
+    int i;
+    for (i = 0; i < run->glyphs_num; i++) {
+        run->glyphs[i].x += dx;
+        run->glyphs[i].y += dy;
     }
-    XXRaiseWindow(wm, display, w);
-    focus(wm, frame);
-    int x = e->x;
-    int y = e->y;
-    grasp_frame(wm, detect_frame_position(wm, w, x, y), w, x, y);
+    run->x = x;
+    run->y = y;
 }
 
 static void
-unmap_popup_menu(WindowManager* wm)
+draw_glyph_run(WindowManager* wm, XftDraw* draw, GlyphRun* run, int x, int y)
 {
-    XXUnmapWindow(wm, wm->display, wm->popup_menu.window);
+    if (run->glyphs_num == 0) {
+        return;
+    }
+    move_glyph_run(run, x, y);
+    XftColor* color = &wm->title_color;
+    XXftDrawGlyphFontSpec(wm, draw, color, run->glyphs, run->glyphs_num);
+}
+
+static XftDraw*
+get_frame_draw(WindowManager* wm, Frame* frame)
+{
+    XftDraw* draw = wm->frame_draw;
+    Window w = frame->window;
+    if (wm->backend->xft_draw_drawable(draw) != w) {
+        XXftDrawChange(wm, draw, w);
+    }
+    return draw;
 }
 
 static void
-resize_child(WindowManager* wm, Window w, int frame_width, int frame_height)
+release_frame_draw(WindowManager* wm, Frame* frame)
 {
-    int width = frame_width - compute_frame_width(wm);
-    int height = frame_height - compute_frame_height(wm);
-    XXResizeWindow(wm, wm->display, w, width, height);
+    /*
+     * XftDraw must leave a window before the window is destroyed. Otherwise
+     * the next XftDrawChange frees a picture which the server already freed.
+     */
+    XftDraw* draw = wm->frame_draw;
+    if (wm->backend->xft_draw_drawable(draw) != frame->window) {
+        return;
+    }
+    XXftDrawChange(wm, draw, DefaultRootWindow(wm->display));
 }
 
 static int
-compute_font_height(XftFont* font)
+compute_title_max_width(WindowManager* wm, int frame_width)
 {
-    return font->ascent + font->descent;
+    int frame_size = wm->frame_size;
+    int buttons_width = 3 * wm->title_height;
+    return frame_width - 2 * frame_size - buttons_width - wm->padding_size;
 }
 
-static int
-detect_selected_popup_item(WindowManager* wm, int x, int y)
+static void
+draw_title_text(WindowManager* wm, Frame* frame, int width)
 {
-    XWindowAttributes wa;
-    XXGetWindowAttributes(wm, wm->display, wm->popup_menu.window, &wa);
-    if (!is_region_inside(wa.x, wa.y, wa.width, wa.height, x, y)) {
-        return -1;
-    }
-    int index = (y - wa.y) / compute_font_height(wm->title_font);
-    return wm->config->menu.ptr->items_num <= index ? -1 : index;
+    GlyphRun* run = &frame->title_run;
+    int max_width = compute_title_max_width(wm, width);
+    update_glyph_run(wm, run, frame->title, max_width);
+
+    int frame_size = wm->frame_size;
+    int x = frame_size;
+    int y = frame_size + wm->title_font->ascent;
+    draw_glyph_run(wm, get_frame_draw(wm, frame), run, x, y);
 }
 
-static const char* caption_of_exit = "exit";
-static const char* caption_of_reload = "reload";
+static void
+get_window_geometry(WindowManager* wm, Window w, int* x, int* y, unsigned int* width, unsigned int* height)
+{
+    WindowState* state = find_window_state(wm, w);
+    unsigned int known = STATE_POSITION | STATE_SIZE;
+    if ((state != NULL) && ((state->known & known) == known)) {
+        elide_request(__FILE__, __LINE__, wm, SR_GET_GEOMETRY, w);
+        *x = state->x;
+        *y = state->y;
+        *width = state->width;
+        *height = state->height;
+        return;
+    }
+    Window _;
+    unsigned int __;
+    XXGetGeometry(wm, wm->display, w, &_, x, y, width, height, &__, &__);
+}
 
-static const char*
-get_menu_item_caption(MenuItem* item)
+static void
+get_geometry(WindowManager* wm, Window w, unsigned int* width, unsigned int* height)
 {
-    switch (item->type) {
+    int _;
+    get_window_geometry(wm, w, &_, &_, width, height);
+}
+
+/* The marks show where a drag resizes two sides. */
+static void
+compute_corner_marks(WindowManager* wm, int width, int height, XSegment* marks)
+{
+    int frame_size = wm->frame_size;
+    int corner_size = wm->resizable_corner_size;
+    int east_x1 = width - corner_size;
+    int east_x2 = width - frame_size;
+    int south_y1 = height - corner_size;
+    int south_y2 = height - frame_size;
+    XSegment segments[] = {
+        { 0, corner_size, frame_size, corner_size },
+        { corner_size, 0, corner_size, frame_size },
+        { east_x1, 0, east_x1, frame_size },
+        { east_x2, corner_size, width, corner_size },
+        { east_x2, south_y1, width, south_y1 },
+        { east_x1, south_y2, east_x1, height },
+        { corner_size, south_y2, corner_size, height },
+        { 0, south_y1, frame_size, south_y1 } };
+    assert(array_sizeof(segments) == CORNER_MARKS_NUM);
+    memcpy(marks, segments, sizeof(segments));
+}
+
+static void
+batch_corner_marks(WindowManager* wm, DrawBatch* batch, GC gc, int width, int height)
+{
+    XSegment marks[CORNER_MARKS_NUM];
+    compute_corner_marks(wm, width, height, marks);
+    int i;
+    for (i = 0; i < CORNER_MARKS_NUM; i++) {
+        XSegment* mark = &marks[i];
+        batch_line(wm, batch, gc, mark->x1, mark->y1, mark->x2, mark->y2);
+    }
+}
+
+static Bool
+is_corner_mark_exposed(WindowManager* wm, XRectangle* area, int width, int height)
+{
+    XSegment marks[CORNER_MARKS_NUM];
+    compute_corner_marks(wm, width, height, marks);
+    int i;
+    for (i = 0; i < CORNER_MARKS_NUM; i++) {
+        XSegment* mark = &marks[i];
+        Bool x_overlapped = (area->x <= mark->x2) && (mark->x1 < area->x + area->width);
+        Bool y_overlapped = (area->y <= mark->y2) && (mark->y1 < area->y + area->height);
+        if (x_overlapped && y_overlapped) {
+            return True;
+        }
+    }
+    return False;
+}
+
+static void
+draw_corner_marks(WindowManager* wm, Frame* frame, int width, int height)
+{
+    DrawBatch batch;
+    begin_draw_batch(&batch, frame->window);
+    batch_corner_marks(wm, &batch, wm->gcs.line_gc, width, height);
+    flush_draw_batch(wm, &batch);
+    frame->marks_width = width;
+    frame->marks_height = height;
+}
+
+/*
+ * The server keeps the old corner marks at their places after resizing
+ * (bit_gravity), so they are painted over by the background before the new
+ * ones are drawn. Both go in one batch.
+ */
+static void
+refresh_corner_marks(WindowManager* wm, Frame* frame, int width, int height)
+{
+    if ((frame->marks_width == width) && (frame->marks_height == height)) {
+        return;
+    }
+    DrawBatch batch;
+    begin_draw_batch(&batch, frame->window);
+    if (0 < frame->marks_width) {
+        GC gc = frame == wm->focused_frame ? wm->gcs.focused_gc : wm->gcs.unfocused_gc;
+        batch_corner_marks(wm, &batch, gc, frame->marks_width, frame->marks_height);
+    }
+    batch_corner_marks(wm, &batch, wm->gcs.line_gc, width, height);
+    flush_draw_batch(wm, &batch);
+    frame->marks_width = width;
+    frame->marks_height = height;
+}
+
+static void
+draw_frame(WindowManager* wm, Frame* frame, XRectangle* area, int count)
+{
+    /*
+     * The buttons are a subwindow which the X server repaints by itself. The
+     * corner marks are drawn once for an Expose series, at its last event.
+     * Pixels outside of the exposed area are kept by the server
+     * (bit_gravity), so the title is clipped not to be drawn twice over them.
+     */
+    unsigned int width;
+    unsigned int height;
+    get_geometry(wm, frame->window, &width, &height);
+    if (is_corner_mark_exposed(wm, area, width, height)) {
+        frame->marks_exposed = True;
+    }
+    if ((count == 0) && frame->marks_exposed) {
+        draw_corner_marks(wm, frame, width, height);
+        frame->marks_exposed = False;
+    }
+
+    int frame_size = wm->frame_size;
+    int title_bottom = frame_size + wm->title_height;
+    if ((title_bottom <= area->y) || (area->y + area->height <= frame_size)) {
+        return;
+    }
+    if (area->x + area->width <= frame_size) {
+        return;
+    }
+
+    XftDraw* draw = get_frame_draw(wm, frame);
+    XXftDrawSetClipRectangles(wm, draw, 0, 0, area, 1);
+    draw_title_text(wm, frame, width);
+    XXftDrawSetClip(wm, draw, NULL);
+}
+
+static Bool
+is_title_changed(WindowManager* wm, Frame* frame, int width)
+{
+    /* This follows update_glyph_run(). */
+    GlyphRun* run = &frame->title_run;
+    int max_width = compute_title_max_width(wm, width);
+    if (run->max_width == max_width) {
+        return False;
+    }
+    return (run->max_width < 0) || run->truncated || (max_width < run->width);
+}
+
+static void
+refresh_title(WindowManager* wm, Frame* frame, int width)
+{
+    /*
+     * The server keeps the old title after resizing. It must be redrawn only
+     * when its glyphs are changed (truncated at another width).
+     */
+    if (!is_title_changed(wm, frame, width)) {
+        return;
+    }
+    int frame_size = wm->frame_size;
+    Window w = frame->window;
+    XXClearArea(wm, wm->display, w, frame_size, frame_size, 0, wm->title_height, True);
+}
+
+static long
+get_frame_event_mask()
+{
+    return 0
+        | ButtonPressMask
+        | ButtonReleaseMask
+        | ExposureMask
+        | FocusChangeMask
+        | LeaveWindowMask
+        | PointerMotionMask
+        | PropertyChangeMask
+        | SubstructureNotifyMask
+        | SubstructureRedirectMask;
+}
+
+static void
+change_event_mask(WindowManager* wm, Window w, long event_mask)
+{
+    XSetWindowAttributes swa;
+    swa.event_mask = event_mask;
+    XXChangeWindowAttributes(wm, wm->display, w, CWEventMask, &swa);
+}
+
+static void*
+alloc_memory(size_t size)
+{
+    void* p = malloc(size);
+    if (p == NULL) {
+        print_error("malloc failed.");
+        abort();
+    }
+    memset(p, 0xfb, size);
+    return p;
+}
+
+static Frame*
+alloc_frame(WindowManager* wm)
+{
+    Array* a = &wm->free_frames;
+    if (a->size == 0) {
+        /* Slabs are never freed. They will be reused by next frames. */
+        Frame* slab = (Frame*)alloc_memory(sizeof(Frame) * FRAMES_PER_SLAB);
+        int i;
+        for (i = FRAMES_PER_SLAB - 1; 0 <= i; i--) {
+            append_to_array(a, &slab[i]);
+        }
+    }
+    a->size--;
+    Frame* frame = a->items[a->size];
+    memset(frame, 0xfb, sizeof(*frame));
+    return frame;
+}
+
+static void
+dispose_frame(WindowManager* wm, Frame* frame)
+{
+    memset(frame, 0xfd, sizeof(*frame));
+    append_to_array(&wm->free_frames, frame);
+}
+
+static void
+schedule_restack(Desktop* desktop)
+{
+    desktop->dirty = True;
+}
+
+static void
+insert_frame(WindowManager* wm, Frame* frame)
+{
+    frame->desktop = wm->current_desktop;
+    Desktop* desktop = get_current_desktop(wm);
+    append_to_array(&wm->all_frames, frame);
+    append_to_array(&desktop->frames, frame);
+    prepend_to_array(&desktop->z_order, frame);
+    schedule_restack(desktop);
+
+    frame->applied_stamp = 0;
+
+    SpatialEntry* entry = &frame->spatial;
+    entry->data = frame;
+    entry->layer = frame->desktop;
+    entry->z = ++wm->spatial.top_z;
+    entry->indexed = False;
+    WindowState* state = find_window_state(wm, frame->window);
+    state->frame = frame;
+    reindex_window(wm, state);
+}
+
+static int
+compute_frame_width(WindowManager* wm)
+{
+    /**
+     * Name of this function is "compute_frame_width", but this returns value
+     * including client borders size.
+     */
+    return 2 * (wm->frame_size + wm->client_border_size);
+}
+
+static int
+compute_frame_height(WindowManager* wm)
+{
+    /**
+     * Name of this function is "compute_frame_height", but this returns value
+     * including client borders size.
+     */
+    return wm->title_height + 3 * wm->frame_size + 2 * wm->client_border_size;
+}
+
+static XftDraw*
+create_draw(WindowManager* wm, Window w)
+{
+    Display* display = wm->display;
+    int screen = DefaultScreen(display);
+    Visual* visual = DefaultVisual(display, screen);
+    Colormap colormap = DefaultColormap(display, screen);
+    return XXftDrawCreate(wm, display, w, visual, colormap);
+}
+
+static GC
+create_foreground_gc(WindowManager* wm, Window w, int pixel)
+{
+    XGCValues v;
+    v.foreground = pixel;
+    return XXCreateGC(wm, wm->display, w, GCForeground, &v);
+}
+
+static Window
+create_decoration(WindowManager* wm, Window parent, int x, int y, int width, int height, unsigned long valuemask, XSetWindowAttributes* swa)
+{
+    return XXCreateWindow(
+        wm,
+        wm->display, parent,
+        x, y,
+        width, height,
+        0,
+        CopyFromParent, InputOutput, CopyFromParent,
+        valuemask, swa);
+}
+
+static void
+create_buttons(WindowManager* wm, Frame* frame, int width)
+{
+    int frame_size = wm->frame_size;
+    int buttons_width = compute_buttons_width(wm);
+    int x = width - frame_size - buttons_width + 1;
+    int y = frame_size;
+    int height = compute_buttons_height(wm);
+    XSetWindowAttributes swa;
+    swa.background_pixmap = wm->decoration.buttons[FOCUS_NONE];
+    swa.win_gravity = NorthEastGravity;
+    unsigned long mask = CWBackPixmap | CWWinGravity;
+    Window w = frame->window;
+    frame->buttons = create_decoration(wm, w, x, y, buttons_width, height, mask, &swa);
+}
+
+static void
+log_resources(WindowManager* wm)
+{
+    /*
+     * A frame owns windows only. GCs, pixmaps and XftDraws are shared by all
+     * frames, so their numbers do not depend on number of frames.
+     */
+    int nframes = wm->all_frames.size;
+    int npooled = wm->frame_pool.size;
+    int nwindows = FRAME_WINDOWS_NUM * (nframes + npooled);
+#define FMT "resources: frames=%d, pooled frames=%d, windows=%d (%d per frame), gcs=%d, pixmaps=%d, xft_draws=%d"
+    LOG(wm, FMT, nframes, npooled, nwindows, FRAME_WINDOWS_NUM, wm->resources.gcs, wm->resources.pixmaps, wm->resources.xft_draws);
+#undef FMT
+}
+
+static Frame*
+take_pooled_frame(WindowManager* wm, int x, int y, int width, int height)
+{
+    Array* pool = &wm->frame_pool;
+    if (pool->size == 0) {
+        wm->frame_pool_stats.misses++;
+        return NULL;
+    }
+    wm->frame_pool_stats.hits++;
+    pool->size--;
+    Frame* frame = pool->items[pool->size];
+
+    /* The decorations follow the new size with their win_gravity. */
+    Display* display = wm->display;
+    Window w = frame->window;
+    if (frame->desktop != wm->current_desktop) {
+        Window container = get_current_desktop(wm)->container;
+        XXReparentWindow(wm, display, w, container, x, y);
+    }
+    XXMoveResizeWindow(wm, display, w, x, y, width, height);
+    XXSetWindowBackground(wm, display, w, wm->focused_foreground_color);
+    /* The frame was unmapped, so Expose draws the marks again. */
+    frame->marks_width = frame->marks_height = 0;
+    frame->marks_exposed = False;
+
+    return frame;
+}
+
+static Bool
+park_frame(WindowManager* wm, Frame* frame)
+{
+    Array* pool = &wm->frame_pool;
+    if (FRAME_POOL_SIZE <= pool->size) {
+        return False;
+    }
+    Display* display = wm->display;
+    XXUnmapWindow(wm, display, frame->window);
+    if (frame->status != FOCUS_NONE) {
+        Pixmap pixmap = wm->decoration.buttons[FOCUS_NONE];
+        XXSetWindowBackgroundPixmap(wm, display, frame->buttons, pixmap);
+        frame->status = FOCUS_NONE;
+    }
+    frame->child = None;
+    append_to_array(pool, frame);
+    return True;
+}
+
+static void
+create_frame_windows(WindowManager* wm, Frame* frame, int x, int y, int width, int height)
+{
+    Display* display = wm->display;
+    XSetWindowAttributes swa;
+    swa.background_pixel = wm->focused_foreground_color;
+    swa.border_pixel = BlackPixel(display, DefaultScreen(display));
+    swa.event_mask = get_frame_event_mask();
+    /* The title and the corners are kept by the server while resizing. */
+    swa.bit_gravity = NorthWestGravity;
+    unsigned long mask = CWBackPixel | CWBorderPixel | CWBitGravity | CWEventMask;
+    Window w = XXCreateWindow(
+        wm,
+        display, get_current_desktop(wm)->container,
+        x, y,
+        width, height,
+        wm->border_size,
+        CopyFromParent, InputOutput, CopyFromParent,
+        mask, &swa);
+    track_window(wm, w);
+    WindowState* state = find_window_state(wm, w);
+    update_shadow_position(state, x, y);
+    update_shadow_size(state, width, height);
+
+    frame->window = w;
+    frame->status = FOCUS_NONE;
+    create_buttons(wm, frame, width);
+    XXMapSubwindows(wm, display, w);
+}
+
+static Frame*
+create_frame(WindowManager* wm, int x, int y, int child_width, int child_height)
+{
+    int width = child_width + compute_frame_width(wm);
+    int height = child_height + compute_frame_height(wm);
+    Frame* frame = take_pooled_frame(wm, x, y, width, height);
+    if (frame == NULL) {
+        frame = alloc_frame(wm);
+        create_frame_windows(wm, frame, x, y, width, height);
+    }
+    frame->wm_delete_window = False;
+    frame->width_inc = frame->height_inc = 1;
+    frame->grabbed = False;
+    frame->marks_width = frame->marks_height = 0;
+    frame->marks_exposed = False;
+    invalidate_glyph_run(&frame->title_run);
+    invalidate_glyph_run(&frame->list_run);
+
+    insert_frame(wm, frame);
+    log_resources(wm);
+
+    return frame;
+}
+
+static void
+move_frame_to_z_order_head(WindowManager* wm, Frame* frame)
+{
+    Desktop* desktop = get_desktop_of_frame(wm, frame);
+    Array* a = &desktop->z_order;
+    /* FIXME: Do it in one function. */
+    remove_from_array(a, frame);
+    prepend_to_array(a, frame);
+    schedule_restack(desktop);
+    spatial_restack(&wm->spatial.index, &frame->spatial, ++wm->spatial.top_z);
+}
+
+static int
+index_in_array(Array* a, Frame* f)
+{
+    int size = a->size;
+    int i;
+    for (i = 0; (i < size) && (a->items[i] != f); i++) {
+    }
+    return i == size ? -1 : i;
+}
+
+static void
+find_stable_frames(WindowManager* wm, int n)
+{
+    /*
+     * Frames in the longest increasing subsequence of positions (in the last
+     * applied order) are already in the desired order, so they are never
+     * moved. Frames of -1 (not applied yet) are never stable.
+     */
+    int* positions = wm->restack.positions;
+    int* tails = wm->restack.tails;
+    int* prev = wm->restack.prev;
+    Bool* stable = wm->restack.stable;
+    int len = 0;
+    int i;
+    for (i = 0; i < n; i++) {
+        stable[i] = False;
+        int pos = positions[i];
+        if (pos < 0) {
+            continue;
+        }
+        int lo = 0;
+        int hi = len;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (positions[tails[mid]] < pos) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        prev[i] = 0 < lo ? tails[lo - 1] : -1;
+        tails[lo] = i;
+        len = lo == len ? len + 1 : len;
+    }
+    for (i = 0 < len ? tails[len - 1] : -1; 0 <= i; i = prev[i]) {
+        stable[i] = True;
+    }
+}
+
+static int
+flush_restack_run(WindowManager* wm, Window* windows, int nwindows)
+{
+    /* XRestackWindows() does not move the first window. */
+    if (1 < nwindows) {
+        XXRestackWindows(wm, wm->display, windows, nwindows);
+    }
+    return 0;
+}
+
+static void
+reserve_restack_arrays(WindowManager* wm, int n)
+{
+    if (n <= wm->restack.capacity) {
+        return;
+    }
+    int capacity = MAX(2 * wm->restack.capacity, n);
+    free(wm->restack.positions);
+    free(wm->restack.tails);
+    free(wm->restack.prev);
+    free(wm->restack.stable);
+    free(wm->restack.windows);
+    wm->restack.positions = (int*)alloc_memory(sizeof(int) * capacity);
+    wm->restack.tails = (int*)alloc_memory(sizeof(int) * capacity);
+    wm->restack.prev = (int*)alloc_memory(sizeof(int) * capacity);
+    wm->restack.stable = (Bool*)alloc_memory(sizeof(Bool) * capacity);
+    wm->restack.windows = (Window*)alloc_memory(sizeof(Window) * (capacity + 1));
+    wm->restack.capacity = capacity;
+}
+
+static void
+restack_frames(WindowManager* wm, Desktop* desktop)
+{
+    if (!desktop->dirty) {
+        return;
+    }
+    desktop->dirty = False;
+
+    Array* desired = &desktop->z_order;
+    Array* applied = &desktop->applied;
+    int n = desired->size;
+    if (n == 0) {
+        applied->size = 0;
+        return;
+    }
+    reserve_restack_arrays(wm, n);
+    int* positions = wm->restack.positions;
+    Bool* stable = wm->restack.stable;
+    Window* windows = wm->restack.windows;
+    unsigned int stamp = ++wm->restack.stamp;
+    int i;
+    for (i = 0; i < applied->size; i++) {
+        Frame* frame = applied->items[i];
+        frame->applied_index = i;
+        frame->applied_stamp = stamp;
+    }
+    for (i = 0; i < n; i++) {
+        Frame* frame = desired->items[i];
+        positions[i] = frame->applied_stamp == stamp ? frame->applied_index : -1;
+    }
+    find_stable_frames(wm, n);
+
+    /*
+     * Each moved frame is put just below the previous one in the desired
+     * order. Consecutive moved frames are sent by one XRestackWindows().
+     */
+    int moves = 0;
+    int nwindows = 0;
+    for (i = 0; i < n; i++) {
+        if (stable[i]) {
+            nwindows = flush_restack_run(wm, windows, nwindows);
+            continue;
+        }
+        moves++;
+        Window w = desired->items[i]->window;
+        if (i == 0) {
+            XXRaiseWindow(wm, wm->display, w);
+            windows[0] = w;
+            nwindows = 1;
+            continue;
+        }
+        if (nwindows == 0) {
+            windows[0] = desired->items[i - 1]->window;
+            nwindows = 1;
+        }
+        windows[nwindows] = w;
+        nwindows++;
+    }
+    flush_restack_run(wm, windows, nwindows);
+    wm->restack_requests += moves;
+    LOG(wm, "restack: frames=%d, moved=%d, total=%d", n, moves, wm->restack_requests);
+
+    applied->size = 0;
+    for (i = 0; i < n; i++) {
+        append_to_array(applied, desired->items[i]);
+    }
+}
+
+static void
+expose(WindowManager* wm, Window w)
+{
+    XXClearArea(wm, wm->display, w, 0, 0, 0, 0, True);
+}
+
+/*
+ * One handler may change the taskbar twice, like focusing a new frame and
+ * listing it. Until the Expose of the first clear comes, another one is not
+ * needed. A clear without Expose (of an unmapped taskbar) is forgotten at
+ * the end of the batch.
+ */
+static void
+expose_taskbar(WindowManager* wm)
+{
+    if (wm->taskbar.exposed) {
+        return;
+    }
+    wm->taskbar.exposed = True;
+    int i;
+    for (i = 0; i < wm->taskbar.bars_num; i++) {
+        expose(wm, wm->taskbar.bars[i].window);
+    }
+}
+
+static Taskbar*
+search_taskbar(WindowManager* wm, Window w)
+{
+    int i;
+    for (i = 0; i < wm->taskbar.bars_num; i++) {
+        Taskbar* bar = &wm->taskbar.bars[i];
+        if (bar->window == w) {
+            return bar;
+        }
+    }
+    return NULL;
+}
+
+static Output*
+get_output_of_taskbar(WindowManager* wm, Taskbar* bar)
+{
+    return &wm->outputs[bar - wm->taskbar.bars];
+}
+
+static void
+grab_click(WindowManager* wm, Frame* frame)
+{
+    if (frame->grabbed) {
+        return;
+    }
+    XXGrabButton(wm, wm->display, Button1, AnyModifier, frame->child, True, ButtonPressMask, GrabModeSync, GrabModeAsync, None, None);
+    frame->grabbed = True;
+}
+
+static void
+ungrab_click(WindowManager* wm, Frame* frame)
+{
+    if (!frame->grabbed) {
+        return;
+    }
+    XXUngrabButton(wm, wm->display, Button1, AnyModifier, frame->child);
+    frame->grabbed = False;
+}
+
+static void
+set_focused_frame(WindowManager* wm, Frame* frame)
+{
+    Frame* prev = wm->focused_frame;
+    if (prev == frame) {
+        return;
+    }
+    if (prev != NULL) {
+        grab_click(wm, prev);
+    }
+    if (frame != NULL) {
+        ungrab_click(wm, frame);
+    }
+    wm->focused_frame = frame;
+}
+
+static void
+focus(WindowManager* wm, Frame* frame)
+{
+    if (frame->desktop != wm->current_desktop) {
+        /* An invisible window cannot be focused. It will be when shown. */
+        if (wm->focused_frame != frame) {
+            grab_click(wm, frame);
+        }
+        move_frame_to_z_order_head(wm, frame);
+        return;
+    }
+    /* The taskbar shows the focused window only, not the z-order. */
+    Bool changed = wm->focused_frame != frame;
+    set_focused_frame(wm, frame);
+    move_frame_to_z_order_head(wm, frame);
+    XXSetInputFocus(wm, wm->display, frame->child, RevertToNone, CurrentTime);
+    if (changed) {
+        expose_taskbar(wm);
+    }
+}
+
+static void
+read_protocol(WindowManager* wm, Frame* frame, Atom atom)
+{
+    if (atom == wm->atoms.wm_delete_window) {
+        frame->wm_delete_window = True;
+    }
+}
+
+static void
+read_protocols(WindowManager* wm, Frame* frame)
+{
+    Atom* protos;
+    int n;
+    if (XXGetWMProtocols(wm, wm->display, frame->child, &protos, &n) == 0) {
+        return;
+    }
+    int i;
+    for (i = 0; i < n; i++) {
+        read_protocol(wm, frame, protos[i]);
+    }
+    XFree(protos);
+}
+
+static Status
+__XGetWMNormalHints__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, XSizeHints* hints, long* supplied_return)
+{
+    LOG_X(filename, lineno, wm, "XGetWMNormalHints(display, w=0x%08x, hints=%p, supplied_return=%p)", w, hints, supplied_return);
+    count_round_trip(wm);
+    return wm->backend->get_wm_normal_hints(display, w, hints, supplied_return);
+}
+
+#define XXGetWMNormalHints(wm, a, b, c, d) \
+    __XGetWMNormalHints__(__FILE__, __LINE__, (wm), (a), (b), (c), (d))
+
+static void
+get_normal_hints(WindowManager* wm, Window w, XSizeHints* hints)
+{
+    long _;
+    if (XXGetWMNormalHints(wm, wm->display, w, hints, &_) == 0) {
+        hints->flags = 0;
+    }
+}
+
+static void
+set_resize_increments(WindowManager* wm, Frame* frame, XSizeHints* hints)
+{
+    if ((hints->flags & PResizeInc) == 0) {
+        return;
+    }
+    frame->width_inc = hints->width_inc;
+    frame->height_inc = hints->height_inc;
+    LOG(wm, "PResizeInc: window=0x%08x, width_inc=%d, height_inc=%d", frame->child, hints->width_inc, hints->height_inc);
+}
+
+static int
+search_output(WindowManager* wm, int x, int y)
+{
+    int i;
+    for (i = 0; i < wm->outputs_num; i++) {
+        Output* output = &wm->outputs[i];
+        if ((x < output->x) || (output->x + output->width <= x)) {
+            continue;
+        }
+        if ((y < output->y) || (output->y + output->height <= y)) {
+            continue;
+        }
+        return i;
+    }
+    return -1;
+}
+
+static Output*
+find_output(WindowManager* wm, int x, int y)
+{
+    int index = search_output(wm, x, y);
+    return &wm->outputs[index < 0 ? 0 : index];
+}
+
+/*
+ * Moves a rectangle into the output which has its top-left corner, so that a
+ * window neither lies across monitors nor hides under the taskbar.
+ */
+static void
+fit_in_output(WindowManager* wm, int* x, int* y, int width, int height)
+{
+    Output* output = find_output(wm, *x, *y);
+    int right = output->x + output->width;
+    if (right < *x + width) {
+        *x = right - width;
+    }
+    if (*x < output->x) {
+        *x = output->x;
+    }
+    int bottom = output->y + output->height - wm->taskbar.height;
+    if (bottom < *y + height) {
+        *y = bottom - height;
+    }
+    if (*y < output->y) {
+        *y = output->y;
+    }
+}
+
+/*
+ * Puts a new frame where it overlaps the fewest others in the output which has
+ * the focused frame.
+ */
+static void
+place_frame(WindowManager* wm, int* x, int* y, int width, int height)
+{
+    long start = get_monotonic_usec();
+    Array* z_order = &get_current_desktop(wm)->z_order;
+    Output* output = find_output(wm, *x, *y);
+    /* The index knows the geometry, so that no round trip is needed. */
+    SpatialEntry* focused = 0 < z_order->size ? &z_order->items[0]->spatial : NULL;
+    if ((focused != NULL) && focused->indexed) {
+        SpatialRect* rect = &focused->rect;
+        int center_x = rect->x + rect->width / 2;
+        int center_y = rect->y + rect->height / 2;
+        output = find_output(wm, center_x, center_y);
+    }
+    SpatialRect bounds;
+    bounds.x = output->x;
+    bounds.y = output->y;
+    bounds.width = output->width;
+    bounds.height = output->height - wm->taskbar.height;
+    SpatialIndex* index = &wm->spatial.index;
+    int layer = wm->current_desktop;
+    spatial_place(index, layer, &bounds, width, height, x, y);
+    long elapsed = get_monotonic_usec() - start;
+
+#define FMT "place_frame: x=%d, y=%d, width=%d, height=%d, frames=%d, %ld usec"
+    LOG(wm, FMT, *x, *y, width, height, z_order->size, elapsed);
+#undef FMT
+}
+
+/*
+ * Returns the key of the application of the window in geometries, or 0 for a
+ * window without WM_CLASS.
+ */
+static uint64_t
+read_geometry_key(WindowManager* wm, Window w)
+{
+    Display* display = wm->display;
+    XTextProperty class_hint;
+    if (XXGetTextProperty(wm, display, w, &class_hint, XA_WM_CLASS) == 0) {
+        return 0;
+    }
+    if (class_hint.nitems == 0) {
+        XXFree(wm, class_hint.value);
+        return 0;
+    }
+    XTextProperty role;
+    if (XXGetTextProperty(wm, display, w, &role, wm->atoms.wm_window_role) == 0) {
+        role.value = NULL;
+        role.nitems = 0;
+    }
+    const char* s = (const char*)class_hint.value;
+    const char* t = role.value != NULL ? (const char*)role.value : "";
+    uint64_t key = geometries_make_key(s, class_hint.nitems, t, role.nitems);
+    XXFree(wm, class_hint.value);
+    if (role.value != NULL) {
+        XXFree(wm, role.value);
+    }
+    return key;
+}
+
+static Bool
+lookup_geometry(WindowManager* wm, uint64_t key, GeometryEntry* entry)
+{
+    if ((key == 0) || !geometries_lookup(wm->geometries, key, entry)) {
+        return False;
+    }
+    /* The file may be broken. */
+    return (0 < entry->width) && (entry->width < 32768) && (0 < entry->height) && (entry->height < 32768);
+}
+
+/*
+ * A window which is mapped at startup keeps its position. So does a window
+ * whose position was given by a user or a program. A new window of a known
+ * application gets the last geometry of it, unless a user gave another one.
+ * The client is resized before it is mapped, so that it draws only once.
+ */
+static void
+reparent_window_of_attributes(WindowManager* wm, Window w, XWindowAttributes* attrs, Bool place)
+{
+    LOG(wm, "reparent_window: w=0x%08x", w);
+    Display* display = wm->display;
+    XWindowAttributes wa = *attrs;
+    XSizeHints hints;
+    get_normal_hints(wm, w, &hints);
+    uint64_t key = read_geometry_key(wm, w);
+    GeometryEntry remembered;
+    Bool known = place && lookup_geometry(wm, key, &remembered);
+    int width = wa.width;
+    int height = wa.height;
+    if (known && ((hints.flags & USSize) == 0)) {
+        width = remembered.width;
+        height = remembered.height;
+    }
+    int frame_x = wa.x;
+    int frame_y = wa.y;
+    int frame_width = width + compute_frame_width(wm);
+    int frame_height = height + compute_frame_height(wm);
+    if (known && ((hints.flags & USPosition) == 0)) {
+        frame_x = remembered.x;
+        frame_y = remembered.y;
+    }
+    else if (place && ((hints.flags & (USPosition | PPosition)) == 0)) {
+        place_frame(wm, &frame_x, &frame_y, frame_width, frame_height);
+    }
+    fit_in_output(wm, &frame_x, &frame_y, frame_width, frame_height);
+    Frame* frame = create_frame(wm, frame_x, frame_y, width, height);
+    frame->child = w;
+    frame->geometry_key = key;
+    if ((width != wa.width) || (height != wa.height)) {
+        LOG(wm, "remembered geometry: window=0x%08x, width=%d, height=%d", w, width, height);
+        XXResizeWindow(wm, display, w, width, height);
+    }
+    track_window(wm, w);
+    /* A property of a client is notified only to ones which select it. */
+    change_event_mask(wm, w, PropertyChangeMask);
+    get_window_name(wm, frame->title, array_sizeof(frame->title), w);
+    LOG(wm, "Window Name: window=0x%08x, name=%s", w, frame->title);
+    int frame_size = wm->frame_size;
+    int x = frame_size;
+    int y = 2 * frame_size + wm->title_height;
+    XXSetWindowBorderWidth(wm, display, w, wm->client_border_size);
+    Window parent = frame->window;
+    LOG(wm, "Reparenting: frame=0x%08x, child=0x%08x", parent, w);
+    XXReparentWindow(wm, display, w, parent, x, y);
+
+    set_resize_increments(wm, frame, &hints);
+    read_protocols(wm, frame);
+
+    XXMapWindow(wm, display, frame->window);
+    XXMapWindow(wm, display, w);
+    focus(wm, frame);
+    XXAddToSaveSet(wm, display, w);
+}
+
+static void
+reparent_window(WindowManager* wm, Window w, Bool place)
+{
+    XWindowAttributes wa;
+    if (XXGetWindowAttributes(wm, wm->display, w, &wa) == 0) {
+        return;
+    }
+    reparent_window_of_attributes(wm, w, &wa, place);
+}
+
+/* The attributes which tell the map state are used for the frame too. */
+static void
+reparent_mapped_child(WindowManager* wm, Window w)
+{
+    /* The container of the current desktop is mapped already. */
+    if (is_container(wm, w)) {
+        return;
+    }
+    XWindowAttributes wa;
+    if (XXGetWindowAttributes(wm, wm->display, w, &wa) == 0) {
+        return;
+    }
+    if (wa.map_state == IsUnmapped) {
+        return;
+    }
+    reparent_window_of_attributes(wm, w, &wa, False);
+}
+
+static void
+reparent_toplevels(WindowManager* wm)
+{
+    Display* display = wm->display;
+    Window root = DefaultRootWindow(display);
+    Window _;
+    Window* children;
+    unsigned int nchildren;
+    if (XXQueryTree(wm, display, root, &_, &_, &children, &nchildren) == 0) {
+        print_error("XQueryTree failed.");
+        return;
+    }
+    int i;
+    for (i = 0; i < nchildren; i++) {
+        reparent_mapped_child(wm, children[i]);
+    }
+    XXFree(wm, children);
+}
+
+/* Values of colors which fawm uses, from rgb.txt of X11 */
+static struct {
+    const char* name;
+    unsigned char red;
+    unsigned char green;
+    unsigned char blue;
+} builtin_colors[] = {
+    { "black", 0, 0, 0 },
+    { "light grey", 211, 211, 211 },
+    { "light pink", 255, 182, 193 },
+};
+
+static Bool
+lookup_builtin_color(const char* name, XColor* color)
+{
+    int i;
+    for (i = 0; i < array_sizeof(builtin_colors); i++) {
+        if (strcasecmp(builtin_colors[i].name, name) != 0) {
+            continue;
+        }
+        color->red = builtin_colors[i].red * 0x101;
+        color->green = builtin_colors[i].green * 0x101;
+        color->blue = builtin_colors[i].blue * 0x101;
+        color->flags = DoRed | DoGreen | DoBlue;
+        return True;
+    }
+    return False;
+}
+
+/* Same as XftColorAllocValue() does for TrueColor */
+static unsigned long
+scale_to_mask(unsigned short value, unsigned long mask)
+{
+    int shift = 0;
+    for (; (mask & 1) == 0; mask >>= 1) {
+        shift++;
+    }
+    int bits = 0;
+    for (; (mask & 1) == 1; mask >>= 1) {
+        bits++;
+    }
+    return ((unsigned long)value >> (16 - bits)) << shift;
+}
+
+/*
+ * With TrueColor, a pixel is computed from the value, so that known colors
+ * are resolved without any round trips. Others are allocated one by one.
+ */
+static void
+alloc_colors(WindowManager* wm, const char* names[], XColor colors[], int n)
+{
+    Display* display = wm->display;
+    int screen = DefaultScreen(display);
+    Visual* visual = DefaultVisual(display, screen);
+    Colormap colormap = DefaultColormap(display, screen);
+    int i;
+    for (i = 0; i < n; i++) {
+        XColor* c = &colors[i];
+        if ((visual->class == TrueColor) && lookup_builtin_color(names[i], c)) {
+            c->pixel = 0
+                | scale_to_mask(c->red, visual->red_mask)
+                | scale_to_mask(c->green, visual->green_mask)
+                | scale_to_mask(c->blue, visual->blue_mask);
+            continue;
+        }
+        XColor exact;
+        if (XXAllocNamedColor(wm, display, colormap, names[i], c, &exact) == 0) {
+            bzero(c, sizeof(*c));
+            c->pixel = BlackPixel(display, screen);
+            continue;
+        }
+        c->red = exact.red;
+        c->green = exact.green;
+        c->blue = exact.blue;
+    }
+}
+
+static int
+__XFreeGC__(const char* filename, int lineno, WindowManager* wm, Display* display, GC gc)
+{
+    LOG_X0(filename, lineno, wm, "XFreeGC(display, gc)");
+    wm->resources.gcs--;
+    return wm->backend->free_gc(display, gc);
+}
+
+#define XXFreeGC(wm, display, gc) \
+    __XFreeGC__(__FILE__, __LINE__, (wm), (display), (gc))
+
+static void
+remove_frame(WindowManager* wm, Frame* frame)
+{
+    Desktop* desktop = get_desktop_of_frame(wm, frame);
+    remove_from_array(&wm->all_frames, frame);
+    remove_from_array(&desktop->frames, frame);
+    remove_from_array(&desktop->z_order, frame);
+    /* The struct may be reused for another client. */
+    remove_from_array(&desktop->applied, frame);
+    if (wm->focused_frame == frame) {
+        wm->focused_frame = NULL;
+    }
+    find_window_state(wm, frame->window)->frame = NULL;
+    spatial_remove(&wm->spatial.index, &frame->spatial);
+    release_frame_draw(wm, frame);
+}
+
+static int
+__XDestroyWindow__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
+{
+    LOG_X(filename, lineno, wm, "XDestroyWindow(display, w=0x%08x)", w);
+    return wm->backend->destroy_window(display, w);
+}
+
+#define XXDestroyWindow(wm, a, b) \
+    __XDestroyWindow__(__FILE__, __LINE__, (wm), (a), (b))
+
+/* Geometries are remembered when clients are closed, and when fawm exits. */
+static void
+remember_geometry(WindowManager* wm, Frame* frame)
+{
+    if (frame->geometry_key == 0) {
+        return;
+    }
+    int x;
+    int y;
+    unsigned int width;
+    unsigned int height;
+    get_window_geometry(wm, frame->window, &x, &y, &width, &height);
+    int child_width = width - compute_frame_width(wm);
+    int child_height = height - compute_frame_height(wm);
+    if ((child_width <= 0) || (child_height <= 0)) {
+        return;
+    }
+    geometries_store(wm->geometries, frame->geometry_key, x, y, child_width, child_height);
+}
+
+static void
+destroy_frame(WindowManager* wm, Frame* frame)
+{
+    remember_geometry(wm, frame);
+    remove_frame(wm, frame);
+    if (!park_frame(wm, frame)) {
+        Window w = frame->window;
+        dispose_frame(wm, frame);
+        forget_window(wm, w);
+        XXDestroyWindow(wm, wm->display, w);
+    }
+    log_resources(wm);
+}
+
+static void
+focus_top_frame(WindowManager* wm)
+{
+    /* Callers removed or hid a frame, or changed the desktop. */
+    expose_taskbar(wm);
+    Array* z_order = &get_current_desktop(wm)->z_order;
+    if (z_order->size == 0) {
+        return;
+    }
+    focus(wm, z_order->items[0]);
+}
+
+static void
+switch_desktop(WindowManager* wm, int n)
+{
+    if (n == wm->current_desktop) {
+        return;
+    }
+    long start = get_monotonic_usec();
+    Display* display = wm->display;
+    Desktop* prev = get_current_desktop(wm);
+    Desktop* next = &wm->desktops[n];
+    /* The new desktop is mapped first not to show the root window between. */
+    XXMapWindow(wm, display, next->container);
+    XXUnmapWindow(wm, display, prev->container);
+    wm->current_desktop = n;
+    focus_top_frame(wm);
+    long elapsed = get_monotonic_usec() - start;
+
+#define FMT "switch desktop: %d -> %d, frames=%d, %ld usec"
+    LOG(wm, FMT, prev - wm->desktops, n, next->frames.size, elapsed);
+#undef FMT
+}
+
+static int
+search_output_of_frame(WindowManager* wm, Frame* frame)
+{
+    int x;
+    int y;
+    unsigned int width;
+    unsigned int height;
+    get_window_geometry(wm, frame->window, &x, &y, &width, &height);
+    int index = search_output(wm, x + width / 2, y + height / 2);
+    return index < 0 ? 0 : index;
+}
+
+/*
+ * Returns frames of the current desktop whose centers are on the output of the
+ * taskbar. The array is overwritten by the next call.
+ */
+static Array*
+list_frames_of_taskbar(WindowManager* wm, Taskbar* bar)
+{
+    int output = bar - wm->taskbar.bars;
+    Array* listed = &wm->taskbar.listed;
+    listed->size = 0;
+    Array* frames = &get_current_desktop(wm)->frames;
+    int i;
+    for (i = 0; i < frames->size; i++) {
+        Frame* frame = frames->items[i];
+        if (search_output_of_frame(wm, frame) != output) {
+            continue;
+        }
+        append_to_array(listed, frame);
+    }
+    shrink_array(listed);
+    return listed;
+}
+
+static int
+compute_window_list_x(int taskbar_height)
+{
+    /* The menu button and cells of the pager are on the left of the list. */
+    return taskbar_height * (1 + DESKTOPS_NUM);
+}
+
+static void
+process_destroy_notify(WindowManager* wm, XDestroyWindowEvent* e)
+{
+    Window w = e->window;
+    LOG(wm, "process_destroy_notify: event=0x%08x, window=0x%08x", e->event, w);
+    Frame* frame = search_frame_of_child(wm, w);
+    if (frame == NULL) {
+        return;
+    }
+    forget_window(wm, w);
+    destroy_frame(wm, frame);
+    focus_top_frame(wm);
+}
+
+static Bool
+is_range_inside(int range_begin, int range_size, int n)
+{
+    return (range_begin <= n) && (n < range_begin + range_size);
+}
+
+static Bool
+is_region_inside(int region_x, int region_y, int region_width, int region_height, int x, int y)
+{
+    if (!is_range_inside(region_x, region_width, x)) {
+        return False;
+    }
+    if (!is_range_inside(region_y, region_height, y)) {
+        return False;
+    }
+    return True;
+}
+
+static void
+release_frame(WindowManager* wm)
+{
+    int steps = wm->resize_stats.steps;
+    if (0 < steps) {
+        int exposes = wm->resize_stats.exposes;
+        LOG(wm, "resize: steps=%d, exposes=%d", steps, exposes);
+    }
+    bzero(&wm->resize_stats, sizeof(wm->resize_stats));
+    wm->grasped_position = GP_NONE;
+}
+
+static void
+grasp_frame(WindowManager* wm, GraspedPosition pos, Window w, int x, int y)
+{
+    wm->grasped_position = pos;
+    wm->grasped_frame = w;
+    wm->grasped_x = x;
+    wm->grasped_y = y;
+
+    unsigned int width;
+    unsigned int height;
+    get_geometry(wm, w, &width, &height);
+    wm->grasped_width = width;
+    wm->grasped_height = height;
+    wm->grasped_output = search_output_of_frame(wm, search_frame(wm, w));
+}
+
+static void
+map_popup_menu(WindowManager* wm, int x, int y)
+{
+    Display* display = wm->display;
+    Window w = wm->popup_menu.window;
+    unsigned int menu_width;
+    unsigned int menu_height;
+    get_geometry(wm, w, &menu_width, &menu_height);
+    /* The menu is kept in the output of the pointer. */
+    Output* output = find_output(wm, x, y);
+    int menu_x = x;
+    int menu_y = y + 1;
+    if (output->x + output->width < menu_x + menu_width) {
+        menu_x = x - menu_width;
+    }
+    if (output->y + output->height < menu_y + menu_height) {
+        menu_y = y - menu_height - 1;
+    }
+
+    wm->popup_menu.selected_item = -1;
+    XXMoveWindow(wm, display, w, menu_x, menu_y);
+    XXMapRaised(wm, display, w);
+}
+
+static GraspedPosition
+detect_frame_position(WindowManager* wm, Window w, int x, int y)
+{
+    unsigned int width;
+    unsigned int height;
+    get_geometry(wm, w, &width, &height);
+    int frame_size = wm->frame_size;
+    int corner_size = wm->resizable_corner_size;
+    int virt_corner_size = corner_size - frame_size;
+
+    if (is_region_inside(0, frame_size, frame_size, virt_corner_size, x, y)) {
+        return GP_NORTH_WEST;
+    }
+    if (is_region_inside(0, 0, corner_size, frame_size, x, y)) {
+        return GP_NORTH_WEST;
+    }
+
+    int middle_width = width - 2 * corner_size;
+    if (is_region_inside(corner_size, 0, middle_width, frame_size, x, y)) {
+        return GP_NORTH;
+    }
+
+    int east_corner_x = width - corner_size;
+    if (is_region_inside(east_corner_x, 0, corner_size, frame_size, x, y)) {
+        return GP_NORTH_EAST;
+    }
+    int virt_east_x = width - frame_size;
+    if (is_region_inside(virt_east_x, frame_size, frame_size, virt_corner_size, x, y)) {
+        return GP_NORTH_EAST;
+    }
+
+    int middle_height = height - 2 * corner_size;
+    if (is_region_inside(virt_east_x, corner_size, frame_size, middle_height, x, y)) {
+        return GP_EAST;
+    }
+
+    if (is_region_inside(virt_east_x, height - corner_size, frame_size, virt_corner_size, x, y)) {
+        return GP_SOUTH_EAST;
+    }
+    int bottom_y = height - frame_size;
+    if (is_region_inside(east_corner_x, bottom_y, corner_size, frame_size, x, y)) {
+        return GP_SOUTH_EAST;
+    }
+
+    if (is_region_inside(corner_size, height - frame_size, middle_width, frame_size, x, y)) {
+        return GP_SOUTH;
+    }
+
+    if (is_region_inside(0, bottom_y, corner_size, frame_size, x, y)) {
+        return GP_SOUTH_WEST;
+    }
+    if (is_region_inside(0, height - corner_size, frame_size, corner_size - frame_size, x, y)) {
+        return GP_SOUTH_WEST;
+    }
+
+    if (is_region_inside(0, corner_size, frame_size, middle_height, x, y)) {
+        return GP_WEST;
+    }
+
+    if (is_region_inside(0, 0, width, height, x, y)) {
+        return GP_TITLE_BAR;
+    }
+
+    return GP_NONE;
+}
+
+static void
+close_frame(WindowManager* wm, Frame* frame)
+{
+    Display* display = wm->display;
+    Window child = frame->child;
+    if (!frame->wm_delete_window) {
+        XXKillClient(wm, display, child);
+        return;
+    }
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.xclient.type = ClientMessage;
+    e.xclient.window = child;
+    e.xclient.message_type = wm->atoms.wm_protocols;
+    e.xclient.format = 32;
+    e.xclient.data.l[0] = wm->atoms.wm_delete_window;
+    e.xclient.data.l[1] = CurrentTime;
+    XXSendEvent(wm, display, child, False, 0, &e);
+}
+
+static void
+focus_window_of_taskbar(WindowManager* wm, Taskbar* bar, int x, int y)
+{
+    if (bar->clock_x < x) {
+        return;
+    }
+    Display* display = wm->display;
+    int taskbar_height = wm->taskbar.height;
+    if (x < taskbar_height) {
+        Output* output = get_output_of_taskbar(wm, bar);
+        int menu_y = output->y + output->height - taskbar_height;
+        map_popup_menu(wm, output->x, menu_y);
+        return;
+    }
+    int list_x = compute_window_list_x(taskbar_height);
+    if (x < list_x) {
+        switch_desktop(wm, x / taskbar_height - 1);
+        return;
+    }
+
+    Array* frames = list_frames_of_taskbar(wm, bar);
+    int nframes = frames->size;
+    if (nframes == 0) {
+        return;
+    }
+    int list_right_x = bar->clock_x - wm->padding_size;
+    int item_width = (list_right_x - list_x) / nframes;
+    int index = 0 < item_width ? (x - list_x) / item_width : nframes;
+    if (nframes <= index) {
+        return;
+    }
+    Frame* frame = frames->items[index];
+    XXMapWindow(wm, display, frame->window);
+    focus(wm, frame);
+}
+
+static void
+unmap_frame(WindowManager* wm, Frame* frame)
+{
+    remove_from_array(&get_desktop_of_frame(wm, frame)->z_order, frame);
+    XXUnmapWindow(wm, wm->display, frame->window);
+    if (wm->focused_frame == frame) {
+        /*
+         * A closed client is often destroyed already, so a click is not
+         * grabbed on it. focus() grabs it when the window is mapped again.
+         */
+        wm->focused_frame = NULL;
+    }
+
+    if (frame->desktop != wm->current_desktop) {
+        return;
+    }
+    focus_top_frame(wm);
+}
+
+static void
+process_button_press(WindowManager* wm, XButtonEvent* e)
+{
+    LOG(wm, "process_button_press: window=0x%08x, root=0x%08x, subwindow=0x%08x", e->window, e->root, e->subwindow);
+    if (e->button != Button1) {
+        return;
+    }
+    Window w = e->window;
+    Display* display = wm->display;
+    if ((w == DefaultRootWindow(display)) || is_container(wm, w)) {
+        map_popup_menu(wm, e->x_root, e->y_root);
+        return;
+    }
+    Taskbar* bar = search_taskbar(wm, w);
+    if (bar != NULL) {
+        focus_window_of_taskbar(wm, bar, e->x, e->y);
+        return;
+    }
+    Frame* frame = search_frame_of_child(wm, w);
+    if (frame != NULL) {
+        focus(wm, frame);
+        XXAllowEvents(wm, display, ReplayPointer, CurrentTime);
+        return;
+    }
+    frame = search_frame(wm, w);
+    if (frame == NULL) {
+        return;
+    }
+    if (frame->status == FOCUS_CLOSE) {
+        close_frame(wm, frame);
+        return;
+    }
+    if (frame->status == FOCUS_MINIMIZE) {
+        unmap_frame(wm, frame);
+        return;
+    }
+    focus(wm, frame);
+    int x = e->x;
+    int y = e->y;
+    grasp_frame(wm, detect_frame_position(wm, w, x, y), w, x, y);
+}
+
+static void
+unmap_popup_menu(WindowManager* wm)
+{
+    XXUnmapWindow(wm, wm->display, wm->popup_menu.window);
+}
+
+static void
+resize_child(WindowManager* wm, Window w, int frame_width, int frame_height)
+{
+    int width = frame_width - compute_frame_width(wm);
+    int height = frame_height - compute_frame_height(wm);
+    XXResizeWindow(wm, wm->display, w, width, height);
+}
+
+static void
+follow_frame_size(WindowManager* wm, Frame* frame, int width, int height)
+{
+    wm->resize_stats.steps++;
+    resize_child(wm, frame->child, width, height);
+    refresh_title(wm, frame, width);
+    refresh_corner_marks(wm, frame, width, height);
+}
+
+static int
+compute_font_height(XftFont* font)
+{
+    return font->ascent + font->descent;
+}
+
+static int
+detect_selected_popup_item(WindowManager* wm, int x, int y)
+{
+    int menu_x;
+    int menu_y;
+    unsigned int width;
+    unsigned int height;
+    Window w = wm->popup_menu.window;
+    get_window_geometry(wm, w, &menu_x, &menu_y, &width, &height);
+    if (!is_region_inside(menu_x, menu_y, width, height, x, y)) {
+        return -1;
+    }
+    int index = (y - menu_y) / compute_font_height(wm->title_font);
+    return wm->config->menu.ptr->items_num <= index ? -1 : index;
+}
+
+static const char* caption_of_exit = "exit";
+static const char* caption_of_reload = "reload";
+static const char* caption_of_cascade = "cascade";
+static const char* caption_of_grid = "grid";
+static const char* caption_of_tile = "tile";
+static const char* caption_of_restart = "restart";
+
+static const char*
+get_menu_item_caption(MenuItem* item)
+{
+    switch (item->type) {
     case MENU_ITEM_TYPE_EXIT:
         return caption_of_exit;
     case MENU_ITEM_TYPE_EXEC:
         return item->u.exec.caption.ptr;
     case MENU_ITEM_TYPE_RELOAD:
         return caption_of_reload;
+    case MENU_ITEM_TYPE_CASCADE:
+        return caption_of_cascade;
+    case MENU_ITEM_TYPE_GRID:
+        return caption_of_grid;
+    case MENU_ITEM_TYPE_TILE:
+        return caption_of_tile;
+    case MENU_ITEM_TYPE_RESTART:
+        return caption_of_restart;
     default:
         assert(false);
         break;
     }
-    return NULL;
+    return NULL;
+}
+
+static void
+draw_popup_menu(WindowManager* wm)
+{
+    Window w = wm->popup_menu.window;
+    unsigned int window_width;
+    unsigned int _;
+    get_geometry(wm, w, &window_width, &_);
+
+    XftFont* font = wm->title_font;
+    int item_height = font->ascent + font->descent;
+
+    int selected_item = wm->popup_menu.selected_item;
+    if (0 <= selected_item) {
+        Display* display = wm->display;
+        GC gc = wm->gcs.focused_gc;
+        int y = item_height * selected_item;
+        XXFillRectangle(wm, display, w, gc, 0, y, window_width, item_height);
+    }
+
+    XftDraw* draw = wm->popup_menu.draw;
+    int y = - font->descent;
+    Menu* menu = wm->config->menu.ptr;
+    int items_num = menu->items_num;
+    int i;
+    for (i = 0; i < items_num; i++) {
+        y += item_height;
+        const char* caption = get_menu_item_caption(&menu->items.ptr[i]);
+        draw_title_font_string(wm, draw, wm->popup_menu.margin, y, caption);
+    }
+}
+
+static void
+highlight_selected_popup_item(WindowManager* wm, int x, int y)
+{
+    int new_item = detect_selected_popup_item(wm, x, y);
+    if (new_item == wm->popup_menu.selected_item) {
+        return;
+    }
+    wm->popup_menu.selected_item = new_item;
+    expose(wm, wm->popup_menu.window);
+}
+
+static void
+change_cursor(WindowManager* wm, Window w, int x, int y)
+{
+    Cursor cursor;
+    switch (detect_frame_position(wm, w, x, y)) {
+    case GP_NONE:
+    case GP_TITLE_BAR:
+        cursor = get_cursor(wm, &wm->normal_cursor, XC_top_left_arrow);
+        break;
+    case GP_NORTH:
+        cursor = get_cursor(wm, &wm->top_cursor, XC_top_side);
+        break;
+    case GP_NORTH_EAST:
+        cursor = get_cursor(wm, &wm->top_right_cursor, XC_top_right_corner);
+        break;
+    case GP_EAST:
+        cursor = get_cursor(wm, &wm->right_cursor, XC_right_side);
+        break;
+    case GP_SOUTH_EAST:
+        cursor = get_cursor(wm, &wm->bottom_right_cursor, XC_bottom_right_corner);
+        break;
+    case GP_SOUTH:
+        cursor = get_cursor(wm, &wm->bottom_cursor, XC_bottom_side);
+        break;
+    case GP_SOUTH_WEST:
+        cursor = get_cursor(wm, &wm->bottom_left_cursor, XC_bottom_left_corner);
+        break;
+    case GP_WEST:
+        cursor = get_cursor(wm, &wm->left_cursor, XC_left_side);
+        break;
+    case GP_NORTH_WEST:
+        cursor = get_cursor(wm, &wm->top_left_cursor, XC_top_left_corner);
+        break;
+    default:
+        assert(False);
+        return; /* A statement to surpress GCC warning. */
+    }
+    XXDefineCursor(wm, wm->display, w, cursor);
+}
+
+static int
+floor_int(int n, int inc)
+{
+    return (n / inc) * inc;
+}
+
+static void
+update_frame_status(WindowManager* wm, Frame* frame, int status)
+{
+    if (frame->status == status) {
+        return;
+    }
+    frame->status = status;
+    Display* display = wm->display;
+    Window w = frame->buttons;
+    XXSetWindowBackgroundPixmap(wm, display, w, wm->decoration.buttons[status]);
+    XXClearArea(wm, display, w, 0, 0, 0, 0, False);
+}
+
+static int
+detect_frame_status(WindowManager* wm, Frame* frame, int x, int y)
+{
+    int frame_size = wm->frame_size;
+    int size = wm->title_height;
+    if ((y < frame_size) || (frame_size + size < y)) {
+        return FOCUS_NONE;
+    }
+    unsigned int width;
+    unsigned int height;
+    get_geometry(wm, frame->window, &width, &height);
+    if (x < width - (3 * size + frame_size)) {
+        return FOCUS_NONE;
+    }
+    if (x < width - (2 * size + frame_size)) {
+        return FOCUS_MINIMIZE;
+    }
+    if (x < width - (size + frame_size)) {
+        return FOCUS_MAXIMIZE;
+    }
+    return FOCUS_CLOSE;
+}
+
+static void
+change_frame_status(WindowManager* wm, Frame* frame, int x, int y)
+{
+    update_frame_status(wm, frame, detect_frame_status(wm, frame, x, y));
+}
+
+#define SNAP_DISTANCE 16
+
+static void
+snap_frame(WindowManager* wm, Frame* frame, int* x, int* y)
+{
+    /* Edges of the output above the taskbar pull a frame as ones of frames. */
+    Output* output = find_output(wm, *x, *y);
+    SpatialRect bounds;
+    bounds.x = output->x;
+    bounds.y = output->y;
+    bounds.width = output->width;
+    bounds.height = output->height - wm->taskbar.height;
+    SpatialIndex* index = &wm->spatial.index;
+    spatial_snap(index, &frame->spatial, &bounds, x, y, SNAP_DISTANCE);
+}
+
+static void
+process_motion_notify(WindowManager* wm, XMotionEvent* e)
+{
+    LOG(wm, "process_motion_notify: window=0x%08x, root=0x%08x, subwindow=0x%08x", e->window, e->root, e->subwindow);
+    Display* display = wm->display;
+    Window w = e->window;
+    Window root = DefaultRootWindow(display);
+    if ((w == root) || is_container(wm, w) || (search_taskbar(wm, w) != NULL)) {
+        highlight_selected_popup_item(wm, e->x_root, e->y_root);
+        return;
+    }
+    Frame* frame = search_frame(wm, w);
+    if (frame == NULL) {
+        return;
+    }
+    int x = e->x;
+    int y = e->y;
+    if ((e->state & Button1Mask) == 0) {
+        change_cursor(wm, w, x, y);
+        change_frame_status(wm, frame, x, y);
+        return;
+    }
+
+    GraspedPosition pos = wm->grasped_position;
+    if (pos == GP_NONE) {
+        return;
+    }
+    int border_size = wm->border_size;
+    int new_x = e->x_root - wm->grasped_x - border_size;
+    int new_y = e->y_root - wm->grasped_y - border_size;
+    if (pos == GP_TITLE_BAR) {
+        snap_frame(wm, frame, &new_x, &new_y);
+        XXMoveWindow(wm, display, w, new_x, new_y);
+        return;
+    }
+    int frame_x;
+    int frame_y;
+    unsigned int frame_width;
+    unsigned int frame_height;
+    get_window_geometry(wm, w, &frame_x, &frame_y, &frame_width, &frame_height);
+    int new_width;
+    int new_height;
+    int inc_x;
+    int inc_y;
+    int resize_x;
+    int resize_y;
+    switch (wm->grasped_position) {
+    case GP_NORTH:
+        new_width = frame_width;
+        inc_y = floor_int(frame_y - new_y, frame->height_inc);
+        new_height = frame_height + inc_y;
+        resize_x = frame_x;
+        resize_y = frame_y - inc_y;
+        break;
+    case GP_NORTH_EAST:
+        inc_x = floor_int(x - wm->grasped_x, frame->width_inc);
+        new_width = wm->grasped_width + inc_x;
+        inc_y = floor_int(frame_y - new_y, frame->height_inc);
+        new_height = frame_height + inc_y;
+        resize_x = frame_x;
+        resize_y = frame_y - inc_y;
+        break;
+    case GP_EAST:
+        inc_x = floor_int(x - wm->grasped_x, frame->width_inc);
+        new_width = wm->grasped_width + inc_x;
+        new_height = frame_height;
+        resize_x = frame_x;
+        resize_y = frame_y;
+        break;
+    case GP_SOUTH_EAST:
+        inc_x = floor_int(x - wm->grasped_x, frame->width_inc);
+        new_width = wm->grasped_width + inc_x;
+        inc_y = floor_int(y - wm->grasped_y, frame->height_inc);
+        new_height = wm->grasped_height + inc_y;
+        resize_x = frame_x;
+        resize_y = frame_y;
+        break;
+    case GP_SOUTH:
+        new_width = frame_width;
+        inc_y = floor_int(y - wm->grasped_y, frame->height_inc);
+        new_height = wm->grasped_height + inc_y;
+        resize_x = frame_x;
+        resize_y = frame_y;
+        break;
+    case GP_SOUTH_WEST:
+        inc_x = floor_int(frame_x - new_x, frame->width_inc);
+        new_width = frame_width + inc_x;
+        inc_y = floor_int(y - wm->grasped_y, frame->height_inc);
+        new_height = wm->grasped_height + inc_y;
+        resize_x = frame_x - inc_x;
+        resize_y = frame_y;
+        break;
+    case GP_WEST:
+        inc_x = floor_int(frame_x - new_x, frame->width_inc);
+        new_width = frame_width + inc_x;
+        new_height = frame_height;
+        resize_x = frame_x - inc_x;
+        resize_y = frame_y;
+        break;
+    case GP_NORTH_WEST:
+        inc_x = floor_int(frame_x - new_x, frame->width_inc);
+        new_width = frame_width + inc_x;
+        inc_y = floor_int(frame_y - new_y, frame->height_inc);
+        new_height = frame_height + inc_y;
+        resize_x = frame_x - inc_x;
+        resize_y = frame_y - inc_y;
+        break;
+    case GP_NONE:
+    case GP_TITLE_BAR:
+    default:
+        assert(False);
+        return;
+    }
+    /* A frame never gets smaller than its decorations. */
+    if ((new_width <= compute_frame_width(wm)) || (new_height <= compute_frame_height(wm))) {
+        return;
+    }
+    if ((resize_x == frame_x) && (resize_y == frame_y)) {
+        XXResizeWindow(wm, display, w, new_width, new_height);
+    }
+    else {
+        XXMoveResizeWindow(wm, display, w, resize_x, resize_y, new_width, new_height);
+    }
+    follow_frame_size(wm, frame, new_width, new_height);
+}
+
+struct EventRun {
+    Window window;
+    int type;
+    Bool broken;
+};
+
+typedef struct EventRun EventRun;
+
+/* Matches events of the run until any other event comes. */
+static Bool
+is_in_event_run(Display* display, XEvent* e, XPointer arg)
+{
+    EventRun* run = (EventRun*)arg;
+    if (run->broken) {
+        return False;
+    }
+    if ((e->type == run->type) && (e->xany.window == run->window)) {
+        return True;
+    }
+    run->broken = True;
+    return False;
+}
+
+/*
+ * Skips to the last of the queued events which follow the current one. An
+ * event of another type, like ButtonPress between motions, ends them, so that
+ * events are never handled out of order.
+ */
+static void
+get_last_event(WindowManager* wm, Window w, int event_type, XEvent* e)
+{
+    Display* display = wm->display;
+    EventRun run;
+    run.window = w;
+    run.type = event_type;
+    do {
+        run.broken = False;
+    } while (XXCheckIfEvent(wm, display, e, is_in_event_run, (XPointer)&run));
+}
+
+static int
+compute_text_width(WindowManager* wm, XftFont* font, const char* text, int len)
+{
+    XGlyphInfo glyph;
+    XXftTextExtentsUtf8(wm, wm->display, font, (XftChar8*)text, len, &glyph);
+    return glyph.width;
+}
+
+static Region
+__XPolygonRegion__(const char* filename, int lineno, WindowManager* wm, XPoint points[], int n, int fill_rule)
+{
+    const char* s = fill_rule == EvenOddRule ? "EvenOddRule" : "WindingRule";
+#define FMT "XPolygonRegion(points=%p, n=%d, fill_rule=%d (%s))"
+    LOG_X(filename, lineno, wm, FMT, points, n, fill_rule, s);
+#undef FMT
+
+    wm->resources.regions++;
+    return XPolygonRegion(points, n, fill_rule);
+}
+
+#define XXPolygonRegion(wm, points, n, fill_rule) \
+        __XPolygonRegion__(__FILE__, __LINE__, (wm), (points), (n), (fill_rule))
+
+static Region
+create_padded_region(WindowManager* wm, int x, int y, int width, int height)
+{
+    int padding_size = wm->padding_size;
+    int left = x + padding_size;
+    int top = y + padding_size;
+    int right = x + width - padding_size;
+    int bottom = y + height - padding_size;
+    XPoint points[4];
+    points[0].x = left;
+    points[0].y = top;
+    points[1].x = left;
+    points[1].y = bottom;
+    points[2].x = right;
+    points[2].y = bottom;
+    points[3].x = right;
+    points[3].y = top;
+    return XXPolygonRegion(wm, points, array_sizeof(points), EvenOddRule);
+}
+
+static void
+__XDestroyRegion__(const char* filename, int lineno, WindowManager* wm, Region r)
+{
+    LOG_X0(filename, lineno, wm, "XDestroyRegion(region)");
+    wm->resources.regions--;
+    XDestroyRegion(r);
+}
+
+#define XXDestroyRegion(wm, r) __XDestroyRegion__(__FILE__, __LINE__, (wm), (r))
+
+static void
+clip_padded_region(WindowManager* wm, XftDraw* d, int x, int y, int width, int height)
+{
+    Region region = create_padded_region(wm, x, 0, width, height);
+    XXftDrawSetClip(wm, d, region);
+    XXDestroyRegion(wm, region);
+}
+
+static XftFont*
+open_font(WindowManager* wm, const char* name)
+{
+    Display* display = wm->display;
+    XftFont* font = XXftFontOpenName(wm, display, DefaultScreen(display), name);
+    if (font == NULL) {
+        print_error("Cannot find font (XftFontOpenName failed): %s", name);
+        exit(1);
+    }
+    return font;
+}
+
+/*
+ * Opening a font may scan fonts, so the first paint of a taskbar has no clock,
+ * and the font is opened when fawm has processed all events of startup.
+ */
+static void
+open_clock_font(WindowManager* wm)
+{
+    wm->taskbar.clock_font = open_font(wm, "VL Gothic-18");
+    wm->taskbar.clock_font_wanted = False;
+    expose_taskbar(wm);
+}
+
+static void
+draw_clock(WindowManager* wm, Taskbar* bar)
+{
+    struct timeval tv;
+    if (gettimeofday(&tv, NULL) != 0) {
+        print_error("gettimeofday failed: %s", strerror(errno));
+        return;
+    }
+    struct tm tm;
+    localtime_r(&tv.tv_sec, &tm);
+    char datetime[32];
+    strftime(datetime, array_sizeof(datetime), "%Y-%m-%d %H:%M", &tm);
+    const char* dow[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    char text[32];
+    snprintf(text, array_sizeof(text), "%s (%s)", datetime, dow[tm.tm_wday]);
+
+    unsigned int width;
+    unsigned int height;
+    get_geometry(wm, bar->window, &width, &height);
+
+    XftFont* font = wm->taskbar.clock_font;
+    if (font == NULL) {
+        wm->taskbar.clock_font_wanted = True;
+        bar->clock_x = width;
+        return;
+    }
+    int len = strlen(text);
+    int x = width - compute_text_width(wm, font, text, len) - wm->padding_size;
+
+    XftDraw* draw = bar->draw;
+    /*
+     * The clock never overflows because its width is computed. The following
+     * statement is not strict, but causes nothing bad.
+     */
+    clip_padded_region(wm, draw, 0, 0, width, height);
+
+    XftColor* color = &wm->title_color;
+    int y = font->ascent + wm->padding_size;
+    XXftDrawStringUtf8(wm, draw, color, font, x, y, (XftChar8*)text, len);
+
+    bar->clock_x = x;
+}
+
+static void
+fill_top_frame_rect(WindowManager* wm, DrawBatch* batch, Frame* frame, int x, int width, int height)
+{
+    Array* z_order = &get_current_desktop(wm)->z_order;
+    if (z_order->size == 0) {
+        return;
+    }
+    if (frame != z_order->items[0]) {
+        return;
+    }
+    GC gc = wm->gcs.focused_gc;
+    batch_fill_rectangle(wm, batch, gc, x, 0, width, height);
 }
 
 static void
-draw_popup_menu(WindowManager* wm)
+draw_vertical_line(WindowManager* wm, DrawBatch* batch, GC gc, int x, int y0, int y1)
 {
-    Window w = wm->popup_menu.window;
-    unsigned int window_width;
-    unsigned int _;
-    get_geometry(wm, w, &window_width, &_);
+    batch_line(wm, batch, gc, x, y0, x, y1);
+}
+
+static void
+draw_list_rect(WindowManager* wm, DrawBatch* batch, Frame* frame, int x, int width, int height)
+{
+    fill_top_frame_rect(wm, batch, frame, x, width, height);
+
+    GC gc = wm->gcs.line_gc;
+    int y0 = 0;
+    int y1 = height;
+    draw_vertical_line(wm, batch, gc, x, y0, y1);
+    draw_vertical_line(wm, batch, gc, x + width, y0, y1);
+}
+
+#if 0
+static Region
+__XCreateRegion__(const char* filename, int lineno, WindowManager* wm)
+{
+    LOG_X0(filename, lineno, wm, "XCreateRegion()");
+    wm->resources.regions++;
+    return XCreateRegion();
+}
+
+#define XXCreateRegion(wm)  __XCreateRegion__(__FILE__, __LINE__, (wm))
+
+static int
+__XShrinkRegion__(const char* filename, int lineno, WindowManager* wm, Region r, int dx, int dy)
+{
+    LOG_X(filename, lineno, wm, "XShrinkRegion(r, dx=%d, dy=%d)", dx, dy);
+    return XShrinkRegion(r, dx, dy);
+}
+
+#define XXShrinkRegion(wm, r, dx, dy) \
+                    __XShrinkRegion__(__FILE__, __LINE__, (wm), (r), (dx), (dy))
+
+static int
+__XOffsetRegion__(const char* filename, int lineno, WindowManager* wm, Region r, int dx, int dy)
+{
+    LOG_X(filename, lineno, wm, "XOffsetRegion(r, dx=%d, dy=%d)", dx, dy);
+    return XOffsetRegion(r, dx, dy);
+}
+
+#define XXOffsetRegion(wm, r, dx, dy) \
+                    __XOffsetRegion__(__FILE__, __LINE__, (wm), (r), (dx), (dy))
+#endif
+
+static void
+draw_list_entry(WindowManager* wm, XftDraw* draw, Frame* frame, int x, int width, int height)
+{
+    /*
+     * The title is truncated to fit into the item, so the clipping region
+     * which draw_clock() set is enough.
+     */
+    int padding_size = wm->padding_size;
+    GlyphRun* run = &frame->list_run;
+    update_glyph_run(wm, run, frame->title, width - 2 * padding_size);
+
+    int pos = x + padding_size;
+    int y = padding_size + wm->title_font->ascent;
+    draw_glyph_run(wm, draw, run, pos, y);
+}
+
+static void
+draw_pager_rects(WindowManager* wm, DrawBatch* batch, int taskbar_height)
+{
+    int size = taskbar_height;
+    int i;
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        int x = size * (i + 1);
+        if (i == wm->current_desktop) {
+            batch_fill_rectangle(wm, batch, wm->gcs.focused_gc, x, 0, size, size);
+        }
+        draw_vertical_line(wm, batch, wm->gcs.line_gc, x, 0, size);
+    }
+}
 
+static void
+draw_pager_labels(WindowManager* wm, XftDraw* draw, int taskbar_height)
+{
     XftFont* font = wm->title_font;
-    int item_height = font->ascent + font->descent;
+    int size = taskbar_height;
+    int y = wm->padding_size + font->ascent;
+    int i;
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        char label[8];
+        snprintf(label, array_sizeof(label), "%d", i + 1);
+        int width = compute_text_width(wm, font, label, strlen(label));
+        int x = size * (i + 1) + (size - width) / 2;
+        draw_title_font_string(wm, draw, x, y, label);
+    }
+}
 
-    int selected_item = wm->popup_menu.selected_item;
-    if (0 <= selected_item) {
-        Display* display = wm->display;
-        GC gc = wm->popup_menu.selected_gc;
-        int y = item_height * selected_item;
-        XXFillRectangle(wm, display, w, gc, 0, y, window_width, item_height);
+static void
+draw_window_list(WindowManager* wm, Taskbar* bar, int list_right_x)
+{
+    Window w = bar->window;
+    unsigned int _;
+    unsigned int taskbar_height;
+    get_geometry(wm, w, &_, &taskbar_height);
+
+    /*
+     * All rectangles and lines are sent first, because the title of the focused
+     * window must be drawn over its filled rectangle.
+     */
+    DrawBatch batch;
+    begin_draw_batch(&batch, w);
+    draw_pager_rects(wm, &batch, taskbar_height);
+    Array* frames = list_frames_of_taskbar(wm, bar);
+    int nframes = frames->size;
+    int list_x = compute_window_list_x(taskbar_height);
+    int item_width = 0 < nframes ? (list_right_x - list_x) / nframes : 0;
+    int i;
+    for (i = 0; i < nframes; i++) {
+        Frame* frame = frames->items[i];
+        int x = list_x + item_width * i;
+        draw_list_rect(wm, &batch, frame, x, item_width, taskbar_height);
     }
+    flush_draw_batch(wm, &batch);
 
-    XftDraw* draw = wm->popup_menu.draw;
-    int y = - font->descent;
+    draw_pager_labels(wm, bar->draw, taskbar_height);
+    for (i = 0; i < nframes; i++) {
+        Frame* frame = frames->items[i];
+        int x = list_x + item_width * i;
+        draw_list_entry(wm, bar->draw, frame, x, item_width, taskbar_height);
+    }
+}
+
+#if defined(FAWM_FAKE)
+static void
+record_taskbar_draw(WindowManager* wm, Taskbar* bar, unsigned long requests)
+{
+    wm->fake.taskbar_draws++;
+    wm->fake.taskbar_requests += requests;
+    if (wm->fake.max_taskbar_requests < requests) {
+        wm->fake.max_taskbar_requests = requests;
+    }
+    int nframes = list_frames_of_taskbar(wm, bar)->size;
+    if (wm->fake.max_taskbar_frames < nframes) {
+        wm->fake.max_taskbar_frames = nframes;
+    }
+}
+#endif
+
+static void
+draw_taskbar(WindowManager* wm, Taskbar* bar)
+{
+#if defined(FAWM_FAKE)
+    unsigned long serial = NextRequest(wm->display);
+#endif
+    draw_clock(wm, bar);
+    draw_window_list(wm, bar, bar->clock_x - wm->padding_size);
+#if defined(FAWM_FAKE)
+    record_taskbar_draw(wm, bar, NextRequest(wm->display) - serial);
+#endif
+}
+
+static void
+process_expose(WindowManager* wm, XExposeEvent* e)
+{
+    LOG(wm, "process_expose: window=0x%08x", e->window);
+    Window w = e->window;
+    if (w == wm->popup_menu.window) {
+        draw_popup_menu(wm);
+        return;
+    }
+    Taskbar* bar = search_taskbar(wm, w);
+    if (bar != NULL) {
+        /* Changes after this are not drawn, so they need another clear. */
+        wm->taskbar.exposed = False;
+        draw_taskbar(wm, bar);
+        return;
+    }
+    Frame* frame = search_frame(wm, w);
+    if (frame == NULL) {
+        return;
+    }
+    GraspedPosition pos = wm->grasped_position;
+    if ((pos != GP_NONE) && (pos != GP_TITLE_BAR)) {
+        wm->resize_stats.exposes++;
+    }
+    /*
+     * An Expose event which is a result of killing a child window is outside
+     * of the title, so draw_frame() ignores it.
+     */
+    XRectangle area;
+    set_rectangle(&area, e->x, e->y, e->width, e->height);
+    draw_frame(wm, frame, &area, e->count);
+}
+
+static pid_t
+do_fork()
+{
+    pid_t pid = fork();
+    if (pid == -1) {
+        print_error("fork failed: %s", strerror(errno));
+        exit(1);
+    }
+    return pid;
+}
+
+static void
+fork_child(char* cmd)
+{
+    pid_t pid = do_fork();
+    if (pid == 0) {
+        char* argv[] = { "/bin/sh", "-c", cmd, NULL };
+        execv(argv[0], argv);
+        exit(1);
+    }
+    exit(0);
+}
+
+static void
+execute(WindowManager* wm, char* cmd)
+{
+#if defined(FAWM_FAKE)
+    LOG(wm, "skipped a command with the fake server: %s", cmd);
+    return;
+#endif
+    pid_t pid = do_fork();
+    if (pid == 0) {
+        fork_child(cmd);
+        exit(1);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+static char* config_exe = "__fawm_config__";
+
+static char*
+make_config_exe_path(char* dest, size_t size, const char* fawm_exe)
+{
+    /*
+     * For compatibility, I prepare a writable buffer for dirname(3).
+     */
+    char* buf = (char*)alloca(strlen(fawm_exe) + 1);
+    strcpy(buf, fawm_exe);
+    const char* dir = dirname(buf);
+    snprintf(dest, size, "%s/%s", dir, config_exe);
+
+    return dest;
+}
+
+static void
+convert_offset_to_pointer(Config* config)
+{
+    uintptr_t base = (uintptr_t)config;
+#define offset2ptr(type, ref)   ref.ptr = (type*)(base + ref.offset)
+    offset2ptr(Menu, config->menu);
+
+    Menu* menu = config->menu.ptr;
+    offset2ptr(MenuItem, menu->items);
+
+    int i;
+    for (i = 0; i < menu->items_num; i++) {
+        MenuItem* item = &menu->items.ptr[i];
+        offset2ptr(char, item->u.exec.caption);
+        offset2ptr(char, item->u.exec.command);
+    }
+#undef offset2ptr
+}
+
+static Bool
+read_file(void* dest, FILE* src, size_t size)
+{
+    size_t nbytes = 0;
+    while (!ferror(src) && (nbytes < size)) {
+        void* ptr = (void*)((uintptr_t)dest + nbytes);
+        nbytes += fread(ptr, size - nbytes, 1, src);
+    }
+    return nbytes == size ? True : False;
+}
+
+/* Starts __fawm_config__. finish_loading_config() reads its output. */
+static void
+start_loading_config(WindowManager* wm)
+{
+    char buf[MAXPATHLEN];
+    const char* fawm_exe = wm->fawm_exe;
+    const char* p = strchr(fawm_exe, '/');
+    const char* exe = p != NULL ? make_config_exe_path(buf, array_sizeof(buf), fawm_exe) : config_exe;
+
+    char cmd[MAXPATHLEN];
+    snprintf(cmd, array_sizeof(cmd), "%s %s", exe, wm->config_file);
+
+    wm->config_pipe = popen(cmd, "r");
+    assert(wm->config_pipe != NULL);
+}
+
+static Bool
+finish_loading_config(WindowManager* wm)
+{
+    FILE* fpin = wm->config_pipe;
+    wm->config_pipe = NULL;
+    size_t size;
+    if (!read_file(&size, fpin, sizeof(size))) {
+        pclose(fpin);
+        return False;
+    }
+    Config* config = (Config*)malloc(size);
+    assert(config != NULL);
+    if (!read_file(config, fpin, size)) {
+        pclose(fpin);
+        return False;
+    }
+    if (pclose(fpin) != 0) {
+        return False;
+    }
+
+    convert_offset_to_pointer(config);
+    free(wm->config);
+    wm->config = config;
+
+    return True;
+}
+
+static Bool
+load_config(WindowManager* wm)
+{
+    start_loading_config(wm);
+    return finish_loading_config(wm);
+}
+
+static int
+compute_popup_menu_width(WindowManager* wm)
+{
+    int max = 0;
     Menu* menu = wm->config->menu.ptr;
-    int items_num = menu->items_num;
     int i;
-    for (i = 0; i < items_num; i++) {
-        y += item_height;
+    for (i = 0; i < menu->items_num; i++) {
         const char* caption = get_menu_item_caption(&menu->items.ptr[i]);
-        draw_title_font_string(wm, draw, wm->popup_menu.margin, y, caption);
+        int len = strlen(caption);
+        int width = compute_text_width(wm, wm->title_font, caption, len);
+        max = max < width ? width : max;
     }
+    return max;
 }
 
 static void
-highlight_selected_popup_item(WindowManager* wm, int x, int y)
+resize_popup_menu(WindowManager* wm)
 {
-    int new_item = detect_selected_popup_item(wm, x, y);
-    if (new_item == wm->popup_menu.selected_item) {
-        return;
+    Window w = wm->popup_menu.window;
+    int width = 2 * wm->popup_menu.margin + compute_popup_menu_width(wm);
+    int font_height = compute_font_height(wm->title_font);
+    int height = font_height * wm->config->menu.ptr->items_num;
+    XXResizeWindow(wm, wm->display, w, width, height);
+}
+
+static int
+search_output_of_entry(WindowManager* wm, SpatialEntry* entry)
+{
+    SpatialRect* rect = &entry->rect;
+    int x = rect->x + rect->width / 2;
+    int y = rect->y + rect->height / 2;
+    int index = search_output(wm, x, y);
+    return index < 0 ? 0 : index;
+}
+
+/*
+ * Lays out visible frames of the current desktop in each output. All
+ * geometries are computed first from the spatial index without any round
+ * trips, and then sent at once with one flush.
+ */
+static void
+arrange_frames(WindowManager* wm, LayoutType type)
+{
+    long start = get_monotonic_usec();
+    Array* z_order = &get_current_desktop(wm)->z_order;
+    int size = z_order->size;
+    Frame** frames = (Frame**)alloc_memory(sizeof(frames[0]) * (size + 1));
+    SpatialRect* rects = (SpatialRect*)alloc_memory(sizeof(rects[0]) * (size + 1));
+    int n = 0;
+    int i;
+    for (i = 0; i < wm->outputs_num; i++) {
+        int first = n;
+        int j;
+        for (j = 0; j < size; j++) {
+            /* The top frame is the front of cascade, or the first in others. */
+            int k = type == LAYOUT_TYPE_CASCADE ? size - j - 1 : j;
+            Frame* frame = z_order->items[k];
+            SpatialEntry* entry = &frame->spatial;
+            if (!entry->indexed || (search_output_of_entry(wm, entry) != i)) {
+                continue;
+            }
+            frames[n] = frame;
+            n++;
+        }
+        Output* output = &wm->outputs[i];
+        SpatialRect bounds;
+        bounds.x = output->x;
+        bounds.y = output->y;
+        bounds.width = output->width;
+        bounds.height = output->height - wm->taskbar.height;
+        int step = wm->title_height + 2 * wm->frame_size;
+        layout_compute(type, &bounds, n - first, step, &rects[first]);
     }
-    wm->popup_menu.selected_item = new_item;
-    expose(wm, wm->popup_menu.window);
+
+    Display* display = wm->display;
+    int border_size = 2 * wm->border_size;
+    int min_width = compute_frame_width(wm) + 1;
+    int min_height = compute_frame_height(wm) + 1;
+    for (i = 0; i < n; i++) {
+        Frame* frame = frames[i];
+        SpatialRect* rect = &rects[i];
+        int width = rect->width - border_size;
+        width = width < min_width ? min_width : width;
+        int height = rect->height - border_size;
+        height = height < min_height ? min_height : height;
+        Window w = frame->window;
+        XXMoveResizeWindow(wm, display, w, rect->x, rect->y, width, height);
+        resize_child(wm, frame->child, width, height);
+        refresh_title(wm, frame, width);
+        refresh_corner_marks(wm, frame, width, height);
+    }
+    wm->backend->flush(display);
+    free(rects);
+    free(frames);
+    long elapsed = get_monotonic_usec() - start;
+
+#define FMT "arrange_frames: type=%d, frames=%d, %ld usec"
+    LOG(wm, FMT, type, n, elapsed);
+#undef FMT
 }
 
 static void
-change_cursor(WindowManager* wm, Window w, int x, int y)
+process_button_release(WindowManager* wm, XButtonEvent* e)
 {
-    Cursor cursor;
-    switch (detect_frame_position(wm, w, x, y)) {
-    case GP_NONE:
-    case GP_TITLE_BAR:
-        cursor = wm->normal_cursor;
-        break;
-    case GP_NORTH:
-        cursor = wm->top_cursor;
-        break;
-    case GP_NORTH_EAST:
-        cursor = wm->top_right_cursor;
-        break;
-    case GP_EAST:
-        cursor = wm->right_cursor;
+    LOG(wm, "process_button_release: window=0x%08x, root=0x%08x, subwindow=0x%08x", e->window, e->root, e->subwindow);
+    Frame* frame = search_frame(wm, e->window);
+    if (frame != NULL) {
+        Bool grasped = wm->grasped_position == GP_TITLE_BAR;
+        if (grasped && (search_output_of_frame(wm, frame) != wm->grasped_output)) {
+            /* The frame was moved onto another output. */
+            expose_taskbar(wm);
+        }
+        release_frame(wm);
+        return;
+    }
+    unmap_popup_menu(wm);
+    int index = detect_selected_popup_item(wm, e->x_root, e->y_root);
+    if (index < 0) {
+        return;
+    }
+    MenuItem* item = &wm->config->menu.ptr->items.ptr[index];
+    switch (item->type) {
+    case MENU_ITEM_TYPE_EXIT:
+        wm->running = False;
         break;
-    case GP_SOUTH_EAST:
-        cursor = wm->bottom_right_cursor;
+    case MENU_ITEM_TYPE_RELOAD:
+        load_config(wm);
+        resize_popup_menu(wm);
         break;
-    case GP_SOUTH:
-        cursor = wm->bottom_cursor;
+    case MENU_ITEM_TYPE_CASCADE:
+        arrange_frames(wm, LAYOUT_TYPE_CASCADE);
         break;
-    case GP_SOUTH_WEST:
-        cursor = wm->bottom_left_cursor;
+    case MENU_ITEM_TYPE_GRID:
+        arrange_frames(wm, LAYOUT_TYPE_GRID);
         break;
-    case GP_WEST:
-        cursor = wm->left_cursor;
+    case MENU_ITEM_TYPE_TILE:
+        arrange_frames(wm, LAYOUT_TYPE_TILE);
         break;
-    case GP_NORTH_WEST:
-        cursor = wm->top_left_cursor;
+    case MENU_ITEM_TYPE_RESTART:
+        wm->restart.requested = True;
         break;
     default:
-        assert(False);
-        return; /* A statement to surpress GCC warning. */
+        assert(item->type == MENU_ITEM_TYPE_EXEC);
+        execute(wm, item->u.exec.command.ptr);
+        break;
     }
-    XXDefineCursor(wm, wm->display, w, cursor);
 }
 
-static int
-floor_int(int n, int inc)
+static void
+change_frame_background(WindowManager* wm, Window w, int pixel)
 {
-    return (n / inc) * inc;
+    XXSetWindowBackground(wm, wm->display, w, pixel);
+    expose(wm, w);
 }
 
 static void
-update_frame_status(WindowManager* wm, Frame* frame, int status)
+process_focus_out(WindowManager* wm, XFocusChangeEvent* e)
 {
-    if (frame->status == status) {
+    LOG(wm, "process_focus_out: window=0x%08x", e->window);
+    if (e->mode != NotifyNormal) {
         return;
     }
-    frame->status = status;
-    expose(wm, frame->window);
+    int detail = e->detail;
+    if ((detail != NotifyNonlinear) && (detail != NotifyNonlinearVirtual)) {
+        return;
+    }
+    Window w = e->window;
+    Frame* frame = search_frame(wm, w);
+    if (frame == NULL) {
+        /* XXX: X seems to throw FocusOut event for XDestroyWindow'ed window? */
+        return;
+    }
+    if (wm->shadow.focus == frame->child) {
+        /* Someone else moved the focus. */
+        forget_focus(wm);
+    }
+    if (wm->focused_frame == frame) {
+        set_focused_frame(wm, NULL);
+    }
+    change_frame_background(wm, w, wm->unfocused_foreground_color);
 }
 
-static int
-detect_frame_status(WindowManager* wm, Frame* frame, int x, int y)
+static void
+process_focus_in(WindowManager* wm, XFocusChangeEvent* e)
 {
-    int frame_size = wm->frame_size;
-    int size = wm->title_height;
-    if ((y < frame_size) || (frame_size + size < y)) {
-        return FOCUS_NONE;
+    LOG(wm, "process_focus_in: window=0x%08x", e->window);
+    if (e->mode != NotifyNormal) {
+        return;
     }
-    unsigned int width;
-    unsigned int height;
-    get_geometry(wm, frame->window, &width, &height);
-    if (x < width - (3 * size + frame_size)) {
-        return FOCUS_NONE;
+    int detail = e->detail;
+    if ((detail != NotifyNonlinear) && (detail != NotifyNonlinearVirtual)) {
+        return;
     }
-    if (x < width - (2 * size + frame_size)) {
-        return FOCUS_MINIMIZE;
+    Window w = e->window;
+    Frame* frame = search_frame(wm, w);
+    if (frame == NULL) {
+        return;
     }
-    if (x < width - (size + frame_size)) {
-        return FOCUS_MAXIMIZE;
+    if (!wm->shadow.focus_known || (wm->shadow.focus != frame->child)) {
+        forget_focus(wm);
     }
-    return FOCUS_CLOSE;
+    set_focused_frame(wm, frame);
+    if (0 < index_in_array(&get_desktop_of_frame(wm, frame)->z_order, frame)) {
+        /* The client took the focus by itself. */
+        move_frame_to_z_order_head(wm, frame);
+        expose_taskbar(wm);
+    }
+    change_frame_background(wm, w, wm->focused_foreground_color);
 }
 
 static void
-change_frame_status(WindowManager* wm, Frame* frame, int x, int y)
+map_frame_of_child(WindowManager* wm, Window w)
 {
-    update_frame_status(wm, frame, detect_frame_status(wm, frame, x, y));
+    Frame* frame = search_frame_of_child(wm, w);
+    if (frame != NULL) {
+        Display* display = wm->display;
+        XXMapWindow(wm, display, frame->window);
+        XXMapWindow(wm, display, frame->child);
+        focus(wm, frame);
+        return;
+    }
+    reparent_window(wm, w, True);
+    map_frame_of_child(wm, w);
 }
 
 static void
-process_motion_notify(WindowManager* wm, XMotionEvent* e)
+process_map_request(WindowManager* wm, XMapRequestEvent* e)
 {
-    LOG(wm, "process_motion_notify: window=0x%08x, root=0x%08x, subwindow=0x%08x", e->window, e->root, e->subwindow);
-    Display* display = wm->display;
     Window w = e->window;
-    Window root = DefaultRootWindow(display);
-    if ((w == root) || (w == wm->taskbar.window)) {
-        highlight_selected_popup_item(wm, e->x_root, e->y_root);
-        return;
-    }
-    Frame* frame = search_frame(wm, w);
+#define FMT "process_map_request: parent=0x%08x, window=0x%08x"
+    LOG(wm, FMT, e->parent, w);
+#undef FMT
+    long start = get_monotonic_usec();
+    map_frame_of_child(wm, w);
+    long elapsed = get_monotonic_usec() - start;
+
+    int hits = wm->frame_pool_stats.hits;
+    int misses = wm->frame_pool_stats.misses;
+    int total = hits + misses;
+    int rate = 0 < total ? 100 * hits / total : 0;
+#define FMT "map latency: window=0x%08x, %ld usec, frame pool: hits=%d, misses=%d (%d%%)"
+    LOG(wm, FMT, w, elapsed, hits, misses, rate);
+#undef FMT
+}
+
+static void
+process_unmap_notify(WindowManager* wm, XUnmapEvent* e)
+{
+    LOG(wm, "process_unmap_notify: event=0x%08x, window=0x%08x", e->event, e->window);
+    Window w = e->window;
+    Frame* frame = search_frame_of_child(wm, w);
     if (frame == NULL) {
         return;
     }
-    int x = e->x;
-    int y = e->y;
-    if ((e->state & Button1Mask) == 0) {
-        change_cursor(wm, w, x, y);
-        change_frame_status(wm, frame, x, y);
+    /*
+     * A client withdraws an unmapped window by a synthetic UnmapNotify to the
+     * root window (ICCCM 4.1.4).
+     */
+    Bool synthetic = e->send_event && (e->event == DefaultRootWindow(wm->display));
+    if ((e->event != frame->window) && !synthetic) {
         return;
     }
+    /* The client unmapped its window by itself. */
+    update_shadow_mapped(find_window_state(wm, w), False);
+    unmap_frame(wm, frame);
+}
 
-    GraspedPosition pos = wm->grasped_position;
-    if (pos == GP_NONE) {
-        return;
-    }
-    int border_size = wm->border_size;
-    int new_x = e->x_root - wm->grasped_x - border_size;
-    int new_y = e->y_root - wm->grasped_y - border_size;
-    if (pos == GP_TITLE_BAR) {
-        XXMoveWindow(wm, display, w, new_x, new_y);
-        return;
-    }
-    XWindowAttributes frame_attrs;
-    XXGetWindowAttributes(wm, display, w, &frame_attrs);
-    Window child = frame->child;
-    XWindowAttributes child_attrs;
-    XXGetWindowAttributes(wm, display, child, &child_attrs);
-    int new_width;
-    int new_height;
-    int inc_x;
-    int inc_y;
-    switch (wm->grasped_position) {
-    case GP_NORTH:
-        new_width = frame_attrs.width;
-        inc_y = floor_int(frame_attrs.y - new_y, frame->height_inc);
-        new_height = frame_attrs.height + inc_y;
-        XXMoveResizeWindow(
-            wm,
-            display, w,
-            frame_attrs.x, frame_attrs.y - inc_y,
-            new_width, new_height);
-        resize_child(wm, child, new_width, new_height);
-        return;
-    case GP_NORTH_EAST:
-        inc_x = floor_int(x - wm->grasped_x, frame->width_inc);
-        new_width = wm->grasped_width + inc_x;
-        inc_y = floor_int(frame_attrs.y - new_y, frame->height_inc);
-        new_height = frame_attrs.height + inc_y;
-        XXMoveResizeWindow(
-            wm,
-            display, w,
-            frame_attrs.x, frame_attrs.y - inc_y,
-            new_width, new_height);
-        resize_child(wm, child, new_width, new_height);
-        return;
-    case GP_EAST:
-        inc_x = floor_int(x - wm->grasped_x, frame->width_inc);
-        new_width = wm->grasped_width + inc_x;
-        new_height = frame_attrs.height;
-        XXResizeWindow(wm, display, w, new_width, new_height);
-        resize_child(wm, child, new_width, new_height);
-        return;
-    case GP_SOUTH_EAST:
-        inc_x = floor_int(x - wm->grasped_x, frame->width_inc);
-        new_width = wm->grasped_width + inc_x;
-        inc_y = floor_int(y - wm->grasped_y, frame->height_inc);
-        new_height = wm->grasped_height + inc_y;
-        XXResizeWindow(wm, display, w, new_width, new_height);
-        resize_child(wm, child, new_width, new_height);
-        return;
-    case GP_SOUTH:
-        new_width = frame_attrs.width;
-        inc_y = floor_int(y - wm->grasped_y, frame->height_inc);
-        new_height = wm->grasped_height + inc_y;
-        XXResizeWindow(wm, display, w, new_width, new_height);
-        resize_child(wm, child, new_width, new_height);
-        return;
-    case GP_SOUTH_WEST:
-        inc_x = floor_int(frame_attrs.x - new_x, frame->width_inc);
-        new_width = frame_attrs.width + inc_x;
-        inc_y = floor_int(y - wm->grasped_y, frame->height_inc);
-        new_height = wm->grasped_height + inc_y;
-        XXMoveResizeWindow(
-            wm,
-            display, w,
-            frame_attrs.x - inc_x, frame_attrs.y,
-            new_width, new_height);
-        resize_child(wm, child, new_width, new_height);
-        return;
-    case GP_WEST:
-        inc_x = floor_int(frame_attrs.x - new_x, frame->width_inc);
-        new_width = frame_attrs.width + inc_x;
-        new_height = frame_attrs.height;
-        XXMoveResizeWindow(
-            wm,
-            display, w,
-            frame_attrs.x - inc_x, frame_attrs.y,
-            new_width, new_height);
-        resize_child(wm, child, new_width, new_height);
-        return;
-    case GP_NORTH_WEST:
-        inc_x = floor_int(frame_attrs.x - new_x, frame->width_inc);
-        new_width = frame_attrs.width + inc_x;
-        inc_y = floor_int(frame_attrs.y - new_y, frame->height_inc);
-        new_height = frame_attrs.height + inc_y;
-        XXMoveResizeWindow(
-            wm,
-            display, w,
-            frame_attrs.x - inc_x, frame_attrs.y - inc_y,
-            new_width, new_height);
-        resize_child(wm, child, new_width, new_height);
+static void
+process_override_redirect_notify(WindowManager* wm, Window w, Bool override_redirect)
+{
+    /*
+     * Override-redirect windows (menus, tooltips, ...) can be stacked over
+     * frames without fawm.
+     */
+    if (!override_redirect) {
         return;
-    case GP_NONE:
-    case GP_TITLE_BAR:
-    default:
-        assert(False);
     }
+    LOG(wm, "override-redirect window changed: window=0x%08x", w);
+    forget_top(wm);
+}
+
+static char event_name[LASTEvent][32];
+
+static void
+initialize_event_name()
+{
+    bzero(event_name, sizeof(event_name));
+#define REGISTER_NAME(type) \
+    strncpy(event_name[(type)], #type, sizeof(event_name[(type)]))
+    REGISTER_NAME(KeyPress);
+    REGISTER_NAME(KeyRelease);
+    REGISTER_NAME(ButtonPress);
+    REGISTER_NAME(ButtonRelease);
+    REGISTER_NAME(MotionNotify);
+    REGISTER_NAME(EnterNotify);
+    REGISTER_NAME(LeaveNotify);
+    REGISTER_NAME(FocusIn);
+    REGISTER_NAME(FocusOut);
+    REGISTER_NAME(KeymapNotify);
+    REGISTER_NAME(Expose);
+    REGISTER_NAME(GraphicsExpose);
+    REGISTER_NAME(NoExpose);
+    REGISTER_NAME(VisibilityNotify);
+    REGISTER_NAME(CreateNotify);
+    REGISTER_NAME(DestroyNotify);
+    REGISTER_NAME(UnmapNotify);
+    REGISTER_NAME(MapNotify);
+    REGISTER_NAME(MapRequest);
+    REGISTER_NAME(ReparentNotify);
+    REGISTER_NAME(ConfigureNotify);
+    REGISTER_NAME(ConfigureRequest);
+    REGISTER_NAME(GravityNotify);
+    REGISTER_NAME(ResizeRequest);
+    REGISTER_NAME(CirculateNotify);
+    REGISTER_NAME(CirculateRequest);
+    REGISTER_NAME(PropertyNotify);
+    REGISTER_NAME(SelectionClear);
+    REGISTER_NAME(SelectionRequest);
+    REGISTER_NAME(SelectionNotify);
+    REGISTER_NAME(ColormapNotify);
+    REGISTER_NAME(ClientMessage);
+    REGISTER_NAME(MappingNotify);
+    REGISTER_NAME(GenericEvent);
+#undef REGISTER_NAME
 }
 
 static void
-get_last_event(WindowManager* wm, Window w, int event_type, XEvent* e)
+send_configure_notify(WindowManager* wm, Frame* frame)
 {
-    Display* display = wm->display;
-    while (XXCheckTypedWindowEvent(wm, display, w, event_type, e));
-}
+    int frame_x;
+    int frame_y;
+    unsigned int frame_width;
+    unsigned int frame_height;
+    Window w = frame->window;
+    get_window_geometry(wm, w, &frame_x, &frame_y, &frame_width, &frame_height);
 
-static int
-compute_text_width(WindowManager* wm, XftFont* font, const char* text, int len)
-{
-    XGlyphInfo glyph;
-    XXftTextExtentsUtf8(wm, wm->display, font, (XftChar8*)text, len, &glyph);
-    return glyph.width;
+    /* ICCCM 4.1.5: Coordinates are relative to the root window. */
+    Window child = frame->child;
+    int offset = wm->border_size + wm->frame_size;
+    XEvent e;
+    bzero(&e, sizeof(e));
+    e.xconfigure.type = ConfigureNotify;
+    e.xconfigure.event = child;
+    e.xconfigure.window = child;
+    e.xconfigure.x = frame_x + offset;
+    e.xconfigure.y = frame_y + offset + wm->frame_size + wm->title_height;
+    e.xconfigure.width = frame_width - compute_frame_width(wm);
+    e.xconfigure.height = frame_height - compute_frame_height(wm);
+    e.xconfigure.border_width = wm->client_border_size;
+    e.xconfigure.above = None;
+    e.xconfigure.override_redirect = False;
+    XXSendEvent(wm, wm->display, child, False, StructureNotifyMask, &e);
 }
 
-static Region
-__XPolygonRegion__(const char* filename, int lineno, WindowManager* wm, XPoint points[], int n, int fill_rule)
+static void
+configure_frame(WindowManager* wm, Frame* frame, XConfigureRequestEvent* e)
 {
-    const char* s = fill_rule == EvenOddRule ? "EvenOddRule" : "WindingRule";
-#define FMT "XPolygonRegion(points=%p, n=%d, fill_rule=%d (%s))"
-    LOG_X(filename, lineno, wm, FMT, points, n, fill_rule, s);
-#undef FMT
-
-    return XPolygonRegion(points, n, fill_rule);
+    Display* display = wm->display;
+    unsigned int value_mask = e->value_mask & (CWWidth | CWHeight);
+    if (value_mask != 0) {
+        XWindowChanges changes;
+        changes.width = e->width + compute_frame_width(wm);
+        changes.height = e->height + compute_frame_height(wm);
+        XXConfigureWindow(wm, display, frame->window, value_mask, &changes);
+        changes.width = e->width;
+        changes.height = e->height;
+        XXConfigureWindow(wm, display, frame->child, value_mask, &changes);
+        unsigned int width;
+        unsigned int height;
+        get_geometry(wm, frame->window, &width, &height);
+        if (value_mask & CWWidth) {
+            refresh_title(wm, frame, width);
+        }
+        refresh_corner_marks(wm, frame, width, height);
+    }
+    /*
+     * CWX, CWY, CWBorderWidth and CWSibling are not honored. The client is
+     * told where it is by a synthetic ConfigureNotify (ICCCM 4.1.5).
+     * CWStackMode is handled by stack_frame_by_request().
+     */
+    send_configure_notify(wm, frame);
 }
 
-#define XXPolygonRegion(wm, points, n, fill_rule) \
-        __XPolygonRegion__(__FILE__, __LINE__, (wm), (points), (n), (fill_rule))
-
-static Region
-create_padded_region(WindowManager* wm, int x, int y, int width, int height)
+static void
+stack_frame_by_request(WindowManager* wm, Frame* frame, int detail)
 {
-    int padding_size = wm->padding_size;
-    int left = x + padding_size;
-    int top = y + padding_size;
-    int right = x + width - padding_size;
-    int bottom = y + height - padding_size;
-    XPoint points[4];
-    points[0].x = left;
-    points[0].y = top;
-    points[1].x = left;
-    points[1].y = bottom;
-    points[2].x = right;
-    points[2].y = bottom;
-    points[3].x = right;
-    points[3].y = top;
-    return XXPolygonRegion(wm, points, array_sizeof(points), EvenOddRule);
+    /*
+     * The head of z_order is the focused frame, so a client which wants to be
+     * on the top is focused. Siblings and other modes are ignored.
+     */
+    Desktop* desktop = get_desktop_of_frame(wm, frame);
+    Array* a = &desktop->z_order;
+    if (index_in_array(a, frame) < 0) {
+        return;
+    }
+    Bool was_top = a->items[0] == frame;
+    switch (detail) {
+    case Above:
+        focus(wm, frame);
+        return;
+    case Below:
+        remove_from_array(a, frame);
+        append_to_array(a, frame);
+        schedule_restack(desktop);
+        spatial_restack(&wm->spatial.index, &frame->spatial, --wm->spatial.bottom_z);
+        if (was_top && (frame->desktop == wm->current_desktop)) {
+            focus_top_frame(wm);
+        }
+        return;
+    default:
+        LOG(wm, "stack mode ignored: window=0x%08x, detail=%d", frame->child, detail);
+        return;
+    }
 }
 
 static void
-__XDestroyRegion__(const char* filename, int lineno, WindowManager* wm, Region r)
+process_configure_request(WindowManager* wm, XConfigureRequestEvent* e)
 {
-    LOG_X0(filename, lineno, wm, "XDestroyRegion(region)");
-    XDestroyRegion(r);
-}
+    LOG(wm, "process_configure_request: parent=0x%08x, window=0x%08x, above=0x%08x", e->parent, e->window, e->above);
+    Window w = e->window;
+    Frame* frame = search_frame_of_child(wm, w);
+    if (frame != NULL) {
+        configure_frame(wm, frame, e);
+        if (e->value_mask & CWStackMode) {
+            stack_frame_by_request(wm, frame, e->detail);
+        }
+        return;
+    }
 
-#define XXDestroyRegion(wm, r) __XDestroyRegion__(__FILE__, __LINE__, (wm), (r))
+    /* The window is not managed yet. All changes are sent at once. */
+    unsigned long value_mask = e->value_mask;
+    if (value_mask & CWSibling) {
+        LOG0(wm, "CWSibling");
+        value_mask &= ~CWSibling;
+    }
+    if (value_mask == 0) {
+        return;
+    }
+    XWindowChanges changes;
+    changes.x = e->x;
+    changes.y = e->y;
+    changes.width = e->width;
+    changes.height = e->height;
+    changes.border_width = e->border_width;
+    changes.stack_mode = e->detail;
+    XXConfigureWindow(wm, wm->display, w, value_mask, &changes);
+}
 
 static int
-__XftDrawSetClip__(const char* filename, int lineno, WindowManager* wm, XftDraw* d, Region r)
+__XUndefineCursor__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
 {
-    LOG_X0(filename, lineno, wm, "XftDrawSetClip(d, r)");
-    return XftDrawSetClip(d, r);
+    WindowState* state = find_window_state(wm, w);
+    if (has_shadow_cursor(state, None)) {
+        return elide_request(filename, lineno, wm, SR_UNDEFINE_CURSOR, w);
+    }
+    LOG_X(filename, lineno, wm, "XUndefineCursor(display, w=0x%08x)", w);
+    count_sent_request(wm, SR_UNDEFINE_CURSOR);
+    update_shadow_cursor(state, None);
+    return wm->backend->undefine_cursor(display, w);
 }
 
-#define XXftDrawSetClip(wm, d, r) \
-                        __XftDrawSetClip__(__FILE__, __LINE__, (wm), (d), (r))
+#define XXUndefineCursor(wm, a, b) \
+    __XUndefineCursor__(__FILE__, __LINE__, (wm), (a), (b))
 
-static void
-clip_padded_region(WindowManager* wm, XftDraw* d, int x, int y, int width, int height)
+static Bool
+is_decoration(Frame* frame, Window w)
 {
-    Region region = create_padded_region(wm, x, 0, width, height);
-    XXftDrawSetClip(wm, d, region);
-    XXDestroyRegion(wm, region);
+    return w == frame->buttons;
 }
 
 static void
-draw_clock(WindowManager* wm)
+process_leave_notify(WindowManager* wm, XCrossingEvent* e)
 {
-    struct timeval tv;
-    if (gettimeofday(&tv, NULL) != 0) {
-        print_error("gettimeofday failed: %s", strerror(errno));
+    LOG(wm, "process_leave_notify: window=0x%08x, root=0x%08x, subwindow=0x%08x", e->window, e->root, e->subwindow);
+    Window w = e->window;
+    Frame* frame = search_frame(wm, w);
+    if (frame == NULL) {
         return;
     }
-    struct tm tm;
-    localtime_r(&tv.tv_sec, &tm);
-    char datetime[32];
-    strftime(datetime, array_sizeof(datetime), "%Y-%m-%d %H:%M", &tm);
-    const char* dow[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
-    char text[32];
-    snprintf(text, array_sizeof(text), "%s (%s)", datetime, dow[tm.tm_wday]);
-
-    Display* display = wm->display;
-    unsigned int width;
-    unsigned int height;
-    get_geometry(wm, DefaultRootWindow(display), &width, &height);
-
-    XftFont* font = wm->taskbar.clock_font;
-    int len = strlen(text);
-    int x = width - compute_text_width(wm, font, text, len) - wm->padding_size;
-
-    XftDraw* draw = wm->taskbar.draw;
     /*
-     * The clock never overflows because its width is computed. The following
-     * statement is not strict, but causes nothing bad.
+     * The pointer is still on the border if it went into a decoration. The
+     * client is also an inferior, but the resize cursor must not stay on it.
      */
-    clip_padded_region(wm, draw, 0, 0, width, height);
-
-    XftColor* color = &wm->title_color;
-    int y = font->ascent + wm->padding_size;
-    XXftDrawStringUtf8(wm, draw, color, font, x, y, (XftChar8*)text, len);
+    if ((e->detail == NotifyInferior) && is_decoration(frame, e->subwindow)) {
+        return;
+    }
+    XXUndefineCursor(wm, wm->display, w);
+}
 
-    wm->taskbar.clock_x = x;
+static void
+expose_frame(WindowManager* wm, Frame* frame)
+{
+    expose(wm, frame->window);
 }
 
 static void
-fill_top_frame_rect(WindowManager* wm, Frame* frame, int x, int width, int height)
+process_property_notify(WindowManager* wm, XPropertyEvent* e)
 {
-    if (wm->frames_z_order.size == 0) {
+    Window w = e->window;
+    LOG(wm, "process_property_notify: window=0x%08x", w);
+    Frame* frame = search_frame_of_child(wm, w);
+    if (frame == NULL) {
         return;
     }
-    if (frame != wm->frames_z_order.items[0]) {
+    if ((e->atom != XA_WM_NAME) || (e->state != PropertyNewValue)) {
         return;
     }
-    Window w = wm->taskbar.window;
-    GC gc = wm->taskbar.focused_gc;
-    XXFillRectangle(wm, wm->display, w, gc, x, 0, width, height);
+    get_window_name(wm, frame->title, array_sizeof(frame->title), w);
+    invalidate_glyph_run(&frame->title_run);
+    invalidate_glyph_run(&frame->list_run);
+    expose_frame(wm, frame);
+    expose_taskbar(wm);
 }
 
+typedef void (*EventHandler)(WindowManager*, XEvent*);
+
+static EventHandler event_handlers[LASTEvent];
+
 static void
-draw_vertical_line(WindowManager* wm, Drawable d, GC gc, int x, int y0, int y1)
+handle_button_press(WindowManager* wm, XEvent* event)
 {
-    XXDrawLine(wm, wm->display, d, gc, x, y0, x, y1);
+    XButtonEvent* e = &event->xbutton;
+    process_button_press(wm, e);
 }
 
 static void
-draw_list_rect(WindowManager* wm, Frame* frame, int x, int width, int height)
+handle_button_release(WindowManager* wm, XEvent* event)
 {
-    fill_top_frame_rect(wm, frame, x, width, height);
+    XButtonEvent* e = &event->xbutton;
+    process_button_release(wm, e);
+}
 
-    Window w = wm->taskbar.window;
-    GC gc = wm->taskbar.line_gc;
-    int y0 = 0;
-    int y1 = height;
-    draw_vertical_line(wm, w, gc, x, y0, y1);
-    draw_vertical_line(wm, w, gc, x + width, y0, y1);
+static void
+handle_configure_request(WindowManager* wm, XEvent* event)
+{
+    XConfigureRequestEvent* e = &event->xconfigurerequest;
+    process_configure_request(wm, e);
 }
 
-#if 0
-static Region
-__XCreateRegion__(const char* filename, int lineno, WindowManager* wm)
+static void
+handle_destroy_notify(WindowManager* wm, XEvent* event)
 {
-    LOG_X0(filename, lineno, wm, "XCreateRegion()");
-    return XCreateRegion();
+    XDestroyWindowEvent* e = &event->xdestroywindow;
+    process_destroy_notify(wm, e);
 }
 
-#define XXCreateRegion(wm)  __XCreateRegion__(__FILE__, __LINE__, (wm))
+static void
+handle_expose(WindowManager* wm, XEvent* event)
+{
+    XExposeEvent* e = &event->xexpose;
+    process_expose(wm, e);
+}
 
-static int
-__XShrinkRegion__(const char* filename, int lineno, WindowManager* wm, Region r, int dx, int dy)
+static void
+handle_leave_notify(WindowManager* wm, XEvent* event)
 {
-    LOG_X(filename, lineno, wm, "XShrinkRegion(r, dx=%d, dy=%d)", dx, dy);
-    return XShrinkRegion(r, dx, dy);
+    XCrossingEvent* e = &event->xcrossing;
+    process_leave_notify(wm, e);
 }
 
-#define XXShrinkRegion(wm, r, dx, dy) \
-                    __XShrinkRegion__(__FILE__, __LINE__, (wm), (r), (dx), (dy))
+static void
+handle_focus_in(WindowManager* wm, XEvent* event)
+{
+    XFocusChangeEvent* e = &event->xfocus;
+    process_focus_in(wm, e);
+}
 
-static int
-__XOffsetRegion__(const char* filename, int lineno, WindowManager* wm, Region r, int dx, int dy)
+static void
+handle_focus_out(WindowManager* wm, XEvent* event)
 {
-    LOG_X(filename, lineno, wm, "XOffsetRegion(r, dx=%d, dy=%d)", dx, dy);
-    return XOffsetRegion(r, dx, dy);
+    XFocusChangeEvent* e = &event->xfocus;
+    process_focus_out(wm, e);
 }
 
-#define XXOffsetRegion(wm, r, dx, dy) \
-                    __XOffsetRegion__(__FILE__, __LINE__, (wm), (r), (dx), (dy))
-#endif
+static void
+handle_motion_notify(WindowManager* wm, XEvent* event)
+{
+    /*
+     * Hmm... I dislike to reuse an object (event) for diffent usages.
+     */
+    XEvent last_event;
+    memcpy(&last_event, event, sizeof(last_event));
+    get_last_event(wm, event->xmotion.window, MotionNotify, &last_event);
+
+    XMotionEvent* e = &last_event.xmotion;
+    process_motion_notify(wm, e);
+}
 
 static void
-draw_list_entry(WindowManager* wm, Frame* frame, int x, int width, int height)
+handle_map_request(WindowManager* wm, XEvent* event)
 {
-    draw_list_rect(wm, frame, x, width, height);
+    XMapRequestEvent* e = &event->xmaprequest;
+    process_map_request(wm, e);
+}
 
-    XftDraw* d = wm->taskbar.draw;
-    clip_padded_region(wm, d, x, 0, width, height);
+static void
+handle_property_notify(WindowManager* wm, XEvent* event)
+{
+    XPropertyEvent* e = &event->xproperty;
+    process_property_notify(wm, e);
+}
 
-    XftColor* color = &wm->title_color;
-    XftFont* font = wm->title_font;
-    int padding_size = wm->padding_size;
-    int pos = x + padding_size;
-    int y = padding_size + wm->title_font->ascent;
-    XftChar8* pstr = (XftChar8*)frame->title;
-    XXftDrawStringUtf8(wm, d, color, font, pos, y, pstr, strlen(frame->title));
+static void
+handle_unmap_notify(WindowManager* wm, XEvent* event)
+{
+    XUnmapEvent* e = &event->xunmap;
+    process_unmap_notify(wm, e);
 }
 
 static void
-draw_window_list(WindowManager* wm, int list_right_x)
+handle_map_notify(WindowManager* wm, XEvent* event)
 {
-    Window w = wm->taskbar.window;
-    unsigned int _;
-    unsigned int taskbar_height;
-    get_geometry(wm, w, &_, &taskbar_height);
+    XMapEvent* e = &event->xmap;
+    process_override_redirect_notify(wm, e->window, e->override_redirect);
+}
 
-    int nframes = wm->all_frames.size;
-    if (nframes == 0) {
-        return;
-    }
-    int item_width = (list_right_x - taskbar_height) / nframes;
-    int i;
-    for (i = 0; i < nframes; i++) {
-        Frame* frame = wm->all_frames.items[i];
-        int x = taskbar_height + item_width * i;
-        draw_list_entry(wm, frame, x, item_width, taskbar_height);
-    }
+static void
+handle_configure_notify(WindowManager* wm, XEvent* event)
+{
+    XConfigureEvent* e = &event->xconfigure;
+    process_override_redirect_notify(wm, e->window, e->override_redirect);
 }
 
 static void
-draw_taskbar(WindowManager* wm)
+nop(WindowManager* _, XEvent* __)
 {
-    draw_clock(wm);
-    draw_window_list(wm, wm->taskbar.clock_x - wm->padding_size);
 }
 
 static void
-process_expose(WindowManager* wm, XExposeEvent* e)
+initialize_event_handlers()
 {
-    LOG(wm, "process_expose: window=0x%08x", e->window);
-    Window w = e->window;
-    if (w == wm->popup_menu.window) {
-        draw_popup_menu(wm);
-        return;
-    }
-    if (w == wm->taskbar.window) {
-        draw_taskbar(wm);
-        return;
-    }
-    if (e->x == wm->frame_size) {
-        /**
-         * If above condition is true, this Expose event may be a result of
-         * killing a child window. At this time, WM does not draw a frame,
-         * because parent frame will be destroyed soon.
-         * FIXME: More strict checking?
-         */
-        return;
+    int i;
+    for (i = 0; i < array_sizeof(event_handlers); i++) {
+        event_handlers[i] = nop;
     }
-    draw_frame(wm, w);
+
+#define REGISTER_HANDLER(type, handler) \
+    event_handlers[(type)] = handler
+    REGISTER_HANDLER(ButtonPress, handle_button_press);
+    REGISTER_HANDLER(ButtonRelease, handle_button_release);
+    REGISTER_HANDLER(ConfigureNotify, handle_configure_notify);
+    REGISTER_HANDLER(ConfigureRequest, handle_configure_request);
+    REGISTER_HANDLER(DestroyNotify, handle_destroy_notify);
+    REGISTER_HANDLER(Expose, handle_expose);
+    REGISTER_HANDLER(LeaveNotify, handle_leave_notify);
+    REGISTER_HANDLER(FocusIn, handle_focus_in);
+    REGISTER_HANDLER(FocusOut, handle_focus_out);
+    REGISTER_HANDLER(MotionNotify, handle_motion_notify);
+    REGISTER_HANDLER(MapNotify, handle_map_notify);
+    REGISTER_HANDLER(MapRequest, handle_map_request);
+    REGISTER_HANDLER(PropertyNotify, handle_property_notify);
+    REGISTER_HANDLER(UnmapNotify, handle_unmap_notify);
+#undef REGISTER_HANDLER
 }
 
-static pid_t
-do_fork()
-{
-    pid_t pid = fork();
-    if (pid == -1) {
-        print_error("fork failed: %s", strerror(errno));
-        exit(1);
+static void
+record_event_stats(WindowManager* wm, int type, long nsec, unsigned long requests, unsigned long round_trips)
+{
+    EventStats* stats = &wm->event_stats.types[type];
+    histogram_record(&stats->latency, 0 < nsec ? nsec : 0);
+    stats->requests += requests;
+    stats->round_trips += round_trips;
+    if (stats->max_round_trips < round_trips) {
+        stats->max_round_trips = round_trips;
     }
-    return pid;
 }
 
+#if defined(FAWM_FAKE)
+/* A replay prints every event, so that two runs can be compared. */
 static void
-fork_child(char* cmd)
+print_replayed_event(WindowManager* wm, int type, long nsec, unsigned long requests, unsigned long round_trips)
 {
-    pid_t pid = do_fork();
-    if (pid == 0) {
-        char* argv[] = { "/bin/sh", "-c", cmd, NULL };
-        execv(argv[0], argv);
-        exit(1);
-    }
-    exit(0);
+    int n = wm->replay.events_num;
+    double usec = (double)nsec / 1000;
+    printf("%d %s usec=%.1f requests=%lu round_trips=%lu\n", n, event_name[type], usec, requests, round_trips);
+    wm->replay.events_num++;
 }
+#endif
 
 static void
-execute(WindowManager* wm, char* cmd)
+process_event(WindowManager* wm, XEvent* e)
 {
-    pid_t pid = do_fork();
-    if (pid == 0) {
-        fork_child(cmd);
-        exit(1);
+    int type = e->type;
+    LOG(wm, "%s: window=0x%08x", event_name[type], e->xany.window);
+    /* Serial numbers tell how many requests the handler sent. */
+    Display* display = wm->display;
+    unsigned long serial = NextRequest(display);
+    unsigned long round_trips = wm->event_stats.round_trips;
+    long start = get_monotonic_nsec();
+    event_handlers[type](wm, e);
+    long elapsed = get_monotonic_nsec() - start;
+    unsigned long requests = NextRequest(display) - serial;
+    round_trips = wm->event_stats.round_trips - round_trips;
+    record_event_stats(wm, type, elapsed, requests, round_trips);
+#if defined(FAWM_FAKE)
+    if (wm->replay.replay != NULL) {
+        print_replayed_event(wm, type, elapsed, requests, round_trips);
     }
-    waitpid(pid, NULL, 0);
+#endif
 }
 
-static char* config_exe = "__fawm_config__";
-
-static char*
-make_config_exe_path(char* dest, size_t size, const char* fawm_exe)
+static void
+change_taskbar_event_mask(WindowManager* wm, Window w)
 {
-    /*
-     * For compatibility, I prepare a writable buffer for dirname(3).
-     */
-    char* buf = (char*)alloca(strlen(fawm_exe) + 1);
-    strcpy(buf, fawm_exe);
-    const char* dir = dirname(buf);
-    snprintf(dest, size, "%s/%s", dir, config_exe);
-
-    return dest;
+    long mask = 0
+        | Button1MotionMask
+        | ButtonPressMask
+        | ButtonReleaseMask
+        | ExposureMask;
+    change_event_mask(wm, w, mask);
 }
 
 static void
-convert_offset_to_pointer(Config* config)
+change_popup_menu_event_mask(WindowManager* wm, Window w)
 {
-    uintptr_t base = (uintptr_t)config;
-#define offset2ptr(type, ref)   ref.ptr = (type*)(base + ref.offset)
-    offset2ptr(Menu, config->menu);
-
-    Menu* menu = config->menu.ptr;
-    offset2ptr(MenuItem, menu->items);
+    change_event_mask(wm, w, ExposureMask);
+}
 
+static void
+add_output(WindowManager* wm, int x, int y, int width, int height)
+{
     int i;
-    for (i = 0; i < menu->items_num; i++) {
-        MenuItem* item = &menu->items.ptr[i];
-        offset2ptr(char, item->u.exec.caption);
-        offset2ptr(char, item->u.exec.command);
+    for (i = 0; i < wm->outputs_num; i++) {
+        Output* output = &wm->outputs[i];
+        if ((output->x == x) && (output->y == y)) {
+            /* A cloned output is shown as one. */
+            return;
+        }
     }
-#undef offset2ptr
+    if (OUTPUTS_MAX <= wm->outputs_num) {
+        return;
+    }
+    Output* output = &wm->outputs[wm->outputs_num];
+    output->x = x;
+    output->y = y;
+    output->width = width;
+    output->height = height;
+    wm->outputs_num++;
+    LOG(wm, "output %d: x=%d, y=%d, width=%d, height=%d", i, x, y, width, height);
 }
 
-static Bool
-read_file(void* dest, FILE* src, size_t size)
+#if defined(FAWM_HAVE_XRANDR)
+static void
+query_crtcs(WindowManager* wm)
 {
-    size_t nbytes = 0;
-    while (!ferror(src) && (nbytes < size)) {
-        void* ptr = (void*)((uintptr_t)dest + nbytes);
-        nbytes += fread(ptr, size - nbytes, 1, src);
+    Display* display = wm->display;
+    Window root = DefaultRootWindow(display);
+    XRRScreenResources* resources = XXRRGetScreenResourcesCurrent(wm, display, root);
+    if (resources == NULL) {
+        return;
     }
-    return nbytes == size ? True : False;
+    int i;
+    for (i = 0; i < resources->ncrtc; i++) {
+        RRCrtc crtc = resources->crtcs[i];
+        XRRCrtcInfo* info = XXRRGetCrtcInfo(wm, display, resources, crtc);
+        if (info == NULL) {
+            continue;
+        }
+        if ((info->mode != None) && (0 < info->noutput)) {
+            add_output(wm, info->x, info->y, info->width, info->height);
+        }
+        wm->backend->rr_free_crtc_info(info);
+    }
+    wm->backend->rr_free_screen_resources(resources);
 }
+#endif
 
-static Bool
-load_config(WindowManager* wm)
+static void
+query_outputs(WindowManager* wm)
 {
-    char buf[MAXPATHLEN];
-    const char* fawm_exe = wm->fawm_exe;
-    const char* p = strchr(fawm_exe, '/');
-    const char* exe = p != NULL ? make_config_exe_path(buf, array_sizeof(buf), fawm_exe) : config_exe;
-
-    char cmd[MAXPATHLEN];
-    snprintf(cmd, array_sizeof(cmd), "%s %s", exe, wm->config_file);
-
-    FILE* fpin = popen(cmd, "r");
-    assert(fpin != NULL);
-    size_t size;
-    if (!read_file(&size, fpin, sizeof(size))) {
-        pclose(fpin);
-        return False;
-    }
-    Config* config = (Config*)malloc(size);
-    assert(config != NULL);
-    if (!read_file(config, fpin, size)) {
-        pclose(fpin);
-        return False;
+    wm->outputs_num = 0;
+#if defined(FAWM_HAVE_XRANDR)
+    if (wm->rr_event_base != -1) {
+        query_crtcs(wm);
     }
-    if (pclose(fpin) != 0) {
-        return False;
+#endif
+    if (0 < wm->outputs_num) {
+        return;
     }
+    Display* display = wm->display;
+    int screen = DefaultScreen(display);
+    int width = DisplayWidth(display, screen);
+    int height = DisplayHeight(display, screen);
+    add_output(wm, 0, 0, width, height);
+}
 
-    convert_offset_to_pointer(config);
-    free(wm->config);
-    wm->config = config;
-
-    return True;
+static void
+setup_outputs(WindowManager* wm)
+{
+#if defined(FAWM_HAVE_XRANDR)
+    Display* display = wm->display;
+    int event_base;
+    int error_base;
+    if (wm->backend->rr_query_extension(display, &event_base, &error_base)) {
+        wm->rr_event_base = event_base;
+        Window root = DefaultRootWindow(display);
+        XXRRSelectInput(wm, display, root, RRScreenChangeNotifyMask);
+    }
+    else {
+        wm->rr_event_base = -1;
+    }
+#endif
+    query_outputs(wm);
 }
 
-static int
-compute_popup_menu_width(WindowManager* wm)
+static void
+setup_desktops(WindowManager* wm)
 {
-    int max = 0;
-    Menu* menu = wm->config->menu.ptr;
+    /*
+     * Containers are created before the taskbar to be stacked under it. They
+     * show the background of the root window, and take clicks for it.
+     */
+    Display* display = wm->display;
+    Window root = DefaultRootWindow(display);
+    unsigned int root_width;
+    unsigned int root_height;
+    get_geometry(wm, root, &root_width, &root_height);
+    XSetWindowAttributes swa;
+    swa.background_pixmap = ParentRelative;
+    swa.event_mask = 0
+        | Button1MotionMask
+        | ButtonPressMask
+        | ButtonReleaseMask;
+    unsigned long mask = CWBackPixmap | CWEventMask;
+    RestartSnapshot* snapshot = wm->restart.snapshot;
     int i;
-    for (i = 0; i < menu->items_num; i++) {
-        const char* caption = get_menu_item_caption(&menu->items.ptr[i]);
-        int len = strlen(caption);
-        int width = compute_text_width(wm, wm->title_font, caption, len);
-        max = max < width ? width : max;
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        Desktop* desktop = &wm->desktops[i];
+        Window w;
+        if (snapshot != NULL) {
+            w = snapshot->header->containers[i];
+            change_event_mask(wm, w, swa.event_mask);
+        }
+        else {
+            w = XXCreateWindow(
+                wm,
+                display, root,
+                0, 0,
+                root_width, root_height,
+                0,
+                CopyFromParent, InputOutput, CopyFromParent,
+                mask, &swa);
+        }
+        LOG(wm, "desktop %d: container=0x%08x", i, w);
+        track_window(wm, w);
+        desktop->container = w;
+        initialize_array(&desktop->frames);
+        initialize_array(&desktop->z_order);
+        initialize_array(&desktop->applied);
+        desktop->dirty = False;
     }
-    return max;
+    wm->current_desktop = snapshot != NULL ? snapshot->header->current_desktop : 0;
 }
 
 static void
-resize_popup_menu(WindowManager* wm)
+setup_popup_menu(WindowManager* wm)
 {
-    Window w = wm->popup_menu.window;
-    int width = 2 * wm->popup_menu.margin + compute_popup_menu_width(wm);
-    int font_height = compute_font_height(wm->title_font);
-    int height = font_height * wm->config->menu.ptr->items_num;
-    XXResizeWindow(wm, wm->display, w, width, height);
+    Display* display = wm->display;
+    int screen = DefaultScreen(display);
+    Window w = XXCreateSimpleWindow(
+        wm,
+        display, DefaultRootWindow(display),
+        0, 0,
+        42, 42, /* They are dummy. They will be defined later. */
+        wm->border_size,
+        BlackPixel(display, screen), wm->unfocused_foreground_color);
+    LOG(wm, "popup menu: 0x%08x", w);
+    change_popup_menu_event_mask(wm, w);
+    track_window(wm, w);
+    wm->popup_menu.window = w;
+    wm->popup_menu.draw = create_draw(wm, w);
+    assert(wm->popup_menu.draw != NULL);
+    wm->popup_menu.margin = 8;
 }
 
 static void
-process_button_release(WindowManager* wm, XButtonEvent* e)
+setup_gcs(WindowManager* wm)
 {
-    LOG(wm, "process_button_release: window=0x%08x, root=0x%08x, subwindow=0x%08x", e->window, e->root, e->subwindow);
-    Frame* frame = search_frame(wm, e->window);
-    if (frame != NULL) {
-        release_frame(wm);
-        return;
-    }
-    unmap_popup_menu(wm);
-    int index = detect_selected_popup_item(wm, e->x_root, e->y_root);
-    if (index < 0) {
-        return;
-    }
-    MenuItem* item = &wm->config->menu.ptr->items.ptr[index];
-    switch (item->type) {
-    case MENU_ITEM_TYPE_EXIT:
-        wm->running = False;
-        break;
-    case MENU_ITEM_TYPE_RELOAD:
-        load_config(wm);
-        resize_popup_menu(wm);
-        break;
-    default:
-        assert(item->type == MENU_ITEM_TYPE_EXEC);
-        execute(wm, item->u.exec.command.ptr);
-        break;
+    Display* display = wm->display;
+    int screen = DefaultScreen(display);
+    Window root = DefaultRootWindow(display);
+    wm->gcs.line_gc = create_foreground_gc(wm, root, BlackPixel(display, screen));
+    wm->gcs.focused_gc = create_foreground_gc(wm, root, wm->focused_foreground_color);
+    wm->gcs.unfocused_gc = create_foreground_gc(wm, root, wm->unfocused_foreground_color);
+
+    wm->frame_draw = create_draw(wm, root);
+    assert(wm->frame_draw != NULL);
+}
+
+static void
+setup_decoration(WindowManager* wm)
+{
+    Display* display = wm->display;
+    int screen = DefaultScreen(display);
+    Window root = DefaultRootWindow(display);
+    int width = compute_buttons_width(wm);
+    int height = compute_buttons_height(wm);
+    int depth = DefaultDepth(display, screen);
+    int status;
+    for (status = 0; status < FRAME_STATUS_NUM; status++) {
+        Pixmap pixmap = XXCreatePixmap(wm, display, root, width, height, depth);
+        draw_boxes(wm, pixmap, status);
+        wm->decoration.buttons[status] = pixmap;
     }
 }
 
 static void
-change_frame_background(WindowManager* wm, Window w, int pixel)
+setup_ellipsis(WindowManager* wm)
 {
-    XXSetWindowBackground(wm, wm->display, w, pixel);
-    expose(wm, w);
+    /*
+     * Glyphs of an ellipsis are computed once. If the title font does not have
+     * "\u2026" (HORIZONTAL ELLIPSIS), three periods are used instead.
+     */
+    Display* display = wm->display;
+    XftFont* font = wm->title_font;
+    FcChar32 c = 0x2026;
+    int n = 1;
+    if (!XXftCharExists(wm, display, font, c)) {
+        c = '.';
+        n = MAX_ELLIPSIS_GLYPHS;
+    }
+    FT_UInt glyph = XXftCharIndex(wm, display, font, c);
+    XGlyphInfo info;
+    XXftGlyphExtents(wm, display, font, &glyph, 1, &info);
+    wm->ellipsis.glyph = glyph;
+    wm->ellipsis.glyphs_num = n;
+    wm->ellipsis.advance = info.xOff;
 }
 
-static Bool
-is_alive_frame(WindowManager* wm, Window w)
+static void
+setup_title_font(WindowManager* wm)
 {
-    return search_frame(wm, w) != NULL;
+    wm->title_font = open_font(wm, "VL PGothic-18");
+    wm->taskbar.clock_font = NULL;
+    wm->taskbar.clock_font_wanted = False;
+    wm->taskbar.clock_margin = 8;
+    setup_ellipsis(wm);
 }
 
 static void
-process_focus_out(WindowManager* wm, XFocusChangeEvent* e)
+setup_colors(WindowManager* wm)
 {
-    LOG(wm, "process_focus_out: window=0x%08x", e->window);
-    if (e->mode != NotifyNormal) {
-        return;
-    }
-    int detail = e->detail;
-    if ((detail != NotifyNonlinear) && (detail != NotifyNonlinearVirtual)) {
-        return;
-    }
-    Window w = e->window;
-    if (!is_alive_frame(wm, w)) {
-        /* XXX: X seems to throw FocusOut event for XDestroyWindow'ed window? */
-        return;
-    }
-    change_frame_background(wm, w, wm->unfocused_foreground_color);
+    const char* names[] = { "light pink", "light grey", "black" };
+    XColor colors[array_sizeof(names)];
+    alloc_colors(wm, names, colors, array_sizeof(names));
+    wm->focused_foreground_color = colors[0].pixel;
+    wm->unfocused_foreground_color = colors[1].pixel;
+
+    XftColor* title_color = &wm->title_color;
+    title_color->pixel = colors[2].pixel;
+    title_color->color.red = colors[2].red;
+    title_color->color.green = colors[2].green;
+    title_color->color.blue = colors[2].blue;
+    title_color->color.alpha = 0xffff;
 }
 
+/* Cursors are created by get_cursor() when they are used first. */
 static void
-process_focus_in(WindowManager* wm, XFocusChangeEvent* e)
+setup_cursors(WindowManager* wm)
 {
-    LOG(wm, "process_focus_in: window=0x%08x", e->window);
-    if (e->mode != NotifyNormal) {
-        return;
-    }
-    int detail = e->detail;
-    if ((detail != NotifyNonlinear) && (detail != NotifyNonlinearVirtual)) {
-        return;
-    }
-    Window w = e->window;
-    if (!is_alive_frame(wm, w)) {
-        return;
-    }
-    XXRaiseWindow(wm, wm->display, w);
-    change_frame_background(wm, w, wm->focused_foreground_color);
+    wm->normal_cursor = None;
+    wm->bottom_left_cursor = None;
+    wm->bottom_right_cursor = None;
+    wm->bottom_cursor = None;
+    wm->left_cursor = None;
+    wm->right_cursor = None;
+    wm->top_left_cursor = None;
+    wm->top_right_cursor = None;
+    wm->top_cursor = None;
 }
 
 static void
-map_frame_of_child(WindowManager* wm, Window w)
+create_taskbar(WindowManager* wm, Taskbar* bar, int x, int y, int width, int height)
 {
-    Frame* frame = search_frame_of_child(wm, w);
-    if (frame != NULL) {
-        Display* display = wm->display;
-        XXMapWindow(wm, display, frame->window);
-        XXMapWindow(wm, display, frame->child);
-        XXRaiseWindow(wm, display, frame->window);
-        focus(wm, frame);
-        return;
-    }
-    reparent_window(wm, w);
-    map_frame_of_child(wm, w);
+    Display* display = wm->display;
+    int screen = DefaultScreen(display);
+    Window w = XXCreateSimpleWindow(
+        wm,
+        display, DefaultRootWindow(display),
+        x, y,
+        width, height,
+        wm->border_size,
+        BlackPixel(display, screen), wm->unfocused_foreground_color);
+    LOG(wm, "taskbar: 0x%08x", w);
+    change_taskbar_event_mask(wm, w);
+    track_window(wm, w);
+    bar->window = w;
+    bar->draw = create_draw(wm, w);
+    bar->clock_x = 0;
 }
 
 static void
-process_map_request(WindowManager* wm, XMapRequestEvent* e)
+destroy_taskbar(WindowManager* wm, Taskbar* bar)
 {
-    Window w = e->window;
-#define FMT "process_map_request: parent=0x%08x, window=0x%08x"
-    LOG(wm, FMT, e->parent, w);
-#undef FMT
-    map_frame_of_child(wm, w);
+    Window w = bar->window;
+    XXftDrawDestroy(wm, bar->draw);
+    forget_window(wm, w);
+    XXDestroyWindow(wm, wm->display, w);
 }
 
+/*
+ * Places one taskbar at the bottom of each output. Existing taskbars are moved
+ * instead of being created again.
+ */
 static void
-process_unmap_notify(WindowManager* wm, XUnmapEvent* e)
+layout_taskbars(WindowManager* wm)
 {
-    LOG(wm, "process_unmap_notify: event=0x%08x, window=0x%08x", e->event, e->window);
-    Frame* frame = search_frame_of_child(wm, e->window);
-    if (frame == NULL) {
-        return;
+    int height = wm->taskbar.height;
+    int border_size = wm->border_size;
+    int i;
+    for (i = 0; i < wm->outputs_num; i++) {
+        Output* output = &wm->outputs[i];
+        int x = output->x - border_size;
+        int y = output->y + output->height - height;
+        int width = output->width;
+        Taskbar* bar = &wm->taskbar.bars[i];
+        if (i < wm->taskbar.bars_num) {
+            XXMoveResizeWindow(wm, wm->display, bar->window, x, y, width, height);
+            continue;
+        }
+        create_taskbar(wm, bar, x, y, width, height);
     }
-    unmap_frame(wm, frame);
+    for (; i < wm->taskbar.bars_num; i++) {
+        destroy_taskbar(wm, &wm->taskbar.bars[i]);
+    }
+    wm->taskbar.bars_num = wm->outputs_num;
 }
 
-static char event_name[LASTEvent][32];
+static void
+map_taskbars(WindowManager* wm)
+{
+    int i;
+    for (i = 0; i < wm->taskbar.bars_num; i++) {
+        XXMapWindow(wm, wm->display, wm->taskbar.bars[i].window);
+    }
+}
 
 static void
-initialize_event_name()
+setup_taskbar(WindowManager* wm)
 {
-    bzero(event_name, sizeof(event_name));
-#define REGISTER_NAME(type) \
-    strncpy(event_name[(type)], #type, sizeof(event_name[(type)]))
-    REGISTER_NAME(KeyPress);
-    REGISTER_NAME(KeyRelease);
-    REGISTER_NAME(ButtonPress);
-    REGISTER_NAME(ButtonRelease);
-    REGISTER_NAME(MotionNotify);
-    REGISTER_NAME(EnterNotify);
-    REGISTER_NAME(LeaveNotify);
-    REGISTER_NAME(FocusIn);
-    REGISTER_NAME(FocusOut);
-    REGISTER_NAME(KeymapNotify);
-    REGISTER_NAME(Expose);
-    REGISTER_NAME(GraphicsExpose);
-    REGISTER_NAME(NoExpose);
-    REGISTER_NAME(VisibilityNotify);
-    REGISTER_NAME(CreateNotify);
-    REGISTER_NAME(DestroyNotify);
-    REGISTER_NAME(UnmapNotify);
-    REGISTER_NAME(MapNotify);
-    REGISTER_NAME(MapRequest);
-    REGISTER_NAME(ReparentNotify);
-    REGISTER_NAME(ConfigureNotify);
-    REGISTER_NAME(ConfigureRequest);
-    REGISTER_NAME(GravityNotify);
-    REGISTER_NAME(ResizeRequest);
-    REGISTER_NAME(CirculateNotify);
-    REGISTER_NAME(CirculateRequest);
-    REGISTER_NAME(PropertyNotify);
-    REGISTER_NAME(SelectionClear);
-    REGISTER_NAME(SelectionRequest);
-    REGISTER_NAME(SelectionNotify);
-    REGISTER_NAME(ColormapNotify);
-    REGISTER_NAME(ClientMessage);
-    REGISTER_NAME(MappingNotify);
-    REGISTER_NAME(GenericEvent);
-#undef REGISTER_NAME
+    int font_height = compute_font_height(wm->title_font);
+    wm->taskbar.height = font_height + 2 * wm->padding_size;
+    wm->taskbar.bars_num = 0;
+    initialize_array(&wm->taskbar.listed);
+    wm->taskbar.exposed = False;
+    wm->taskbar.clock = -1;
+    layout_taskbars(wm);
 }
 
+#if defined(FAWM_HAVE_XRANDR)
 static void
-configure_frame(WindowManager* wm, Window parent, Window w, XConfigureRequestEvent* e)
+rescue_frames(WindowManager* wm)
 {
-    Display* display = wm->display;
-    unsigned long value_mask = e->value_mask;
-    if (value_mask & CWWidth) {
-        XWindowChanges changes;
-        int width = e->width;
-        changes.width = width + compute_frame_width(wm);
-        unsigned int value_mask = CWWidth;
-        XXConfigureWindow(wm, display, parent, value_mask, &changes);
-        changes.width = width;
-        XXConfigureWindow(wm, display, w, value_mask, &changes);
-    }
-    if (value_mask & CWHeight) {
-        XWindowChanges changes;
-        int height = e->height;
-        changes.height = height + compute_frame_height(wm);
-        unsigned int value_mask = CWHeight;
-        XXConfigureWindow(wm, display, parent, value_mask, &changes);
-        changes.height = height;
-        XXConfigureWindow(wm, display, w, value_mask, &changes);
+    /* Frames which were on a removed output are moved to the first one. */
+    Array* frames = &wm->all_frames;
+    int i;
+    for (i = 0; i < frames->size; i++) {
+        Frame* frame = frames->items[i];
+        Window w = frame->window;
+        int x;
+        int y;
+        unsigned int width;
+        unsigned int height;
+        get_window_geometry(wm, w, &x, &y, &width, &height);
+        if (search_output(wm, x, y) != -1) {
+            continue;
+        }
+        Output* output = &wm->outputs[0];
+        int new_x = output->x;
+        int new_y = output->y;
+        fit_in_output(wm, &new_x, &new_y, width, height);
+        XXMoveWindow(wm, wm->display, w, new_x, new_y);
     }
-    /* Ignore CWBorderWidth, CWSibling and CWStackMode */
 }
 
 static void
-process_configure_request(WindowManager* wm, XConfigureRequestEvent* e)
+process_screen_change(WindowManager* wm, XEvent* e)
 {
-    LOG(wm, "process_configure_request: parent=0x%08x, window=0x%08x, above=0x%08x", e->parent, e->window, e->above);
-    Window w = e->window;
-    Frame* frame = search_frame_of_child(wm, w);
-    if (frame != NULL) {
-        configure_frame(wm, e->parent, w, e);
-        return;
-    }
+    LOG0(wm, "process_screen_change");
+    /* This updates DisplayWidth() and DisplayHeight(). */
+    wm->backend->rr_update_configuration(e);
+    query_outputs(wm);
 
     Display* display = wm->display;
-    unsigned long value_mask = e->value_mask;
-    if (value_mask & CWX) {
-        XWindowChanges changes;
-        changes.x = e->x;
-        XXConfigureWindow(wm, display, w, CWX, &changes);
-    }
-    if (value_mask & CWY) {
-        XWindowChanges changes;
-        changes.y = e->y;
-        XXConfigureWindow(wm, display, w, CWY, &changes);
-    }
-    if (value_mask & CWWidth) {
-        XWindowChanges changes;
-        changes.width = e->width;
-        XXConfigureWindow(wm, display, w, CWWidth, &changes);
-    }
-    if (value_mask & CWHeight) {
-        XWindowChanges changes;
-        changes.height = e->height;
-        XXConfigureWindow(wm, display, w, CWHeight, &changes);
-    }
-    if (value_mask & CWBorderWidth) {
-        XWindowChanges changes;
-        changes.border_width = e->border_width;
-        XXConfigureWindow(wm, display, w, CWBorderWidth, &changes);
-    }
-    if (value_mask & CWSibling) {
-        LOG0(wm, "CWSibling");
+    int screen = DefaultScreen(display);
+    int width = DisplayWidth(display, screen);
+    int height = DisplayHeight(display, screen);
+    int i;
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        Window w = wm->desktops[i].container;
+        XXResizeWindow(wm, display, w, width, height);
     }
-    if (value_mask & CWStackMode) {
-        XWindowChanges changes;
-        changes.stack_mode = e->detail;
-        XXConfigureWindow(wm, display, w, CWStackMode, &changes);
+    layout_taskbars(wm);
+    map_taskbars(wm);
+    rescue_frames(wm);
+    expose_taskbar(wm);
+}
+#endif
+
+static void
+dispatch_event(WindowManager* wm, XEvent* e)
+{
+#if defined(FAWM_HAVE_XRANDR)
+    /* Events of extensions are out of event_handlers. */
+    if (e->type == wm->rr_event_base + RRScreenChangeNotify) {
+        process_screen_change(wm, e);
+        return;
     }
+#endif
+    process_event(wm, e);
 }
 
-static int
-__XUndefineCursor__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w)
+static TraceWriter*
+open_log(const char* log_file, Bool append)
 {
-    LOG_X(filename, lineno, wm, "XUndefineCursor(display, w=0x%08x)", w);
-    return XUndefineCursor(display, w);
+    if (strlen(log_file) == 0) {
+        return NULL;
+    }
+    TraceWriter* trace = trace_open(log_file, append);
+    if (trace == NULL) {
+        print_error("Cannot open %s: %s", log_file, strerror(errno));
+    }
+    return trace;
 }
 
-#define XXUndefineCursor(wm, a, b) \
-    __XUndefineCursor__(__FILE__, __LINE__, (wm), (a), (b))
+static void
+end_startup_phase(WindowManager* wm, const char* name)
+{
+    long now = get_monotonic_nsec();
+    int n = wm->startup.phases_num;
+    if (n < STARTUP_PHASES_MAX) {
+        wm->startup.phases[n].name = name;
+        wm->startup.phases[n].nsec = now - wm->startup.last;
+        wm->startup.phases_num++;
+    }
+    wm->startup.last = now;
+}
 
 static void
-process_leave_notify(WindowManager* wm, XCrossingEvent* e)
+report_startup(WindowManager* wm)
 {
-    LOG(wm, "process_leave_notify: window=0x%08x, root=0x%08x, subwindow=0x%08x", e->window, e->root, e->subwindow);
-    Window w = e->window;
-    if (search_frame(wm, w) == NULL) {
-        return;
+    int i;
+    for (i = 0; i < wm->startup.phases_num; i++) {
+        const char* name = wm->startup.phases[i].name;
+        double msec = wm->startup.phases[i].nsec / 1000000.0;
+        LOG(wm, "startup: %s: %.2f msec", name, msec);
+        if (wm->startup.verbose) {
+            print_error("startup: %s: %.2f msec", name, msec);
+        }
     }
-    XXUndefineCursor(wm, wm->display, w);
+    /* A fake server has no latency, but round trips tell the one of X. */
+    double total = (wm->startup.last - wm->startup.start) / 1000000.0;
+    unsigned long requests = NextRequest(wm->display) - 1;
+    unsigned long round_trips = wm->event_stats.round_trips;
+#define FMT "startup: total: %.2f msec, requests=%lu, round trips=%lu"
+    LOG(wm, FMT, total, requests, round_trips);
+    if (wm->startup.verbose) {
+        print_error(FMT, total, requests, round_trips);
+    }
+#undef FMT
 }
 
 static void
-expose_frame(WindowManager* wm, Frame* frame)
-{
-    expose(wm, frame->window);
+setup_geometries(WindowManager* wm)
+{
+    const char* path = wm->geometries_file;
+    wm->geometries = geometries_open(path);
+    if ((wm->geometries == NULL) && (path != NULL)) {
+        print_error("Cannot open %s: %s", path, strerror(errno));
+        /* Geometries are remembered until fawm exits. */
+        wm->geometries = geometries_open(NULL);
+    }
+    if (wm->geometries == NULL) {
+        print_error("Cannot make a table of geometries: %s", strerror(errno));
+        exit(1);
+    }
 }
 
 static void
-expose_taskbar(WindowManager* wm)
+setup_window_manager(WindowManager* wm, Display* display, const char* log_file)
 {
-    expose(wm, wm->taskbar.window);
+    wm->trace = open_log(log_file, wm->restart.restarted);
+    bzero(&wm->resources, sizeof(wm->resources));
+    bzero(&wm->shadow, sizeof(wm->shadow));
+
+    wm->display = display;
+    setup_title_font(wm);
+    end_startup_phase(wm, "title font");
+
+    wm->running = True;
+    setup_colors(wm);
+    end_startup_phase(wm, "colors");
+    wm->border_size = wm->client_border_size = 1;
+    wm->frame_size = 4;
+    wm->title_height = wm->title_font->height;
+    wm->resizable_corner_size = 32;
+    wm->padding_size = wm->frame_size;
+    initialize_array(&wm->all_frames);
+    spatial_initialize(&wm->spatial.index);
+    wm->spatial.top_z = wm->spatial.bottom_z = 0;
+    wm->focused_frame = NULL;
+    wm->restack_requests = 0;
+    bzero(&wm->restack, sizeof(wm->restack));
+    initialize_array(&wm->frame_pool);
+    initialize_array(&wm->free_frames);
+    bzero(&wm->frame_pool_stats, sizeof(wm->frame_pool_stats));
+    release_frame(wm);
+    setup_gcs(wm);
+    setup_decoration(wm);
+    setup_cursors(wm);
+    end_startup_phase(wm, "gcs and pixmaps");
+    setup_outputs(wm);
+    setup_desktops(wm);
+    end_startup_phase(wm, "outputs and desktops");
+
+    /* The menu is the first one which needs the config. */
+    if (!finish_loading_config(wm)) {
+        print_error("Cannot read config file: %s", wm->config_file);
+        exit(1);
+    }
+    end_startup_phase(wm, "waiting config");
+    setup_popup_menu(wm);
+    resize_popup_menu(wm);
+    setup_taskbar(wm);
+    wm->atoms.compound_text = intern(wm, "XA_COMPOUND_TEXT");
+    wm->atoms.wm_delete_window = intern(wm, "WM_DELETE_WINDOW");
+    wm->atoms.wm_protocols = intern(wm, "WM_PROTOCOLS");
+    wm->atoms.wm_window_role = intern(wm, "WM_WINDOW_ROLE");
+    end_startup_phase(wm, "menu and taskbar");
+
+    setup_geometries(wm);
+    end_startup_phase(wm, "geometries");
 }
 
 static void
-process_property_notify(WindowManager* wm, XPropertyEvent* e)
+update_clock(WindowManager* wm)
 {
-    Window w = e->window;
-    LOG(wm, "process_property_notify: window=0x%08x", w);
-    Frame* frame = search_frame_of_child(wm, w);
-    if (frame == NULL) {
-        return;
-    }
-    if ((e->atom != XA_WM_NAME) || (e->state != PropertyNewValue)) {
+    time_t now;
+    time(&now);
+    if (wm->taskbar.clock / 60 == now / 60) {
         return;
     }
-    get_window_name(wm, frame->title, array_sizeof(frame->title), w);
-    expose_frame(wm, frame);
     expose_taskbar(wm);
+    wm->taskbar.clock = now;
 }
 
-typedef void (*EventHandler)(WindowManager*, XEvent*);
-
-static EventHandler event_handlers[LASTEvent];
-
 static void
-handle_button_press(WindowManager* wm, XEvent* event)
+do_select(WindowManager* wm)
 {
-    XButtonEvent* e = &event->xbutton;
-    process_button_press(wm, e);
+    Display* display = wm->display;
+    int fd = XConnectionNumber(display);
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval timeout;
+    timeout.tv_sec = 1;
+    timeout.tv_usec = 0;
+    int status = select(fd + 1, &fds, NULL, NULL, &timeout);
+    if ((status < 0) && (errno == EINTR)) {
+        return;
+    }
+    if (status < 0) {
+        print_error("select failed: %s", strerror(errno));
+        abort();
+    }
+    else if (status == 0) {
+        update_clock(wm);
+        /* An idle time is good to write logs. */
+        if (wm->trace != NULL) {
+            trace_flush(wm->trace);
+        }
+        if (wm->recording != NULL) {
+            recording_flush(wm->recording);
+        }
+    }
 }
 
 static void
-handle_button_release(WindowManager* wm, XEvent* event)
+finish_event_batch(WindowManager* wm)
 {
-    XButtonEvent* e = &event->xbutton;
-    process_button_release(wm, e);
+    wm->taskbar.exposed = False;
+    Bool dirty = False;
+    int i;
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        Desktop* desktop = &wm->desktops[i];
+        dirty = dirty || desktop->dirty;
+        restack_frames(wm, desktop);
+    }
+    if (!dirty) {
+        return;
+    }
+    wm->backend->flush(wm->display);
 }
 
 static void
-handle_configure_request(WindowManager* wm, XEvent* event)
+save_frame_for_restart(WindowManager* wm, Frame* frame, RestartClient* client, RestartFrame* saved)
 {
-    XConfigureRequestEvent* e = &event->xconfigurerequest;
-    process_configure_request(wm, e);
+    int x;
+    int y;
+    unsigned int width;
+    unsigned int height;
+    get_window_geometry(wm, frame->window, &x, &y, &width, &height);
+    client->window = frame->child;
+    client->x = x + wm->border_size + wm->frame_size;
+    client->y = y + wm->border_size + 2 * wm->frame_size + wm->title_height;
+
+    bzero(saved, sizeof(*saved));
+    saved->window = frame->window;
+    saved->child = frame->child;
+    saved->buttons = frame->buttons;
+    saved->desktop = frame->desktop;
+    saved->z_index = index_in_array(&get_desktop_of_frame(wm, frame)->z_order, frame);
+    saved->width_inc = frame->width_inc;
+    saved->height_inc = frame->height_inc;
+    saved->wm_delete_window = frame->wm_delete_window;
+    saved->geometry_key = frame->geometry_key;
+    WindowState* state = find_window_state(wm, frame->window);
+    saved->known = state->known & (STATE_POSITION | STATE_SIZE);
+    saved->x = state->x;
+    saved->y = state->y;
+    saved->width = state->width;
+    saved->height = state->height;
+    snprintf(saved->title, array_sizeof(saved->title), "%s", frame->title);
 }
 
-static void
-handle_destroy_notify(WindowManager* wm, XEvent* event)
+static Bool
+is_executable(const char* path)
 {
-    XDestroyWindowEvent* e = &event->xdestroywindow;
-    process_destroy_notify(wm, e);
+    struct stat st;
+    if (access(path, X_OK) != 0) {
+        return False;
+    }
+    if ((stat(path, &st) != 0) || !S_ISREG(st.st_mode)) {
+        errno = EACCES;
+        return False;
+    }
+    return True;
 }
 
-static void
-handle_expose(WindowManager* wm, XEvent* event)
+/* Searches PATH like execvp(3) does. */
+static Bool
+find_executable(const char* name, char* path, size_t size)
 {
-    XExposeEvent* e = &event->xexpose;
-    process_expose(wm, e);
+    if (strchr(name, '/') != NULL) {
+        snprintf(path, size, "%s", name);
+        return is_executable(path);
+    }
+    const char* dirs = getenv("PATH");
+    const char* p = dirs != NULL ? dirs : "/bin:/usr/bin";
+    while (True) {
+        const char* colon = strchr(p, ':');
+        int len = colon != NULL ? colon - p : strlen(p);
+        /* An empty entry is the current directory. */
+        snprintf(path, size, "%.*s%s%s", len, p, 0 < len ? "/" : "", name);
+        if (is_executable(path)) {
+            return True;
+        }
+        if (colon == NULL) {
+            return False;
+        }
+        p = colon + 1;
+    }
 }
 
+/*
+ * Writes frames into a snapshot, and stops the event loop. wm_main() leaves
+ * the frames in the server, and main() executes the next fawm with the
+ * snapshot. If the snapshot cannot be written, fawm keeps running. If the
+ * executable is gone, fawm quits normally, because a user who restarts it
+ * does not want this one any more, and no frame must be left behind. If exec
+ * fails anyway, main() gives the clients back by give_back_failed_restart().
+ */
 static void
-handle_leave_notify(WindowManager* wm, XEvent* event)
+save_for_restart(WindowManager* wm)
 {
-    XCrossingEvent* e = &event->xcrossing;
-    process_leave_notify(wm, e);
+    wm->restart.requested = False;
+#if defined(FAWM_FAKE)
+    LOG0(wm, "restart is skipped with the fake server.");
+    return;
+#endif
+    const char* program = wm->restart.program;
+    char* path = wm->restart.path;
+    if (!find_executable(program, path, array_sizeof(wm->restart.path))) {
+        print_error("Cannot restart %s, so fawm quits: %s", program, strerror(errno));
+        wm->running = False;
+        return;
+    }
+    /* The snapshot has the order which the server has. */
+    finish_event_batch(wm);
+
+    RestartHeader header;
+    bzero(&header, sizeof(header));
+    assert(DESKTOPS_NUM <= RESTART_DESKTOPS_MAX);
+    header.desktops_num = DESKTOPS_NUM;
+    header.current_desktop = wm->current_desktop;
+    Frame* focused = wm->focused_frame;
+    header.focused = focused != NULL ? focused->child : None;
+    int n = wm->all_frames.size;
+    RestartClient* clients = (RestartClient*)alloc_memory(sizeof(clients[0]) * MAX(n, 1));
+    RestartFrame* frames = (RestartFrame*)alloc_memory(sizeof(frames[0]) * MAX(n, 1));
+    int nframes = 0;
+    int i;
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        Desktop* desktop = &wm->desktops[i];
+        header.containers[i] = desktop->container;
+        int j;
+        for (j = 0; j < desktop->frames.size; j++) {
+            Frame* frame = desktop->frames.items[j];
+            save_frame_for_restart(wm, frame, &clients[nframes], &frames[nframes]);
+            nframes++;
+        }
+    }
+    int fd = restart_create(&header, clients, frames, nframes);
+    free(frames);
+    free(clients);
+    if (fd == -1) {
+        print_error("Cannot save windows for restart: %s", strerror(errno));
+        return;
+    }
+    LOG(wm, "restart: fd=%d, frames=%d", fd, nframes);
+    wm->restart.fd = fd;
+    wm->running = False;
 }
 
-static void
-handle_focus_in(WindowManager* wm, XEvent* event)
-{
-    XFocusChangeEvent* e = &event->xfocus;
-    process_focus_in(wm, e);
-}
+static volatile sig_atomic_t restart_requested = 0;
+static volatile sig_atomic_t quit_requested = 0;
 
 static void
-handle_focus_out(WindowManager* wm, XEvent* event)
+request_restart(int signo)
 {
-    XFocusChangeEvent* e = &event->xfocus;
-    process_focus_out(wm, e);
+    restart_requested = 1;
 }
 
 static void
-handle_motion_notify(WindowManager* wm, XEvent* event)
+request_quit(int signo)
 {
-    /*
-     * Hmm... I dislike to reuse an object (event) for diffent usages.
-     */
-    XEvent last_event;
-    memcpy(&last_event, event, sizeof(last_event));
-    get_last_event(wm, event->xmotion.window, MotionNotify, &last_event);
-
-    XMotionEvent* e = &last_event.xmotion;
-    process_motion_notify(wm, e);
+    quit_requested = 1;
 }
 
 static void
-handle_map_request(WindowManager* wm, XEvent* event)
+setup_signals()
 {
-    XMapRequestEvent* e = &event->xmaprequest;
-    process_map_request(wm, e);
+    struct {
+        int signo;
+        void (*handler)(int);
+    } handlers[] = {
+        { SIGHUP, request_restart },
+        { SIGTERM, request_quit } };
+    int i;
+    for (i = 0; i < array_sizeof(handlers); i++) {
+        struct sigaction sa;
+        bzero(&sa, sizeof(sa));
+        sa.sa_handler = handlers[i].handler;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(handlers[i].signo, &sa, NULL) != 0) {
+            print_error("sigaction failed: %s", strerror(errno));
+        }
+    }
 }
 
-static void
-handle_property_notify(WindowManager* wm, XEvent* event)
+/* SIGHUP or the menu restarts fawm, and SIGTERM stops it. */
+static Bool
+is_stopping(WindowManager* wm)
 {
-    XPropertyEvent* e = &event->xproperty;
-    process_property_notify(wm, e);
+    if (quit_requested) {
+        quit_requested = 0;
+        wm->running = False;
+    }
+    if (restart_requested) {
+        restart_requested = 0;
+        wm->restart.requested = True;
+    }
+    if (wm->restart.requested) {
+        save_for_restart(wm);
+    }
+    return !wm->running;
 }
 
-static void
-handle_unmap_notify(WindowManager* wm, XEvent* event)
-{
-    XUnmapEvent* e = &event->xunmap;
-    process_unmap_notify(wm, e);
-}
+static volatile sig_atomic_t event_stats_requested = 0;
 
 static void
-nop(WindowManager* _, XEvent* __)
+request_event_stats(int signo)
 {
+    event_stats_requested = 1;
 }
 
 static void
-initialize_event_handlers()
+dump_event_stats(WindowManager* wm)
 {
+    print_error("event stats of pid %u (latencies in usec):", getpid());
     int i;
-    for (i = 0; i < array_sizeof(event_handlers); i++) {
-        event_handlers[i] = nop;
+    for (i = 0; i < LASTEvent; i++) {
+        EventStats* stats = &wm->event_stats.types[i];
+        Histogram* latency = &stats->latency;
+        unsigned long count = latency->count;
+        if (count == 0) {
+            continue;
+        }
+        double p50 = histogram_percentile(latency, 50) / 1000.0;
+        double p99 = histogram_percentile(latency, 99) / 1000.0;
+        double max = latency->max / 1000.0;
+        double requests = (double)stats->requests / count;
+        double round_trips = (double)stats->round_trips / count;
+        unsigned long max_round_trips = stats->max_round_trips;
+
+#define FMT "  %s: count=%lu, p50=%.1f, p99=%.1f, max=%.1f, requests=%.1f/event, round trips=%.2f/event (max %lu)"
+        const char* name = event_name[i];
+        print_error(FMT, name, count, p50, p99, max, requests, round_trips, max_round_trips);
+        LOG(wm, FMT, name, count, p50, p99, max, requests, round_trips, max_round_trips);
+#undef FMT
     }
 
-#define REGISTER_HANDLER(type, handler) \
-    event_handlers[(type)] = handler
-    REGISTER_HANDLER(ButtonPress, handle_button_press);
-    REGISTER_HANDLER(ButtonRelease, handle_button_release);
-    REGISTER_HANDLER(ConfigureRequest, handle_configure_request);
-    REGISTER_HANDLER(DestroyNotify, handle_destroy_notify);
-    REGISTER_HANDLER(Expose, handle_expose);
-    REGISTER_HANDLER(LeaveNotify, handle_leave_notify);
-    REGISTER_HANDLER(FocusIn, handle_focus_in);
-    REGISTER_HANDLER(FocusOut, handle_focus_out);
-    REGISTER_HANDLER(MotionNotify, handle_motion_notify);
-    REGISTER_HANDLER(MapRequest, handle_map_request);
-    REGISTER_HANDLER(PropertyNotify, handle_property_notify);
-    REGISTER_HANDLER(UnmapNotify, handle_unmap_notify);
-#undef REGISTER_HANDLER
-}
-
-static void
-process_event(WindowManager* wm, XEvent* e)
-{
-    int type = e->type;
-    LOG(wm, "%s: window=0x%08x", event_name[type], e->xany.window);
-    event_handlers[type](wm, e);
+    /*
+     * fawm-budgets reads this line. Requests out of handlers, like the ones of
+     * finish_event_batch(), are included.
+     */
+    unsigned long requests = NextRequest(wm->display) - 1;
+    unsigned long round_trips = wm->event_stats.round_trips;
+#define FMT "totals: requests=%lu, round trips=%lu"
+    print_error(FMT, requests, round_trips);
+    LOG(wm, FMT, requests, round_trips);
+#undef FMT
 }
 
-static void
-change_event_mask(WindowManager* wm, Window w, long event_mask)
+static long
+get_heap_size()
 {
-    XSetWindowAttributes swa;
-    swa.event_mask = event_mask;
-    XXChangeWindowAttributes(wm, wm->display, w, CWEventMask, &swa);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 mi = mallinfo2();
+    return (long)mi.uordblks;
+#else
+    return -1;
+#endif
 }
 
+/*
+ * fawm-stress reads this line to find leaks. All numbers must come back after
+ * windows are closed.
+ */
 static void
-change_taskbar_event_mask(WindowManager* wm, Window w)
+dump_resources(WindowManager* wm)
 {
-    long mask = 0
-        | Button1MotionMask
-        | ButtonPressMask
-        | ButtonReleaseMask
-        | ExposureMask;
-    change_event_mask(wm, w, mask);
+    int capacity = wm->all_frames.capacity + wm->frame_pool.capacity + wm->free_frames.capacity + wm->taskbar.listed.capacity;
+    int i;
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        Desktop* desktop = &wm->desktops[i];
+        capacity += desktop->frames.capacity + desktop->z_order.capacity + desktop->applied.capacity;
+    }
+    int nframes = wm->all_frames.size;
+    int npooled = wm->frame_pool.size;
+    int nstates = wm->shadow.windows.size;
+    int gcs = wm->resources.gcs;
+    int pixmaps = wm->resources.pixmaps;
+    int xft_draws = wm->resources.xft_draws;
+    int regions = wm->resources.regions;
+    long heap = get_heap_size();
+#define FMT "resources: frames=%d, pooled frames=%d, array capacity=%d, window states=%d, gcs=%d, pixmaps=%d, xft_draws=%d, regions=%d, heap=%ld"
+    print_error(FMT, nframes, npooled, capacity, nstates, gcs, pixmaps, xft_draws, regions, heap);
+    LOG(wm, FMT, nframes, npooled, capacity, nstates, gcs, pixmaps, xft_draws, regions, heap);
+#undef FMT
 }
 
+#if defined(FAWM_FAKE)
 static void
-change_popup_menu_event_mask(WindowManager* wm, Window w)
+wait_replayed_time(WindowManager* wm, uint64_t nsec)
 {
-    change_event_mask(wm, w, ExposureMask);
+    if (wm->replay.first_nsec == 0) {
+        wm->replay.first_nsec = nsec;
+        wm->replay.start = get_monotonic_nsec();
+    }
+    if (!wm->replay.realtime) {
+        return;
+    }
+    long at = wm->replay.start + (long)(nsec - wm->replay.first_nsec);
+    long rest = at - get_monotonic_nsec();
+    if (rest <= 0) {
+        return;
+    }
+    struct timespec ts;
+    ts.tv_sec = rest / 1000000000;
+    ts.tv_nsec = rest % 1000000000;
+    while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR));
 }
 
 static void
-setup_popup_menu(WindowManager* wm)
+record_scenario_step(WindowManager* wm, Scenario scenario, unsigned long requests, unsigned long round_trips)
 {
-    Display* display = wm->display;
-    int screen = DefaultScreen(display);
-    Window w = XXCreateSimpleWindow(
-        wm,
-        display, DefaultRootWindow(display),
-        0, 0,
-        42, 42, /* They are dummy. They will be defined later. */
-        wm->border_size,
-        BlackPixel(display, screen), wm->unfocused_foreground_color);
-    LOG(wm, "popup menu: 0x%08x", w);
-    change_popup_menu_event_mask(wm, w);
-    wm->popup_menu.window = w;
-
-    XGCValues title_gc;
-    title_gc.foreground = wm->focused_foreground_color;
-    int mask = GCForeground;
-    wm->popup_menu.title_gc = XXCreateGC(wm, display, w, mask, &title_gc);
-
-    XGCValues selected_gc;
-    selected_gc.foreground = wm->focused_foreground_color;
-    wm->popup_menu.selected_gc = XXCreateGC(wm, display, w, mask, &selected_gc);
-
-    wm->popup_menu.draw = create_draw(wm, w);
-    assert(wm->popup_menu.draw != NULL);
-    wm->popup_menu.margin = 8;
+    ScenarioStats* stats = &wm->fake.scenarios[scenario];
+    stats->requests += requests;
+    if (stats->max_requests < requests) {
+        stats->max_requests = requests;
+    }
+    stats->round_trips += round_trips;
+    if (stats->max_round_trips < round_trips) {
+        stats->max_round_trips = round_trips;
+    }
 }
 
-static void
-setup_title_font(WindowManager* wm)
+/*
+ * A step is played after fawm processed all events of the previous one, so
+ * requests since the previous step are of it. The first step maps background
+ * windows, and it is not counted. Returns False after the last step.
+ */
+static Bool
+play_scenario_step(WindowManager* wm)
 {
     Display* display = wm->display;
-    int screen = DefaultScreen(display);
-
-#define OPEN_FONT(var, name) \
-XftFont* var; \
-do { \
-        var = XXftFontOpenName(wm, display, screen, (name)); \
-        if (var == NULL) { \
-            const char* fmt = "Cannot find font (XftFontOpenName failed): %s"; \
-            print_error(fmt, (name)); \
-            exit(1); \
-        } \
-} while (0)
-    OPEN_FONT(title_font, "VL PGothic-18");
-    wm->title_font = title_font;
-    OPEN_FONT(clock_font, "VL Gothic-18");
-    wm->taskbar.clock_font = clock_font;
-#undef OPEN_FONT
-    wm->taskbar.clock_margin = 8;
-
-    Visual* visual = DefaultVisual(display, screen);
-    Colormap colormap = DefaultColormap(display, screen);
-    XftColor* result = &wm->title_color;
-    /**
-     * XXX: I could not find a description about a mean of XftColorAllocName's
-     * return value.
-     */
-    XXftColorAllocName(wm, display, visual, colormap, "black", result);
+    unsigned long serial = NextRequest(display);
+    unsigned long round_trips = wm->event_stats.round_trips;
+    int repeats = wm->fake.repeats;
+    int step = wm->fake.step;
+    if (1 < step) {
+        Scenario scenario = (step - 2) / repeats;
+        unsigned long requests = serial - wm->fake.serial;
+        record_scenario_step(wm, scenario, requests, round_trips - wm->fake.round_trips);
+        char message[128];
+        if (!fake_check_scenario(display, scenario, message, array_sizeof(message))) {
+            const char* names[] = SCENARIO_NAMES;
+            print_error("fake: scenario %s: %s", names[scenario], message);
+            wm->fake.failures++;
+        }
+    }
+    if (step == 0) {
+        fake_prepare_scenarios(display);
+    }
+    else if (step <= SCENARIOS_NUM * repeats) {
+        fake_play_scenario(display, (step - 1) / repeats, (step - 1) % repeats);
+    }
+    else {
+        return False;
+    }
+    wm->fake.serial = serial;
+    wm->fake.round_trips = round_trips;
+    wm->fake.step++;
+    return True;
 }
 
+/* Clients which exist before fawm starts, like the ones of a session */
 static void
-setup_cursors(WindowManager* wm)
+map_fake_clients(Display* display, int n)
 {
-    Display* display = wm->display;
-#define CREATE_CURSOR(member, cursor) \
-    wm->member = XXCreateFontCursor(wm, display, cursor)
-    CREATE_CURSOR(normal_cursor, XC_top_left_arrow);
-    CREATE_CURSOR(bottom_left_cursor, XC_bottom_left_corner);
-    CREATE_CURSOR(bottom_right_cursor, XC_bottom_right_corner);
-    CREATE_CURSOR(bottom_cursor, XC_bottom_side);
-    CREATE_CURSOR(left_cursor, XC_left_side);
-    CREATE_CURSOR(right_cursor, XC_right_side);
-    CREATE_CURSOR(top_left_cursor, XC_top_left_corner);
-    CREATE_CURSOR(top_right_cursor, XC_top_right_corner);
-    CREATE_CURSOR(top_cursor, XC_top_side);
-#undef CREATE_CURSOR
+    int i;
+    for (i = 0; i < n; i++) {
+        char title[32];
+        snprintf(title, array_sizeof(title), "client %d", i);
+        int x = (37 * i) % (FAKE_SCREEN_WIDTH - 640);
+        int y = (23 * i) % (FAKE_SCREEN_HEIGHT - 480);
+        Window w = fake_create_client(display, x, y, 640, 480, title);
+        fake_map_client(display, w);
+    }
 }
 
-static void
-setup_taskbar(WindowManager* wm)
+/*
+ * The first DESKTOPS_NUM steps fill the desktops, and the others switch
+ * desktops. A switch is timed from its click until fawm processed all events
+ * of it.
+ */
+static Bool
+play_switch_step(WindowManager* wm)
 {
     Display* display = wm->display;
-    Window root = DefaultRootWindow(display);
-    unsigned int root_width;
-    unsigned int root_height;
-    get_geometry(wm, root, &root_width, &root_height);
-
-    int font_height = compute_font_height(wm->title_font);
-    int height = font_height + 2 * wm->padding_size;
-    int border_size = wm->border_size;
-    int screen = DefaultScreen(display);
-    Window w = XXCreateSimpleWindow(
-        wm,
-        display, root,
-        - border_size, root_height - height,
-        root_width, height,
-        border_size,
-        BlackPixel(display, screen), wm->unfocused_foreground_color);
-    LOG(wm, "taskbar: 0x%08x", w);
-    change_taskbar_event_mask(wm, w);
-    wm->taskbar.window = w;
-    wm->taskbar.draw = create_draw(wm, w);
-    wm->taskbar.clock = -1;
-    wm->taskbar.clock_x = 0;
-
-    wm->taskbar.line_gc = create_foreground_gc(wm, w, BlackPixel(display, screen));
-    wm->taskbar.focused_gc = create_foreground_gc(wm, w, wm->focused_foreground_color);
-}
-
-static FILE*
-open_log(const char* log_file)
-{
-    if (strlen(log_file) == 0) {
-        return NULL;
+    long now = get_monotonic_nsec();
+    unsigned long serial = NextRequest(display);
+    int step = wm->fake.step;
+    if (DESKTOPS_NUM < step) {
+        histogram_record(&wm->fake.switch_latency, now - wm->fake.step_start);
+        unsigned long requests = serial - wm->fake.serial;
+        wm->fake.switch_requests += requests;
+        if (wm->fake.max_switch_requests < requests) {
+            wm->fake.max_switch_requests = requests;
+        }
     }
-    FILE* fp = fopen(log_file, "w");
-    if (fp == NULL) {
-        goto fail;
+    if (step < DESKTOPS_NUM) {
+        fake_click_pager(display, step);
+        map_fake_clients(display, wm->fake.switch_windows);
     }
-    if (fcntl(fileno(fp), F_SETFD, FD_CLOEXEC) == -1) {
-        goto fail;
+    else if (step < DESKTOPS_NUM + FAKE_SWITCHES_NUM) {
+        /* The last filled desktop is the current one at first. */
+        fake_click_pager(display, (step + 1) % DESKTOPS_NUM);
     }
-    return fp;
-
-fail:
-    print_error("Cannot open %s: %s", log_file, strerror(errno));
-
-    return NULL;
-}
-
-static void
-setup_window_manager(WindowManager* wm, Display* display, const char* log_file)
-{
-    wm->log_file = open_log(log_file);
-
-    wm->display = display;
-    setup_title_font(wm);
-
-    wm->running = True;
-    wm->focused_foreground_color = alloc_color(wm, "light pink");
-    wm->unfocused_foreground_color = alloc_color(wm, "light grey");
-    wm->border_size = wm->client_border_size = 1;
-    wm->frame_size = 4;
-    wm->title_height = wm->title_font->height;
-    wm->resizable_corner_size = 32;
-    wm->padding_size = wm->frame_size;
-    initialize_array(&wm->all_frames);
-    initialize_array(&wm->frames_z_order);
-    release_frame(wm);
-    setup_cursors(wm);
-    setup_popup_menu(wm);
-    resize_popup_menu(wm);
-    setup_taskbar(wm);
-    wm->atoms.wm_delete_window = intern(wm, "WM_DELETE_WINDOW");
-    wm->atoms.wm_protocols = intern(wm, "WM_PROTOCOLS");
+    else {
+        return False;
+    }
+    wm->fake.serial = serial;
+    wm->fake.step_start = get_monotonic_nsec();
+    wm->fake.step++;
+    return True;
 }
 
-static void
-update_clock(WindowManager* wm)
+/* Queues the next batch of the recording. Returns False at the end. */
+static Bool
+put_replayed_batch(WindowManager* wm)
 {
-    time_t now;
-    time(&now);
-    if (wm->taskbar.clock / 60 == now / 60) {
-        return;
+    Replay* replay = wm->replay.replay;
+    Display* display = wm->display;
+    XEvent e;
+    uint64_t nsec;
+    bool batch_end = false;
+    while (!batch_end) {
+        if (!replay_next(replay, &e, &nsec, &batch_end)) {
+            return 0 < wm->backend->pending(display);
+        }
+        if (wm->backend->pending(display) == 0) {
+            wait_replayed_time(wm, nsec);
+        }
+        fake_put_event(display, &e);
     }
-    expose(wm, wm->taskbar.window);
-    wm->taskbar.clock = now;
+    return True;
 }
+#endif
 
-static void
-do_select(WindowManager* wm)
+static Bool
+wait_event(WindowManager* wm)
 {
-    Display* display = wm->display;
-    int fd = XConnectionNumber(display);
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(fd, &fds);
-    struct timeval timeout;
-    timeout.tv_sec = 1;
-    timeout.tv_usec = 0;
-    int status = select(fd + 1, &fds, NULL, NULL, &timeout);
-    if (status < 0) {
-        print_error("select failed: %s", strerror(errno));
-        abort();
+    if (is_stopping(wm)) {
+        return False;
     }
-    else if (status == 0) {
-        update_clock(wm);
+#if defined(FAWM_FAKE)
+    Bool fake = wm->replay.replay == NULL;
+    if (fake) {
+        if (wm->fake.events_left == 0) {
+            return False;
+        }
+        wm->fake.events_left--;
+    }
+#endif
+    Display* display = wm->display;
+    while (wm->backend->pending(display) == 0) {
+        /* All queued events were processed. */
+        finish_event_batch(wm);
+        if (wm->taskbar.clock_font_wanted) {
+            open_clock_font(wm);
+        }
+        if (wm->recording != NULL) {
+            recording_write_batch(wm->recording);
+        }
+#if defined(FAWM_FAKE)
+        if (wm->replay.replay != NULL) {
+            if (!put_replayed_batch(wm)) {
+                return False;
+            }
+            continue;
+        }
+        if (fake && (0 < wm->fake.repeats)) {
+            if (!play_scenario_step(wm)) {
+                return False;
+            }
+            continue;
+        }
+        if (fake && (0 < wm->fake.switch_windows)) {
+            if (!play_switch_step(wm)) {
+                return False;
+            }
+            continue;
+        }
+        if (fake) {
+            fake_act(display, &wm->fake.seed);
+            continue;
+        }
+#endif
+        do_select(wm);
+        /* SIGUSR1 interrupts select(2). */
+        if (event_stats_requested) {
+            event_stats_requested = 0;
+            dump_event_stats(wm);
+            dump_resources(wm);
+        }
+        if (is_stopping(wm)) {
+            return False;
+        }
     }
+
+    return True;
 }
 
 static void
-wait_event(WindowManager* wm)
+setup_event_stats(WindowManager* wm)
 {
-    Display* display = wm->display;
-    while (XPending(display) == 0) {
-        do_select(wm);
+    int i;
+    for (i = 0; i < LASTEvent; i++) {
+        EventStats* stats = &wm->event_stats.types[i];
+        histogram_initialize(&stats->latency);
+        stats->requests = stats->round_trips = stats->max_round_trips = 0;
+    }
+    wm->event_stats.round_trips = 0;
+
+    struct sigaction sa;
+    bzero(&sa, sizeof(sa));
+    sa.sa_handler = request_event_stats;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGUSR1, &sa, NULL) != 0) {
+        print_error("sigaction failed: %s", strerror(errno));
     }
 }
 
@@ -2784,9 +6402,47 @@ log_error(FILE* fp, const char* fmt, ...)
     va_end(ap);
 }
 
+/*
+ * Windows which BadWindow errors named while collecting is True. An error
+ * handler has no WindowManager, so this is static like flags of signals.
+ */
+static struct {
+    Bool collecting;
+    int size;
+    int capacity;
+    XID* ids;
+} lost_windows;
+
+static void
+collect_lost_window(XID id)
+{
+    if (lost_windows.size == lost_windows.capacity) {
+        int capacity = MAX(8, 2 * lost_windows.capacity);
+        XID* p = (XID*)realloc(lost_windows.ids, sizeof(p[0]) * capacity);
+        assert(p != NULL);
+        lost_windows.capacity = capacity;
+        lost_windows.ids = p;
+    }
+    lost_windows.ids[lost_windows.size] = id;
+    lost_windows.size++;
+}
+
+static Bool
+is_lost_window(Window w)
+{
+    int i;
+    for (i = 0; (i < lost_windows.size) && (lost_windows.ids[i] != w); i++) {
+    }
+    return i < lost_windows.size;
+}
+
 static int
 error_handler(Display* display, XErrorEvent* e)
 {
+    if (lost_windows.collecting && (e->error_code == BadWindow)) {
+        collect_lost_window(e->resourceid);
+        return 0;
+    }
     FILE* fp = fopen("fawm-error.log", "a");
     assert(fp != NULL);
     log_error(fp, "**********");
@@ -2815,7 +6471,7 @@ static int
 __XSelectInput__(const char* filename, int lineno, WindowManager* wm, Display* display, Window w, int event_mask)
 {
     LOG_X(filename, lineno, wm, "XSelectInput(display, w=0x%08x, event_mask)", w);
-    return XSelectInput(display, w, event_mask);
+    return wm->backend->select_input(display, w, event_mask);
 }
 
 #define XXSelectInput(wm, a, b, c) \
@@ -2830,36 +6486,505 @@ execute_startup(WindowManager* wm, int argc, char* argv[])
     }
 }
 
+static Frame*
+adopt_frame(WindowManager* wm, RestartFrame* saved)
+{
+    Frame* frame = alloc_frame(wm);
+    frame->window = saved->window;
+    frame->child = saved->child;
+    frame->wm_delete_window = saved->wm_delete_window;
+    snprintf(frame->title, array_sizeof(frame->title), "%.*s", (int)sizeof(saved->title), saved->title);
+    invalidate_glyph_run(&frame->title_run);
+    invalidate_glyph_run(&frame->list_run);
+    frame->width_inc = saved->width_inc;
+    frame->height_inc = saved->height_inc;
+    frame->buttons = saved->buttons;
+    /* change_frame_background() exposes the frame to draw them. */
+    frame->marks_width = frame->marks_height = 0;
+    frame->marks_exposed = False;
+    frame->status = FOCUS_NONE;
+    frame->grabbed = False;
+    frame->desktop = saved->desktop;
+    frame->geometry_key = saved->geometry_key;
+
+    /* The previous fawm deselected events, and freed its pixmaps. */
+    Display* display = wm->display;
+    Window w = frame->window;
+    change_event_mask(wm, w, get_frame_event_mask());
+    change_event_mask(wm, frame->child, PropertyChangeMask);
+    Pixmap pixmap = wm->decoration.buttons[FOCUS_NONE];
+    XXSetWindowBackgroundPixmap(wm, display, frame->buttons, pixmap);
+    track_window(wm, frame->child);
+    track_window(wm, w);
+    WindowState* state = find_window_state(wm, w);
+    if (saved->known & STATE_POSITION) {
+        update_shadow_position(state, saved->x, saved->y);
+    }
+    if (saved->known & STATE_SIZE) {
+        update_shadow_size(state, saved->width, saved->height);
+    }
+    update_shadow_mapped(state, 0 <= saved->z_index);
+
+    Desktop* desktop = get_desktop_of_frame(wm, frame);
+    append_to_array(&wm->all_frames, frame);
+    append_to_array(&desktop->frames, frame);
+    SpatialEntry* entry = &frame->spatial;
+    entry->data = frame;
+    entry->layer = frame->desktop;
+    entry->z = 0;
+    entry->indexed = False;
+    state->frame = frame;
+    frame->applied_stamp = 0;
+
+    return frame;
+}
+
+struct AdoptedFrame {
+    int z_index;
+    Frame* frame;
+};
+
+typedef struct AdoptedFrame AdoptedFrame;
+
+static int
+compare_adopted_frames(const void* a, const void* b)
+{
+    const AdoptedFrame* x = (const AdoptedFrame*)a;
+    const AdoptedFrame* y = (const AdoptedFrame*)b;
+    if (x->frame->desktop != y->frame->desktop) {
+        return x->frame->desktop - y->frame->desktop;
+    }
+    return x->z_index - y->z_index;
+}
+
+/*
+ * A client may destroy its window while no fawm runs, and its frame is left
+ * empty. Adding children to the save-set names such ones by BadWindow, so one
+ * round trip finds all of them.
+ */
+static void
+find_lost_children(WindowManager* wm, RestartSnapshot* snapshot)
+{
+    Display* display = wm->display;
+    lost_windows.size = 0;
+    lost_windows.collecting = True;
+    int i;
+    for (i = 0; i < snapshot->header->frames_num; i++) {
+        XXAddToSaveSet(wm, display, snapshot->frames[i].child);
+    }
+    count_round_trip(wm);
+    wm->backend->sync(display, False);
+    lost_windows.collecting = False;
+}
+
+/*
+ * Takes frames which the previous fawm left, instead of reparenting clients
+ * again. The server already has the z-order of the snapshot, so nothing is
+ * restacked.
+ */
+static void
+adopt_frames(WindowManager* wm)
+{
+    RestartSnapshot* snapshot = wm->restart.snapshot;
+    find_lost_children(wm, snapshot);
+    int n = 0;
+    AdoptedFrame* adopted = (AdoptedFrame*)alloc_memory(sizeof(adopted[0]) * MAX(snapshot->header->frames_num, 1));
+    int i;
+    for (i = 0; i < snapshot->header->frames_num; i++) {
+        RestartFrame* saved = &snapshot->frames[i];
+        if (is_lost_window(saved->child)) {
+            LOG(wm, "lost: frame=0x%08x, child=0x%08x", saved->window, saved->child);
+            XXDestroyWindow(wm, wm->display, saved->window);
+            continue;
+        }
+        adopted[n].z_index = saved->z_index;
+        adopted[n].frame = adopt_frame(wm, saved);
+        n++;
+    }
+    qsort(adopted, n, sizeof(adopted[0]), compare_adopted_frames);
+    for (i = 0; i < n; i++) {
+        if (adopted[i].z_index < 0) {
+            continue;
+        }
+        Frame* frame = adopted[i].frame;
+        append_to_array(&get_desktop_of_frame(wm, frame)->z_order, frame);
+    }
+    free(adopted);
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        Desktop* desktop = &wm->desktops[i];
+        Array* z_order = &desktop->z_order;
+        int j;
+        for (j = 0; j < z_order->size; j++) {
+            append_to_array(&desktop->applied, z_order->items[j]);
+        }
+        /* The top has the largest z. */
+        for (j = z_order->size - 1; 0 <= j; j--) {
+            spatial_restack(&wm->spatial.index, &z_order->items[j]->spatial, ++wm->spatial.top_z);
+        }
+    }
+
+    /*
+     * The server keeps the focus, so no FocusIn draws the focused frame. The
+     * colors of this fawm may differ from the previous one.
+     */
+    Window focused = snapshot->header->focused;
+    for (i = 0; i < wm->all_frames.size; i++) {
+        Frame* frame = wm->all_frames.items[i];
+        reindex_window(wm, find_window_state(wm, frame->window));
+        if (frame->child == focused) {
+            wm->focused_frame = frame;
+            change_frame_background(wm, frame->window, wm->focused_foreground_color);
+            continue;
+        }
+        change_frame_background(wm, frame->window, wm->unfocused_foreground_color);
+        grab_click(wm, frame);
+    }
+
+    LOG(wm, "adopted: frames=%d, lost=%d", n, lost_windows.size);
+    restart_close(snapshot);
+    wm->restart.snapshot = NULL;
+    wm->restart.adopted = True;
+}
+
+/*
+ * The next fawm takes windows of this one, so they are left in the server by
+ * RetainTemporary. Only resources which the next one does not use are freed.
+ * Events on the windows are deselected, because only one client can select
+ * SubstructureRedirectMask or ButtonPressMask on a window.
+ */
+static void
+leave_windows_for_restart(WindowManager* wm)
+{
+    Display* display = wm->display;
+    int i;
+    for (i = 0; i < wm->all_frames.size; i++) {
+        Frame* frame = wm->all_frames.items[i];
+        ungrab_click(wm, frame);
+        change_event_mask(wm, frame->window, NoEventMask);
+    }
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        change_event_mask(wm, wm->desktops[i].container, NoEventMask);
+    }
+    Array* pool = &wm->frame_pool;
+    for (i = 0; i < pool->size; i++) {
+        XXDestroyWindow(wm, display, pool->items[i]->window);
+    }
+    for (i = 0; i < wm->taskbar.bars_num; i++) {
+        destroy_taskbar(wm, &wm->taskbar.bars[i]);
+    }
+    XXftDrawDestroy(wm, wm->popup_menu.draw);
+    XXDestroyWindow(wm, display, wm->popup_menu.window);
+    XXftDrawDestroy(wm, wm->frame_draw);
+
+    XXFreeGC(wm, display, wm->gcs.line_gc);
+    XXFreeGC(wm, display, wm->gcs.focused_gc);
+    XXFreeGC(wm, display, wm->gcs.unfocused_gc);
+    for (i = 0; i < FRAME_STATUS_NUM; i++) {
+        XXFreePixmap(wm, display, wm->decoration.buttons[i]);
+    }
+    Cursor cursors[] = {
+        wm->normal_cursor,
+        wm->bottom_left_cursor,
+        wm->bottom_right_cursor,
+        wm->bottom_cursor,
+        wm->left_cursor,
+        wm->right_cursor,
+        wm->top_left_cursor,
+        wm->top_right_cursor,
+        wm->top_cursor };
+    for (i = 0; i < array_sizeof(cursors); i++) {
+        if (cursors[i] != None) {
+            XXFreeCursor(wm, display, cursors[i]);
+        }
+    }
+    XXftFontClose(wm, display, wm->title_font);
+    if (wm->taskbar.clock_font != NULL) {
+        XXftFontClose(wm, display, wm->taskbar.clock_font);
+    }
+
+    XXSetCloseDownMode(wm, display, RetainTemporary);
+}
+
+/*
+ * Frames which were adopted belong to a previous fawm, so the server does not
+ * give their clients back by the save-set when this fawm exits.
+ */
+static void
+give_back_windows(WindowManager* wm)
+{
+    Display* display = wm->display;
+    Window root = DefaultRootWindow(display);
+    int offset_x = wm->border_size + wm->frame_size;
+    int offset_y = wm->border_size + 2 * wm->frame_size + wm->title_height;
+    int i;
+    for (i = 0; i < wm->all_frames.size; i++) {
+        Frame* frame = wm->all_frames.items[i];
+        int x;
+        int y;
+        unsigned int width;
+        unsigned int height;
+        get_window_geometry(wm, frame->window, &x, &y, &width, &height);
+        XXReparentWindow(wm, display, frame->child, root, x + offset_x, y + offset_y);
+        XXDestroyWindow(wm, display, frame->window);
+    }
+    for (i = 0; i < DESKTOPS_NUM; i++) {
+        XXDestroyWindow(wm, display, wm->desktops[i].container);
+    }
+}
+
+/*
+ * Gives clients of a snapshot back to the root, and destroys the containers
+ * with the frames in them. The clients are framed again by
+ * reparent_toplevels(), though on the current desktop.
+ */
+static void
+give_back_snapshot(WindowManager* wm, RestartSnapshot* snapshot)
+{
+    Display* display = wm->display;
+    Window root = DefaultRootWindow(display);
+    RestartHeader* header = snapshot->header;
+    /* Clients may have been destroyed during the restart. */
+    lost_windows.size = 0;
+    lost_windows.collecting = True;
+    int i;
+    for (i = 0; i < header->frames_num; i++) {
+        RestartClient* client = &snapshot->clients[i];
+        XXReparentWindow(wm, display, client->window, root, client->x, client->y);
+    }
+    int n = MIN(header->desktops_num, RESTART_DESKTOPS_MAX);
+    for (i = 0; i < n; i++) {
+        XXDestroyWindow(wm, display, header->containers[i]);
+    }
+    count_round_trip(wm);
+    wm->backend->sync(display, False);
+    lost_windows.collecting = False;
+    LOG(wm, "given back: clients=%d, lost=%d", header->frames_num, lost_windows.size);
+}
+
+/*
+ * If exec fails, the windows are left in the server by RetainTemporary, so
+ * this fawm connects again to give them back.
+ */
+static void
+give_back_failed_restart(WindowManager* wm, int fd)
+{
+    RestartSnapshot* snapshot = restart_open(fd);
+    if (snapshot == NULL) {
+        return;
+    }
+    Display* display = wm->backend->open_display(NULL);
+    if (display != NULL) {
+        wm->display = display;
+        give_back_snapshot(wm, snapshot);
+        wm->backend->close_display(display);
+    }
+    restart_close(snapshot);
+}
+
 static void
 wm_main(WindowManager* wm, Display* display, const char* log_file, int argc, char* argv[])
 {
     XSetErrorHandler(error_handler);
 
+    setup_event_stats(wm);
+    setup_signals();
     setup_window_manager(wm, display, log_file);
     Window root = DefaultRootWindow(display);
-    XXDefineCursor(wm, display, root, wm->normal_cursor);
-    reparent_toplevels(wm);
-    XXMapWindow(wm, display, wm->taskbar.window);
+    Cursor cursor = get_cursor(wm, &wm->normal_cursor, XC_top_left_arrow);
+    XXDefineCursor(wm, display, root, cursor);
+    /* Clients must be viewable when reparent_window() focuses them. */
+    XXMapWindow(wm, display, get_current_desktop(wm)->container);
+    if (wm->restart.rejected != NULL) {
+        give_back_snapshot(wm, wm->restart.rejected);
+        restart_close(wm->restart.rejected);
+        wm->restart.rejected = NULL;
+    }
+    if (wm->restart.snapshot != NULL) {
+        adopt_frames(wm);
+        /* Toplevels which were mapped while no fawm ran have no frames. */
+        reparent_toplevels(wm);
+        end_startup_phase(wm, "adopting");
+    }
+    else {
+        reparent_toplevels(wm);
+        end_startup_phase(wm, "reparenting");
+    }
+    map_taskbars(wm);
     long mask = 0
         | Button1MotionMask
         | ButtonPressMask
         | ButtonReleaseMask
+        | SubstructureNotifyMask
         | SubstructureRedirectMask;
     XXSelectInput(wm, display, root, mask);
     LOG(wm, "root window=0x%08x", root);
 
-    execute_startup(wm, argc, argv);
+    /* The commands ran at the first start. */
+    if (!wm->restart.adopted) {
+        execute_startup(wm, argc, argv);
+        end_startup_phase(wm, "startup commands");
+    }
+    report_startup(wm);
 
-    while (wm->running) {
-        wait_event(wm);
+    while (wm->running && wait_event(wm)) {
         XEvent e;
-        XNextEvent(display, &e);
-        process_event(wm, &e);
+        wm->backend->next_event(display, &e);
+        /* Events of extensions are not recorded, because ids of them vary. */
+        if ((wm->recording != NULL) && (e.type < LASTEvent)) {
+            recording_write_event(wm->recording, get_monotonic_nsec(), &e);
+        }
+        dispatch_event(wm, &e);
+    }
+    if (wm->restart.fd != -1) {
+        leave_windows_for_restart(wm);
+    }
+    else {
+        int i;
+        for (i = 0; i < wm->all_frames.size; i++) {
+            remember_geometry(wm, wm->all_frames.items[i]);
+        }
+        if (wm->restart.adopted) {
+            give_back_windows(wm);
+        }
+    }
+    geometries_close(wm->geometries);
+    log_shadow_stats(wm);
+
+    if (wm->trace != NULL) {
+        trace_close(wm->trace);
+        wm->trace = NULL;
+    }
+    if (wm->recording != NULL) {
+        recording_close(wm->recording);
+        wm->recording = NULL;
+    }
+}
+
+#if defined(FAWM_FAKE)
+static Window
+create_replayed_client(void* data, XEvent* e, Window recorded)
+{
+    WindowManager* wm = (WindowManager*)data;
+    int x = 0;
+    int y = 0;
+    int width = 640;
+    int height = 480;
+    if ((e->type == CreateNotify) && (e->xcreatewindow.window == recorded)) {
+        x = e->xcreatewindow.x;
+        y = e->xcreatewindow.y;
+        width = e->xcreatewindow.width;
+        height = e->xcreatewindow.height;
+    }
+    else if ((e->type == ConfigureRequest) && (e->xconfigurerequest.window == recorded)) {
+        x = e->xconfigurerequest.x;
+        y = e->xconfigurerequest.y;
+        width = e->xconfigurerequest.width;
+        height = e->xconfigurerequest.height;
+    }
+    char title[32];
+    snprintf(title, array_sizeof(title), "0x%08lx", recorded);
+    return fake_create_client(wm->display, x, y, MAX(width, 1), MAX(height, 1), title);
+}
+
+static void
+report_fake_run(WindowManager* wm, unsigned long processed, long nsec)
+{
+    FakeStats stats;
+    fake_get_stats(wm->display, &stats);
+    double sec = (double)nsec / 1000000000;
+    print_error("fake: events=%lu in %.3f sec (%.0f events/sec)", processed, sec, processed / sec);
+    print_error("fake: requests=%lu (%.1f/event), windows=%d, clients=%d", stats.requests, (double)stats.requests / processed, stats.windows, stats.clients);
+    unsigned long bad_window = stats.bad_window;
+    unsigned long bad_value = stats.bad_value;
+    unsigned long bad_match = stats.bad_match;
+    print_error("fake: errors: BadWindow=%lu, BadValue=%lu, BadMatch=%lu", bad_window, bad_value, bad_match);
+    if (stats.message[0] != '\0') {
+        print_error("fake: first error: %s", stats.message);
+    }
+    const char* names[] = SCENARIO_NAMES;
+    int repeats = wm->fake.repeats;
+    int i;
+    for (i = 0; (0 < repeats) && (i < SCENARIOS_NUM); i++) {
+        ScenarioStats* scenario = &wm->fake.scenarios[i];
+        double requests = (double)scenario->requests / repeats;
+        unsigned long max_requests = scenario->max_requests;
+        double round_trips = (double)scenario->round_trips / repeats;
+        unsigned long max_round_trips = scenario->max_round_trips;
+#define FMT "fake: scenario %s: requests=%.1f (max %lu), round trips=%.2f (max %lu)"
+        print_error(FMT, names[i], requests, max_requests, round_trips, max_round_trips);
+#undef FMT
+    }
+    unsigned long draws = wm->fake.taskbar_draws;
+    double draw_requests = 0 < draws ? (double)wm->fake.taskbar_requests / draws : 0;
+    unsigned long max_draw_requests = wm->fake.max_taskbar_requests;
+    int max_frames = wm->fake.max_taskbar_frames;
+#define FMT "fake: taskbar: draws=%lu, requests=%.1f/draw (max %lu), windows=%d at most"
+    print_error(FMT, draws, draw_requests, max_draw_requests, max_frames);
+#undef FMT
+    Histogram* latency = &wm->fake.switch_latency;
+    unsigned long switches = latency->count;
+    if (0 < switches) {
+        int windows = wm->fake.switch_windows;
+        double p50 = histogram_percentile(latency, 50) / 1000.0;
+        double max = latency->max / 1000.0;
+        double switch_requests = (double)wm->fake.switch_requests / switches;
+        unsigned long max_switch_requests = wm->fake.max_switch_requests;
+#define FMT "fake: switch: windows=%d/desktop, switches=%lu, p50=%.1f usec, max=%.1f usec, requests=%.1f/switch (max %lu)"
+        print_error(FMT, windows, switches, p50, max, switch_requests, max_switch_requests);
+#undef FMT
+    }
+    dump_event_stats(wm);
+    dump_resources(wm);
+}
+#endif
+
+/* A snapshot of another version of fawm may have other frames or desktops. */
+static Bool
+is_adoptable(RestartSnapshot* snapshot)
+{
+    RestartHeader* header = snapshot->header;
+    if (snapshot->frames == NULL) {
+        return False;
+    }
+    if ((header->desktops_num != DESKTOPS_NUM) || (DESKTOPS_NUM <= header->current_desktop)) {
+        return False;
+    }
+    int i;
+    for (i = 0; i < header->frames_num; i++) {
+        int desktop = snapshot->frames[i].desktop;
+        if ((desktop < 0) || (DESKTOPS_NUM <= desktop)) {
+            return False;
+        }
     }
+    return True;
+}
 
-    if (wm->log_file != NULL) {
-        fclose(wm->log_file);
+/*
+ * Executes fawm again with the same options. Returns only on failure, which
+ * find_executable() has made rare, and then the caller must give the windows
+ * back.
+ */
+static void
+restart(const char* path, int fd, int argc, char* argv[])
+{
+    char adopt[32];
+    snprintf(adopt, array_sizeof(adopt), "--adopt=%d", fd);
+    char** args = (char**)alloc_memory(sizeof(args[0]) * (argc + 2));
+    int n = 0;
+    args[n++] = argv[0];
+    args[n++] = adopt;
+    int i;
+    for (i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if ((strncmp(arg, "--adopt=", 8) == 0) || (strncmp(arg, "-adopt=", 7) == 0)) {
+            continue;
+        }
+        args[n++] = argv[i];
     }
+    args[n] = NULL;
+    execv(path, args);
+    print_error("Cannot restart %s: %s", path, strerror(errno));
+    free(args);
 }
 
 int
@@ -2868,19 +6993,75 @@ main(int argc, char* argv[])
     char config_file[MAXPATHLEN];
     const char* home = getenv("HOME");
     snprintf(config_file, array_sizeof(config_file), "%s/.fawm.conf", home);
+    char geometries_file[MAXPATHLEN];
+    snprintf(geometries_file, array_sizeof(geometries_file), "%s/.fawm.geometries", home);
     char log_file[MAXPATHLEN] = "";
+#if defined(FAWM_FAKE)
+    unsigned long fake_events = 0;
+    int fake_clients = 0;
+    int scenario_repeats = 0;
+    int switch_windows = 0;
+    unsigned int seed = 0;
+    const char* replay_file = NULL;
+    Bool realtime = False;
+#endif
+    const char* record_file = NULL;
+    Bool startup_times = False;
+    int adopt_fd = -1;
     struct option longopts[] = {
+        { "adopt", required_argument, NULL, 'a' },
         { "config", required_argument, NULL, 'c' },
+#if defined(FAWM_FAKE)
+        { "fake", required_argument, NULL, 'f' },
+        { "fake-clients", required_argument, NULL, 'F' },
+        { "fake-scenarios", required_argument, NULL, 'P' },
+        { "fake-switch", required_argument, NULL, 'W' },
+        { "realtime", no_argument, NULL, 't' },
+        { "replay", required_argument, NULL, 'p' },
+        { "seed", required_argument, NULL, 's' },
+#endif
         { "log-file", required_argument, NULL, 'l' },
+        { "record", required_argument, NULL, 'r' },
+        { "startup-times", no_argument, NULL, 'S' },
         { "version", no_argument, NULL, 'v' },
         { NULL, 0, NULL, 0 }
     };
     int val;
     while ((val = getopt_long_only(argc, argv, "l", longopts, NULL)) != -1) {
         switch (val) {
+        case 'a':
+            adopt_fd = atoi(optarg);
+            break;
         case 'c':
             snprintf(config_file, array_sizeof(config_file), "%s", optarg);
             break;
+#if defined(FAWM_FAKE)
+        case 'f':
+            fake_events = strtoul(optarg, NULL, 10);
+            break;
+        case 'F':
+            fake_clients = atoi(optarg);
+            break;
+        case 'P':
+            scenario_repeats = atoi(optarg);
+            if ((scenario_repeats < 1) || (SCENARIO_REPEATS_MAX < scenario_repeats)) {
+                print_error("Repeats of scenarios must be in 1..%d.", SCENARIO_REPEATS_MAX);
+                return 1;
+            }
+            break;
+        case 'W':
+            switch_windows = atoi(optarg);
+            break;
+        case 'p':
+            replay_file = optarg;
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            realtime = True;
+            break;
+#endif
         case 'l':
             if (array_sizeof(log_file) - 1 < strlen(optarg)) {
                 print_error("Log Filename Too Long.");
@@ -2888,6 +7069,12 @@ main(int argc, char* argv[])
             }
             strcpy(log_file, optarg);
             break;
+        case 'r':
+            record_file = optarg;
+            break;
+        case 'S':
+            startup_times = True;
+            break;
         case 'v':
             printf("fawm %s\n", FAWM_PACKAGE_VERSION);
             return 0;
@@ -2901,26 +7088,130 @@ main(int argc, char* argv[])
     initialize_event_handlers();
     initialize_event_name();
 
-    Display* display = XOpenDisplay(NULL);
-    if (display == NULL) {
-        print_error("XOpenDisplay failed.");
-        return 1;
-    }
-
     WindowManager wm;
+    wm.startup.start = wm.startup.last = get_monotonic_nsec();
+    wm.startup.phases_num = 0;
+    wm.startup.verbose = startup_times;
+
+    /* __fawm_config__ compiles the config while fawm sets up X. */
     wm.config = NULL;
     wm.fawm_exe = argv[0];
     wm.config_file = config_file;
-    if (!load_config(&wm)) {
-        print_error("Cannot read config file: %s", config_file);
+    start_loading_config(&wm);
+
+#if defined(FAWM_FAKE)
+    wm.backend = &fake_backend;
+    /* Scenarios and switches end by themselves. */
+    Bool fake_steps = (0 < scenario_repeats) || (0 < switch_windows);
+    unsigned long fake_limit = fake_steps ? ULONG_MAX : fake_events;
+    wm.fake.events_left = fake_limit;
+    wm.fake.seed = seed;
+    bzero(&wm.fake.scenarios, sizeof(wm.fake.scenarios));
+    wm.fake.repeats = scenario_repeats;
+    wm.fake.step = 0;
+    wm.fake.failures = 0;
+    wm.fake.taskbar_draws = 0;
+    wm.fake.taskbar_requests = 0;
+    wm.fake.max_taskbar_requests = 0;
+    wm.fake.max_taskbar_frames = 0;
+    wm.fake.switch_windows = switch_windows;
+    histogram_initialize(&wm.fake.switch_latency);
+    wm.fake.switch_requests = 0;
+    wm.fake.max_switch_requests = 0;
+    /* A fake run does not change the file of a real one. */
+    wm.geometries_file = NULL;
+#else
+    wm.backend = &xlib_backend;
+    wm.geometries_file = geometries_file;
+#endif
+    Display* display = wm.backend->open_display(NULL);
+    if (display == NULL) {
+        print_error("XOpenDisplay failed.");
         return 1;
     }
+    end_startup_phase(&wm, "opening display");
+#if defined(FAWM_FAKE)
+    map_fake_clients(display, fake_clients);
+    end_startup_phase(&wm, "fake clients");
+#endif
+
+    wm.restart.restarted = 0 <= adopt_fd;
+    wm.restart.requested = False;
+    wm.restart.program = argv[0];
+    wm.restart.path[0] = '\0';
+    wm.restart.fd = -1;
+    wm.restart.snapshot = NULL;
+    wm.restart.rejected = NULL;
+    wm.restart.adopted = False;
+    if (0 <= adopt_fd) {
+        RestartSnapshot* snapshot = restart_open(adopt_fd);
+        if (snapshot == NULL) {
+            print_error("Cannot read the snapshot of a restart: %s", strerror(errno));
+        }
+        else if (!is_adoptable(snapshot)) {
+            print_error("The snapshot of a restart is not for this fawm, so its windows are given back.");
+            wm.restart.rejected = snapshot;
+        }
+        else {
+            wm.restart.snapshot = snapshot;
+        }
+    }
+
+    /* Both are opened before fawm creates its first window. */
+    Window root = DefaultRootWindow(display);
+    wm.recording = NULL;
+    if (record_file != NULL) {
+        wm.recording = recording_open(record_file, root);
+        if (wm.recording == NULL) {
+            print_error("Cannot open %s: %s", record_file, strerror(errno));
+            return 1;
+        }
+    }
+#if defined(FAWM_FAKE)
+    bzero(&wm.replay, sizeof(wm.replay));
+    if (replay_file != NULL) {
+        wm.replay.replay = replay_open(replay_file, root, create_replayed_client, &wm);
+        if (wm.replay.replay == NULL) {
+            print_error("Cannot read %s: %s", replay_file, strerror(errno));
+            return 1;
+        }
+        wm.replay.realtime = realtime;
+        fake_set_replaying(display, True);
+    }
+#endif
 
+    wm.trace = NULL;
+
+#if defined(FAWM_FAKE)
+    long start = get_monotonic_nsec();
+    wm_main(&wm, display, log_file, argc - optind, argv + optind);
+    long elapsed = get_monotonic_nsec() - start;
+    if (wm.replay.replay != NULL) {
+        report_fake_run(&wm, wm.replay.events_num, elapsed);
+        replay_close(wm.replay.replay);
+    }
+    else {
+        report_fake_run(&wm, fake_limit - wm.fake.events_left, elapsed);
+    }
+#else
     wm_main(&wm, display, log_file, argc - optind, argv + optind);
+#endif
 
-    XCloseDisplay(display);
+    wm.backend->close_display(display);
     free(wm.config);
 
+    if (wm.restart.fd != -1) {
+        restart(wm.restart.path, wm.restart.fd, argc, argv);
+        give_back_failed_restart(&wm, wm.restart.fd);
+        return 1;
+    }
+#if defined(FAWM_FAKE)
+    /* Same as fawm-budgets, whose scenarios failed */
+    if (0 < wm.fake.failures) {
+        return 2;
+    }
+#endif
+
     return 0;
 }
 
@@ -0,0 +1,513 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+
+#include <fawm/private/recording.h>
+
+/* Entries are buffered like TraceWriter does. */
+#define RECORDING_BUFFER_SIZE (256 * 1024)
+
+struct RecordingWriter {
+    int fd;
+    size_t size;
+    /* Events after the last BATCH entry */
+    int events_num;
+    char buffer[RECORDING_BUFFER_SIZE];
+};
+
+static size_t
+align_entry_size(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+/* Returns the size of the struct of the event type in XEvent. */
+static size_t
+get_event_size(int type)
+{
+    switch (type) {
+    case KeyPress:
+    case KeyRelease:
+        return sizeof(XKeyEvent);
+    case ButtonPress:
+    case ButtonRelease:
+        return sizeof(XButtonEvent);
+    case MotionNotify:
+        return sizeof(XMotionEvent);
+    case EnterNotify:
+    case LeaveNotify:
+        return sizeof(XCrossingEvent);
+    case FocusIn:
+    case FocusOut:
+        return sizeof(XFocusChangeEvent);
+    case Expose:
+        return sizeof(XExposeEvent);
+    case CreateNotify:
+        return sizeof(XCreateWindowEvent);
+    case DestroyNotify:
+        return sizeof(XDestroyWindowEvent);
+    case UnmapNotify:
+        return sizeof(XUnmapEvent);
+    case MapNotify:
+        return sizeof(XMapEvent);
+    case MapRequest:
+        return sizeof(XMapRequestEvent);
+    case ReparentNotify:
+        return sizeof(XReparentEvent);
+    case ConfigureNotify:
+        return sizeof(XConfigureEvent);
+    case ConfigureRequest:
+        return sizeof(XConfigureRequestEvent);
+    case GravityNotify:
+        return sizeof(XGravityEvent);
+    case CirculateNotify:
+        return sizeof(XCirculateEvent);
+    case CirculateRequest:
+        return sizeof(XCirculateRequestEvent);
+    case PropertyNotify:
+        return sizeof(XPropertyEvent);
+    case ClientMessage:
+        return sizeof(XClientMessageEvent);
+    default:
+        return sizeof(XEvent);
+    }
+}
+
+void
+recording_flush(RecordingWriter* writer)
+{
+    const char* p = writer->buffer;
+    size_t rest = writer->size;
+    while (0 < rest) {
+        ssize_t n = write(writer->fd, p, rest);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        p += n;
+        rest -= n;
+    }
+    writer->size = 0;
+}
+
+static RecordingEntry*
+append_entry(RecordingWriter* writer, RecordingEntryType type, uint64_t nsec, uint64_t value, const void* payload, size_t payload_size)
+{
+    size_t size = align_entry_size(sizeof(RecordingEntry) + payload_size);
+    if (RECORDING_BUFFER_SIZE < writer->size + size) {
+        recording_flush(writer);
+    }
+    char* p = writer->buffer + writer->size;
+    memset(p, 0, size);
+    RecordingEntry* entry = (RecordingEntry*)p;
+    entry->size = size;
+    entry->type = type;
+    entry->nsec = nsec;
+    entry->value = value;
+    memcpy(p + sizeof(RecordingEntry), payload, payload_size);
+    writer->size += size;
+    return entry;
+}
+
+void
+recording_write_event(RecordingWriter* writer, uint64_t nsec, XEvent* e)
+{
+    size_t size = get_event_size(e->type);
+    append_entry(writer, RECORDING_ENTRY_TYPE_EVENT, nsec, 0, e, size);
+    writer->events_num++;
+}
+
+void
+recording_write_window(RecordingWriter* writer, Window w)
+{
+    append_entry(writer, RECORDING_ENTRY_TYPE_WINDOW, 0, w, NULL, 0);
+}
+
+void
+recording_write_batch(RecordingWriter* writer)
+{
+    if (writer->events_num == 0) {
+        return;
+    }
+    append_entry(writer, RECORDING_ENTRY_TYPE_BATCH, 0, 0, NULL, 0);
+    writer->events_num = 0;
+}
+
+RecordingWriter*
+recording_open(const char* path, Window root)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    RecordingWriter* writer = (RecordingWriter*)malloc(sizeof(RecordingWriter));
+    if (writer == NULL) {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    writer->fd = fd;
+    writer->events_num = 0;
+
+    RecordingFileHeader* header = (RecordingFileHeader*)writer->buffer;
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, RECORDING_MAGIC, sizeof(header->magic));
+    header->pid = getpid();
+    header->root = root;
+    writer->size = sizeof(RecordingFileHeader);
+
+    return writer;
+}
+
+void
+recording_close(RecordingWriter* writer)
+{
+    recording_write_batch(writer);
+    recording_flush(writer);
+    close(writer->fd);
+    free(writer);
+}
+
+/*
+ * Recorded ids are mapped by a hash table with open addressing. It is never
+ * shrunk, because ids are not removed.
+ */
+struct WindowMapEntry {
+    Window recorded;
+    Window w;
+};
+
+typedef struct WindowMapEntry WindowMapEntry;
+
+struct Replay {
+    char* data;
+    size_t size;
+    /* The next entry to read */
+    size_t pos;
+    int events_num;
+
+    Window* windows;
+    int windows_num;
+    int next_window;
+
+    WindowMapEntry* map;
+    int map_size;
+    int map_capacity;
+
+    ReplayWindowCreator create_window;
+    void* creator_data;
+};
+
+static int
+hash_window(Window w, int capacity)
+{
+    return (int)((w * 2654435761UL) & (capacity - 1));
+}
+
+/* Returns true if the id is new in the map. */
+static bool
+insert_window(WindowMapEntry* map, int capacity, Window recorded, Window w)
+{
+    int mask = capacity - 1;
+    int i = hash_window(recorded, capacity);
+    while ((map[i].recorded != None) && (map[i].recorded != recorded)) {
+        i = (i + 1) & mask;
+    }
+    bool added = map[i].recorded == None;
+    map[i].recorded = recorded;
+    map[i].w = w;
+    return added;
+}
+
+static void
+grow_map(Replay* replay)
+{
+    int old_capacity = replay->map_capacity;
+    int capacity = old_capacity == 0 ? 256 : 2 * old_capacity;
+    WindowMapEntry* map = (WindowMapEntry*)calloc(capacity, sizeof(WindowMapEntry));
+    if (map == NULL) {
+        fprintf(stderr, "calloc failed.\n");
+        abort();
+    }
+    int i;
+    for (i = 0; i < old_capacity; i++) {
+        WindowMapEntry* entry = &replay->map[i];
+        if (entry->recorded != None) {
+            insert_window(map, capacity, entry->recorded, entry->w);
+        }
+    }
+    free(replay->map);
+    replay->map = map;
+    replay->map_capacity = capacity;
+}
+
+static void
+put_window(Replay* replay, Window recorded, Window w)
+{
+    if (replay->map_capacity <= 2 * (replay->map_size + 1)) {
+        grow_map(replay);
+    }
+    if (insert_window(replay->map, replay->map_capacity, recorded, w)) {
+        replay->map_size++;
+    }
+}
+
+static Window
+get_window(Replay* replay, Window recorded)
+{
+    if (replay->map_capacity == 0) {
+        return None;
+    }
+    int mask = replay->map_capacity - 1;
+    int i = hash_window(recorded, replay->map_capacity);
+    while (replay->map[i].recorded != None) {
+        if (replay->map[i].recorded == recorded) {
+            return replay->map[i].w;
+        }
+        i = (i + 1) & mask;
+    }
+    return None;
+}
+
+static void
+translate_window(Replay* replay, XEvent* e, Window* w)
+{
+    /* PointerRoot is 1, and no window has so small id. */
+    if (*w <= PointerRoot) {
+        return;
+    }
+    Window mapped = get_window(replay, *w);
+    if (mapped == None) {
+        mapped = replay->create_window(replay->creator_data, e, *w);
+        put_window(replay, *w, mapped);
+    }
+    *w = mapped;
+}
+
+/* Changes all windows in the event. The event window is done at the last. */
+static void
+translate_event(Replay* replay, XEvent* e)
+{
+    switch (e->type) {
+    case KeyPress:
+    case KeyRelease:
+    case ButtonPress:
+    case ButtonRelease:
+    case MotionNotify:
+    case EnterNotify:
+    case LeaveNotify:
+        /* These structs begin with the same members. */
+        translate_window(replay, e, &e->xbutton.root);
+        translate_window(replay, e, &e->xbutton.subwindow);
+        break;
+    case CreateNotify:
+        translate_window(replay, e, &e->xcreatewindow.window);
+        break;
+    case DestroyNotify:
+        translate_window(replay, e, &e->xdestroywindow.window);
+        break;
+    case UnmapNotify:
+        translate_window(replay, e, &e->xunmap.window);
+        break;
+    case MapNotify:
+        translate_window(replay, e, &e->xmap.window);
+        break;
+    case MapRequest:
+        translate_window(replay, e, &e->xmaprequest.window);
+        break;
+    case ReparentNotify:
+        translate_window(replay, e, &e->xreparent.window);
+        translate_window(replay, e, &e->xreparent.parent);
+        break;
+    case ConfigureNotify:
+        translate_window(replay, e, &e->xconfigure.window);
+        translate_window(replay, e, &e->xconfigure.above);
+        break;
+    case ConfigureRequest:
+        translate_window(replay, e, &e->xconfigurerequest.window);
+        translate_window(replay, e, &e->xconfigurerequest.above);
+        break;
+    case GravityNotify:
+        translate_window(replay, e, &e->xgravity.window);
+        break;
+    case CirculateNotify:
+        translate_window(replay, e, &e->xcirculate.window);
+        break;
+    case CirculateRequest:
+        translate_window(replay, e, &e->xcirculaterequest.window);
+        break;
+    default:
+        break;
+    }
+    translate_window(replay, e, &e->xany.window);
+}
+
+static RecordingEntry*
+get_entry(Replay* replay, size_t pos)
+{
+    if (replay->size < pos + sizeof(RecordingEntry)) {
+        return NULL;
+    }
+    RecordingEntry* entry = (RecordingEntry*)(replay->data + pos);
+    if ((entry->size < sizeof(RecordingEntry)) || (replay->size < pos + entry->size)) {
+        return NULL;
+    }
+    return entry;
+}
+
+/*
+ * Reads the next event. batch_end is set when fawm waited for events after
+ * it in the recording.
+ */
+bool
+replay_next(Replay* replay, XEvent* e, uint64_t* nsec, bool* batch_end)
+{
+    RecordingEntry* entry = get_entry(replay, replay->pos);
+    while ((entry != NULL) && (entry->type != RECORDING_ENTRY_TYPE_EVENT)) {
+        replay->pos += entry->size;
+        entry = get_entry(replay, replay->pos);
+    }
+    if (entry == NULL) {
+        return false;
+    }
+    memset(e, 0, sizeof(*e));
+    size_t size = entry->size - sizeof(RecordingEntry);
+    memcpy(e, (char*)entry + sizeof(RecordingEntry), size < sizeof(*e) ? size : sizeof(*e));
+    *nsec = entry->nsec;
+    replay->pos += entry->size;
+
+    RecordingEntry* next = get_entry(replay, replay->pos);
+    *batch_end = (next == NULL) || (next->type == RECORDING_ENTRY_TYPE_BATCH);
+
+    translate_event(replay, e);
+    return true;
+}
+
+/* Pairs a window which fawm has just created with the recorded one. */
+void
+replay_bind_window(Replay* replay, Window w)
+{
+    if (replay->windows_num <= replay->next_window) {
+        return;
+    }
+    put_window(replay, replay->windows[replay->next_window], w);
+    replay->next_window++;
+}
+
+int
+replay_get_events_num(Replay* replay)
+{
+    return replay->events_num;
+}
+
+static char*
+read_all(const char* path, size_t* size)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    size_t capacity = 64 * 1024;
+    char* data = (char*)malloc(capacity);
+    size_t len = 0;
+    size_t n;
+    while ((data != NULL) && ((n = fread(data + len, 1, capacity - len, fp)) != 0)) {
+        len += n;
+        if (len < capacity) {
+            continue;
+        }
+        capacity *= 2;
+        char* p = (char*)realloc(data, capacity);
+        if (p == NULL) {
+            free(data);
+        }
+        data = p;
+    }
+    if ((data == NULL) || ferror(fp)) {
+        free(data);
+        fclose(fp);
+        errno = data == NULL ? ENOMEM : EIO;
+        return NULL;
+    }
+    fclose(fp);
+    *size = len;
+    return data;
+}
+
+static bool
+scan_entries(Replay* replay)
+{
+    size_t pos = sizeof(RecordingFileHeader);
+    RecordingEntry* entry;
+    while ((entry = get_entry(replay, pos)) != NULL) {
+        if (entry->type == RECORDING_ENTRY_TYPE_EVENT) {
+            replay->events_num++;
+        }
+        else if (entry->type == RECORDING_ENTRY_TYPE_WINDOW) {
+            int n = replay->windows_num + 1;
+            Window* windows = (Window*)realloc(replay->windows, sizeof(Window) * n);
+            if (windows == NULL) {
+                return false;
+            }
+            windows[replay->windows_num] = entry->value;
+            replay->windows = windows;
+            replay->windows_num = n;
+        }
+        pos += entry->size;
+    }
+    return true;
+}
+
+/* The recorded root window is mapped to root. */
+Replay*
+replay_open(const char* path, Window root, ReplayWindowCreator create_window, void* creator_data)
+{
+    Replay* replay = (Replay*)calloc(1, sizeof(Replay));
+    if (replay == NULL) {
+        return NULL;
+    }
+    replay->data = read_all(path, &replay->size);
+    if (replay->data == NULL) {
+        free(replay);
+        return NULL;
+    }
+    RecordingFileHeader* header = (RecordingFileHeader*)replay->data;
+    const char* magic = RECORDING_MAGIC;
+    if ((replay->size < sizeof(*header)) || (memcmp(header->magic, magic, sizeof(header->magic)) != 0)) {
+        replay_close(replay);
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!scan_entries(replay)) {
+        replay_close(replay);
+        errno = ENOMEM;
+        return NULL;
+    }
+    replay->pos = sizeof(RecordingFileHeader);
+    replay->create_window = create_window;
+    replay->creator_data = creator_data;
+    put_window(replay, header->root, root);
+
+    return replay;
+}
+
+void
+replay_close(Replay* replay)
+{
+    free(replay->map);
+    free(replay->windows);
+    free(replay->data);
+    free(replay);
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,115 @@
+#define _GNU_SOURCE /* for memfd_create(2) of glibc */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fawm/config.h>
+#include <fawm/private/restart.h>
+
+static int
+create_anonymous_file()
+{
+#if defined(FAWM_HAVE_MEMFD_CREATE)
+    return memfd_create("fawm-restart", 0);
+#else
+    char path[] = "/tmp/fawm-restart.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd != -1) {
+        unlink(path);
+    }
+    return fd;
+#endif
+}
+
+static bool
+write_all(int fd, const void* buf, size_t size)
+{
+    const char* p = (const char*)buf;
+    size_t rest = size;
+    while (0 < rest) {
+        ssize_t n = write(fd, p, rest);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        rest -= n;
+    }
+    return true;
+}
+
+int
+restart_create(RestartHeader* header, RestartClient* clients, RestartFrame* frames, int frames_num)
+{
+    int fd = create_anonymous_file();
+    if (fd == -1) {
+        return -1;
+    }
+    memcpy(header->magic, RESTART_MAGIC, sizeof(header->magic));
+    header->frames_num = frames_num;
+    header->version = RESTART_VERSION;
+    size_t clients_size = sizeof(clients[0]) * frames_num;
+    size_t frames_size = sizeof(frames[0]) * frames_num;
+    bool written = write_all(fd, header, sizeof(*header))
+        && write_all(fd, clients, clients_size)
+        && write_all(fd, frames, frames_size);
+    if (!written) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+RestartSnapshot*
+restart_open(int fd)
+{
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size < sizeof(RestartHeader))) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = st.st_size;
+    void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    RestartHeader* header = (RestartHeader*)p;
+    size_t clients_size = sizeof(RestartClient) * header->frames_num;
+    size_t frames_size = sizeof(RestartFrame) * header->frames_num;
+    bool valid = memcmp(header->magic, RESTART_MAGIC, sizeof(header->magic)) == 0;
+    if (!valid || (size < sizeof(*header) + clients_size)) {
+        munmap(p, size);
+        errno = EINVAL;
+        return NULL;
+    }
+    RestartSnapshot* snapshot = (RestartSnapshot*)malloc(sizeof(RestartSnapshot));
+    if (snapshot == NULL) {
+        munmap(p, size);
+        return NULL;
+    }
+    snapshot->header = header;
+    snapshot->clients = (RestartClient*)(header + 1);
+    bool same = (header->version == RESTART_VERSION)
+        && (size == sizeof(*header) + clients_size + frames_size);
+    snapshot->frames = same ? (RestartFrame*)(snapshot->clients + header->frames_num) : NULL;
+    snapshot->size = size;
+    return snapshot;
+}
+
+void
+restart_close(RestartSnapshot* snapshot)
+{
+    munmap(snapshot->header, snapshot->size);
+    free(snapshot);
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
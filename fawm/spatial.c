@@ -0,0 +1,935 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fawm/private/spatial.h>
+
+static int
+compute_cell(int n)
+{
+    /* Division which rounds toward negative infinity */
+    if (0 <= n) {
+        return n / SPATIAL_CELL_SIZE;
+    }
+    return - ((- n + SPATIAL_CELL_SIZE - 1) / SPATIAL_CELL_SIZE);
+}
+
+static int
+wrap_cell(int n)
+{
+    int m = n % SPATIAL_GRID_SIZE;
+    return m < 0 ? m + SPATIAL_GRID_SIZE : m;
+}
+
+static int
+compute_last_cell(int first, int pos, int size)
+{
+    /* A cell is visited once even if a rectangle is wider than the grid. */
+    int last = compute_cell(pos + (0 < size ? size : 1) - 1);
+    int max = first + SPATIAL_GRID_SIZE - 1;
+    return last < max ? last : max;
+}
+
+static SpatialCell*
+get_cell(SpatialIndex* index, int column, int row)
+{
+    return &index->cells[wrap_cell(row)][wrap_cell(column)];
+}
+
+static void*
+grow_array(void* p, size_t size)
+{
+    void* q = realloc(p, size);
+    assert(q != NULL);
+    return q;
+}
+
+static void
+move_in_cell(SpatialCell* cell, int to, int from, int n)
+{
+    size_t size = sizeof(int) * n;
+    memmove(&cell->entries[to], &cell->entries[from], sizeof(cell->entries[0]) * n);
+    memmove(&cell->zs[to], &cell->zs[from], size);
+    memmove(&cell->layers[to], &cell->layers[from], size);
+    memmove(&cell->lefts[to], &cell->lefts[from], size);
+    memmove(&cell->tops[to], &cell->tops[from], size);
+    memmove(&cell->rights[to], &cell->rights[from], size);
+    memmove(&cell->bottoms[to], &cell->bottoms[from], size);
+}
+
+static void
+insert_into_cell(SpatialCell* cell, SpatialEntry* entry)
+{
+    if (cell->size == cell->capacity) {
+        int capacity = cell->capacity == 0 ? 8 : 2 * cell->capacity;
+        size_t size = sizeof(int) * capacity;
+        cell->entries = (SpatialEntry**)grow_array(cell->entries, sizeof(cell->entries[0]) * capacity);
+        cell->zs = (int*)grow_array(cell->zs, size);
+        cell->layers = (int*)grow_array(cell->layers, size);
+        cell->lefts = (int*)grow_array(cell->lefts, size);
+        cell->tops = (int*)grow_array(cell->tops, size);
+        cell->rights = (int*)grow_array(cell->rights, size);
+        cell->bottoms = (int*)grow_array(cell->bottoms, size);
+        cell->capacity = capacity;
+    }
+    /* A new entry goes below others of the same z. */
+    int z = entry->z;
+    int i;
+    for (i = cell->size; (0 < i) && (cell->zs[i - 1] < z); i--) {
+    }
+    move_in_cell(cell, i + 1, i, cell->size - i);
+    SpatialRect* rect = &entry->rect;
+    cell->entries[i] = entry;
+    cell->zs[i] = z;
+    cell->layers[i] = entry->layer;
+    cell->lefts[i] = rect->x;
+    cell->tops[i] = rect->y;
+    cell->rights[i] = rect->x + rect->width;
+    cell->bottoms[i] = rect->y + rect->height;
+    cell->size++;
+}
+
+static void
+remove_from_cell(SpatialCell* cell, SpatialEntry* entry)
+{
+    int size = cell->size;
+    int i;
+    for (i = 0; (i < size) && (cell->entries[i] != entry); i++) {
+    }
+    if (i == size) {
+        return;
+    }
+    move_in_cell(cell, i, i + 1, size - i - 1);
+    cell->size--;
+}
+
+static int
+compute_bucket(int n)
+{
+    if (0 <= n) {
+        return n / SPATIAL_BUCKET_SIZE;
+    }
+    return - ((- n + SPATIAL_BUCKET_SIZE - 1) / SPATIAL_BUCKET_SIZE);
+}
+
+static SpatialEdgeBucket*
+get_bucket(SpatialEdgeBucket* buckets, int pos)
+{
+    int m = compute_bucket(pos) % SPATIAL_BUCKETS_NUM;
+    return &buckets[m < 0 ? m + SPATIAL_BUCKETS_NUM : m];
+}
+
+static void
+move_in_bucket(SpatialEdgeBucket* bucket, int to, int from, int n)
+{
+    memmove(&bucket->poses[to], &bucket->poses[from], sizeof(bucket->poses[0]) * n);
+    memmove(&bucket->edges[to], &bucket->edges[from], sizeof(bucket->edges[0]) * n);
+}
+
+/*
+ * Returns the index of the first edge at pos or after it. Edges in a bucket
+ * are sorted by their positions.
+ */
+static int
+find_edge(SpatialEdgeBucket* bucket, int pos)
+{
+    int low = 0;
+    int high = bucket->size;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (bucket->poses[middle] < pos) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static void
+insert_edge(SpatialEdgeBucket* buckets, SpatialEntry* entry, int pos, int from, int to)
+{
+    SpatialEdgeBucket* bucket = get_bucket(buckets, pos);
+    if (bucket->size == bucket->capacity) {
+        int capacity = bucket->capacity == 0 ? 8 : 2 * bucket->capacity;
+        bucket->poses = (int*)grow_array(bucket->poses, sizeof(bucket->poses[0]) * capacity);
+        bucket->edges = (SpatialEdge*)grow_array(bucket->edges, sizeof(bucket->edges[0]) * capacity);
+        bucket->capacity = capacity;
+    }
+    int i = find_edge(bucket, pos);
+    move_in_bucket(bucket, i + 1, i, bucket->size - i);
+    bucket->poses[i] = pos;
+    SpatialEdge* edge = &bucket->edges[i];
+    edge->entry = entry;
+    edge->layer = entry->layer;
+    edge->from = from;
+    edge->to = to;
+    bucket->size++;
+}
+
+static void
+remove_edge(SpatialEdgeBucket* buckets, SpatialEntry* entry, int pos)
+{
+    /* Both edges of a narrow rectangle may be in one bucket. */
+    SpatialEdgeBucket* bucket = get_bucket(buckets, pos);
+    int size = bucket->size;
+    int i;
+    for (i = find_edge(bucket, pos); (i < size) && (bucket->poses[i] == pos); i++) {
+        if (bucket->edges[i].entry == entry) {
+            move_in_bucket(bucket, i, i + 1, size - i - 1);
+            bucket->size--;
+            return;
+        }
+    }
+}
+
+static void
+insert_edges(SpatialIndex* index, SpatialEntry* entry)
+{
+    SpatialRect* rect = &entry->rect;
+    int right = rect->x + rect->width;
+    int bottom = rect->y + rect->height;
+    insert_edge(index->vertical_edges, entry, rect->x, rect->y, bottom);
+    insert_edge(index->vertical_edges, entry, right, rect->y, bottom);
+    insert_edge(index->horizontal_edges, entry, rect->y, rect->x, right);
+    insert_edge(index->horizontal_edges, entry, bottom, rect->x, right);
+}
+
+static void
+remove_edges(SpatialIndex* index, SpatialEntry* entry)
+{
+    SpatialRect* rect = &entry->rect;
+    remove_edge(index->vertical_edges, entry, rect->x);
+    remove_edge(index->vertical_edges, entry, rect->x + rect->width);
+    remove_edge(index->horizontal_edges, entry, rect->y);
+    remove_edge(index->horizontal_edges, entry, rect->y + rect->height);
+}
+
+void
+spatial_initialize(SpatialIndex* index)
+{
+    memset(index, 0, sizeof(*index));
+}
+
+static void
+free_bucket(SpatialEdgeBucket* bucket)
+{
+    free(bucket->poses);
+    free(bucket->edges);
+}
+
+void
+spatial_dispose(SpatialIndex* index)
+{
+    int row;
+    for (row = 0; row < SPATIAL_GRID_SIZE; row++) {
+        int column;
+        for (column = 0; column < SPATIAL_GRID_SIZE; column++) {
+            SpatialCell* cell = &index->cells[row][column];
+            free(cell->entries);
+            free(cell->zs);
+            free(cell->layers);
+            free(cell->lefts);
+            free(cell->tops);
+            free(cell->rights);
+            free(cell->bottoms);
+        }
+    }
+    int i;
+    for (i = 0; i < SPATIAL_BUCKETS_NUM; i++) {
+        free_bucket(&index->vertical_edges[i]);
+        free_bucket(&index->horizontal_edges[i]);
+    }
+    spatial_initialize(index);
+}
+
+void
+spatial_remove(SpatialIndex* index, SpatialEntry* entry)
+{
+    if (!entry->indexed) {
+        return;
+    }
+    SpatialRect* rect = &entry->rect;
+    int column0 = compute_cell(rect->x);
+    int column1 = compute_last_cell(column0, rect->x, rect->width);
+    int row0 = compute_cell(rect->y);
+    int row1 = compute_last_cell(row0, rect->y, rect->height);
+    int row;
+    for (row = row0; row <= row1; row++) {
+        int column;
+        for (column = column0; column <= column1; column++) {
+            remove_from_cell(get_cell(index, column, row), entry);
+        }
+    }
+    remove_edges(index, entry);
+    entry->indexed = false;
+}
+
+static bool
+is_same_rect(SpatialRect* rect, int x, int y, int width, int height)
+{
+    if ((rect->x != x) || (rect->y != y)) {
+        return false;
+    }
+    return (rect->width == width) && (rect->height == height);
+}
+
+void
+spatial_update(SpatialIndex* index, SpatialEntry* entry, int x, int y, int width, int height)
+{
+    if (entry->indexed && is_same_rect(&entry->rect, x, y, width, height)) {
+        return;
+    }
+    spatial_remove(index, entry);
+    SpatialRect* rect = &entry->rect;
+    rect->x = x;
+    rect->y = y;
+    rect->width = width;
+    rect->height = height;
+
+    int column0 = compute_cell(x);
+    int column1 = compute_last_cell(column0, x, width);
+    int row0 = compute_cell(y);
+    int row1 = compute_last_cell(row0, y, height);
+    int row;
+    for (row = row0; row <= row1; row++) {
+        int column;
+        for (column = column0; column <= column1; column++) {
+            insert_into_cell(get_cell(index, column, row), entry);
+        }
+    }
+    insert_edges(index, entry);
+    entry->indexed = true;
+}
+
+/**
+ * Changes z of the entry. This keeps entries in cells sorted from the top.
+ */
+void
+spatial_restack(SpatialIndex* index, SpatialEntry* entry, int z)
+{
+    if (!entry->indexed || (entry->z == z)) {
+        entry->z = z;
+        return;
+    }
+    entry->z = z;
+    SpatialRect* rect = &entry->rect;
+    int column0 = compute_cell(rect->x);
+    int column1 = compute_last_cell(column0, rect->x, rect->width);
+    int row0 = compute_cell(rect->y);
+    int row1 = compute_last_cell(row0, rect->y, rect->height);
+    int row;
+    for (row = row0; row <= row1; row++) {
+        int column;
+        for (column = column0; column <= column1; column++) {
+            SpatialCell* cell = get_cell(index, column, row);
+            remove_from_cell(cell, entry);
+            insert_into_cell(cell, entry);
+        }
+    }
+}
+
+SpatialEntry*
+spatial_find_at(SpatialIndex* index, int layer, int x, int y)
+{
+    /* The first hit is the top. */
+    SpatialCell* cell = get_cell(index, compute_cell(x), compute_cell(y));
+    int size = cell->size;
+    int i;
+    for (i = 0; i < size; i++) {
+        if ((cell->layers[i] != layer) || (x < cell->lefts[i]) || (cell->rights[i] <= x)) {
+            continue;
+        }
+        if ((y < cell->tops[i]) || (cell->bottoms[i] <= y)) {
+            continue;
+        }
+        return cell->entries[i];
+    }
+    return NULL;
+}
+
+/**
+ * Calls visitor once for each entry in the layer which overlaps with the
+ * rectangle.
+ */
+void
+spatial_visit(SpatialIndex* index, int layer, SpatialRect* rect, SpatialVisitor visitor, void* arg)
+{
+    /* stamp marks entries which were visited already in another cell. */
+    index->stamp++;
+    unsigned int stamp = index->stamp;
+    int left = rect->x;
+    int top = rect->y;
+    int right = rect->x + rect->width;
+    int bottom = rect->y + rect->height;
+    int column0 = compute_cell(rect->x);
+    int column1 = compute_last_cell(column0, rect->x, rect->width);
+    int row0 = compute_cell(rect->y);
+    int row1 = compute_last_cell(row0, rect->y, rect->height);
+    int row;
+    for (row = row0; row <= row1; row++) {
+        int column;
+        for (column = column0; column <= column1; column++) {
+            SpatialCell* cell = get_cell(index, column, row);
+            int size = cell->size;
+            int i;
+            for (i = 0; i < size; i++) {
+                if ((cell->layers[i] != layer) || (right <= cell->lefts[i]) || (cell->rights[i] <= left)) {
+                    continue;
+                }
+                if ((bottom <= cell->tops[i]) || (cell->bottoms[i] <= top)) {
+                    continue;
+                }
+                SpatialEntry* entry = cell->entries[i];
+                if (entry->stamp == stamp) {
+                    continue;
+                }
+                entry->stamp = stamp;
+                visitor(entry, arg);
+            }
+        }
+    }
+}
+
+static int
+max_int(int a, int b)
+{
+    return a < b ? b : a;
+}
+
+static int
+min_int(int a, int b)
+{
+    return a < b ? a : b;
+}
+
+static long
+compute_intersection(SpatialRect* a, SpatialRect* b)
+{
+    int x0 = max_int(a->x, b->x);
+    int x1 = min_int(a->x + a->width, b->x + b->width);
+    int y0 = max_int(a->y, b->y);
+    int y1 = min_int(a->y + a->height, b->y + b->height);
+    if ((x1 <= x0) || (y1 <= y0)) {
+        return 0;
+    }
+    return (long)(x1 - x0) * (y1 - y0);
+}
+
+struct Overlap {
+    SpatialEntry* exclude;
+    SpatialRect* rect;
+    long area;
+};
+
+typedef struct Overlap Overlap;
+
+static void
+add_overlap(SpatialEntry* entry, void* arg)
+{
+    Overlap* overlap = (Overlap*)arg;
+    if (entry == overlap->exclude) {
+        return;
+    }
+    overlap->area += compute_intersection(&entry->rect, overlap->rect);
+}
+
+/*
+ * Returns the overlap of the i-th entry in a cell with the part of a rectangle
+ * in the cell. The part is at most SPATIAL_CELL_SIZE square, so the area fits
+ * in an int. This has no branches, so that a loop of this is vectorized.
+ */
+static int
+compute_part_overlap(SpatialCell* cell, int i, int layer, int left, int top, int right, int bottom)
+{
+    int width = min_int(cell->rights[i], right) - max_int(cell->lefts[i], left);
+    int height = min_int(cell->bottoms[i], bottom) - max_int(cell->tops[i], top);
+    int hit = (cell->layers[i] == layer) & (0 < width) & (0 < height);
+    return hit * width * height;
+}
+
+static int
+compute_cell_overlap(SpatialCell* cell, int layer, SpatialEntry* exclude, int left, int top, int right, int bottom)
+{
+    int area = 0;
+    int size = min_int(cell->size, SPATIAL_CELL_DEPTH);
+    int i;
+    for (i = 0; i < size; i++) {
+        area += compute_part_overlap(cell, i, layer, left, top, right, bottom);
+    }
+    if (exclude == NULL) {
+        return area;
+    }
+    for (i = 0; (i < size) && (cell->entries[i] != exclude); i++) {
+    }
+    if (i < size) {
+        area -= compute_part_overlap(cell, i, layer, left, top, right, bottom);
+    }
+    return area;
+}
+
+static bool
+is_rect_in_grid(SpatialRect* rect)
+{
+    int size = SPATIAL_CELL_SIZE * (SPATIAL_GRID_SIZE - 1);
+    return (rect->width <= size) && (rect->height <= size);
+}
+
+/**
+ * Returns the sum of areas where the rectangle overlaps with entries in the
+ * layer. exclude is not counted. It can be NULL. In each cell, only the top
+ * SPATIAL_CELL_DEPTH entries are counted, so windows deeper in a stack are not
+ * seen. A rectangle wider than the grid is measured with all entries.
+ */
+long
+spatial_compute_overlap(SpatialIndex* index, int layer, SpatialEntry* exclude, SpatialRect* rect)
+{
+    if (!is_rect_in_grid(rect)) {
+        /* The rectangle covers some cells twice. */
+        Overlap overlap;
+        overlap.exclude = exclude;
+        overlap.rect = rect;
+        overlap.area = 0;
+        spatial_visit(index, layer, rect, add_overlap, &overlap);
+        return overlap.area;
+    }
+    /*
+     * The rectangle is clipped to each cell, so that an entry in some cells is
+     * counted once without reading the entry.
+     */
+    long area = 0;
+    int column0 = compute_cell(rect->x);
+    int column1 = compute_last_cell(column0, rect->x, rect->width);
+    int row0 = compute_cell(rect->y);
+    int row1 = compute_last_cell(row0, rect->y, rect->height);
+    int row;
+    for (row = row0; row <= row1; row++) {
+        int top = max_int(rect->y, SPATIAL_CELL_SIZE * row);
+        int bottom = min_int(rect->y + rect->height, SPATIAL_CELL_SIZE * (row + 1));
+        int column;
+        for (column = column0; column <= column1; column++) {
+            int left = max_int(rect->x, SPATIAL_CELL_SIZE * column);
+            int right = min_int(rect->x + rect->width, SPATIAL_CELL_SIZE * (column + 1));
+            SpatialCell* cell = get_cell(index, column, row);
+            area += compute_cell_overlap(cell, layer, exclude, left, top, right, bottom);
+        }
+    }
+    return area;
+}
+
+struct Snap {
+    SpatialRect moved;
+    int distance;
+    int dx;
+    int dy;
+};
+
+typedef struct Snap Snap;
+
+static void
+pull(int* best, int delta, int distance)
+{
+    /* A tie is broken in the same way in any order of entries. */
+    if ((distance < abs(delta)) || (abs(*best) < abs(delta))) {
+        return;
+    }
+    if ((abs(*best) == abs(delta)) && (*best <= delta)) {
+        return;
+    }
+    *best = delta;
+}
+
+static bool
+is_range_near(int pos0, int size0, int pos1, int size1, int distance)
+{
+    return (pos0 < pos1 + size1 + distance) && (pos1 < pos0 + size0 + distance);
+}
+
+static void
+snap_to_bounds(Snap* snap, SpatialRect* rect)
+{
+    SpatialRect* moved = &snap->moved;
+    int distance = snap->distance;
+    int left = moved->x;
+    int right = moved->x + moved->width;
+    int top = moved->y;
+    int bottom = moved->y + moved->height;
+    int rect_right = rect->x + rect->width;
+    int rect_bottom = rect->y + rect->height;
+    if (is_range_near(moved->y, moved->height, rect->y, rect->height, distance)) {
+        pull(&snap->dx, rect->x - left, distance);
+        pull(&snap->dx, rect_right - right, distance);
+    }
+    if (is_range_near(moved->x, moved->width, rect->x, rect->width, distance)) {
+        pull(&snap->dy, rect->y - top, distance);
+        pull(&snap->dy, rect_bottom - bottom, distance);
+    }
+}
+
+/*
+ * An edge pulls pos, an edge of the moved rectangle across the axis, when it
+ * is within distance of pos, and when its range along itself is near [from,
+ * to).
+ */
+static bool
+is_pulling(SpatialEdge* edge, SpatialEntry* self, int from, int to, int distance)
+{
+    if ((edge->layer != self->layer) || (edge->entry == self)) {
+        return false;
+    }
+    return (from < edge->to + distance) && (edge->from < to + distance);
+}
+
+/*
+ * Returns the offset of the nearest edge which pulls pos from pos or after it.
+ * distance + 1 means none. The search starts at the start-th edge in the n-th
+ * bucket, which is the first one at pos or after it, and stops at the first
+ * pulling edge. A bucket may have edges which wrapped around.
+ */
+static int
+find_pulling_edge_after(SpatialEdgeBucket* buckets, int n, int start, SpatialEntry* self, int distance, int pos, int from, int to)
+{
+    int first = n;
+    int last = min_int(compute_bucket(pos + distance), first + SPATIAL_BUCKETS_NUM - 1);
+    for (; n <= last; n++) {
+        SpatialEdgeBucket* bucket = get_bucket(buckets, SPATIAL_BUCKET_SIZE * n);
+        int size = bucket->size;
+        int i;
+        for (i = n == first ? start : 0; (i < size) && (bucket->poses[i] <= pos + distance); i++) {
+            if ((pos <= bucket->poses[i]) && is_pulling(&bucket->edges[i], self, from, to, distance)) {
+                return bucket->poses[i] - pos;
+            }
+        }
+    }
+    return distance + 1;
+}
+
+/*
+ * Returns the offset of the nearest edge which pulls pos from before pos.
+ */
+static int
+find_pulling_edge_before(SpatialEdgeBucket* buckets, int n, int start, SpatialEntry* self, int distance, int pos, int from, int to)
+{
+    int first = n;
+    int last = max_int(compute_bucket(pos - distance), first - SPATIAL_BUCKETS_NUM + 1);
+    for (; last <= n; n--) {
+        SpatialEdgeBucket* bucket = get_bucket(buckets, SPATIAL_BUCKET_SIZE * n);
+        int i;
+        for (i = n == first ? start - 1 : bucket->size - 1; (0 <= i) && (pos - distance <= bucket->poses[i]); i--) {
+            if ((bucket->poses[i] < pos) && is_pulling(&bucket->edges[i], self, from, to, distance)) {
+                return bucket->poses[i] - pos;
+            }
+        }
+    }
+    return - distance - 1;
+}
+
+/*
+ * Pulls an edge of the moved rectangle at pos to the nearest edge which pulls
+ * it. Edges in a bucket are read in order from pos, so that a query reads a few
+ * edges even in a crowded bucket.
+ */
+static void
+snap_to_buckets(SpatialEdgeBucket* buckets, SpatialEntry* self, int distance, int pos, int from, int size, int* best)
+{
+    int to = from + size;
+    int n = compute_bucket(pos);
+    int start = find_edge(get_bucket(buckets, pos), pos);
+    pull(best, find_pulling_edge_before(buckets, n, start, self, distance, pos, from, to), distance);
+    pull(best, find_pulling_edge_after(buckets, n, start, self, distance, pos, from, to), distance);
+}
+
+/**
+ * Moves (*x, *y), a new position of entry, to the nearest edge of another
+ * entry or of bounds within distance. An edge pulls a moved rectangle until it
+ * goes farther than distance, so that edges also resist being crossed.
+ */
+void
+spatial_snap(SpatialIndex* index, SpatialEntry* entry, SpatialRect* bounds, int* x, int* y, int distance)
+{
+    Snap snap;
+    snap.moved.x = *x;
+    snap.moved.y = *y;
+    snap.moved.width = entry->rect.width;
+    snap.moved.height = entry->rect.height;
+    snap.distance = distance;
+    snap.dx = snap.dy = distance + 1;
+
+    SpatialRect* moved = &snap.moved;
+    int left = moved->x;
+    int right = moved->x + moved->width;
+    int top = moved->y;
+    int bottom = moved->y + moved->height;
+    SpatialEdgeBucket* vertical_edges = index->vertical_edges;
+    int height = moved->height;
+    snap_to_buckets(vertical_edges, entry, distance, left, top, height, &snap.dx);
+    snap_to_buckets(vertical_edges, entry, distance, right, top, height, &snap.dx);
+    SpatialEdgeBucket* horizontal_edges = index->horizontal_edges;
+    int width = moved->width;
+    snap_to_buckets(horizontal_edges, entry, distance, top, left, width, &snap.dy);
+    snap_to_buckets(horizontal_edges, entry, distance, bottom, left, width, &snap.dy);
+    if (bounds != NULL) {
+        snap_to_bounds(&snap, bounds);
+    }
+
+    if (abs(snap.dx) <= distance) {
+        *x += snap.dx;
+    }
+    if (abs(snap.dy) <= distance) {
+        *y += snap.dy;
+    }
+}
+
+struct RectList {
+    int size;
+    int capacity;
+    SpatialRect* items;
+};
+
+typedef struct RectList RectList;
+
+static void
+append_rect(SpatialEntry* entry, void* arg)
+{
+    RectList* list = (RectList*)arg;
+    if (list->size == list->capacity) {
+        int capacity = list->capacity == 0 ? 64 : 2 * list->capacity;
+        size_t size = sizeof(list->items[0]) * capacity;
+        SpatialRect* items = (SpatialRect*)realloc(list->items, size);
+        assert(items != NULL);
+        list->capacity = capacity;
+        list->items = items;
+    }
+    list->items[list->size] = entry->rect;
+    list->size++;
+}
+
+/*
+ * A frame blocks positions of a new window in [left, right) x [top, bottom).
+ * left and right are indexes of slices of x. A sweep from the top adds a
+ * frame at top, and removes it at bottom.
+ */
+struct PlacementEvent {
+    int y;
+    int left;
+    int right;
+    int delta;
+};
+
+typedef struct PlacementEvent PlacementEvent;
+
+static int
+compare_placement_events(const void* a, const void* b)
+{
+    int y0 = ((const PlacementEvent*)a)->y;
+    int y1 = ((const PlacementEvent*)b)->y;
+    return y0 < y1 ? -1 : (y1 < y0 ? 1 : 0);
+}
+
+/*
+ * A segment tree over slices of x. A node has the number of frames added to
+ * all of its slices, and the least number of frames in its slices. Leaves
+ * start at size, which is a power of two.
+ */
+struct PlacementTree {
+    int size;
+    int* adds;
+    int* mins;
+};
+
+typedef struct PlacementTree PlacementTree;
+
+static void
+initialize_tree(PlacementTree* tree, int slices_num)
+{
+    int size = 1;
+    while (size < slices_num) {
+        size *= 2;
+    }
+    tree->size = size;
+    tree->adds = (int*)calloc(2 * size, sizeof(tree->adds[0]));
+    tree->mins = (int*)calloc(2 * size, sizeof(tree->mins[0]));
+    assert((tree->adds != NULL) && (tree->mins != NULL));
+    /* Leaves out of slices are never the least. */
+    int i;
+    for (i = size + slices_num; i < 2 * size; i++) {
+        tree->mins[i] = INT_MAX / 2;
+    }
+    for (i = size - 1; 0 < i; i--) {
+        tree->mins[i] = min_int(tree->mins[2 * i], tree->mins[2 * i + 1]);
+    }
+}
+
+static void
+update_ancestors(PlacementTree* tree, int node)
+{
+    for (node /= 2; 0 < node; node /= 2) {
+        tree->mins[node] = tree->adds[node] + min_int(tree->mins[2 * node], tree->mins[2 * node + 1]);
+    }
+}
+
+static void
+add_to_tree(PlacementTree* tree, int left, int right, int delta)
+{
+    int l = left + tree->size;
+    int r = right + tree->size;
+    while (l < r) {
+        if (l % 2 == 1) {
+            tree->adds[l] += delta;
+            tree->mins[l] += delta;
+            l++;
+        }
+        if (r % 2 == 1) {
+            r--;
+            tree->adds[r] += delta;
+            tree->mins[r] += delta;
+        }
+        l /= 2;
+        r /= 2;
+    }
+    update_ancestors(tree, left + tree->size);
+    update_ancestors(tree, right - 1 + tree->size);
+}
+
+static int
+find_leftmost_min(PlacementTree* tree)
+{
+    int node = 1;
+    int rest = tree->mins[1];
+    while (node < tree->size) {
+        rest -= tree->adds[node];
+        node = tree->mins[2 * node] == rest ? 2 * node : 2 * node + 1;
+    }
+    return node - tree->size;
+}
+
+/*
+ * An end of a blocked range of x. slot is left or right of an event, which
+ * gets the index of the slice starting at x.
+ */
+struct PlacementEnd {
+    int x;
+    int* slot;
+};
+
+typedef struct PlacementEnd PlacementEnd;
+
+static int
+compare_placement_ends(const void* a, const void* b)
+{
+    int x0 = ((const PlacementEnd*)a)->x;
+    int x1 = ((const PlacementEnd*)b)->x;
+    return x0 < x1 ? -1 : (x1 < x0 ? 1 : 0);
+}
+
+/**
+ * Finds a position in bounds for a width x height rectangle which overlaps
+ * with the fewest entries in the layer. The top-most, then the left-most one
+ * is taken among equal ones, so a free position is at the top-left of free
+ * space.
+ *
+ * An entry blocks positions in a rectangle. Slices of x split by edges of such
+ * rectangles are kept in a segment tree, and a sweep from the top adds and
+ * removes the rectangles. This takes O(n log n) time for n entries.
+ */
+void
+spatial_place(SpatialIndex* index, int layer, SpatialRect* bounds, int width, int height, int* x, int* y)
+{
+    int min_x = bounds->x;
+    int max_x = max_int(min_x, bounds->x + bounds->width - width);
+    int min_y = bounds->y;
+    int max_y = max_int(min_y, bounds->y + bounds->height - height);
+    /* A rectangle larger than bounds goes out of them. */
+    SpatialRect area = { min_x, min_y, max_x + width - min_x, max_y + height - min_y };
+    RectList rects;
+    rects.size = rects.capacity = 0;
+    rects.items = NULL;
+    spatial_visit(index, layer, &area, append_rect, &rects);
+    PlacementEvent* events = (PlacementEvent*)malloc(sizeof(events[0]) * (2 * rects.size + 1));
+    PlacementEnd* ends = (PlacementEnd*)malloc(sizeof(ends[0]) * (2 * rects.size + 2));
+    int* xs = (int*)malloc(sizeof(xs[0]) * (2 * rects.size + 2));
+    assert((events != NULL) && (ends != NULL) && (xs != NULL));
+    int ends_num = 0;
+    int events_num = 0;
+    int i;
+    for (i = 0; i < rects.size; i++) {
+        SpatialRect* rect = &rects.items[i];
+        int left = max_int(rect->x - width + 1, min_x);
+        int right = min_int(rect->x + rect->width, max_x + 1);
+        int top = max_int(rect->y - height + 1, min_y);
+        int bottom = min_int(rect->y + rect->height, max_y + 1);
+        if ((right <= left) || (bottom <= top)) {
+            continue;
+        }
+        PlacementEvent* event = &events[events_num++];
+        event->y = top;
+        event->delta = 1;
+        ends[ends_num].x = left;
+        ends[ends_num++].slot = &event->left;
+        ends[ends_num].x = right;
+        ends[ends_num++].slot = &event->right;
+        event = &events[events_num++];
+        event->y = bottom;
+        event->delta = -1;
+    }
+    /* Slices cover [min_x, max_x]. */
+    int dummy;
+    ends[ends_num].x = min_x;
+    ends[ends_num++].slot = &dummy;
+    ends[ends_num].x = max_x + 1;
+    ends[ends_num++].slot = &dummy;
+    qsort(ends, ends_num, sizeof(ends[0]), compare_placement_ends);
+    int xs_num = 0;
+    for (i = 0; i < ends_num; i++) {
+        PlacementEnd* end = &ends[i];
+        if ((xs_num == 0) || (xs[xs_num - 1] != end->x)) {
+            xs[xs_num++] = end->x;
+        }
+        *end->slot = xs_num - 1;
+    }
+    /* A frame is removed from the slices where it was added. */
+    for (i = 0; i < events_num; i += 2) {
+        events[i + 1].left = events[i].left;
+        events[i + 1].right = events[i].right;
+    }
+    int slices_num = xs_num - 1;
+    qsort(events, events_num, sizeof(events[0]), compare_placement_events);
+
+    PlacementTree tree;
+    initialize_tree(&tree, slices_num);
+    int best = INT_MAX;
+    *x = min_x;
+    *y = min_y;
+    /* Counts change only at rows of events. */
+    int row = min_y;
+    i = 0;
+    while (0 < best) {
+        for (; (i < events_num) && (events[i].y <= row); i++) {
+            PlacementEvent* event = &events[i];
+            add_to_tree(&tree, event->left, event->right, event->delta);
+        }
+        if (tree.mins[1] < best) {
+            best = tree.mins[1];
+            *x = xs[find_leftmost_min(&tree)];
+            *y = row;
+        }
+        if ((i == events_num) || (max_y < events[i].y)) {
+            break;
+        }
+        row = events[i].y;
+    }
+
+    free(tree.mins);
+    free(tree.adds);
+    free(xs);
+    free(ends);
+    free(events);
+    free(rects.items);
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,320 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fawm/private/trace.h>
+
+/*
+ * Records are appended into a buffer in memory, and the buffer is written to
+ * the file when it is full. fawm has only one thread, so no locks are needed.
+ */
+#define TRACE_BUFFER_SIZE (256 * 1024)
+#define TRACE_FILES_MAX 16
+#define TRACE_UNKNOWN_FILE 0xffff
+
+struct TraceWriter {
+    int fd;
+    size_t size;
+    int formats_num;
+    int files_num;
+    const char* files[TRACE_FILES_MAX];
+    char buffer[TRACE_BUFFER_SIZE];
+};
+
+/*
+ * Reads one conversion specification at p, which points "%". type is set to
+ * the type of its argument, or '\0' for "%%".
+ */
+const char*
+trace_scan_conversion(const char* p, char* type)
+{
+    assert(*p == '%');
+    const char* q = p + 1;
+    q += strspn(q, "-+ #0");
+    q += strspn(q, "0123456789");
+    if (*q == '.') {
+        q++;
+        q += strspn(q, "0123456789");
+    }
+    bool is_long = false;
+    while ((*q != '\0') && (strchr("hlLqjzt", *q) != NULL)) {
+        is_long = is_long || (*q != 'h');
+        q++;
+    }
+    switch (*q) {
+    case 'c':
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        *type = is_long ? TRACE_ARG_LONG : TRACE_ARG_INT;
+        break;
+    case 'a':
+    case 'A':
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+        *type = TRACE_ARG_DOUBLE;
+        break;
+    case 'p':
+        *type = TRACE_ARG_POINTER;
+        break;
+    case 's':
+        *type = TRACE_ARG_STRING;
+        break;
+    case '\0':
+        *type = '\0';
+        return q;
+    default:
+        *type = '\0';
+        break;
+    }
+    return q + 1;
+}
+
+/* Returns the number of arguments. Ones over size are ignored. */
+int
+trace_parse_format(const char* fmt, char* types, int size)
+{
+    int n = 0;
+    const char* p = strchr(fmt, '%');
+    while (p != NULL) {
+        char type;
+        p = trace_scan_conversion(p, &type);
+        if ((type != '\0') && (n < size)) {
+            types[n] = type;
+            n++;
+        }
+        p = strchr(p, '%');
+    }
+    return n;
+}
+
+static size_t
+align_record_size(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+static uint64_t
+get_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000ULL * ts.tv_sec + ts.tv_nsec;
+}
+
+void
+trace_flush(TraceWriter* writer)
+{
+    const char* p = writer->buffer;
+    size_t rest = writer->size;
+    while (0 < rest) {
+        ssize_t n = write(writer->fd, p, rest);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            /* Nothing can be done for a broken trace. It is given up. */
+            break;
+        }
+        p += n;
+        rest -= n;
+    }
+    writer->size = 0;
+}
+
+static char*
+reserve_record(TraceWriter* writer, size_t size)
+{
+    if (TRACE_BUFFER_SIZE < writer->size + size) {
+        trace_flush(writer);
+    }
+    return writer->buffer + writer->size;
+}
+
+static void
+write_definition(TraceWriter* writer, TraceRecordType type, int id, const char* s)
+{
+    size_t max = TRACE_RECORD_MAX - sizeof(TraceRecord) - 1;
+    size_t len = strnlen(s, max);
+    size_t size = align_record_size(sizeof(TraceRecord) + len + 1);
+    char* p = reserve_record(writer, size);
+    memset(p, 0, size);
+    TraceRecord* record = (TraceRecord*)p;
+    record->size = size;
+    record->type = type;
+    record->file = type == TRACE_RECORD_TYPE_FILE ? id : 0;
+    record->format = type == TRACE_RECORD_TYPE_FORMAT ? id : 0;
+    memcpy(p + sizeof(TraceRecord), s, len);
+    writer->size += size;
+}
+
+static void
+register_format(TraceWriter* writer, TraceFormat* format)
+{
+    format->args_num = trace_parse_format(format->fmt, format->types, TRACE_ARGS_MAX);
+    writer->formats_num++;
+    format->id = writer->formats_num;
+    write_definition(writer, TRACE_RECORD_TYPE_FORMAT, format->id, format->fmt);
+}
+
+static int
+find_file(TraceWriter* writer, const char* file)
+{
+    /* A filename is __FILE__, so its pointer is compared first. */
+    int i;
+    for (i = 0; i < writer->files_num; i++) {
+        if (writer->files[i] == file) {
+            return i;
+        }
+    }
+    for (i = 0; i < writer->files_num; i++) {
+        if (strcmp(writer->files[i], file) == 0) {
+            return i;
+        }
+    }
+    if (TRACE_FILES_MAX <= writer->files_num) {
+        return TRACE_UNKNOWN_FILE;
+    }
+    int id = writer->files_num;
+    writer->files[id] = file;
+    writer->files_num++;
+    write_definition(writer, TRACE_RECORD_TYPE_FILE, id, file);
+    return id;
+}
+
+static char*
+write_number(char* p, const void* value)
+{
+    memcpy(p, value, sizeof(int64_t));
+    return p + sizeof(int64_t);
+}
+
+static char*
+write_string(char* p, const char* s)
+{
+    const char* t = s != NULL ? s : "(null)";
+    size_t len = strnlen(t, TRACE_STRING_MAX);
+    *p = (char)len;
+    memcpy(p + 1, t, len);
+    return p + 1 + len;
+}
+
+/*
+ * Appends an event with raw arguments. Nothing is formatted here; fawm-trace
+ * does it later.
+ */
+void
+trace_write(TraceWriter* writer, TraceFormat* format, const char* file, int line, ...)
+{
+    if (format->id == 0) {
+        register_format(writer, format);
+    }
+    int file_id = find_file(writer, file);
+
+    /* Arguments of the largest record never exceed TRACE_RECORD_MAX. */
+    char* head = reserve_record(writer, TRACE_RECORD_MAX);
+    char* p = head + sizeof(TraceRecord);
+    va_list ap;
+    va_start(ap, line);
+    int i;
+    for (i = 0; i < format->args_num; i++) {
+        int64_t n;
+        double d;
+        void* ptr;
+        switch (format->types[i]) {
+        case TRACE_ARG_INT:
+            n = va_arg(ap, int);
+            p = write_number(p, &n);
+            break;
+        case TRACE_ARG_LONG:
+            n = va_arg(ap, long);
+            p = write_number(p, &n);
+            break;
+        case TRACE_ARG_DOUBLE:
+            d = va_arg(ap, double);
+            p = write_number(p, &d);
+            break;
+        case TRACE_ARG_POINTER:
+            ptr = va_arg(ap, void*);
+            n = (intptr_t)ptr;
+            p = write_number(p, &n);
+            break;
+        case TRACE_ARG_STRING:
+            p = write_string(p, va_arg(ap, const char*));
+            break;
+        default:
+            assert(false);
+            break;
+        }
+    }
+    va_end(ap);
+
+    size_t size = align_record_size(p - head);
+    memset(p, 0, head + size - p);
+    TraceRecord* record = (TraceRecord*)head;
+    record->size = size;
+    record->type = TRACE_RECORD_TYPE_EVENT;
+    record->file = file_id;
+    record->format = format->id;
+    record->line = line;
+    record->reserved = 0;
+    record->nsec = get_nsec();
+    writer->size += size;
+}
+
+/**
+ * With append, a new segment which starts with its own header follows records
+ * in the file, so that a restarted fawm keeps the trace of the former one.
+ */
+TraceWriter*
+trace_open(const char* path, bool append)
+{
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    int fd = open(path, flags, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    TraceWriter* writer = (TraceWriter*)malloc(sizeof(TraceWriter));
+    if (writer == NULL) {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    writer->fd = fd;
+    writer->formats_num = 0;
+    writer->files_num = 0;
+
+    /* The pid is written once here instead of in every record. */
+    TraceFileHeader* header = (TraceFileHeader*)writer->buffer;
+    memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+    header->pid = getpid();
+    header->reserved = 0;
+    writer->size = sizeof(TraceFileHeader);
+
+    return writer;
+}
+
+void
+trace_close(TraceWriter* writer)
+{
+    trace_flush(writer);
+    close(writer->fd);
+    free(writer);
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
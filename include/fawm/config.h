@@ -0,0 +1,5 @@
+#ifndef INCLUDE_FAWM_CONFIG_H
+#define INCLUDE_FAWM_CONFIG_H
+#define FAWM_PACKAGE_VERSION "1.0.0dev4"
+#define FAWM_PREFIX "/usr/local"
+#endif
@@ -6,7 +6,11 @@
 enum MenuItemType {
     MENU_ITEM_TYPE_EXEC,
     MENU_ITEM_TYPE_EXIT,
-    MENU_ITEM_TYPE_RELOAD
+    MENU_ITEM_TYPE_RELOAD,
+    MENU_ITEM_TYPE_CASCADE,
+    MENU_ITEM_TYPE_GRID,
+    MENU_ITEM_TYPE_TILE,
+    MENU_ITEM_TYPE_RESTART
 };
 
 typedef enum MenuItemType MenuItemType;
@@ -0,0 +1,118 @@
+#if !defined(FAWM_PRIVATE_BACKEND_H)
+#define FAWM_PRIVATE_BACKEND_H
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xft/Xft.h>
+
+#include <fawm/config.h>
+
+#if defined(FAWM_HAVE_XRANDR)
+#include <X11/extensions/Xrandr.h>
+#endif
+
+/*
+ * Everything which fawm asks the server goes through a Backend. Members have
+ * the same signatures as the Xlib functions of the same names. Client side
+ * functions like XFree or regions are not here.
+ */
+struct Backend {
+    const char* name;
+
+    Display* (*open_display)(const char*);
+    int (*close_display)(Display*);
+    int (*pending)(Display*);
+    int (*next_event)(Display*, XEvent*);
+    Bool (*check_if_event)(Display*, XEvent*, Bool (*)(Display*, XEvent*, XPointer), XPointer);
+    int (*flush)(Display*);
+    int (*sync)(Display*, Bool);
+
+    int (*add_to_save_set)(Display*, Window);
+    Status (*alloc_named_color)(Display*, Colormap, const char*, XColor*, XColor*);
+    int (*allow_events)(Display*, int, Time);
+    int (*change_window_attributes)(Display*, Window, unsigned long, XSetWindowAttributes*);
+    int (*clear_area)(Display*, Window, int, int, unsigned int, unsigned int, Bool);
+    int (*configure_window)(Display*, Window, unsigned int, XWindowChanges*);
+    int (*copy_area)(Display*, Drawable, Drawable, GC, int, int, unsigned int, unsigned int, int, int);
+    Cursor (*create_font_cursor)(Display*, unsigned int);
+    GC (*create_gc)(Display*, Drawable, unsigned long, XGCValues*);
+    Pixmap (*create_pixmap_from_bitmap_data)(Display*, Drawable, char*, unsigned int, unsigned int, unsigned long, unsigned long, unsigned int);
+    Pixmap (*create_pixmap)(Display*, Drawable, unsigned int, unsigned int, unsigned int);
+    Window (*create_simple_window)(Display*, Window, int, int, unsigned int, unsigned int, unsigned int, unsigned long, unsigned long);
+    Window (*create_window)(Display*, Window, int, int, unsigned int, unsigned int, unsigned int, int, unsigned int, Visual*, unsigned long, XSetWindowAttributes*);
+    int (*define_cursor)(Display*, Window, Cursor);
+    int (*destroy_window)(Display*, Window);
+    int (*draw_rectangles)(Display*, Drawable, GC, XRectangle*, int);
+    int (*draw_segments)(Display*, Drawable, GC, XSegment*, int);
+    int (*fill_rectangle)(Display*, Drawable, GC, int, int, unsigned int, unsigned int);
+    int (*fill_rectangles)(Display*, Drawable, GC, XRectangle*, int);
+    int (*free_cursor)(Display*, Cursor);
+    int (*free_gc)(Display*, GC);
+    int (*free_pixmap)(Display*, Pixmap);
+    Status (*get_geometry)(Display*, Drawable, Window*, int*, int*, unsigned int*, unsigned int*, unsigned int*, unsigned int*);
+    Status (*get_text_property)(Display*, Window, XTextProperty*, Atom);
+    Status (*get_window_attributes)(Display*, Window, XWindowAttributes*);
+    Status (*get_wm_normal_hints)(Display*, Window, XSizeHints*, long*);
+    Status (*get_wm_protocols)(Display*, Window, Atom**, int*);
+    int (*grab_button)(Display*, unsigned int, unsigned int, Window, Bool, unsigned int, int, int, Window, Cursor);
+    Atom (*intern_atom)(Display*, const char*, Bool);
+    int (*kill_client)(Display*, XID);
+    int (*map_raised)(Display*, Window);
+    int (*map_subwindows)(Display*, Window);
+    int (*map_window)(Display*, Window);
+    int (*move_resize_window)(Display*, Window, int, int, unsigned int, unsigned int);
+    int (*move_window)(Display*, Window, int, int);
+    Status (*query_tree)(Display*, Window, Window*, Window*, Window**, unsigned int*);
+    int (*raise_window)(Display*, Window);
+    int (*reparent_window)(Display*, Window, Window, int, int);
+    int (*resize_window)(Display*, Window, unsigned int, unsigned int);
+    int (*restack_windows)(Display*, Window*, int);
+    int (*select_input)(Display*, Window, long);
+    Status (*send_event)(Display*, Window, Bool, long, XEvent*);
+    int (*set_close_down_mode)(Display*, int);
+    int (*set_input_focus)(Display*, Window, int, Time);
+    int (*set_window_background)(Display*, Window, unsigned long);
+    int (*set_window_background_pixmap)(Display*, Window, Pixmap);
+    int (*set_window_border_width)(Display*, Window, unsigned int);
+    int (*undefine_cursor)(Display*, Window);
+    int (*ungrab_button)(Display*, unsigned int, unsigned int, Window);
+    int (*unmap_window)(Display*, Window);
+
+    FcBool (*xft_char_exists)(Display*, XftFont*, FcChar32);
+    FT_UInt (*xft_char_index)(Display*, XftFont*, FcChar32);
+    Bool (*xft_color_alloc_name)(Display*, const Visual*, Colormap, const char*, XftColor*);
+    void (*xft_draw_change)(XftDraw*, Drawable);
+    XftDraw* (*xft_draw_create)(Display*, Drawable, Visual*, Colormap);
+    void (*xft_draw_destroy)(XftDraw*);
+    Drawable (*xft_draw_drawable)(XftDraw*);
+    void (*xft_draw_glyph_font_spec)(XftDraw*, const XftColor*, const XftGlyphFontSpec*, int);
+    Bool (*xft_draw_set_clip)(XftDraw*, Region);
+    Bool (*xft_draw_set_clip_rectangles)(XftDraw*, int, int, const XRectangle*, int);
+    void (*xft_draw_string_utf8)(XftDraw*, const XftColor*, XftFont*, int, int, const FcChar8*, int);
+    void (*xft_font_close)(Display*, XftFont*);
+    XftFont* (*xft_font_open_name)(Display*, int, const char*);
+    void (*xft_glyph_extents)(Display*, XftFont*, const FT_UInt*, int, XGlyphInfo*);
+    void (*xft_text_extents_utf8)(Display*, XftFont*, const FcChar8*, int, XGlyphInfo*);
+
+#if defined(FAWM_HAVE_XRANDR)
+    void (*rr_free_crtc_info)(XRRCrtcInfo*);
+    void (*rr_free_screen_resources)(XRRScreenResources*);
+    XRRCrtcInfo* (*rr_get_crtc_info)(Display*, XRRScreenResources*, RRCrtc);
+    XRRScreenResources* (*rr_get_screen_resources_current)(Display*, Window);
+    Bool (*rr_query_extension)(Display*, int*, int*);
+    void (*rr_select_input)(Display*, Window, int);
+    int (*rr_update_configuration)(XEvent*);
+#endif
+};
+
+typedef struct Backend Backend;
+
+/* The real one, which talks to the X server with Xlib. */
+extern Backend xlib_backend;
+/* An in-process server, which only fawm-fake has. See <fawm/private/fake.h>. */
+extern Backend fake_backend;
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,83 @@
+#if !defined(FAWM_PRIVATE_FAKE_H)
+#define FAWM_PRIVATE_FAKE_H
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include <fawm/private/scenarios.h>
+
+/*
+ * fake_backend is an X server in the process. It keeps windows, geometries,
+ * properties and an event queue, and generates events like the real server
+ * for the only client of it, fawm. Other clients and a user are simulated by
+ * the functions below, which generate requests of them (MapRequest, ...) and
+ * input events. Nothing is drawn.
+ */
+#define FAKE_SCREEN_WIDTH 1920
+#define FAKE_SCREEN_HEIGHT 1080
+
+/*
+ * An error is not reported to fawm. It is counted, and the first one is
+ * described in the message.
+ */
+struct FakeStats {
+    unsigned long requests;
+    unsigned long events;
+    unsigned long bad_window;
+    unsigned long bad_value;
+    unsigned long bad_match;
+    int windows;
+    int clients;
+    char message[128];
+};
+
+typedef struct FakeStats FakeStats;
+
+Window fake_create_client(Display*, int, int, int, int, const char*);
+void fake_set_protocols(Display*, Window, Bool);
+void fake_set_normal_hints(Display*, Window, XSizeHints*);
+void fake_set_class_hint(Display*, Window, const char*, const char*);
+void fake_set_title(Display*, Window, const char*);
+void fake_map_client(Display*, Window);
+void fake_unmap_client(Display*, Window);
+void fake_configure_client(Display*, Window, unsigned int, XWindowChanges*);
+void fake_destroy_client(Display*, Window);
+
+void fake_move_pointer(Display*, int, int);
+void fake_press_button(Display*, unsigned int);
+void fake_release_button(Display*, unsigned int);
+/* Clicks the cell of a desktop in the pager of the taskbar. */
+void fake_click_pager(Display*, int);
+
+/*
+ * Queues an event as it is, to replay a recorded one. While replaying, the
+ * server makes no events by itself, so that fawm sees only recorded ones.
+ */
+void fake_put_event(Display*, XEvent*);
+void fake_set_replaying(Display*, Bool);
+
+/*
+ * Does one random action of clients or the user, like dragging a frame. The
+ * seed is for rand_r(3), so that the same seed makes the same actions.
+ */
+void fake_act(Display*, unsigned int*);
+
+/*
+ * Plays a scenario of fawm-budgets like fawm-budgets does on a real server.
+ * fake_prepare_scenarios() maps the background windows of them.
+ */
+void fake_prepare_scenarios(Display*);
+void fake_play_scenario(Display*, Scenario, int);
+/*
+ * Checks requests of the last step beyond its budget. "configure" must make
+ * exactly one ConfigureWindow for the client and for its frame, and one
+ * synthetic ConfigureNotify. Returns False with a message otherwise.
+ */
+Bool fake_check_scenario(Display*, Scenario, char*, int);
+
+void fake_get_stats(Display*, FakeStats*);
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
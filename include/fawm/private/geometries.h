@@ -0,0 +1,55 @@
+#if !defined(FAWM_PRIVATE_GEOMETRIES_H)
+#define FAWM_PRIVATE_GEOMETRIES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The last geometry of each application, which is identified by WM_CLASS and
+ * WM_WINDOW_ROLE. The file is a GeometriesFileHeader followed by an open
+ * addressing hash table of GeometryEntries, and is mapped into fawm, so that
+ * a lookup or a store is some memory accesses. The kernel writes changes back.
+ * An entry is looked for in GEOMETRIES_PROBES slots at most. When all of them
+ * are used, the oldest one is replaced.
+ */
+#define GEOMETRIES_MAGIC "fawmgeo1"
+#define GEOMETRIES_CAPACITY 1024
+#define GEOMETRIES_PROBES 8
+
+struct GeometriesFileHeader {
+    char magic[8];
+    uint32_t capacity;
+    /* Incremented by every store. stamp of an entry is this at the store. */
+    uint32_t clock;
+};
+
+typedef struct GeometriesFileHeader GeometriesFileHeader;
+
+/* key is zero in an empty slot. (x, y) is of the frame, and sizes are of the client. */
+struct GeometryEntry {
+    uint64_t key;
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stamp;
+    uint32_t reserved;
+};
+
+typedef struct GeometryEntry GeometryEntry;
+
+typedef struct Geometries Geometries;
+
+/* Never returns zero. */
+uint64_t geometries_make_key(const char*, size_t, const char*, size_t);
+/* A NULL path makes a table in memory, which is not saved. */
+Geometries* geometries_open(const char*);
+bool geometries_lookup(Geometries*, uint64_t, GeometryEntry*);
+void geometries_store(Geometries*, uint64_t, int, int, unsigned int, unsigned int);
+void geometries_close(Geometries*);
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
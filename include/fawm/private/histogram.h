@@ -0,0 +1,30 @@
+#if !defined(FAWM_PRIVATE_HISTOGRAM_H)
+#define FAWM_PRIVATE_HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * A log-linear histogram like HdrHistogram. Every power of two is divided into
+ * HISTOGRAM_SUB_BUCKETS_NUM buckets, so a value is reported with an error of
+ * 1/16 at most. Recording is O(1) without any allocation.
+ */
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS_NUM (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS_NUM ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS_NUM)
+
+struct Histogram {
+    uint64_t count;
+    uint64_t max;
+    uint32_t buckets[HISTOGRAM_BUCKETS_NUM];
+};
+
+typedef struct Histogram Histogram;
+
+void histogram_initialize(Histogram*);
+void histogram_record(Histogram*, uint64_t);
+uint64_t histogram_percentile(Histogram*, double);
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,19 @@
+#if !defined(FAWM_PRIVATE_LAYOUT_H)
+#define FAWM_PRIVATE_LAYOUT_H
+
+#include <fawm/private/spatial.h>
+
+enum LayoutType {
+    LAYOUT_TYPE_CASCADE,
+    LAYOUT_TYPE_GRID,
+    LAYOUT_TYPE_TILE
+};
+
+typedef enum LayoutType LayoutType;
+
+void layout_compute(LayoutType, SpatialRect*, int, int, SpatialRect*);
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
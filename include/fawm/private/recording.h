@@ -0,0 +1,76 @@
+#if !defined(FAWM_PRIVATE_RECORDING_H)
+#define FAWM_PRIVATE_RECORDING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <X11/Xlib.h>
+
+/*
+ * A recording is a RecordingFileHeader followed by entries. It keeps events
+ * which fawm received, and ids of windows which fawm created, so that a replay
+ * can tell a recorded frame from a new one.
+ */
+#define RECORDING_MAGIC "fawmrec1"
+
+struct RecordingFileHeader {
+    char magic[8];
+    uint32_t pid;
+    uint32_t reserved;
+    uint64_t root;
+};
+
+typedef struct RecordingFileHeader RecordingFileHeader;
+
+enum RecordingEntryType {
+    RECORDING_ENTRY_TYPE_EVENT,
+    RECORDING_ENTRY_TYPE_WINDOW,
+    RECORDING_ENTRY_TYPE_BATCH
+};
+
+typedef enum RecordingEntryType RecordingEntryType;
+
+/*
+ * Every entry starts with this, and its size is a multiple of 8 bytes. An
+ * EVENT entry is followed by the XEvent, which is cut at the end of the struct
+ * of its type. A WINDOW entry has the id in value. A BATCH entry ends events
+ * which fawm processed without waiting.
+ */
+struct RecordingEntry {
+    uint16_t size;
+    uint16_t type;
+    uint32_t reserved;
+    uint64_t nsec;
+    uint64_t value;
+};
+
+typedef struct RecordingEntry RecordingEntry;
+
+typedef struct RecordingWriter RecordingWriter;
+
+RecordingWriter* recording_open(const char*, Window);
+void recording_write_event(RecordingWriter*, uint64_t, XEvent*);
+void recording_write_window(RecordingWriter*, Window);
+void recording_write_batch(RecordingWriter*);
+void recording_flush(RecordingWriter*);
+void recording_close(RecordingWriter*);
+
+/*
+ * A replay changes recorded window ids into ones of the running fawm. Windows
+ * which fawm created are paired in the order of creation. Other unknown ones
+ * (clients) are made by the callback.
+ */
+typedef Window (*ReplayWindowCreator)(void*, XEvent*, Window);
+
+typedef struct Replay Replay;
+
+Replay* replay_open(const char*, Window, ReplayWindowCreator, void*);
+bool replay_next(Replay*, XEvent*, uint64_t*, bool*);
+void replay_bind_window(Replay*, Window);
+int replay_get_events_num(Replay*);
+void replay_close(Replay*);
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
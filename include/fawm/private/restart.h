@@ -0,0 +1,88 @@
+#if !defined(FAWM_PRIVATE_RESTART_H)
+#define FAWM_PRIVATE_RESTART_H
+
+#include <stdint.h>
+
+/*
+ * At a restart, fawm leaves its windows in the server and passes this
+ * snapshot of them to the next fawm in an anonymous file (memfd), whose
+ * descriptor is given by --adopt. It is a RestartHeader, RestartClients and
+ * RestartFrames, the last two desktop by desktop in the order of the window
+ * list.
+ *
+ * The header and the clients keep their layout in every version, so that a
+ * fawm which cannot adopt the frames still gives the clients back to the root.
+ * RESTART_VERSION is changed with the layout of RestartFrame.
+ */
+#define RESTART_MAGIC "fawmrst3"
+#define RESTART_VERSION 2
+#define RESTART_DESKTOPS_MAX 16
+#define RESTART_TITLE_SIZE 128
+
+struct RestartHeader {
+    char magic[8];
+    uint32_t frames_num;
+    uint32_t desktops_num;
+    uint32_t current_desktop;
+    uint32_t version;
+    /* The child of the focused frame, or None */
+    uint64_t focused;
+    uint64_t containers[RESTART_DESKTOPS_MAX];
+};
+
+typedef struct RestartHeader RestartHeader;
+
+/* x and y are the position of the client in the root. */
+struct RestartClient {
+    uint64_t window;
+    int32_t x;
+    int32_t y;
+};
+
+typedef struct RestartClient RestartClient;
+
+/*
+ * known, x, y, width and height are the shadow of the frame window, so that
+ * the next fawm does not ask the server for them.
+ */
+struct RestartFrame {
+    uint64_t window;
+    uint64_t child;
+    uint64_t buttons;
+    uint64_t geometry_key;
+    int32_t desktop;
+    /* Index in the z order of the desktop, or -1 for a minimized frame */
+    int32_t z_index;
+    int32_t width_inc;
+    int32_t height_inc;
+    int32_t wm_delete_window;
+    uint32_t known;
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+    char title[RESTART_TITLE_SIZE];
+};
+
+typedef struct RestartFrame RestartFrame;
+
+struct RestartSnapshot {
+    RestartHeader* header;
+    RestartClient* clients;
+    /* NULL if the snapshot is of another version */
+    RestartFrame* frames;
+    size_t size;
+};
+
+typedef struct RestartSnapshot RestartSnapshot;
+
+/* Returns a descriptor which survives exec(2), or -1. */
+int restart_create(RestartHeader*, RestartClient*, RestartFrame*, int);
+/* Maps the snapshot, and closes the descriptor. */
+RestartSnapshot* restart_open(int);
+void restart_close(RestartSnapshot*);
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
@@ -0,0 +1,48 @@
+#if !defined(FAWM_PRIVATE_SCENARIOS_H)
+#define FAWM_PRIVATE_SCENARIOS_H
+
+/*
+ * Scenarios of fawm-budgets. fawm-fake plays the same ones on the fake server
+ * by --fake-scenarios, so both must agree on the windows and on the points
+ * where the user clicks.
+ *
+ * SCENARIO_BACKGROUND_WINDOWS_NUM windows are mapped before the scenarios.
+ * "map" maps one more window for each repeat, "minimize" minimizes those, and
+ * "close" closes background windows. Others use the first background windows.
+ * In "configure", a client asks for a new size and position by itself.
+ * Windows are in a grid with USPosition, so that fawm places them without
+ * overlaps in both servers.
+ */
+enum Scenario {
+    SCENARIO_MAP,
+    SCENARIO_FOCUS,
+    SCENARIO_MOVE,
+    SCENARIO_RESIZE,
+    SCENARIO_RETITLE,
+    SCENARIO_CONFIGURE,
+    SCENARIO_TASKBAR,
+    SCENARIO_MINIMIZE,
+    SCENARIO_CLOSE,
+    SCENARIOS_NUM
+};
+
+typedef enum Scenario Scenario;
+
+#define SCENARIO_NAMES { "map", "focus", "move", "resize", "retitle", "configure", "taskbar", "minimize", "close" }
+
+#define SCENARIO_SCREEN_WIDTH 1920
+#define SCENARIO_SCREEN_HEIGHT 1080
+#define SCENARIO_BACKGROUND_WINDOWS_NUM 8
+#define SCENARIO_REPEATS_MAX SCENARIO_BACKGROUND_WINDOWS_NUM
+#define SCENARIO_WINDOW_WIDTH 240
+#define SCENARIO_WINDOW_HEIGHT 160
+#define SCENARIO_WINDOW_X(n) (40 + ((n) % 6) * 300)
+#define SCENARIO_WINDOW_Y(n) (40 + ((n) / 6) * 240)
+/* A drag is made of this many motions of SCENARIO_MOTION_SIZE pixels. */
+#define SCENARIO_MOTIONS_NUM 8
+#define SCENARIO_MOTION_SIZE 4
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
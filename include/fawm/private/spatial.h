@@ -0,0 +1,122 @@
+#if !defined(FAWM_PRIVATE_SPATIAL_H)
+#define FAWM_PRIVATE_SPATIAL_H
+
+#include <stdbool.h>
+
+struct SpatialRect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+typedef struct SpatialRect SpatialRect;
+
+/*
+ * A rectangle in a SpatialIndex. An owner embeds this, and data points back to
+ * the owner. A query sees entries of one layer only. An entry with a larger z
+ * is nearer to the top. spatial_restack() changes z of an indexed entry.
+ */
+struct SpatialEntry {
+    void* data;
+    int layer;
+    int z;
+    SpatialRect rect;
+    bool indexed;
+    unsigned int stamp;
+};
+
+typedef struct SpatialEntry SpatialEntry;
+
+/*
+ * A cell keeps copies of edges of rectangles in arrays of each field, so that
+ * a query reads entries only when they are hit, and a compiler can vectorize
+ * scans of the arrays. right and bottom are exclusive. Entries are sorted from
+ * the top, so that a point query stops at its first hit.
+ */
+struct SpatialCell {
+    int size;
+    int capacity;
+    SpatialEntry** entries;
+    int* zs;
+    int* layers;
+    int* lefts;
+    int* tops;
+    int* rights;
+    int* bottoms;
+};
+
+typedef struct SpatialCell SpatialCell;
+
+/*
+ * An edge of a rectangle. The edge spans [from, to) along itself.
+ */
+struct SpatialEdge {
+    SpatialEntry* entry;
+    int layer;
+    int from;
+    int to;
+};
+
+typedef struct SpatialEdge SpatialEdge;
+
+/*
+ * Edges in a bucket are sorted by poses, which are x of vertical edges, or y
+ * of horizontal ones. A search reads only poses.
+ */
+struct SpatialEdgeBucket {
+    int size;
+    int capacity;
+    int* poses;
+    SpatialEdge* edges;
+};
+
+typedef struct SpatialEdgeBucket SpatialEdgeBucket;
+
+/*
+ * A uniform grid of SPATIAL_CELL_SIZE pixels square cells. The grid wraps
+ * around, so any coordinates are accepted.
+ */
+#define SPATIAL_CELL_SIZE 256
+#define SPATIAL_GRID_SIZE 32
+
+/*
+ * An area query reads at most this many entries from the top in a cell, so
+ * that its cost does not grow with a stack of windows.
+ */
+#define SPATIAL_CELL_DEPTH 16
+
+/*
+ * Edges are also kept in buckets of SPATIAL_BUCKET_SIZE pixels by their
+ * positions, so that snapping reads only edges near edges of a moved
+ * rectangle. Buckets wrap around too.
+ */
+#define SPATIAL_BUCKET_SIZE 32
+#define SPATIAL_BUCKETS_NUM 256
+
+struct SpatialIndex {
+    SpatialCell cells[SPATIAL_GRID_SIZE][SPATIAL_GRID_SIZE];
+    SpatialEdgeBucket vertical_edges[SPATIAL_BUCKETS_NUM];
+    SpatialEdgeBucket horizontal_edges[SPATIAL_BUCKETS_NUM];
+    unsigned int stamp;
+};
+
+typedef struct SpatialIndex SpatialIndex;
+
+typedef void (*SpatialVisitor)(SpatialEntry*, void*);
+
+void spatial_initialize(SpatialIndex*);
+void spatial_dispose(SpatialIndex*);
+void spatial_update(SpatialIndex*, SpatialEntry*, int, int, int, int);
+void spatial_remove(SpatialIndex*, SpatialEntry*);
+void spatial_restack(SpatialIndex*, SpatialEntry*, int);
+SpatialEntry* spatial_find_at(SpatialIndex*, int, int, int);
+void spatial_visit(SpatialIndex*, int, SpatialRect*, SpatialVisitor, void*);
+long spatial_compute_overlap(SpatialIndex*, int, SpatialEntry*, SpatialRect*);
+void spatial_snap(SpatialIndex*, SpatialEntry*, SpatialRect*, int*, int*, int);
+void spatial_place(SpatialIndex*, int, SpatialRect*, int, int, int*, int*);
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
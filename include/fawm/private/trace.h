@@ -0,0 +1,83 @@
+#if !defined(FAWM_PRIVATE_TRACE_H)
+#define FAWM_PRIVATE_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A trace file is a TraceFileHeader followed by records. fawm-trace decodes it
+ * into the text which fawm wrote formerly. A restart appends another header and
+ * its records; ids of files and formats are defined again after it.
+ */
+#define TRACE_MAGIC "fawmtrc1"
+
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t pid;
+    uint32_t reserved;
+};
+
+typedef struct TraceFileHeader TraceFileHeader;
+
+enum TraceRecordType {
+    TRACE_RECORD_TYPE_FILE,
+    TRACE_RECORD_TYPE_FORMAT,
+    TRACE_RECORD_TYPE_EVENT
+};
+
+typedef enum TraceRecordType TraceRecordType;
+
+/*
+ * Every record starts with this, and its size is a multiple of 8 bytes. A FILE
+ * or a FORMAT record defines the id with the following string. An EVENT record
+ * has raw arguments of the format; 8 bytes for a number, and a length byte and
+ * characters for a string.
+ */
+struct TraceRecord {
+    uint16_t size;
+    uint16_t type;
+    uint16_t file;
+    uint16_t format;
+    uint32_t line;
+    uint32_t reserved;
+    uint64_t nsec;
+};
+
+typedef struct TraceRecord TraceRecord;
+
+#define TRACE_ARG_INT       'i'
+#define TRACE_ARG_LONG      'l'
+#define TRACE_ARG_DOUBLE    'f'
+#define TRACE_ARG_POINTER   'p'
+#define TRACE_ARG_STRING    's'
+
+#define TRACE_ARGS_MAX 16
+#define TRACE_STRING_MAX 255
+#define TRACE_RECORD_MAX 8192
+
+/*
+ * A call site has one of this statically. Types of the arguments are parsed at
+ * the first call, and are kept for the others.
+ */
+struct TraceFormat {
+    const char* fmt;
+    int id;
+    int args_num;
+    char types[TRACE_ARGS_MAX];
+};
+
+typedef struct TraceFormat TraceFormat;
+
+typedef struct TraceWriter TraceWriter;
+
+const char* trace_scan_conversion(const char*, char*);
+int trace_parse_format(const char*, char*, int);
+TraceWriter* trace_open(const char*, bool);
+void trace_write(TraceWriter*, TraceFormat*, const char*, int, ...);
+void trace_flush(TraceWriter*);
+void trace_close(TraceWriter*);
+
+#endif
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */
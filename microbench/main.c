@@ -0,0 +1,288 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <fawm/private/histogram.h>
+#include <fawm/private/layout.h>
+#include <fawm/private/spatial.h>
+#include <fawm/private/trace.h>
+
+/*
+ * Microbenchmarks of code in fawm which does not need an X server. It exits
+ * with 1 when a query of the spatial index or a placement is slower than its
+ * budget.
+ */
+
+#define SCREEN_WIDTH 3840
+#define SCREEN_HEIGHT 2160
+#define QUERIES_NUM 1000000
+#define QUERY_BUDGET_NSEC 1000.0
+#define PLACEMENT_BUDGET_USEC 1000.0
+
+static bool
+check_budget(const char* name, double nsec, double budget)
+{
+    if (nsec < budget) {
+        return true;
+    }
+    printf("  %s exceeded %.0f nsec.\n", name, budget);
+    return false;
+}
+
+static long
+get_monotonic_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000L * ts.tv_sec + ts.tv_nsec;
+}
+
+static int
+random_int(int min, int max)
+{
+    return min + rand() % (max - min + 1);
+}
+
+static void
+fill_spatial_index(SpatialIndex* index, SpatialEntry* entries, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        SpatialEntry* entry = &entries[i];
+        entry->data = NULL;
+        entry->layer = 0;
+        entry->z = i;
+        entry->indexed = false;
+        entry->stamp = 0;
+        int width = random_int(200, 1200);
+        int height = random_int(150, 900);
+        int x = random_int(0, SCREEN_WIDTH - width);
+        int y = random_int(0, SCREEN_HEIGHT - height);
+        spatial_update(index, entry, x, y, width, height);
+    }
+}
+
+static double
+bench_find_at(SpatialIndex* index)
+{
+    /* Points are made first not to measure rand(). */
+    int* points = (int*)malloc(sizeof(int) * 2 * QUERIES_NUM);
+    if (points == NULL) {
+        fprintf(stderr, "malloc failed.\n");
+        exit(1);
+    }
+    int i;
+    for (i = 0; i < QUERIES_NUM; i++) {
+        points[2 * i] = random_int(0, SCREEN_WIDTH - 1);
+        points[2 * i + 1] = random_int(0, SCREEN_HEIGHT - 1);
+    }
+
+    long start = get_monotonic_nsec();
+    int found = 0;
+    for (i = 0; i < QUERIES_NUM; i++) {
+        int x = points[2 * i];
+        int y = points[2 * i + 1];
+        found += spatial_find_at(index, 0, x, y) != NULL ? 1 : 0;
+    }
+    long elapsed = get_monotonic_nsec() - start;
+    free(points);
+    /* found is printed to keep the queries from being optimized out. */
+    printf("  found at %d/%d points\n", found, QUERIES_NUM);
+    return (double)elapsed / QUERIES_NUM;
+}
+
+static double
+bench_overlap(SpatialIndex* index, int queries_num)
+{
+    long start = get_monotonic_nsec();
+    long area = 0;
+    int i;
+    for (i = 0; i < queries_num; i++) {
+        SpatialRect rect;
+        rect.width = 800;
+        rect.height = 600;
+        rect.x = random_int(0, SCREEN_WIDTH - rect.width);
+        rect.y = random_int(0, SCREEN_HEIGHT - rect.height);
+        area += spatial_compute_overlap(index, 0, NULL, &rect);
+    }
+    long elapsed = get_monotonic_nsec() - start;
+    printf("  mean overlap: %ld\n", area / queries_num);
+    return (double)elapsed / queries_num;
+}
+
+static double
+bench_snap(SpatialIndex* index, SpatialEntry* entries, int n, int queries_num)
+{
+    SpatialRect bounds = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+    long start = get_monotonic_nsec();
+    int i;
+    for (i = 0; i < queries_num; i++) {
+        SpatialEntry* entry = &entries[i % n];
+        int x = entry->rect.x + random_int(-32, 32);
+        int y = entry->rect.y + random_int(-32, 32);
+        spatial_snap(index, entry, &bounds, &x, &y, 16);
+    }
+    long elapsed = get_monotonic_nsec() - start;
+    return (double)elapsed / queries_num;
+}
+
+static double
+bench_move(SpatialIndex* index, SpatialEntry* entries, int n, int queries_num)
+{
+    long start = get_monotonic_nsec();
+    int i;
+    for (i = 0; i < queries_num; i++) {
+        SpatialEntry* entry = &entries[i % n];
+        SpatialRect* rect = &entry->rect;
+        int x = rect->x + random_int(-8, 8);
+        int y = rect->y + random_int(-8, 8);
+        spatial_update(index, entry, x, y, rect->width, rect->height);
+    }
+    long elapsed = get_monotonic_nsec() - start;
+    return (double)elapsed / queries_num;
+}
+
+static bool
+bench_spatial_index(int n)
+{
+    SpatialIndex* index = (SpatialIndex*)malloc(sizeof(SpatialIndex));
+    SpatialEntry* entries = (SpatialEntry*)malloc(sizeof(SpatialEntry) * n);
+    if ((index == NULL) || (entries == NULL)) {
+        fprintf(stderr, "malloc failed.\n");
+        exit(1);
+    }
+    spatial_initialize(index);
+    fill_spatial_index(index, entries, n);
+
+    printf("spatial index: entries=%d\n", n);
+    double find_at = bench_find_at(index);
+    printf("  find_at: %.1f nsec/query\n", find_at);
+    double overlap = bench_overlap(index, QUERIES_NUM / 10);
+    printf("  compute_overlap: %.1f nsec/query\n", overlap);
+    double snap = bench_snap(index, entries, n, QUERIES_NUM / 10);
+    printf("  snap: %.1f nsec/query\n", snap);
+    double move = bench_move(index, entries, n, QUERIES_NUM / 10);
+    printf("  update: %.1f nsec/move\n", move);
+
+    spatial_dispose(index);
+    free(entries);
+    free(index);
+
+    bool ok = check_budget("find_at", find_at, QUERY_BUDGET_NSEC);
+    ok = check_budget("compute_overlap", overlap, QUERY_BUDGET_NSEC) && ok;
+    return check_budget("snap", snap, QUERY_BUDGET_NSEC) && ok;
+}
+
+static bool
+bench_placement(int n)
+{
+    SpatialIndex* index = (SpatialIndex*)malloc(sizeof(SpatialIndex));
+    SpatialEntry* entries = (SpatialEntry*)malloc(sizeof(SpatialEntry) * n);
+    if ((index == NULL) || (entries == NULL)) {
+        fprintf(stderr, "malloc failed.\n");
+        exit(1);
+    }
+    spatial_initialize(index);
+    fill_spatial_index(index, entries, n);
+
+    SpatialRect bounds = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+    int placements_num = 100;
+    long start = get_monotonic_nsec();
+    int i;
+    for (i = 0; i < placements_num; i++) {
+        int x;
+        int y;
+        spatial_place(index, 0, &bounds, 800, 600, &x, &y);
+    }
+    long elapsed = get_monotonic_nsec() - start;
+    double usec = (double)elapsed / placements_num / 1000;
+    printf("placement: frames=%d, %.1f usec/placement\n", n, usec);
+
+    spatial_dispose(index);
+    free(entries);
+    free(index);
+
+    return check_budget("placement", 1000 * usec, 1000 * PLACEMENT_BUDGET_USEC);
+}
+
+static void
+bench_layout(LayoutType type, const char* name, int n)
+{
+    SpatialRect* rects = (SpatialRect*)malloc(sizeof(SpatialRect) * n);
+    if (rects == NULL) {
+        fprintf(stderr, "malloc failed.\n");
+        exit(1);
+    }
+    SpatialRect bounds = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+    int layouts_num = 10000;
+    long start = get_monotonic_nsec();
+    int i;
+    for (i = 0; i < layouts_num; i++) {
+        layout_compute(type, &bounds, n, 24, rects);
+    }
+    long elapsed = get_monotonic_nsec() - start;
+    double usec = (double)elapsed / layouts_num / 1000;
+    printf("layout: %s, windows=%d, %.2f usec/layout\n", name, n, usec);
+    free(rects);
+}
+
+static void
+bench_trace()
+{
+    TraceWriter* trace = trace_open("/dev/null", false);
+    if (trace == NULL) {
+        perror("/dev/null");
+        exit(1);
+    }
+    static TraceFormat format = { "XMoveWindow(display, w=0x%08x, x=%d, y=%d)" };
+    long start = get_monotonic_nsec();
+    int i;
+    for (i = 0; i < QUERIES_NUM; i++) {
+        trace_write(trace, &format, __FILE__, __LINE__, 0x00c00001, i, -i);
+    }
+    long elapsed = get_monotonic_nsec() - start;
+    trace_close(trace);
+    printf("trace: %.1f nsec/record\n", (double)elapsed / QUERIES_NUM);
+}
+
+static void
+bench_histogram()
+{
+    static Histogram histogram;
+    histogram_initialize(&histogram);
+    long start = get_monotonic_nsec();
+    int i;
+    for (i = 0; i < QUERIES_NUM; i++) {
+        histogram_record(&histogram, 1000 + 37 * i);
+    }
+    long elapsed = get_monotonic_nsec() - start;
+    uint64_t p99 = histogram_percentile(&histogram, 99);
+    printf("histogram: %.1f nsec/record, p99=%lu\n", (double)elapsed / QUERIES_NUM, (unsigned long)p99);
+}
+
+int
+main(int argc, const char* argv[])
+{
+    srand(42);
+    bool ok = true;
+    int sizes[] = { 10, 100, 1000 };
+    int i;
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        ok = bench_spatial_index(sizes[i]) && ok;
+    }
+    int frames[] = { 10, 100, 500 };
+    for (i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+        ok = bench_placement(frames[i]) && ok;
+    }
+    bench_layout(LAYOUT_TYPE_CASCADE, "cascade", 100);
+    bench_layout(LAYOUT_TYPE_GRID, "grid", 100);
+    bench_layout(LAYOUT_TYPE_TILE, "tile", 100);
+    bench_trace();
+    bench_histogram();
+    return ok ? 0 : 1;
+}
+
+/**
+ * vim: tabstop=4 shiftwidth=4 expandtab softtabstop=4
+ */